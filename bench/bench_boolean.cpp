@@ -0,0 +1,178 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_postings.h"
+#include "../include/sch_intersect.h"
+#include "../include/sch_boolean.h"
+#include "../tests/test_util.h"
+
+// Compiled boolean evaluation (n-ary sch_bool_or / sch_bool_and over sorted
+// lists and roaring-style sets) against the pairwise one it replaced: OR folds
+// two lists at a time, NOT materializes the complement, AND intersects the
+// running result with the next operand.
+
+static SchTestRng rng(4242);
+
+static SchVector<int> union_pair(const SchPostingView& l1, const SchPostingView& l2) {
+    SchVector<int> res;
+    SchPostingReader r1(l1), r2(l2);
+    const int32_t *a = nullptr, *b = nullptr;
+    size_t na = 0, nb = 0, i = 0, j = 0;
+    bool has_a = r1.next_block(&a, &na), has_b = r2.next_block(&b, &nb);
+    while (has_a || has_b) {
+        if (!has_b) res.push_back(a[i++]);
+        else if (!has_a) res.push_back(b[j++]);
+        else if (a[i] == b[j]) { res.push_back(a[i]); i++; j++; }
+        else if (a[i] < b[j]) res.push_back(a[i++]);
+        else res.push_back(b[j++]);
+        if (has_a && i == na) { has_a = r1.next_block(&a, &na); i = 0; }
+        if (has_b && j == nb) { has_b = r2.next_block(&b, &nb); j = 0; }
+    }
+    return res;
+}
+
+static SchVector<int> complement(const SchPostingView& l, size_t universe) {
+    SchVector<int> buf, res;
+    const int32_t* ids = sch_materialize(l, buf);
+    size_t j = 0;
+    for (size_t d = 0; d < universe; ++d) {
+        if (j < l.size && ids[j] == (int32_t)d) ++j;
+        else res.push_back((int)d);
+    }
+    return res;
+}
+
+static SchVector<int> intersect_pair(const SchPostingView& l1, const SchPostingView& l2) {
+    SchVector<int> res, scratch;
+    sch_intersect_views(l1, l2, res, scratch);
+    return res;
+}
+
+// Terms by document frequency: stopwords (in a quarter of the documents or
+// more), common (1%..10%) and rare (under 0.1%).
+struct TermClasses {
+    SchVector<size_t> stop, common, rare;
+};
+
+static TermClasses classify(const SchMappedIndex& idx) {
+    TermClasses c;
+    size_t n = idx.doc_count();
+    for (size_t t = 0; t < idx.vocab_size(); ++t) {
+        size_t df = idx.postings(t).size;
+        if (df * 4 >= n) c.stop.push_back(t);
+        else if (df * 100 >= n && df * 10 < n) c.common.push_back(t);
+        else if (df * 1000 < n && df >= 2) c.rare.push_back(t);
+    }
+    return c;
+}
+
+static SchBoolValue leaf(const SchMappedIndex& idx, size_t t) {
+    SchBoolValue v;
+    v.borrowed = true;
+    v.view = idx.postings(t);
+    return v;
+}
+
+static size_t pick(const SchVector<size_t>& terms) { return terms[rng(terms.size())]; }
+
+// One query shape: terms[0..nor) OR-ed, AND-ed with terms[nor..nor+nand), minus
+// terms[nor+nand..); any part may be empty.
+struct Shape {
+    const char* name;
+    size_t nor, nand, nnot;
+};
+
+static void compiled(const SchMappedIndex& idx, const SchVector<size_t>& terms, const Shape& s, SchVector<int>& out) {
+    size_t universe = idx.doc_count();
+    SchVector<SchBoolValue> pos, neg;
+    if (s.nor) {
+        SchVector<SchBoolValue> kids;
+        for (size_t i = 0; i < s.nor; ++i) kids.push_back(leaf(idx, terms[i]));
+        pos.push_back(SchBoolValue());
+        sch_bool_or(kids.begin(), kids.size(), universe, pos[0]);
+    }
+    for (size_t i = s.nor; i < s.nor + s.nand; ++i) pos.push_back(leaf(idx, terms[i]));
+    for (size_t i = s.nor + s.nand; i < terms.size(); ++i) neg.push_back(leaf(idx, terms[i]));
+    SchBoolValue v;
+    if (pos.size() == 1 && neg.size() == 0) v = std::move(pos[0]);
+    else sch_bool_and(pos.begin(), pos.size(), neg.begin(), neg.size(), universe, v);
+    v.to_ids(out);
+}
+
+static void pairwise(const SchMappedIndex& idx, const SchVector<size_t>& terms, const Shape& s, SchVector<int>& out) {
+    SchVector<int> acc;
+    bool have = false;
+    for (size_t i = 0; i < s.nor; ++i) {
+        acc = have ? union_pair(SchPostingView(acc), idx.postings(terms[i])) : union_pair(idx.postings(terms[i]), SchPostingView());
+        have = true;
+    }
+    for (size_t i = s.nor; i < terms.size(); ++i) {
+        SchVector<int> next;
+        bool negated = i >= s.nor + s.nand;
+        if (negated) next = complement(idx.postings(terms[i]), idx.doc_count());
+        if (!have) acc = negated ? next : union_pair(idx.postings(terms[i]), SchPostingView());
+        else acc = intersect_pair(SchPostingView(acc), negated ? SchPostingView(next) : idx.postings(terms[i]));
+        have = true;
+    }
+    out = acc;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <mapped_index> [<mapped_index> ...]\n", argv[0]);
+        return 1;
+    }
+    for (int a = 1; a < argc; ++a) {
+        SchMappedIndex idx;
+        if (!idx.open(argv[a]) || idx.vocab_size() == 0) { fprintf(stderr, "Cannot open mapped index: %s\n", argv[a]); return 1; }
+        TermClasses c = classify(idx);
+        printf("%s: %zu docs, %zu stopwords, %zu common, %zu rare terms\n", argv[a], (size_t)idx.doc_count(), c.stop.size(), c.common.size(), c.rare.size());
+        if (c.stop.size() == 0 || c.common.size() == 0 || c.rare.size() == 0) continue;
+        Shape shapes[] = {
+            {"common OR x4", 4, 0, 0},
+            {"common OR x16", 16, 0, 0},
+            {"rare OR x16", 16, 0, 0},
+            {"common AND NOT stop", 0, 1, 1},
+            {"rare AND NOT stop", 0, 1, 1},
+            {"(c OR c OR c) AND c AND NOT stop", 3, 1, 1},
+            {"stop AND stop AND NOT stop", 0, 2, 1},
+            {"NOT stop", 0, 0, 1},
+        };
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+            const Shape& shape = shapes[s];
+            bool rare = std::strncmp(shape.name, "rare", 4) == 0;
+            bool dense = std::strncmp(shape.name, "stop", 4) == 0;
+            SchVector< SchVector<size_t> > queries;
+            for (int q = 0; q < 200; ++q) {
+                SchVector<size_t> terms;
+                for (size_t i = 0; i < shape.nor + shape.nand; ++i) terms.push_back(pick(rare ? c.rare : (dense ? c.stop : c.common)));
+                for (size_t i = 0; i < shape.nnot; ++i) terms.push_back(pick(c.stop));
+                queries.push_back(terms);
+            }
+            // An untimed pass first, so that neither side pays for faulting in
+            // the postings of the mapping.
+            SchVector<int> out;
+            for (size_t q = 0; q < queries.size(); ++q) pairwise(idx, queries[q], shape, out);
+            size_t compiled_total = 0, pair_total = 0;
+            double t0 = now_sec();
+            for (size_t q = 0; q < queries.size(); ++q) {
+                compiled(idx, queries[q], shape, out);
+                compiled_total += out.size();
+            }
+            double compiled_sec = now_sec() - t0;
+            t0 = now_sec();
+            for (size_t q = 0; q < queries.size(); ++q) {
+                pairwise(idx, queries[q], shape, out);
+                pair_total += out.size();
+            }
+            double pair_sec = now_sec() - t0;
+            if (compiled_total != pair_total) { fprintf(stderr, "%s: result mismatch\n", shape.name); return 1; }
+            printf("  %-34s %9.1f docs/query  compiled %8.1f us (%7.0f q/s)  pairwise %8.1f us (%7.0f q/s)\n", shape.name,
+                   (double)compiled_total / queries.size(), compiled_sec * 1e6 / queries.size(), queries.size() / compiled_sec,
+                   pair_sec * 1e6 / queries.size(), queries.size() / pair_sec);
+        }
+    }
+    return 0;
+}
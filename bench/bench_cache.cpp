@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_mapped_index.h"
+#include "../tests/test_util.h"
+
+// Replays a query log through search_cli with different --cache sizes. The
+// replay draws log queries with Zipf-like skew and rewrites them into
+// equivalent forms (operand order, operator and term case), extends some of
+// them with one more AND term (a cached prefix), and mixes in a tail of
+// one-off queries over random index terms.
+
+static SchTestRng rng(1515);
+
+static const size_t SCH_REPLAY_QUERIES = 20000;
+
+static void append(SchVector<char>& out, const char* s, bool shout) {
+    for (; *s; ++s) out.push_back(shout && *s >= 'a' && *s <= 'z' ? (char)(*s - 'a' + 'A') : *s);
+}
+
+// "a OP b" or "a b" with the operands swapped and the case changed at random.
+static void rewrite(const SchString& q, SchVector<char>& out) {
+    char buf[1024];
+    std::strncpy(buf, q.c_str(), sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    const char* parts[3] = {nullptr, nullptr, nullptr};
+    size_t n = 0;
+    for (char* t = std::strtok(buf, " "); t && n < 3; t = std::strtok(nullptr, " ")) parts[n++] = t;
+    const char* a = parts[0];
+    const char* b = n == 3 ? parts[2] : parts[1];
+    const char* op = n == 3 ? parts[1] : nullptr;
+    if (b && rng(2)) { const char* t = a; a = b; b = t; }
+    append(out, a, rng(4) == 0);
+    if (op) { out.push_back(' '); append(out, op, rng(2)); }
+    if (b) { out.push_back(' '); append(out, b, rng(4) == 0); }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s <search_cli> <index> <queries.txt> <replay_out>\n", argv[0]);
+        return 1;
+    }
+    SchMappedIndex idx;
+    if (!idx.open(argv[2])) { fprintf(stderr, "Need a mapped index: %s\n", argv[2]); return 1; }
+    SchVector<SchString> log;
+    FILE* f = fopen(argv[3], "r");
+    if (!f) { fprintf(stderr, "Cannot open queries: %s\n", argv[3]); return 1; }
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        size_t n = std::strlen(line);
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[--n] = '\0';
+        if (n) log.push_back(SchString(line));
+    }
+    fclose(f);
+    if (log.size() == 0) { fprintf(stderr, "No queries\n"); return 1; }
+
+    // Zipf weights 1/rank over the log order.
+    SchVector<double> cdf;
+    double total = 0;
+    for (size_t i = 0; i < log.size(); ++i) cdf.push_back(total += 1.0 / (double)(i + 1));
+    FILE* out = fopen(argv[4], "w");
+    if (!out) { fprintf(stderr, "Cannot write %s\n", argv[4]); return 1; }
+    const char* ops[3] = {" AND ", " OR ", " "};
+    SchVector<char> q;
+    size_t tail = 0, extended = 0;
+    for (size_t r = 0; r < SCH_REPLAY_QUERIES; ++r) {
+        q.clear();
+        size_t kind = rng(10);
+        if (kind < 3) {
+            append(q, idx.term_at(rng(idx.vocab_size())).c_str(), false);
+            append(q, ops[rng(3)], false);
+            append(q, idx.term_at(rng(idx.vocab_size())).c_str(), false);
+            tail++;
+        } else {
+            double x = (double)rng(1000000) / 1e6 * total;
+            size_t i = 0;
+            while (i + 1 < log.size() && cdf[i] < x) ++i;
+            rewrite(log[i], q);
+            if (kind == 3) {
+                append(q, " AND ", false);
+                append(q, idx.term_at(rng(idx.vocab_size())).c_str(), false);
+                extended++;
+            }
+        }
+        q.push_back('\n');
+        fwrite(q.begin(), 1, q.size(), out);
+    }
+    fclose(out);
+    printf("%s: %zu queries (%zu over random terms, %zu extending a log query) from %zu log queries\n", argv[4],
+           SCH_REPLAY_QUERIES, tail, extended, log.size());
+
+    const char* sizes[4] = {"0", "64K", "1M", "32M"};
+    for (int s = 0; s < 4; ++s) {
+        char cmd[8192];
+        snprintf(cmd, sizeof(cmd), "%s --cache %s %s < %s 2>&1 >/dev/null", argv[1], sizes[s], argv[2], argv[4]);
+        double t0 = now_sec();
+        FILE* p = popen(cmd, "r");
+        if (!p) { fprintf(stderr, "Cannot run %s\n", cmd); return 1; }
+        SchVector<SchString> stats;
+        while (fgets(line, sizeof(line), p)) {
+            if (std::strncmp(line, "Cache ", 6) == 0) stats.push_back(SchString(line));
+        }
+        int status = pclose(p);
+        double elapsed = now_sec() - t0;
+        if (status != 0) { fprintf(stderr, "%s failed\n", cmd); return 1; }
+        printf("  --cache %-4s %8.2f us/query\n", sizes[s], elapsed * 1e6 / SCH_REPLAY_QUERIES);
+        for (size_t i = 0; i < stats.size(); ++i) printf("      %s", stats[i].c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_postings.h"
+#include "../include/sch_intersect.h"
+#include "../include/sch_boolean.h"
+#include "../include/sch_cursor.h"
+#include "../tests/test_util.h"
+
+// The first 15 documents of broad queries (plus counting on to 256 matches for
+// the estimate, as search_cli does) from a tree of cursors, against evaluating
+// the whole result with sch_bool_or / sch_bool_and and cutting it afterwards.
+
+static SchTestRng rng(2121);
+
+static const size_t SHOWN = 15;
+static const size_t SAMPLE = 256;
+
+// Terms by document frequency: stopwords (in a quarter of the documents or
+// more) and common (1%..10%).
+struct TermClasses {
+    SchVector<size_t> stop, common;
+};
+
+static TermClasses classify(const SchMappedIndex& idx) {
+    TermClasses c;
+    size_t n = idx.doc_count();
+    for (size_t t = 0; t < idx.vocab_size(); ++t) {
+        size_t df = idx.postings(t).size;
+        if (df * 4 >= n) c.stop.push_back(t);
+        else if (df * 100 >= n && df * 10 < n) c.common.push_back(t);
+    }
+    return c;
+}
+
+// terms[0..nor) OR-ed, AND-ed with terms[nor..nor+nand), minus the rest.
+struct Shape {
+    const char* name;
+    size_t nor, nand, nnot;
+    bool or_stop;
+};
+
+static SchBoolValue leaf(const SchMappedIndex& idx, size_t t) {
+    SchBoolValue v;
+    v.borrowed = true;
+    v.view = idx.postings(t);
+    return v;
+}
+
+static size_t full(const SchMappedIndex& idx, const SchVector<size_t>& terms, const Shape& s, SchVector<int>& out) {
+    size_t universe = idx.doc_count();
+    SchVector<SchBoolValue> pos, neg;
+    if (s.nor) {
+        SchVector<SchBoolValue> kids;
+        for (size_t i = 0; i < s.nor; ++i) kids.push_back(leaf(idx, terms[i]));
+        pos.push_back(SchBoolValue());
+        sch_bool_or(kids.begin(), kids.size(), universe, pos[0]);
+    }
+    for (size_t i = s.nor; i < s.nor + s.nand; ++i) pos.push_back(leaf(idx, terms[i]));
+    for (size_t i = s.nor + s.nand; i < terms.size(); ++i) neg.push_back(leaf(idx, terms[i]));
+    SchBoolValue v;
+    if (pos.size() == 1 && neg.size() == 0) v = std::move(pos[0]);
+    else sch_bool_and(pos.begin(), pos.size(), neg.begin(), neg.size(), universe, v);
+    v.to_ids(out);
+    size_t total = out.size();
+    if (out.size() > SHOWN) out.resize(SHOWN);
+    return total;
+}
+
+static size_t lazy(const SchMappedIndex& idx, const SchVector<size_t>& terms, const Shape& s, SchVector<int>& out) {
+    SchVector<SchDocCursor*> pos, neg;
+    if (s.nor) {
+        SchVector<SchDocCursor*> kids;
+        for (size_t i = 0; i < s.nor; ++i) kids.push_back(new SchPostingCursor(idx.postings(terms[i])));
+        pos.push_back(new SchOrCursor(kids));
+    }
+    for (size_t i = s.nor; i < s.nor + s.nand; ++i) pos.push_back(new SchPostingCursor(idx.postings(terms[i])));
+    for (size_t i = s.nor + s.nand; i < terms.size(); ++i) neg.push_back(new SchPostingCursor(idx.postings(terms[i])));
+    if (pos.size() == 0) pos.push_back(new SchRangeCursor(idx.doc_count()));
+    SchDocCursor* c = pos.size() == 1 && neg.size() == 0 ? pos[0] : new SchAndCursor(pos, neg);
+    out.clear();
+    size_t seen = 0;
+    int32_t d = c->doc();
+    for (; d != SCH_DOC_END && seen < SAMPLE; d = c->next(), ++seen) {
+        if (out.size() < SHOWN) out.push_back(d);
+    }
+    size_t total = d == SCH_DOC_END ? seen : sch_estimate_count(seen, d, idx.doc_count(), c->cost());
+    delete c;
+    return total;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <mapped_index> [<mapped_index> ...]\n", argv[0]);
+        return 1;
+    }
+    for (int a = 1; a < argc; ++a) {
+        SchMappedIndex idx;
+        if (!idx.open(argv[a]) || idx.vocab_size() == 0) { fprintf(stderr, "Cannot open mapped index: %s\n", argv[a]); return 1; }
+        TermClasses c = classify(idx);
+        printf("%s: %zu docs, %zu stopwords, %zu common terms\n", argv[a], (size_t)idx.doc_count(), c.stop.size(), c.common.size());
+        if (c.stop.size() < 2 || c.common.size() < 2) continue;
+        Shape shapes[] = {
+            {"stop OR stop", 2, 0, 0, true},
+            {"common OR common OR common", 3, 0, 0, false},
+            {"stop AND stop", 0, 2, 0, false},
+            {"(common OR common) AND stop", 2, 1, 0, false},
+            {"stop AND NOT common", 0, 1, 1, false},
+            {"NOT common", 0, 0, 1, false},
+        };
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+            const Shape& shape = shapes[s];
+            SchVector< SchVector<size_t> > queries;
+            for (int q = 0; q < 200; ++q) {
+                SchVector<size_t> terms;
+                for (size_t i = 0; i < shape.nor; ++i) terms.push_back(shape.or_stop ? c.stop[rng(c.stop.size())] : c.common[rng(c.common.size())]);
+                for (size_t i = 0; i < shape.nand; ++i) terms.push_back(c.stop[rng(c.stop.size())]);
+                for (size_t i = 0; i < shape.nnot; ++i) terms.push_back(c.common[rng(c.common.size())]);
+                queries.push_back(terms);
+            }
+            SchVector<int> a_out, b_out;
+            for (size_t q = 0; q < queries.size(); ++q) full(idx, queries[q], shape, a_out);
+            double full_total = 0, lazy_total = 0, err = 0;
+            double t0 = now_sec();
+            for (size_t q = 0; q < queries.size(); ++q) full_total += full(idx, queries[q], shape, a_out);
+            double full_sec = now_sec() - t0;
+            t0 = now_sec();
+            for (size_t q = 0; q < queries.size(); ++q) lazy_total += lazy(idx, queries[q], shape, b_out);
+            double lazy_sec = now_sec() - t0;
+            for (size_t q = 0; q < queries.size(); ++q) {
+                size_t exact = full(idx, queries[q], shape, a_out);
+                size_t est = lazy(idx, queries[q], shape, b_out);
+                bool same = a_out.size() == b_out.size();
+                for (size_t i = 0; same && i < a_out.size(); ++i) same = a_out[i] == b_out[i];
+                if (!same) { fprintf(stderr, "%s: first documents differ\n", shape.name); return 1; }
+                err += exact ? (est > exact ? est - exact : exact - est) / (double)exact : 0;
+            }
+            printf("  %-28s %9.0f docs/query  full %8.1f us  first %zu %7.1f us  count error %5.1f%%\n", shape.name,
+                   full_total / queries.size(), full_sec * 1e6 / queries.size(), SHOWN, lazy_sec * 1e6 / queries.size(),
+                   err * 100 / queries.size());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../tests/test_util.h"
+
+// Separate-chaining map that SchStringHashMap replaced, kept as the baseline.
+template <typename V>
+class ChainedStringHashMap {
+private:
+    struct Node {
+        char* key; // C-string copied
+        V value;
+        Node* next;
+        Node(const char* k, const V& v) : value(v), next(nullptr) {
+            size_t ln = std::strlen(k);
+            key = new char[ln + 1];
+            std::memcpy(key, k, ln + 1);
+        }
+        ~Node() { delete[] key; }
+    };
+
+    Node** buckets;
+    size_t bucket_count;
+    size_t size_;
+
+    size_t hash_cstr(const char* key) const {
+        unsigned long h = 2166136261u;
+        for (const unsigned char* p = (const unsigned char*)key; *p; ++p) {
+            h = (h ^ (*p)) * 16777619u;
+        }
+        return (size_t)(h % bucket_count);
+    }
+
+public:
+    ChainedStringHashMap(size_t buckets_init = 10007) : bucket_count(buckets_init), size_(0) {
+        buckets = new Node*[bucket_count];
+        for (size_t i = 0; i < bucket_count; ++i) buckets[i] = nullptr;
+    }
+    ~ChainedStringHashMap() {
+        clear();
+        delete[] buckets;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            Node* cur = buckets[i];
+            while (cur) {
+                Node* tmp = cur;
+                cur = cur->next;
+                delete tmp;
+            }
+            buckets[i] = nullptr;
+        }
+        size_ = 0;
+    }
+
+    void insert(const SchString& key, const V& value) {
+        const char* k = key.c_str();
+        size_t h = hash_cstr(k);
+        Node* cur = buckets[h];
+        while (cur) {
+            if (std::strcmp(cur->key, k) == 0) {
+                cur->value = value;
+                return;
+            }
+            cur = cur->next;
+        }
+        Node* node = new Node(k, value);
+        node->next = buckets[h];
+        buckets[h] = node;
+        size_++;
+    }
+
+    V* get(const SchString& key) {
+        const char* k = key.c_str();
+        size_t h = hash_cstr(k);
+        Node* cur = buckets[h];
+        while (cur) {
+            if (std::strcmp(cur->key, k) == 0) return &(cur->value);
+            cur = cur->next;
+        }
+        return nullptr;
+    }
+
+    SchVector<SchString> get_keys() const {
+        SchVector<SchString> keys;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            Node* cur = buckets[i];
+            while (cur) {
+                keys.push_back(SchString(cur->key));
+                cur = cur->next;
+            }
+        }
+        return keys;
+    }
+
+    size_t size() const { return size_; }
+};
+
+static SchVector<SchString> load_vocabulary(const char* csv_path) {
+    SchVector<SchString> terms;
+    FILE* f = fopen(csv_path, "r");
+    if (!f) { fprintf(stderr, "Cannot open vocabulary: %s\n", csv_path); exit(1); }
+    char line[1024];
+    if (!fgets(line, sizeof(line), f)) { fclose(f); return terms; }
+    while (fgets(line, sizeof(line), f)) {
+        char* comma = std::strrchr(line, ',');
+        if (!comma || comma == line) continue;
+        terms.push_back(SchString(line, (size_t)(comma - line)));
+    }
+    fclose(f);
+    return terms;
+}
+
+template <typename Map>
+static void run(const char* name, const SchVector<SchString>& terms, const SchVector<SchString>& misses,
+                size_t buckets, int rounds) {
+    double insert_sec = 0, lookup_sec = 0, miss_sec = 0;
+    long long checksum = 0;
+    for (int r = 0; r < rounds; ++r) {
+        Map map(buckets);
+        double t0 = now_sec();
+        for (size_t i = 0; i < terms.size(); ++i) map.insert(terms[i], (int)i);
+        double t1 = now_sec();
+        for (size_t i = 0; i < terms.size(); ++i) checksum += *map.get(terms[i]);
+        double t2 = now_sec();
+        for (size_t i = 0; i < misses.size(); ++i) {
+            if (map.get(misses[i])) checksum++;
+        }
+        double t3 = now_sec();
+        insert_sec += t1 - t0;
+        lookup_sec += t2 - t1;
+        miss_sec += t3 - t2;
+    }
+    double n = (double)terms.size() * rounds;
+    printf("%-10s insert %7.1f ns/op  hit %7.1f ns/op  miss %7.1f ns/op  (checksum %lld)\n",
+           name, insert_sec / n * 1e9, lookup_sec / n * 1e9, miss_sec / n * 1e9, checksum);
+}
+
+int main(int argc, char* argv[]) {
+    const char* csv = argc > 1 ? argv[1] : "dumps/main_index.bin.csv";
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+    SchVector<SchString> terms = load_vocabulary(csv);
+    SchVector<SchString> misses;
+    for (size_t i = 0; i < terms.size(); ++i) misses.push_back(SchString((std::string(terms[i].c_str()) + "#").c_str()));
+    printf("vocabulary: %zu terms from %s\n", terms.size(), csv);
+    run< ChainedStringHashMap<int> >("chained", terms, misses, 50000, rounds);
+    run< SchStringHashMap<int> >("open-addr", terms, misses, 50000, rounds);
+    run< ChainedStringHashMap<int> >("chained*", terms, misses, 1024, rounds);
+    run< SchStringHashMap<int> >("open-addr*", terms, misses, 1024, rounds);
+    printf("* = undersized initial table (1024)\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_postings.h"
+#include "../include/sch_intersect.h"
+#include "../tests/test_util.h"
+
+static SchTestRng rng(12345);
+
+typedef size_t (*Kernel)(const int32_t*, size_t, const int32_t*, size_t, int32_t*);
+
+static size_t gallop_kernel(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+    if (na > nb) return sch_intersect_gallop(b, nb, a, na, out);
+    return sch_intersect_gallop(a, na, b, nb, out);
+}
+
+struct PairClass {
+    const char* name;
+    size_t lo1, hi1, lo2, hi2;
+};
+
+static void collect(const SchMappedIndex& idx, size_t lo, size_t hi, SchVector<size_t>& out) {
+    for (size_t t = 0; t < idx.vocab_size(); ++t) {
+        size_t df = idx.postings(t).size;
+        if (df >= lo && df < hi) out.push_back(t);
+    }
+}
+
+static void bench_kernels(const SchMappedIndex& idx) {
+    PairClass classes[] = {
+        {"rare x common", 10, 100, 5000, 1u << 30},
+        {"mid x common", 300, 1500, 5000, 1u << 30},
+        {"mid x mid", 500, 2000, 500, 2000},
+        {"common x common", 5000, 1u << 30, 5000, 1u << 30},
+    };
+    const char* names[] = {"merge", "gallop", "simd", "adaptive"};
+    Kernel kernels[] = {sch_intersect_merge, gallop_kernel, sch_intersect_simd, sch_intersect};
+    SchVector<int> out;
+    out.resize(idx.doc_count());
+    printf("%-16s %8s %10s %10s %10s %10s  (ns per pair)\n", "pair class", "ratio", names[0], names[1], names[2], names[3]);
+    for (size_t c = 0; c < sizeof(classes) / sizeof(classes[0]); ++c) {
+        SchVector<size_t> t1, t2;
+        collect(idx, classes[c].lo1, classes[c].hi1, t1);
+        collect(idx, classes[c].lo2, classes[c].hi2, t2);
+        if (t1.size() == 0 || t2.size() == 0) continue;
+        const int pairs = 300;
+        SchVector<SchPostingView> a, b;
+        double ratio = 0;
+        for (int p = 0; p < pairs; ++p) {
+            a.push_back(idx.postings(t1[rng(t1.size())]));
+            b.push_back(idx.postings(t2[rng(t2.size())]));
+            ratio += (double)b[p].size / a[p].size;
+        }
+        double ns[4];
+        size_t expect = 0;
+        for (int k = 0; k < 4; ++k) {
+            size_t total = 0;
+            int rounds = 5;
+            double t0 = now_sec();
+            for (int r = 0; r < rounds; ++r) {
+                for (int p = 0; p < pairs; ++p) total += kernels[k](a[p].ids, a[p].size, b[p].ids, b[p].size, out.begin());
+            }
+            ns[k] = (now_sec() - t0) * 1e9 / (rounds * pairs);
+            if (k == 0) expect = total;
+            else if (total != expect) { fprintf(stderr, "kernel %s disagrees with merge\n", names[k]); exit(1); }
+        }
+        printf("%-16s %8.1f %10.0f %10.0f %10.0f %10.0f\n", classes[c].name, ratio / pairs, ns[0], ns[1], ns[2], ns[3]);
+    }
+}
+
+// AND chains of one common term followed by two rarer ones, as typed by users
+// ("the AND kernel AND slab"): left to right versus the shortest-first planner.
+static void bench_chains(const char* path) {
+    SchMappedIndex idx;
+    if (!idx.open(path)) { fprintf(stderr, "Cannot open mapped index: %s\n", path); exit(1); }
+    SchVector<size_t> common, mid, rare;
+    collect(idx, 10000, 1u << 30, common);
+    collect(idx, 1000, 10000, mid);
+    collect(idx, 20, 1000, rare);
+    if (common.size() == 0 || mid.size() == 0 || rare.size() == 0) return;
+    const int queries = 500;
+    SchVector<SchPostingView> chains;
+    for (int q = 0; q < queries; ++q) {
+        chains.push_back(idx.postings(common[rng(common.size())]));
+        chains.push_back(idx.postings(mid[rng(mid.size())]));
+        chains.push_back(idx.postings(rare[rng(rare.size())]));
+    }
+    size_t left_total = 0, plan_total = 0;
+    SchVector<int> acc, next, scratch;
+    double t0 = now_sec();
+    for (int q = 0; q < queries; ++q) {
+        sch_intersect_views(chains[3 * q], chains[3 * q + 1], acc, scratch);
+        sch_intersect_views(SchPostingView(acc), chains[3 * q + 2], next, scratch);
+        left_total += next.size();
+    }
+    double left_us = (now_sec() - t0) * 1e6 / queries;
+    t0 = now_sec();
+    for (int q = 0; q < queries; ++q) {
+        SchPostingView lists[3] = {chains[3 * q], chains[3 * q + 1], chains[3 * q + 2]};
+        plan_total += sch_intersect_all(lists, 3).size();
+    }
+    double plan_us = (now_sec() - t0) * 1e6 / queries;
+    if (left_total != plan_total) { fprintf(stderr, "planner result differs\n"); exit(1); }
+    printf("%s (%s): common AND mid AND rare, left-to-right %.1f us/query, planned %.1f us/query\n",
+           path, idx.compressed() ? "block-packed" : "raw", left_us, plan_us);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <raw_mapped_index> [<mapped_index> ...]\n", argv[0]);
+        return 1;
+    }
+    SchMappedIndex idx;
+    if (!idx.open(argv[1]) || idx.compressed()) { fprintf(stderr, "Need a raw mapped index: %s\n", argv[1]); return 1; }
+#if defined(__AVX2__)
+    printf("simd kernel: AVX2 8x8\n");
+#else
+    printf("simd kernel: SSE2 4x4\n");
+#endif
+    bench_kernels(idx);
+    for (int i = 1; i < argc; ++i) bench_chains(argv[i]);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_string_utils.h"
+#include "../include/sch_stemmer.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_intersect.h"
+#include "../include/sch_positions.h"
+#include "../tests/test_util.h"
+
+// Phrase and NEAR/5 queries against plain AND of the same words. Phrases are
+// 2-3 consecutive words taken from random documents of the corpus; NEAR/5
+// pairs the first two words of each phrase.
+
+static SchTestRng rng(2025);
+
+struct Phrase {
+    SchProximityTerm words[3];
+    size_t n;
+};
+
+static void sample_phrases(const SchMappedIndex& idx, const char* corpus, SchVector<Phrase>& out) {
+    SchVector<char> buf;
+    SchVector<int32_t> toks;
+    for (int tries = 0; tries < 5000 && out.size() < 1000; ++tries) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", corpus, idx.doc_name(rng(idx.doc_count())));
+        FILE* f = fopen(path, "rb");
+        if (!f) continue;
+        fseek(f, 0, SEEK_END);
+        long sz = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        buf.resize(sz > 0 ? (size_t)sz : 0);
+        size_t n = sz > 0 ? fread(buf.begin(), 1, (size_t)sz, f) : 0;
+        fclose(f);
+        toks.clear();
+        sch_tokenize_inplace(buf.begin(), n, [&](char* tok, size_t len) {
+            len = sch_stem_inplace(tok, len);
+            toks.push_back((int32_t)idx.find_term(tok, len));
+        });
+        Phrase p;
+        p.n = 2 + rng(2);
+        if (toks.size() < p.n + 1) continue;
+        size_t start = rng(toks.size() - p.n);
+        for (size_t i = 0; i < p.n; ++i) {
+            p.words[i].term = (size_t)toks[start + i];
+            p.words[i].lo = p.words[i].hi = 1;
+        }
+        out.push_back(p);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <positional_index> <corpus_dir>\n", argv[0]);
+        return 1;
+    }
+    SchMappedIndex idx;
+    if (!idx.open(argv[1]) || !idx.has_positions()) { fprintf(stderr, "Need an index built with --positions: %s\n", argv[1]); return 1; }
+    SchVector<Phrase> phrases;
+    sample_phrases(idx, argv[2], phrases);
+    if (phrases.size() == 0) { fprintf(stderr, "No phrases sampled from %s\n", argv[2]); return 1; }
+    printf("%s (%s): postings %.2f MB, positions %.2f MB, %zu phrases\n", argv[1],
+           idx.compressed() ? "block-packed" : "raw", idx.section(SCH_SEC_POSTINGS).size / 1048576.0,
+           (idx.section(SCH_SEC_POS_OFFSETS).size + idx.section(SCH_SEC_POSITIONS).size) / 1048576.0, phrases.size());
+
+    size_t and_docs = 0;
+    double t0 = now_sec();
+    for (size_t i = 0; i < phrases.size(); ++i) {
+        SchPostingView lists[3];
+        for (size_t j = 0; j < phrases[i].n; ++j) lists[j] = idx.postings(phrases[i].words[j].term);
+        and_docs += sch_intersect_all(lists, phrases[i].n).size();
+    }
+    double t_and = now_sec() - t0;
+
+    size_t phrase_docs = 0;
+    t0 = now_sec();
+    for (size_t i = 0; i < phrases.size(); ++i) phrase_docs += sch_proximity_match(idx, phrases[i].words, phrases[i].n).size();
+    double t_phrase = now_sec() - t0;
+
+    size_t near_docs = 0;
+    t0 = now_sec();
+    for (size_t i = 0; i < phrases.size(); ++i) {
+        SchProximityTerm w[2] = {phrases[i].words[0], phrases[i].words[1]};
+        w[1].lo = -5;
+        w[1].hi = 5;
+        near_docs += sch_proximity_match(idx, w, 2).size();
+    }
+    double t_near = now_sec() - t0;
+
+    double q = (double)phrases.size();
+    printf("  %-12s %9.1f us/query  %9.1f docs/query\n", "AND", t_and * 1e6 / q, and_docs / q);
+    printf("  %-12s %9.1f us/query  %9.1f docs/query\n", "phrase", t_phrase * 1e6 / q, phrase_docs / q);
+    printf("  %-12s %9.1f us/query  %9.1f docs/query\n", "NEAR/5 (1,2)", t_near * 1e6 / q, near_docs / q);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_postings.h"
+#include "../tests/test_util.h"
+
+static void report(const char* path) {
+    SchMappedIndex idx;
+    if (!idx.open(path)) { fprintf(stderr, "Cannot open mapped index: %s\n", path); exit(1); }
+
+    size_t total_ids = 0, total_bytes = 0;
+    for (size_t t = 0; t < idx.vocab_size(); ++t) total_ids += idx.postings(t).size;
+    total_bytes = (size_t)idx.section(SCH_SEC_POSTINGS).size;
+
+    // Sum of log2(gap) over all ids: what the doc id order costs a codec that
+    // spends about log2(gap) bits on every gap.
+    double log_gaps = 0;
+    for (size_t t = 0; t < idx.vocab_size(); ++t) {
+        SchPostingReader reader(idx.postings(t));
+        const int32_t* ids = nullptr;
+        size_t n = 0;
+        int32_t prev = -1;
+        while (reader.next_block(&ids, &n)) {
+            for (size_t i = 0; i < n; ++i) {
+                log_gaps += std::log2((double)(ids[i] - prev));
+                prev = ids[i];
+            }
+        }
+    }
+
+    int rounds = 5;
+    long long checksum = 0;
+    double t0 = now_sec();
+    for (int r = 0; r < rounds; ++r) {
+        for (size_t t = 0; t < idx.vocab_size(); ++t) {
+            SchPostingReader reader(idx.postings(t));
+            const int32_t* ids = nullptr;
+            size_t n = 0;
+            while (reader.next_block(&ids, &n)) checksum += ids[n - 1];
+        }
+    }
+    double dt = now_sec() - t0;
+
+    printf("%s: %s postings\n", path, idx.compressed() ? "block-packed" : "raw");
+    printf("  file size:      %zu bytes\n", idx.file_size());
+    printf("  postings bytes: %zu (%.2f bits/id)\n", total_bytes, total_ids ? 8.0 * total_bytes / total_ids : 0.0);
+    printf("  log2 gaps:      %.2f bits/id\n", total_ids ? log_gaps / total_ids : 0.0);
+    printf("  decode:         %.1f M ids/s (checksum %lld)\n", rounds * total_ids / dt / 1e6, checksum);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <mapped_index> [<mapped_index> ...]\n", argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; ++i) report(argv[i]);
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_postings.h"
+#include "../include/sch_intersect.h"
+#include "../tests/test_util.h"
+
+// Dictionary size and lookup cost of the front-coded dictionary against the
+// plain layout (SchDictEntry per term plus NUL-terminated terms, binary search),
+// and prefix* expansion: heap-based multiway union against folding pairwise
+// unions over the matching lists.
+
+static SchTestRng rng(2718);
+
+struct PlainDict {
+    SchVector<SchDictEntry> entries;
+    SchVector<char> terms;
+
+    long find(const char* term, size_t len) const {
+        size_t lo = 0, hi = entries.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            const SchDictEntry& e = entries[mid];
+            size_t n = e.term_len < len ? e.term_len : len;
+            int c = std::memcmp(terms.begin() + e.term_offset, term, n);
+            if (c == 0) c = (e.term_len < len) ? -1 : (e.term_len > len ? 1 : 0);
+            if (c == 0) return (long)mid;
+            if (c < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        return -1;
+    }
+};
+
+static SchVector<int> union_pair(const SchPostingView& l1, const SchPostingView& l2) {
+    SchVector<int> res;
+    SchPostingReader r1(l1), r2(l2);
+    const int32_t *a = nullptr, *b = nullptr;
+    size_t na = 0, nb = 0, i = 0, j = 0;
+    bool has_a = r1.next_block(&a, &na), has_b = r2.next_block(&b, &nb);
+    while (has_a || has_b) {
+        if (!has_b) res.push_back(a[i++]);
+        else if (!has_a) res.push_back(b[j++]);
+        else if (a[i] == b[j]) { res.push_back(a[i]); i++; j++; }
+        else if (a[i] < b[j]) res.push_back(a[i++]);
+        else res.push_back(b[j++]);
+        if (has_a && i == na) { has_a = r1.next_block(&a, &na); i = 0; }
+        if (has_b && j == nb) { has_b = r2.next_block(&b, &nb); j = 0; }
+    }
+    return res;
+}
+
+static void bench_lookups(const SchMappedIndex& idx) {
+    PlainDict plain;
+    SchVector<SchString> probes;
+    for (size_t t = 0; t < idx.vocab_size(); ++t) {
+        SchString term = idx.term_at(t);
+        SchDictEntry e;
+        e.term_offset = plain.terms.size();
+        e.term_len = (uint32_t)term.size();
+        e.postings_offset = 0;
+        e.doc_freq = 0;
+        plain.entries.push_back(e);
+        for (size_t i = 0; i <= term.size(); ++i) plain.terms.push_back(term.c_str()[i]);
+    }
+    for (size_t i = 0; i < 200000; ++i) {
+        SchString term = idx.term_at(rng(idx.vocab_size()));
+        if (i % 4 == 0) {
+            SchVector<char> miss;
+            for (size_t k = 0; k < term.size(); ++k) miss.push_back(term.c_str()[k]);
+            miss.push_back('q');
+            term = SchString(miss.begin(), miss.size());
+        }
+        probes.push_back(term);
+    }
+    size_t front_bytes = idx.section(SCH_SEC_DICT).size + idx.section(SCH_SEC_TERMS).size + idx.section(SCH_SEC_TERM_BLOCKS).size;
+    size_t plain_bytes = plain.entries.size() * sizeof(SchDictEntry) + plain.terms.size();
+    printf("  dictionary: %zu terms, plain %.2f MB, front-coded %.2f MB (%.1f%%)\n", (size_t)idx.vocab_size(),
+           plain_bytes / 1048576.0, front_bytes / 1048576.0, 100.0 * front_bytes / plain_bytes);
+    long hits = 0;
+    double t0 = now_sec();
+    for (size_t i = 0; i < probes.size(); ++i) hits += plain.find(probes[i].c_str(), probes[i].size()) >= 0;
+    double plain_ns = (now_sec() - t0) * 1e9 / probes.size();
+    long front_hits = 0;
+    t0 = now_sec();
+    for (size_t i = 0; i < probes.size(); ++i) front_hits += idx.find_term(probes[i].c_str(), probes[i].size()) >= 0;
+    double front_ns = (now_sec() - t0) * 1e9 / probes.size();
+    if (hits != front_hits) { fprintf(stderr, "lookup mismatch\n"); exit(1); }
+    printf("  lookup:     plain %.1f ns, front-coded %.1f ns (%ld of %zu found)\n", plain_ns, front_ns, hits, probes.size());
+}
+
+static void bench_prefixes(const SchMappedIndex& idx) {
+    for (size_t plen = 1; plen <= 4; ++plen) {
+        SchVector<SchString> prefixes;
+        for (int q = 0; q < 200; ++q) {
+            SchString term = idx.term_at(rng(idx.vocab_size()));
+            if (term.size() >= plen) prefixes.push_back(SchString(term.c_str(), plen));
+        }
+        size_t terms = 0, heap_total = 0, pair_total = 0;
+        double heap_sec = 0, pair_sec = 0;
+        SchVector<SchPostingView> lists;
+        SchVector<int> out;
+        for (size_t q = 0; q < prefixes.size(); ++q) {
+            size_t first = 0, last = 0;
+            double t0 = now_sec();
+            idx.prefix_range(prefixes[q].c_str(), plen, &first, &last);
+            lists.clear();
+            for (size_t t = first; t < last; ++t) lists.push_back(idx.postings(t));
+            sch_union_all(lists.begin(), lists.size(), out);
+            heap_sec += now_sec() - t0;
+            heap_total += out.size();
+            terms += last - first;
+
+            t0 = now_sec();
+            SchVector<int> acc;
+            for (size_t t = first; t < last; ++t) acc = union_pair(SchPostingView(acc), idx.postings(t));
+            pair_sec += now_sec() - t0;
+            pair_total += acc.size();
+        }
+        if (heap_total != pair_total) { fprintf(stderr, "union mismatch\n"); exit(1); }
+        size_t n = prefixes.size() ? prefixes.size() : 1;
+        printf("  prefix len %zu: %7.1f terms, %8.1f docs/query  heap %9.1f us  pairwise %9.1f us\n", plen,
+               (double)terms / n, (double)heap_total / n, heap_sec * 1e6 / n, pair_sec * 1e6 / n);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <mapped_index> [<mapped_index> ...]\n", argv[0]);
+        return 1;
+    }
+    for (int a = 1; a < argc; ++a) {
+        SchMappedIndex idx;
+        if (!idx.open(argv[a]) || idx.vocab_size() == 0) { fprintf(stderr, "Cannot open mapped index: %s\n", argv[a]); return 1; }
+        printf("%s\n", argv[a]);
+        bench_lookups(idx);
+        bench_prefixes(idx);
+    }
+    return 0;
+}
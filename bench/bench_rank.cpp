@@ -0,0 +1,101 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_string_utils.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_intersect.h"
+#include "../include/sch_rank.h"
+#include "../tests/test_util.h"
+
+static SchTestRng rng(2024);
+
+struct Query {
+    size_t terms[8];
+    size_t n;
+};
+
+static void load_queries(const char* path, const SchMappedIndex& idx, SchVector<Query>& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) { fprintf(stderr, "Cannot open queries: %s\n", path); exit(1); }
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        Query q;
+        q.n = 0;
+        size_t len = std::strlen(line);
+        sch_tokenize_inplace(line, len, [&](char* tok, size_t tok_len) {
+            if (q.n >= 8) return;
+            if ((tok_len == 3 && std::memcmp(tok, "and", 3) == 0) || (tok_len == 2 && std::memcmp(tok, "or", 2) == 0)) return;
+            size_t stem_len = sch_stem_inplace(tok, tok_len);
+            long t = idx.find_term(tok, stem_len);
+            if (t >= 0) q.terms[q.n++] = (size_t)t;
+        });
+        if (q.n) out.push_back(q);
+    }
+    fclose(f);
+}
+
+static void sample_queries(const SchMappedIndex& idx, SchVector<Query>& out) {
+    SchVector<size_t> pools[3];
+    for (size_t t = 0; t < idx.vocab_size(); ++t) {
+        size_t df = idx.postings(t).size;
+        if (df >= 5 && df < 200) pools[0].push_back(t);
+        else if (df >= 200 && df < 3000) pools[1].push_back(t);
+        else if (df >= 3000) pools[2].push_back(t);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        Query q = Query();
+        q.n = 2 + rng(3);
+        for (size_t j = 0; j < q.n; ++j) {
+            size_t p = rng(3);
+            while (pools[p].size() == 0) p = (p + 1) % 3;
+            q.terms[j] = pools[p][rng(pools[p].size())];
+        }
+        out.push_back(q);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <mapped_index> [queries.txt]\n", argv[0]);
+        return 1;
+    }
+    SchMappedIndex idx;
+    if (!idx.open(argv[1]) || !idx.has_scores()) { fprintf(stderr, "Need a mapped index with scores: %s\n", argv[1]); return 1; }
+    SchVector<Query> queries;
+    if (argc > 2) load_queries(argv[2], idx, queries);
+    else sample_queries(idx, queries);
+    if (queries.size() == 0) { fprintf(stderr, "No queries\n"); return 1; }
+    printf("%s (%s): %zu queries\n", argv[1], idx.compressed() ? "block-packed" : "raw", queries.size());
+
+    size_t checksum = 0;
+    double t0 = now_sec();
+    for (size_t i = 0; i < queries.size(); ++i) {
+        SchPostingView lists[8];
+        for (size_t j = 0; j < queries[i].n; ++j) lists[j] = idx.postings(queries[i].terms[j]);
+        checksum += sch_intersect_all(lists, queries[i].n).size();
+    }
+    printf("  %-24s %9.1f us/query\n", "boolean AND", (now_sec() - t0) * 1e6 / queries.size());
+
+    size_t ks[] = {10, 100};
+    for (size_t ki = 0; ki < 2; ++ki) {
+        for (int pruned = 0; pruned < 2; ++pruned) {
+            SchVector<SchTermCursor> cursors;
+            cursors.resize(8);
+            t0 = now_sec();
+            for (size_t i = 0; i < queries.size(); ++i) {
+                for (size_t j = 0; j < queries[i].n; ++j) cursors[j].init(idx, queries[i].terms[j]);
+                SchTopK top(ks[ki]);
+                if (pruned) sch_maxscore_topk(idx, cursors.begin(), queries[i].n, top);
+                else sch_exhaustive_topk(idx, cursors.begin(), queries[i].n, top);
+                checksum += top.size();
+            }
+            char label[64];
+            snprintf(label, sizeof(label), "BM25 top-%zu %s", ks[ki], pruned ? "MaxScore" : "exhaustive");
+            printf("  %-24s %9.1f us/query\n", label, (now_sec() - t0) * 1e6 / queries.size());
+        }
+    }
+    printf("  (checksum %zu)\n", checksum);
+    return 0;
+}
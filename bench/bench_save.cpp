@@ -0,0 +1,168 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_sort.h"
+#include "../tests/test_util.h"
+
+// The pieces of index_builder's save phase, old against new: sorting the
+// vocabulary (quicksort of term ids by strcmp against MSD radix sort over
+// handles), the Zipf table (quicksort of copied term/frequency pairs against a
+// radix sort of ids by frequency) and writing the legacy records (fwrite per
+// field through the default stdio buffer against a 4M buffer).
+
+static SchTestRng rng(2222);
+
+template <typename T, typename Comp>
+static void quicksort(SchVector<T>& arr, int left, int right, Comp comp) {
+    if (left >= right) return;
+    int i = left, j = right;
+    T pivot = arr[(left + right) / 2];
+    while (i <= j) {
+        while (comp(arr.at_unchecked(i), pivot)) ++i;
+        while (comp(pivot, arr.at_unchecked(j))) --j;
+        if (i <= j) {
+            std::swap(arr.at_unchecked(i), arr.at_unchecked(j));
+            ++i; --j;
+        }
+    }
+    if (left < j) quicksort(arr, left, j, comp);
+    if (i < right) quicksort(arr, i, right, comp);
+}
+
+// Terms and frequencies of a Zipf table, shuffled to stand in for the
+// first-seen order of the interner.
+struct Vocabulary {
+    SchVector<SchString> terms;
+    SchVector<int> freqs;
+};
+
+static bool load_vocabulary(const char* csv_path, Vocabulary& v) {
+    FILE* f = fopen(csv_path, "r");
+    if (!f) return false;
+    char line[1024];
+    if (!fgets(line, sizeof(line), f)) { fclose(f); return true; }
+    while (fgets(line, sizeof(line), f)) {
+        char* comma = std::strrchr(line, ',');
+        if (!comma || comma == line) continue;
+        v.terms.push_back(SchString(line, (size_t)(comma - line)));
+        v.freqs.push_back(std::atoi(comma + 1));
+    }
+    fclose(f);
+    for (size_t i = v.terms.size(); i > 1; --i) {
+        size_t j = rng(i);
+        std::swap(v.terms[i - 1], v.terms[j]);
+        std::swap(v.freqs[i - 1], v.freqs[j]);
+    }
+    return true;
+}
+
+static const int ROUNDS = 5;
+
+static void bench_vocabulary_sort(const Vocabulary& v) {
+    size_t n = v.terms.size();
+    double old_best = 1e9, new_best = 1e9;
+    SchVector<uint32_t> a, b;
+    for (int r = 0; r < ROUNDS; ++r) {
+        a.clear();
+        for (size_t i = 0; i < n; ++i) a.push_back((uint32_t)i);
+        double t0 = now_sec();
+        auto comp = [&v](const uint32_t& x, const uint32_t& y){ return std::strcmp(v.terms[x].c_str(), v.terms[y].c_str()) < 0; };
+        quicksort<uint32_t, decltype(comp)>(a, 0, (int)n - 1, comp);
+        double t1 = now_sec();
+        SchVector<SchStrHandle> h;
+        h.reserve(n);
+        for (size_t i = 0; i < n; ++i) h.push_back(SchStrHandle{(const unsigned char*)v.terms[i].c_str(), (uint32_t)i});
+        sch_sort_strings(h);
+        b.clear();
+        for (size_t i = 0; i < n; ++i) b.push_back(h[i].id);
+        double t2 = now_sec();
+        if (t1 - t0 < old_best) old_best = t1 - t0;
+        if (t2 - t1 < new_best) new_best = t2 - t1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (a[i] != b[i]) { fprintf(stderr, "vocabulary orders differ at %zu\n", i); exit(1); }
+    }
+    printf("sort vocabulary    quicksort %8.2f ms  radix %8.2f ms\n", old_best * 1e3, new_best * 1e3);
+}
+
+static void bench_zipf_sort(const Vocabulary& v) {
+    size_t n = v.terms.size();
+    double old_best = 1e9, new_best = 1e9;
+    SchVector< SchPair<SchString,int> > arr;
+    SchVector<uint32_t> ids;
+    for (int r = 0; r < ROUNDS; ++r) {
+        double t0 = now_sec();
+        arr.clear();
+        arr.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            SchString term(v.terms[i].c_str(), v.terms[i].size());
+            arr.emplace_back(std::move(term), v.freqs[i]);
+        }
+        auto comp = [](const SchPair<SchString,int>& x, const SchPair<SchString,int>& y){ return x.value > y.value; };
+        if (n > 1) quicksort< SchPair<SchString,int>, decltype(comp) >(arr, 0, (int)n - 1, comp);
+        double t1 = now_sec();
+        SchVector<uint32_t> keys;
+        keys.reserve(n);
+        ids.clear();
+        for (size_t i = 0; i < n; ++i) {
+            keys.push_back(~(uint32_t)v.freqs[i]);
+            ids.push_back((uint32_t)i);
+        }
+        sch_sort_by_key(ids, keys.begin());
+        double t2 = now_sec();
+        if (t1 - t0 < old_best) old_best = t1 - t0;
+        if (t2 - t1 < new_best) new_best = t2 - t1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (arr[i].value != v.freqs[ids[i]]) { fprintf(stderr, "frequency orders differ at %zu\n", i); exit(1); }
+    }
+    printf("sort zipf table    quicksort %8.2f ms  radix %8.2f ms\n", old_best * 1e3, new_best * 1e3);
+}
+
+// One legacy term record per term with a list of freq ids (capped).
+static double write_records(const char* path, const Vocabulary& v, size_t buffer) {
+    static int ids[4096];
+    FILE* out = fopen(path, "wb");
+    if (!out) { fprintf(stderr, "Cannot write %s\n", path); exit(1); }
+    if (buffer) setvbuf(out, nullptr, _IOFBF, buffer);
+    double t0 = now_sec();
+    for (size_t i = 0; i < v.terms.size(); ++i) {
+        size_t term_len = v.terms[i].size();
+        size_t list_size = (size_t)v.freqs[i] < 4096 ? (size_t)v.freqs[i] : 4096;
+        fwrite(&term_len, sizeof(term_len), 1, out);
+        fwrite(v.terms[i].c_str(), 1, term_len, out);
+        fwrite(&list_size, sizeof(list_size), 1, out);
+        fwrite(ids, sizeof(int), list_size, out);
+    }
+    fclose(out);
+    return now_sec() - t0;
+}
+
+static void bench_write(const Vocabulary& v, const char* path) {
+    double old_best = 1e9, new_best = 1e9;
+    for (int r = 0; r < ROUNDS; ++r) {
+        double a = write_records(path, v, 0);
+        double b = write_records(path, v, 4 << 20);
+        if (a < old_best) old_best = a;
+        if (b < new_best) new_best = b;
+    }
+    remove(path);
+    printf("write records      default %8.2f ms  4M buffer %8.2f ms\n", old_best * 1e3, new_best * 1e3);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <zipf.csv> <scratch_file>\n", argv[0]);
+        return 1;
+    }
+    Vocabulary v;
+    if (!load_vocabulary(argv[1], v)) { fprintf(stderr, "Cannot open vocabulary: %s\n", argv[1]); return 1; }
+    printf("vocabulary: %zu terms from %s\n", v.terms.size(), argv[1]);
+    bench_vocabulary_sort(v);
+    bench_zipf_sort(v);
+    bench_write(v, argv[2]);
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_protocol.h"
+#include "../tests/test_util.h"
+
+// Load generator for search_cli --serve: N clients on their own connections
+// each send SCH_BENCH_REQUESTS queries cycling through the query file (throughput and latency per client
+// count), then one client keeps sending a very slow query while another
+// measures the latency of normal queries.
+
+static const size_t SCH_BENCH_REQUESTS = 2000;
+
+static SchVector<SchString> queries;
+
+static bool ask(int fd, const SchString& q, SchVector<char>& frame, SchVector<char>& response) {
+    return sch_send_frame(fd, q.c_str(), q.size(), frame) && sch_recv_frame(fd, response, UINT32_MAX - 1);
+}
+
+static void run_client(const char* addr, size_t first, size_t count, std::vector<double>* lat, std::atomic<bool>* failed) {
+    int fd = sch_connect(addr);
+    if (fd < 0) { *failed = true; return; }
+    SchVector<char> frame, response;
+    for (size_t i = 0; i < count; ++i) {
+        double t0 = now_sec();
+        if (!ask(fd, queries[(first + i) % queries.size()], frame, response)) { *failed = true; break; }
+        lat->push_back(now_sec() - t0);
+    }
+    close(fd);
+}
+
+static double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <unix:PATH|tcp:PORT> <queries.txt> [max_clients]\n", argv[0]);
+        return 1;
+    }
+    const char* addr = argv[1];
+    int max_clients = argc > 3 ? std::atoi(argv[3]) : 8;
+    FILE* f = fopen(argv[2], "r");
+    if (!f) { fprintf(stderr, "Cannot open queries: %s\n", argv[2]); return 1; }
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        size_t n = std::strlen(line);
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[--n] = '\0';
+        if (n) queries.push_back(SchString(line));
+    }
+    fclose(f);
+    if (queries.size() == 0) { fprintf(stderr, "No queries\n"); return 1; }
+    printf("%s: %zu queries, %u hardware threads\n", addr, queries.size(), std::thread::hardware_concurrency());
+
+    std::atomic<bool> failed(false);
+    for (int clients = 1; clients <= max_clients; clients *= 2) {
+        std::vector< std::vector<double> > lat(clients);
+        std::vector<std::thread> threads;
+        double t0 = now_sec();
+        for (int c = 0; c < clients; ++c) {
+            threads.emplace_back(run_client, addr, queries.size() * c / clients, SCH_BENCH_REQUESTS, &lat[c], &failed);
+        }
+        for (size_t c = 0; c < threads.size(); ++c) threads[c].join();
+        double elapsed = now_sec() - t0;
+        std::vector<double> all;
+        for (int c = 0; c < clients; ++c) all.insert(all.end(), lat[c].begin(), lat[c].end());
+        printf("  %2d clients  %9.0f queries/s  p50 %7.1f us  p99 %7.1f us\n", clients, all.size() / elapsed,
+               percentile(all, 0.50) * 1e6, percentile(all, 0.99) * 1e6);
+    }
+
+    SchVector<char> joined;
+    for (size_t i = 0; i < queries.size() && i < 300; ++i) {
+        const char* sep = i ? " OR " : "";
+        for (const char* p = sep; *p; ++p) joined.push_back(*p);
+        for (size_t j = 0; j < queries[i].size(); ++j) joined.push_back(queries[i].c_str()[j]);
+    }
+    SchString slow(joined.begin(), joined.size());
+    std::vector<double> alone, beside;
+    run_client(addr, 0, SCH_BENCH_REQUESTS, &alone, &failed);
+    std::atomic<bool> stop(false);
+    size_t slow_done = 0;
+    double slow_time = 0;
+    std::thread slow_client([&]() {
+        int fd = sch_connect(addr);
+        if (fd < 0) { failed = true; return; }
+        SchVector<char> frame, response;
+        double t0 = now_sec();
+        while (!stop && ask(fd, slow, frame, response)) slow_done++;
+        slow_time = now_sec() - t0;
+        close(fd);
+    });
+    run_client(addr, 0, SCH_BENCH_REQUESTS, &beside, &failed);
+    stop = true;
+    slow_client.join();
+    printf("  normal client alone        p50 %7.1f us  p99 %7.1f us\n", percentile(alone, 0.50) * 1e6, percentile(alone, 0.99) * 1e6);
+    printf("  beside a slow-query client p50 %7.1f us  p99 %7.1f us  (slow query %.1f ms)\n",
+           percentile(beside, 0.50) * 1e6, percentile(beside, 0.99) * 1e6, slow_done ? slow_time * 1e3 / slow_done : 0.0);
+    if (failed) { fprintf(stderr, "Some requests failed\n"); return 1; }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include "../include/sch_containers.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_postings.h"
+#include "../include/sch_intersect.h"
+#include "../tests/test_util.h"
+
+static long minor_faults() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_minflt;
+}
+
+static SchTestRng rng(4242);
+
+struct Pair {
+    size_t rare;
+    size_t common;
+};
+
+// The pre-skip path: every block of the long list is visited (and decoded when
+// compressed), or the whole raw array is handed to the kernels.
+static size_t intersect_scan(const SchPostingView& small, const SchPostingView& large, SchVector<int>& out, SchVector<int>& scratch) {
+    const int32_t* s = sch_materialize(small, scratch);
+    size_t ns = small.size;
+    out.resize(ns);
+    if (!large.compressed()) return sch_intersect(s, ns, large.ids, large.size, out.begin());
+    SchPostingReader r(large);
+    const int32_t* b = nullptr;
+    size_t nb = 0, pos = 0, k = 0;
+    while (pos < ns && r.next_block(&b, &nb)) {
+        if (b[nb - 1] < s[pos]) continue;
+        size_t end = sch_gallop(s, pos, ns, b[nb - 1] + 1);
+        k += sch_intersect(s + pos, end - pos, b, nb, out.begin() + k);
+        pos = end;
+    }
+    return k;
+}
+
+static void run(const char* path, const SchVector<Pair>& pairs, bool skip, size_t* total) {
+    SchMappedIndex idx;
+    if (!idx.open(path)) { fprintf(stderr, "Cannot open mapped index: %s\n", path); exit(1); }
+    SchVector<int> out, scratch;
+    long faults = minor_faults();
+    double t0 = now_sec();
+    size_t sum = 0;
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        SchPostingView a = idx.postings(pairs[i].rare), b = idx.postings(pairs[i].common);
+        if (skip) { sch_intersect_views(a, b, out, scratch); sum += out.size(); }
+        else sum += intersect_scan(a, b, out, scratch);
+    }
+    double us = (now_sec() - t0) * 1e6 / pairs.size();
+    faults = minor_faults() - faults;
+    printf("  %-12s %8.2f us/query  %8ld page faults\n", skip ? "skip_to" : "full scan", us, faults);
+    if (*total == (size_t)-1) *total = sum;
+    else if (*total != sum) { fprintf(stderr, "result mismatch\n"); exit(1); }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <mapped_index> [<mapped_index> ...]\n", argv[0]);
+        return 1;
+    }
+    for (int a = 1; a < argc; ++a) {
+        SchVector<Pair> pairs;
+        {
+            SchMappedIndex idx;
+            if (!idx.open(argv[a])) { fprintf(stderr, "Cannot open mapped index: %s\n", argv[a]); return 1; }
+            SchVector<size_t> rare, common;
+            for (size_t t = 0; t < idx.vocab_size(); ++t) {
+                size_t df = idx.postings(t).size;
+                if (df >= 2 && df <= 50) rare.push_back(t);
+                else if (df >= 5000) common.push_back(t);
+            }
+            if (rare.size() == 0 || common.size() == 0) continue;
+            for (int i = 0; i < 2000; ++i) {
+                Pair p = {rare[rng(rare.size())], common[rng(common.size())]};
+                pairs.push_back(p);
+            }
+            printf("%s (%s, %s): rare (df<=50) AND common (df>=5000)\n", argv[a],
+                   idx.compressed() ? "block-packed" : "raw", idx.postings(common[0]).has_skips() ? "with skips" : "no skips");
+        }
+        size_t total = (size_t)-1;
+        run(argv[a], pairs, false, &total);
+        run(argv[a], pairs, true, &total);
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <vector>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_string_utils.h"
+#include "../include/sch_stemmer.h"
+#include "../tests/reference_text_pipeline.h"
+#include "../tests/test_util.h"
+
+struct Token {
+    size_t offset;
+    size_t len;
+};
+
+int main(int argc, char* argv[]) {
+    const char* corpus = argc > 1 ? argv[1] : "data/corpus";
+    size_t max_docs = argc > 2 ? (size_t)std::atol(argv[2]) : 5000;
+    std::string tokens_text;
+    std::vector<Token> tokens;
+    DIR* dir = opendir(corpus);
+    if (!dir) { fprintf(stderr, "Cannot open corpus: %s\n", corpus); return 1; }
+    struct dirent* ent;
+    size_t docs = 0;
+    while ((ent = readdir(dir)) != NULL && docs < max_docs) {
+        size_t ln = std::strlen(ent->d_name);
+        if (ln <= 4 || std::strcmp(ent->d_name + ln - 4, ".txt") != 0) continue;
+        std::string path = std::string(corpus) + "/" + ent->d_name;
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) continue;
+        std::string text;
+        char buf[65536];
+        size_t r;
+        while ((r = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, r);
+        fclose(f);
+        sch_tokenize_inplace(&text[0], text.size(), [&](const char* tok, size_t len) {
+            Token t = {tokens_text.size(), len};
+            tokens_text.append(tok, len);
+            tokens.push_back(t);
+        });
+        docs++;
+    }
+    closedir(dir);
+    printf("stemming %zu tokens from %zu documents\n", tokens.size(), docs);
+
+    size_t ref_bytes = 0;
+    double t0 = now_sec();
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        ref_bytes += reference_stem(tokens_text.substr(tokens[i].offset, tokens[i].len)).size();
+    }
+    double ref_sec = now_sec() - t0;
+
+    std::string scratch;
+    size_t inplace_bytes = 0;
+    scratch = tokens_text;
+    t0 = now_sec();
+    for (size_t i = 0; i < tokens.size(); ++i) inplace_bytes += sch_stem_inplace(&scratch[tokens[i].offset], tokens[i].len);
+    double inplace_sec = now_sec() - t0;
+
+    printf("reference (std::function): %8.2f M tokens/s\n", tokens.size() / ref_sec / 1e6);
+    printf("in-place:                  %8.2f M tokens/s\n", tokens.size() / inplace_sec / 1e6);
+
+    size_t sizes[] = {1024, 8192, 65536};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        SchStemCache cache(sizes[s]);
+        size_t cached_bytes = 0;
+        scratch = tokens_text;
+        t0 = now_sec();
+        for (size_t i = 0; i < tokens.size(); ++i) cached_bytes += cache.stem(&scratch[tokens[i].offset], tokens[i].len);
+        double sec = now_sec() - t0;
+        printf("in-place + cache %6zu:    %8.2f M tokens/s  (hit rate %.1f%%)\n", sizes[s], tokens.size() / sec / 1e6,
+               100.0 * cache.hits() / (cache.hits() + cache.misses() ? cache.hits() + cache.misses() : 1));
+        if (cached_bytes != ref_bytes) { fprintf(stderr, "cached stems differ from reference\n"); return 1; }
+    }
+    if (inplace_bytes != ref_bytes) { fprintf(stderr, "in-place stems differ from reference\n"); return 1; }
+    return 0;
+}
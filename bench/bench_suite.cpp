@@ -0,0 +1,541 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_string_utils.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_postings.h"
+#include "../include/sch_intersect.h"
+#include "../tests/test_util.h"
+
+// The suite behind `make bench`. Runs index_builder over the corpus once per
+// index format (throughput, peak RSS, index size), once more over
+// <work_dir>/corpus.pack if there is one, and search_cli over the result
+// (load time, per-query latency percentiles on the scripts/compare
+// queries), then microbenchmarks tokenize, stem_word, SchStringHashMap::get
+// and the intersection / union kernels in process. Every number is written
+// as one "name": value line of a flat JSON object; given the file of an
+// earlier run, the two are compared metric by metric. Timings are the best of
+// SCH_SUITE_ROUNDS runs, so noise on a busy machine inflates them less.
+
+static SchTestRng rng(2020);
+
+static const int SCH_SUITE_ROUNDS = 3;
+static const int SCH_SUITE_QUERY_REPEATS = 200;
+static const size_t SCH_SUITE_SAMPLE_BYTES = 32 * 1024 * 1024;
+static const int SCH_SUITE_KERNEL_QUERIES = 2000;
+static const int SCH_SUITE_KERNEL_ROUNDS = 7;
+
+struct Metric {
+    SchString name;
+    double value;
+};
+
+static SchVector<Metric> metrics;
+
+static void put(const char* group, const char* name, double value) {
+    char key[256];
+    snprintf(key, sizeof(key), "%s.%s", group, name);
+    Metric m;
+    m.name = SchString(key);
+    m.value = value;
+    metrics.push_back(m);
+}
+
+// Names ending in "_per_s" are throughputs; everything else (seconds,
+// microseconds, megabytes) is better when smaller.
+static bool higher_is_better(const char* name) {
+    size_t n = std::strlen(name);
+    return n > 6 && std::strcmp(name + n - 6, "_per_s") == 0;
+}
+
+struct ChildRun {
+    double sec;
+    double peak_rss_mb;
+};
+
+// Runs argv[0] with stdin from in_path and stderr to err_path (/dev/null when
+// null) and stdout discarded; wall time and peak RSS come from wait4.
+static bool run_child(const char* const* argv, const char* in_path, const char* err_path, ChildRun& r) {
+    double t0 = now_sec();
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        int in = open(in_path ? in_path : "/dev/null", O_RDONLY);
+        int out = open("/dev/null", O_WRONLY);
+        int err = err_path ? open(err_path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : open("/dev/null", O_WRONLY);
+        if (in < 0 || out < 0 || err < 0) _exit(126);
+        dup2(in, 0);
+        dup2(out, 1);
+        dup2(err, 2);
+        execv(argv[0], (char* const*)argv);
+        _exit(127);
+    }
+    int status = 0;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) < 0) return false;
+    r.sec = now_sec() - t0;
+    r.peak_rss_mb = ru.ru_maxrss / 1024.0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s exited with status %d\n", argv[0], WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        return false;
+    }
+    return true;
+}
+
+static double file_mb(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size / 1e6 : 0.0;
+}
+
+struct Corpus {
+    SchVector<SchString> paths;
+    size_t bytes;
+    SchVector<SchString> sample; // the first SCH_SUITE_SAMPLE_BYTES of text
+    size_t sample_bytes;
+};
+
+static bool list_corpus(const char* dir_path, Corpus& c) {
+    c.bytes = c.sample_bytes = 0;
+    DIR* dir = opendir(dir_path);
+    if (!dir) return false;
+    char path[4096];
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t ln = std::strlen(ent->d_name);
+        if (ln <= 4 || std::strcmp(ent->d_name + ln - 4, ".txt") != 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir_path, ent->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        c.paths.push_back(SchString(path));
+        c.bytes += (size_t)st.st_size;
+    }
+    closedir(dir);
+    std::sort(c.paths.begin(), c.paths.end(), [](const SchString& a, const SchString& b) { return std::strcmp(a.c_str(), b.c_str()) < 0; });
+    return c.paths.size() > 0;
+}
+
+// Read only after the child processes have run: a forked child starts with
+// the parent's peak RSS, so the parent is kept small until then.
+static void read_sample(Corpus& c) {
+    SchVector<char> text;
+    char buf[65536];
+    for (size_t i = 0; i < c.paths.size() && c.sample_bytes < SCH_SUITE_SAMPLE_BYTES; ++i) {
+        FILE* f = fopen(c.paths[i].c_str(), "rb");
+        if (!f) continue;
+        text.clear();
+        size_t r;
+        while ((r = fread(buf, 1, sizeof(buf), f)) > 0) {
+            for (size_t j = 0; j < r; ++j) text.push_back(buf[j]);
+        }
+        fclose(f);
+        c.sample.push_back(SchString(text.begin(), text.size()));
+        c.sample_bytes += text.size();
+    }
+}
+
+struct Format {
+    const char* name;
+    const char* flag1;
+    const char* flag2;
+};
+
+static const Format formats[] = {
+    {"legacy", nullptr, nullptr},
+    {"mapped", "--format", "mapped"},
+    {"packed", "--compress", nullptr},
+};
+static const size_t SCH_SUITE_FORMATS = sizeof(formats) / sizeof(formats[0]);
+
+static void index_path(const char* work, const Format& f, char* out, size_t n) { snprintf(out, n, "%s/suite_%s.bin", work, f.name); }
+
+static bool bench_indexing(const char* builder, const char* corpus_dir, const char* work, const Corpus& c) {
+    for (size_t i = 0; i < SCH_SUITE_FORMATS; ++i) {
+        const Format& f = formats[i];
+        char out[4096];
+        index_path(work, f, out, sizeof(out));
+        const char* argv[6];
+        size_t k = 0;
+        argv[k++] = builder;
+        if (f.flag1) argv[k++] = f.flag1;
+        if (f.flag2) argv[k++] = f.flag2;
+        argv[k++] = corpus_dir;
+        argv[k++] = out;
+        argv[k] = nullptr;
+        double best = 0, rss = 0;
+        for (int r = 0; r < SCH_SUITE_ROUNDS; ++r) {
+            ChildRun run;
+            if (!run_child(argv, nullptr, nullptr, run)) return false;
+            if (r == 0 || run.sec < best) best = run.sec;
+            if (run.peak_rss_mb > rss) rss = run.peak_rss_mb;
+        }
+        char group[64];
+        snprintf(group, sizeof(group), "index.%s", f.name);
+        put(group, "seconds", best);
+        put(group, "mb_per_s", c.bytes / best / 1e6);
+        put(group, "docs_per_s", c.paths.size() / best);
+        put(group, "peak_rss_mb", rss);
+        put(group, "size_mb", file_mb(out));
+        printf("index  %-7s %7.3f s  %7.1f MB/s  %9.0f docs/s  peak RSS %7.1f MB  size %7.1f MB\n", f.name, best, c.bytes / best / 1e6,
+               c.paths.size() / best, rss, file_mb(out));
+    }
+
+    // The legacy build again from <work_dir>/corpus.pack, when there is one.
+    char pack[4096], out[4096];
+    snprintf(pack, sizeof(pack), "%s/corpus.pack", work);
+    snprintf(out, sizeof(out), "%s/suite_from_pack.bin", work);
+    struct stat st;
+    if (stat(pack, &st) != 0) return true;
+    const char* argv[] = {builder, pack, out, nullptr};
+    double best = 0, rss = 0;
+    for (int r = 0; r < SCH_SUITE_ROUNDS; ++r) {
+        ChildRun run;
+        if (!run_child(argv, nullptr, nullptr, run)) return false;
+        if (r == 0 || run.sec < best) best = run.sec;
+        if (run.peak_rss_mb > rss) rss = run.peak_rss_mb;
+    }
+    put("index.from_pack", "seconds", best);
+    put("index.from_pack", "mb_per_s", c.bytes / best / 1e6);
+    put("index.from_pack", "docs_per_s", c.paths.size() / best);
+    put("index.from_pack", "peak_rss_mb", rss);
+    printf("index  %-7s %7.3f s  %7.1f MB/s  %9.0f docs/s  peak RSS %7.1f MB  (legacy, from corpus.pack)\n", "pack", best,
+           c.bytes / best / 1e6, c.paths.size() / best, rss);
+    return true;
+}
+
+// search_cli reports "Index loaded in X ms" on stderr.
+static bool bench_load(const char* searcher, const char* work) {
+    char err_path[4096];
+    snprintf(err_path, sizeof(err_path), "%s/suite_load.err", work);
+    for (size_t i = 0; i < SCH_SUITE_FORMATS; ++i) {
+        char idx[4096];
+        index_path(work, formats[i], idx, sizeof(idx));
+        const char* argv[] = {searcher, "--cache", "0", idx, nullptr};
+        double best = 0, rss = 0;
+        for (int r = 0; r < SCH_SUITE_ROUNDS; ++r) {
+            ChildRun run;
+            if (!run_child(argv, nullptr, err_path, run)) return false;
+            FILE* f = fopen(err_path, "r");
+            if (!f) return false;
+            char line[1024];
+            double ms = -1;
+            while (fgets(line, sizeof(line), f)) {
+                if (std::sscanf(line, "Index loaded in %lf ms", &ms) == 1) break;
+            }
+            fclose(f);
+            if (ms < 0) { fprintf(stderr, "%s printed no load time\n", searcher); return false; }
+            if (r == 0 || ms < best) best = ms;
+            if (run.peak_rss_mb > rss) rss = run.peak_rss_mb;
+        }
+        char group[64];
+        snprintf(group, sizeof(group), "load.%s", formats[i].name);
+        put(group, "ms", best);
+        put(group, "peak_rss_mb", rss);
+        printf("load   %-7s %9.2f ms  peak RSS %7.1f MB\n", formats[i].name, best, rss);
+    }
+    unlink(err_path);
+    return true;
+}
+
+static double percentile(const std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+// Every query of the set SCH_SUITE_QUERY_REPEATS times, in one single-threaded
+// uncached batch, so each latency sample is a full evaluation.
+static bool bench_queries(const char* searcher, const char* queries_path, const char* work) {
+    FILE* in = fopen(queries_path, "r");
+    if (!in) { fprintf(stderr, "Cannot open queries: %s\n", queries_path); return false; }
+    SchVector<SchString> queries;
+    char line[4096];
+    while (fgets(line, sizeof(line), in)) {
+        size_t n = std::strlen(line);
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[--n] = '\0';
+        if (n) queries.push_back(SchString(line));
+    }
+    fclose(in);
+    if (queries.size() == 0) { fprintf(stderr, "No queries in %s\n", queries_path); return false; }
+    char batch_path[4096], lat_path[4096];
+    snprintf(batch_path, sizeof(batch_path), "%s/suite_batch.txt", work);
+    snprintf(lat_path, sizeof(lat_path), "%s/suite_latency.txt", work);
+    FILE* out = fopen(batch_path, "w");
+    if (!out) return false;
+    for (int r = 0; r < SCH_SUITE_QUERY_REPEATS; ++r) {
+        for (size_t i = 0; i < queries.size(); ++i) fprintf(out, "%s\n", queries[i].c_str());
+    }
+    fclose(out);
+
+    for (size_t i = 0; i < SCH_SUITE_FORMATS * 2; ++i) {
+        const Format& f = formats[i % SCH_SUITE_FORMATS];
+        bool ranked = i >= SCH_SUITE_FORMATS;
+        if (ranked && !f.flag1) continue; // the legacy format has no scores
+        char idx[4096];
+        index_path(work, f, idx, sizeof(idx));
+        const char* argv[16];
+        size_t k = 0;
+        argv[k++] = searcher;
+        argv[k++] = "--batch";
+        argv[k++] = batch_path;
+        argv[k++] = "--out";
+        argv[k++] = "/dev/null";
+        argv[k++] = "--latency";
+        argv[k++] = lat_path;
+        argv[k++] = "--cache";
+        argv[k++] = "0";
+        argv[k++] = "--threads";
+        argv[k++] = "1";
+        if (ranked) argv[k++] = "--rank";
+        argv[k++] = idx;
+        argv[k] = nullptr;
+        ChildRun run;
+        if (!run_child(argv, nullptr, nullptr, run)) return false;
+        std::vector<double> lat;
+        FILE* lf = fopen(lat_path, "r");
+        if (!lf) return false;
+        char qid[256];
+        double us = 0;
+        size_t found = 0;
+        while (fgets(line, sizeof(line), lf)) {
+            if (std::sscanf(line, "%255s %lf %zu", qid, &us, &found) == 3) lat.push_back(us);
+        }
+        fclose(lf);
+        std::sort(lat.begin(), lat.end());
+        double sum = 0;
+        for (size_t j = 0; j < lat.size(); ++j) sum += lat[j];
+        char group[64];
+        snprintf(group, sizeof(group), "query.%s%s", ranked ? "ranked_" : "", f.name);
+        put(group, "p50_us", percentile(lat, 0.50));
+        put(group, "p95_us", percentile(lat, 0.95));
+        put(group, "p99_us", percentile(lat, 0.99));
+        put(group, "mean_us", lat.empty() ? 0 : sum / lat.size());
+        put(group, "peak_rss_mb", run.peak_rss_mb);
+        printf("query  %-14s %6zu queries  p50 %8.1f us  p95 %8.1f us  p99 %8.1f us  peak RSS %7.1f MB\n", group + 6, lat.size(),
+               percentile(lat, 0.50), percentile(lat, 0.95), percentile(lat, 0.99), run.peak_rss_mb);
+    }
+    unlink(batch_path);
+    unlink(lat_path);
+    return true;
+}
+
+static volatile size_t sink = 0;
+
+static void bench_text(Corpus& c) {
+    read_sample(c);
+    SchVector<SchString> tokens;
+    double tok_best = 0;
+    size_t ntok = 0;
+    for (int r = 0; r < SCH_SUITE_ROUNDS; ++r) {
+        ntok = 0;
+        double t0 = now_sec();
+        for (size_t i = 0; i < c.sample.size(); ++i) ntok += tokenize(c.sample[i]).size();
+        double sec = now_sec() - t0;
+        if (r == 0 || sec < tok_best) tok_best = sec;
+    }
+    for (size_t i = 0; i < c.sample.size() && tokens.size() < 2000000; ++i) {
+        SchVector<SchString> t = tokenize(c.sample[i]);
+        for (size_t j = 0; j < t.size(); ++j) tokens.push_back(t[j]);
+    }
+    put("micro.tokenize", "mb_per_s", c.sample_bytes / tok_best / 1e6);
+    put("micro.tokenize", "ns_per_token", tok_best * 1e9 / ntok);
+    printf("micro  tokenize        %7.1f MB/s  %6.1f ns/token  (%zu tokens, %.1f MB)\n", c.sample_bytes / tok_best / 1e6, tok_best * 1e9 / ntok,
+           ntok, c.sample_bytes / 1e6);
+
+    double stem_best = 0;
+    SchVector<SchString> stems;
+    for (int r = 0; r < SCH_SUITE_ROUNDS; ++r) {
+        double t0 = now_sec();
+        for (size_t i = 0; i < tokens.size(); ++i) sink += stem_word(tokens[i]).size();
+        double sec = now_sec() - t0;
+        if (r == 0 || sec < stem_best) stem_best = sec;
+    }
+    put("micro.stem_word", "ns_per_word", stem_best * 1e9 / tokens.size());
+    printf("micro  stem_word       %7.1f ns/word  (%zu words)\n", stem_best * 1e9 / tokens.size(), tokens.size());
+
+    // Lookups in token order, as the indexer does them: frequent terms hit
+    // the same slots over and over.
+    SchStringHashMap<int> map;
+    SchVector<SchString> misses;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (map.get(tokens[i])) continue;
+        map.insert(tokens[i], (int)map.size());
+        misses.push_back(SchString((std::string(tokens[i].c_str()) + "#").c_str()));
+    }
+    double hit_best = 0, miss_best = 0;
+    for (int r = 0; r < SCH_SUITE_ROUNDS; ++r) {
+        double t0 = now_sec();
+        for (size_t i = 0; i < tokens.size(); ++i) sink += *map.get(tokens[i]);
+        double t1 = now_sec();
+        for (size_t i = 0; i < misses.size(); ++i) sink += map.get(misses[i]) != nullptr;
+        double t2 = now_sec();
+        if (r == 0 || t1 - t0 < hit_best) hit_best = t1 - t0;
+        if (r == 0 || t2 - t1 < miss_best) miss_best = t2 - t1;
+    }
+    put("micro.hashmap_get", "hit_ns", hit_best * 1e9 / tokens.size());
+    put("micro.hashmap_get", "miss_ns", miss_best * 1e9 / misses.size());
+    printf("micro  hashmap get     hit %6.1f ns  miss %6.1f ns  (%zu keys)\n", hit_best * 1e9 / tokens.size(), miss_best * 1e9 / misses.size(),
+           map.size());
+}
+
+// Terms by document frequency as in bench_boolean: stopwords (a quarter of the
+// documents or more), common (1%..10%) and rare (under 0.1%).
+struct TermClasses {
+    SchVector<size_t> stop, common, rare;
+};
+
+static TermClasses classify(const SchMappedIndex& idx) {
+    TermClasses c;
+    size_t n = idx.doc_count();
+    for (size_t t = 0; t < idx.vocab_size(); ++t) {
+        size_t df = idx.postings(t).size;
+        if (df * 4 >= n) c.stop.push_back(t);
+        else if (df * 100 >= n && df * 10 < n) c.common.push_back(t);
+        else if (df * 1000 < n && df >= 2) c.rare.push_back(t);
+    }
+    return c;
+}
+
+struct KernelShape {
+    const char* name;
+    bool is_union;
+    size_t n;
+    int first; // 0 common, 1 rare, 2 stop
+    int rest;
+};
+
+static bool bench_kernels(const char* work) {
+    const KernelShape shapes[] = {
+        {"and_common_x2", false, 2, 0, 0},
+        {"and_common_x4", false, 4, 0, 0},
+        {"and_rare_stop", false, 2, 1, 2},
+        {"and_stop_x2", false, 2, 2, 2},
+        {"or_common_x2", true, 2, 0, 0},
+        {"or_common_x8", true, 8, 0, 0},
+        {"or_stop_x2", true, 2, 2, 2},
+    };
+    for (size_t fi = 1; fi < SCH_SUITE_FORMATS; ++fi) {
+        char path[4096];
+        index_path(work, formats[fi], path, sizeof(path));
+        SchMappedIndex idx;
+        if (!idx.open(path) || idx.vocab_size() == 0) { fprintf(stderr, "Cannot open mapped index: %s\n", path); return false; }
+        TermClasses c = classify(idx);
+        const SchVector<size_t>* classes[3] = {&c.common, &c.rare, &c.stop};
+        if (c.common.size() == 0 || c.rare.size() == 0 || c.stop.size() == 0) {
+            printf("micro  %s: too few documents for the kernel term classes, skipped\n", formats[fi].name);
+            continue;
+        }
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+            const KernelShape& k = shapes[s];
+            SchVector<SchPostingView> lists;
+            for (int q = 0; q < SCH_SUITE_KERNEL_QUERIES; ++q) {
+                for (size_t i = 0; i < k.n; ++i) {
+                    const SchVector<size_t>& cls = *classes[i == 0 ? k.first : k.rest];
+                    lists.push_back(idx.postings(cls[rng(cls.size())]));
+                }
+            }
+            SchVector<int> out;
+            double best = 0;
+            // One extra, untimed round first to fault in the postings. The
+            // kernels are short, so they get more rounds than the rest.
+            for (int r = 0; r <= SCH_SUITE_KERNEL_ROUNDS; ++r) {
+                double t0 = now_sec();
+                for (size_t q = 0; q + k.n <= lists.size(); q += k.n) {
+                    if (k.is_union) sch_union_all(lists.begin() + q, k.n, out);
+                    else out = sch_intersect_all(lists.begin() + q, k.n);
+                    sink += out.size();
+                }
+                double sec = now_sec() - t0;
+                if (r == 1 || (r > 1 && sec < best)) best = sec;
+            }
+            char group[128];
+            snprintf(group, sizeof(group), "micro.%s.%s", k.name, formats[fi].name);
+            put(group, "us_per_op", best * 1e6 / SCH_SUITE_KERNEL_QUERIES);
+            printf("micro  %-22s %8.2f us/op\n", group + 6, best * 1e6 / SCH_SUITE_KERNEL_QUERIES);
+        }
+    }
+    return true;
+}
+
+static bool write_json(const char* path, const char* corpus_dir, const Corpus& c, const char* queries_path) {
+    FILE* f = fopen(path, "w");
+    if (!f) { fprintf(stderr, "Cannot write %s\n", path); return false; }
+    fprintf(f, "{\n  \"meta\": {\n");
+    fprintf(f, "    \"corpus\": \"%s\",\n    \"docs\": %zu,\n    \"bytes\": %zu,\n    \"sample_bytes\": %zu,\n", corpus_dir, c.paths.size(), c.bytes, c.sample_bytes);
+    fprintf(f, "    \"queries\": \"%s\",\n    \"query_repeats\": %d,\n    \"rounds\": %d,\n    \"time\": %ld\n  },\n", queries_path,
+            SCH_SUITE_QUERY_REPEATS, SCH_SUITE_ROUNDS, (long)time(nullptr));
+    fprintf(f, "  \"metrics\": {\n");
+    for (size_t i = 0; i < metrics.size(); ++i) fprintf(f, "    \"%s\": %.6g%s\n", metrics[i].name.c_str(), metrics[i].value, i + 1 < metrics.size() ? "," : "");
+    fprintf(f, "  }\n}\n");
+    fclose(f);
+    return true;
+}
+
+// Reads back the "metrics" object of a file written by write_json.
+static bool read_metrics(const char* path, SchVector<Metric>& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[1024], name[256];
+    bool in_metrics = false;
+    while (fgets(line, sizeof(line), f)) {
+        if (!in_metrics) { in_metrics = std::strstr(line, "\"metrics\"") != nullptr; continue; }
+        Metric m;
+        if (std::sscanf(line, " \"%255[^\"]\": %lf", name, &m.value) != 2) continue;
+        m.name = SchString(name);
+        out.push_back(m);
+    }
+    fclose(f);
+    return true;
+}
+
+static void compare(const char* baseline_path) {
+    SchVector<Metric> base;
+    if (!read_metrics(baseline_path, base)) { fprintf(stderr, "Cannot read baseline %s\n", baseline_path); return; }
+    printf("\nAgainst %s (+ better, - worse):\n", baseline_path);
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        const Metric* b = nullptr;
+        for (size_t j = 0; j < base.size() && !b; ++j) {
+            if (base[j].name == metrics[i].name) b = &base[j];
+        }
+        if (!b) { printf("  %-40s %12s %12.4g  (new)\n", metrics[i].name.c_str(), "-", metrics[i].value); continue; }
+        double change = b->value != 0 ? (metrics[i].value - b->value) / std::fabs(b->value) * 100 : 0;
+        bool better = higher_is_better(metrics[i].name.c_str()) ? change > 0 : change < 0;
+        printf("  %-40s %12.4g %12.4g  %c%5.1f%%\n", metrics[i].name.c_str(), b->value, metrics[i].value,
+               std::fabs(change) < 0.05 ? ' ' : (better ? '+' : '-'), std::fabs(change));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 7) {
+        fprintf(stderr, "Usage: %s <index_builder> <search_cli> <corpus> <queries.txt> <work_dir> <results.json> [baseline.json]\n", argv[0]);
+        return 1;
+    }
+    const char* builder = argv[1];
+    const char* searcher = argv[2];
+    const char* corpus_dir = argv[3];
+    const char* queries_path = argv[4];
+    const char* work = argv[5];
+    Corpus c;
+    if (!list_corpus(corpus_dir, c)) { fprintf(stderr, "Cannot read corpus: %s\n", corpus_dir); return 1; }
+    printf("corpus: %zu documents, %.1f MB\n", c.paths.size(), c.bytes / 1e6);
+    if (!bench_indexing(builder, corpus_dir, work, c)) return 1;
+    if (!bench_load(searcher, work)) return 1;
+    if (!bench_queries(searcher, queries_path, work)) return 1;
+    bench_text(c);
+    if (!bench_kernels(work)) return 1;
+    if (!write_json(argv[6], corpus_dir, c, queries_path)) return 1;
+    printf("Results: %s (%zu metrics)\n", argv[6], metrics.size());
+    if (argc > 7) compare(argv[7]);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <vector>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_string_utils.h"
+#include "../tests/reference_text_pipeline.h"
+#include "../tests/test_util.h"
+
+int main(int argc, char* argv[]) {
+    const char* corpus = argc > 1 ? argv[1] : "data/corpus";
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 3;
+    std::vector<std::string> docs;
+    size_t total_bytes = 0;
+    DIR* dir = opendir(corpus);
+    if (!dir) { fprintf(stderr, "Cannot open corpus: %s\n", corpus); return 1; }
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t ln = std::strlen(ent->d_name);
+        if (ln <= 4 || std::strcmp(ent->d_name + ln - 4, ".txt") != 0) continue;
+        std::string path = std::string(corpus) + "/" + ent->d_name;
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) continue;
+        std::string text;
+        char buf[65536];
+        size_t r;
+        while ((r = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, r);
+        fclose(f);
+        total_bytes += text.size();
+        docs.push_back(text);
+    }
+    closedir(dir);
+    printf("corpus: %zu documents, %.1f MB\n", docs.size(), total_bytes / 1e6);
+
+    size_t ref_tokens = 0;
+    double t0 = now_sec();
+    for (int r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < docs.size(); ++i) ref_tokens += reference_tokenize(docs[i].data(), docs[i].size()).size();
+    }
+    double ref_sec = now_sec() - t0;
+
+    size_t new_tokens = 0;
+    std::vector<std::string> scratch(docs);
+    t0 = now_sec();
+    for (int r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < scratch.size(); ++i) {
+            new_tokens += sch_tokenize_inplace(&scratch[i][0], scratch[i].size(), [](const char*, size_t) {});
+        }
+    }
+    double new_sec = now_sec() - t0;
+
+    printf("stringstream: %8.1f MB/s  %7.2f M tokens/s\n", rounds * total_bytes / ref_sec / 1e6, ref_tokens / ref_sec / 1e6);
+    printf("table+SIMD:   %8.1f MB/s  %7.2f M tokens/s\n", rounds * total_bytes / new_sec / 1e6, new_tokens / new_sec / 1e6);
+    if (ref_tokens != new_tokens) { fprintf(stderr, "token count mismatch: %zu vs %zu\n", ref_tokens, new_tokens); return 1; }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef SCH_ALLOC_COUNTER_H
+#define SCH_ALLOC_COUNTER_H
+
+#include <cstddef>
+
+// Build with -DSCH_COUNT_ALLOCS to count every global operator new call.
+// Include from exactly one translation unit per binary.
+#ifdef SCH_COUNT_ALLOCS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+inline std::atomic<size_t>& sch_alloc_counter() {
+    static std::atomic<size_t> count(0);
+    return count;
+}
+
+void* operator new(size_t n) {
+    sch_alloc_counter().fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+#define SCH_ALLOC_COUNT() (sch_alloc_counter().load(std::memory_order_relaxed))
+#else
+#define SCH_ALLOC_COUNT() ((size_t)0)
+#endif
+
+#endif
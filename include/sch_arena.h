@@ -0,0 +1,96 @@
+#ifndef SCH_ARENA_H
+#define SCH_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+struct SchHeapAllocator {
+    void* allocate(size_t n) const { return ::operator new(n); }
+    void deallocate(void* p, size_t) const { ::operator delete(p); }
+};
+
+// Bump allocator over a chain of blocks. reset() rewinds to the first block and
+// keeps every block for reuse, so steady-state per-document work allocates nothing.
+class SchArena {
+private:
+    struct Block {
+        Block* next;
+        size_t size;
+        size_t used;
+        unsigned char* data() { return (unsigned char*)(this + 1); }
+    };
+
+    Block* first_;
+    Block* current_;
+    size_t block_size_;
+
+    SchArena(const SchArena&);
+    SchArena& operator=(const SchArena&);
+
+    Block* new_block(size_t min_size) {
+        size_t size = min_size > block_size_ ? min_size : block_size_;
+        Block* b = (Block*)::operator new(sizeof(Block) + size);
+        b->next = nullptr;
+        b->size = size;
+        b->used = 0;
+        return b;
+    }
+
+public:
+    explicit SchArena(size_t block_size = 64 * 1024) : first_(nullptr), current_(nullptr), block_size_(block_size) {}
+    ~SchArena() { release(); }
+
+    void* allocate(size_t n, size_t align = alignof(std::max_align_t)) {
+        if (current_) {
+            size_t off = (current_->used + align - 1) & ~(align - 1);
+            if (off + n <= current_->size) {
+                current_->used = off + n;
+                return current_->data() + off;
+            }
+        }
+        Block* b = current_ ? current_->next : first_;
+        while (b && b->size < n + align) b = b->next;
+        if (!b) {
+            b = new_block(n + align);
+            if (current_) { b->next = current_->next; current_->next = b; }
+            else { b->next = first_; first_ = b; }
+        }
+        current_ = b;
+        size_t off = ((uintptr_t)b->data() + align - 1) / align * align - (uintptr_t)b->data();
+        b->used = off + n;
+        return b->data() + off;
+    }
+
+    void reset() {
+        for (Block* b = first_; b; b = b->next) b->used = 0;
+        current_ = first_;
+    }
+
+    void release() {
+        Block* b = first_;
+        while (b) {
+            Block* next = b->next;
+            ::operator delete(b);
+            b = next;
+        }
+        first_ = current_ = nullptr;
+    }
+
+    size_t bytes_reserved() const {
+        size_t total = 0;
+        for (Block* b = first_; b; b = b->next) total += b->size;
+        return total;
+    }
+};
+
+// Allocator handle for SchVector/SchBasicString. Without an arena it falls back
+// to the heap; with one, deallocate is a no-op and memory is reclaimed by reset().
+struct SchArenaAllocator {
+    SchArena* arena;
+    SchArenaAllocator(SchArena* a = nullptr) : arena(a) {}
+    void* allocate(size_t n) const { return arena ? arena->allocate(n) : ::operator new(n); }
+    void deallocate(void* p, size_t) const { if (!arena) ::operator delete(p); }
+};
+
+#endif
@@ -0,0 +1,313 @@
+#ifndef SCH_BOOLEAN_H
+#define SCH_BOOLEAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "sch_containers.h"
+#include "sch_postings.h"
+#include "sch_intersect.h"
+
+// Roaring-style doc id set: ids are split by their high 16 bits into chunks
+// and every chunk is a container of its own, a sorted uint16 array while it
+// holds at most SCH_ARRAY_MAX ids and a 65536-bit bitmap above that. Updates
+// run on bitmaps (an array chunk is widened first); optimize() recounts and
+// narrows sparse chunks back to arrays, and size() is exact only after it.
+static const size_t SCH_CHUNK_IDS = 65536;
+static const size_t SCH_CHUNK_WORDS = SCH_CHUNK_IDS / 64;
+static const size_t SCH_ARRAY_MAX = 4096;
+
+class SchDocSet {
+private:
+    struct Chunk {
+        size_t card;
+        SchVector<uint16_t> array;
+        SchVector<uint64_t> bits;
+        Chunk() : card(0) {}
+        bool empty() const { return array.size() == 0 && bits.size() == 0; }
+    };
+
+    SchVector<Chunk> chunks_;
+    size_t universe_;
+    size_t size_;
+
+    uint64_t* bitmap(size_t c) {
+        Chunk& ch = chunks_[c];
+        if (ch.bits.size() == 0) {
+            ch.bits.reserve(SCH_CHUNK_WORDS);
+            for (size_t w = 0; w < SCH_CHUNK_WORDS; ++w) ch.bits.push_back(0);
+            for (size_t i = 0; i < ch.array.size(); ++i) ch.bits[ch.array[i] >> 6] |= 1ull << (ch.array[i] & 63);
+            ch.array.clear();
+        }
+        return ch.bits.begin();
+    }
+
+    // Calls fn(bitmap words, id) for every id of a sorted list, widening the
+    // chunks it touches; skips chunks that are empty when !create.
+    template <typename Fn>
+    void each_id(const SchPostingView& v, bool create, Fn&& fn) {
+        SchPostingReader r(v);
+        const int32_t* ids = nullptr;
+        size_t n = 0, cur = (size_t)-1;
+        uint64_t* b = nullptr;
+        while (r.next_block(&ids, &n)) {
+            for (size_t i = 0; i < n; ++i) {
+                uint32_t id = (uint32_t)ids[i];
+                if ((id >> 16) != cur) {
+                    cur = id >> 16;
+                    b = create || !chunks_[cur].empty() ? bitmap(cur) : nullptr;
+                }
+                if (b) fn(b, id & 0xffff);
+            }
+        }
+    }
+
+public:
+    SchDocSet() : universe_(0), size_(0) {}
+
+    void reset(size_t universe) {
+        chunks_.clear();
+        for (size_t c = 0; c < (universe + SCH_CHUNK_IDS - 1) / SCH_CHUNK_IDS; ++c) chunks_.push_back(Chunk());
+        universe_ = universe;
+        size_ = 0;
+    }
+
+    size_t universe() const { return universe_; }
+    size_t size() const { return size_; }
+
+    // Every id in [0, universe).
+    void fill() {
+        for (size_t c = 0; c < chunks_.size(); ++c) {
+            uint64_t* b = bitmap(c);
+            size_t n = universe_ - c * SCH_CHUNK_IDS < SCH_CHUNK_IDS ? universe_ - c * SCH_CHUNK_IDS : SCH_CHUNK_IDS;
+            for (size_t w = 0; w < SCH_CHUNK_WORDS; ++w) b[w] = w < n / 64 ? ~0ull : 0;
+            if (n % 64) b[n / 64] = (1ull << (n % 64)) - 1;
+        }
+    }
+
+    void add(const SchPostingView& v) {
+        each_id(v, true, [](uint64_t* b, uint32_t low) { b[low >> 6] |= 1ull << (low & 63); });
+    }
+
+    void remove(const SchPostingView& v) {
+        each_id(v, false, [](uint64_t* b, uint32_t low) { b[low >> 6] &= ~(1ull << (low & 63)); });
+    }
+
+    void add(const SchDocSet& o) {
+        for (size_t c = 0; c < chunks_.size() && c < o.chunks_.size(); ++c) {
+            const Chunk& oc = o.chunks_[c];
+            if (oc.empty()) continue;
+            uint64_t* b = bitmap(c);
+            if (oc.bits.size()) for (size_t w = 0; w < SCH_CHUNK_WORDS; ++w) b[w] |= oc.bits[w];
+            else for (size_t i = 0; i < oc.array.size(); ++i) b[oc.array[i] >> 6] |= 1ull << (oc.array[i] & 63);
+        }
+    }
+
+    void remove(const SchDocSet& o) {
+        for (size_t c = 0; c < chunks_.size() && c < o.chunks_.size(); ++c) {
+            const Chunk& oc = o.chunks_[c];
+            if (oc.empty() || chunks_[c].empty()) continue;
+            uint64_t* b = bitmap(c);
+            if (oc.bits.size()) for (size_t w = 0; w < SCH_CHUNK_WORDS; ++w) b[w] &= ~oc.bits[w];
+            else for (size_t i = 0; i < oc.array.size(); ++i) b[oc.array[i] >> 6] &= ~(1ull << (oc.array[i] & 63));
+        }
+    }
+
+    void intersect(const SchDocSet& o) {
+        for (size_t c = 0; c < chunks_.size(); ++c) {
+            if (chunks_[c].empty()) continue;
+            if (c >= o.chunks_.size() || o.chunks_[c].empty()) { chunks_[c] = Chunk(); continue; }
+            const Chunk& oc = o.chunks_[c];
+            uint64_t* b = bitmap(c);
+            if (oc.bits.size()) {
+                for (size_t w = 0; w < SCH_CHUNK_WORDS; ++w) b[w] &= oc.bits[w];
+            } else {
+                SchVector<uint16_t> kept;
+                for (size_t i = 0; i < oc.array.size(); ++i) {
+                    if ((b[oc.array[i] >> 6] >> (oc.array[i] & 63)) & 1) kept.push_back(oc.array[i]);
+                }
+                chunks_[c] = Chunk();
+                chunks_[c].array = std::move(kept);
+            }
+        }
+    }
+
+    void optimize() {
+        size_ = 0;
+        for (size_t c = 0; c < chunks_.size(); ++c) {
+            Chunk& ch = chunks_[c];
+            if (ch.bits.size()) {
+                size_t card = 0;
+                for (size_t w = 0; w < SCH_CHUNK_WORDS; ++w) card += (size_t)__builtin_popcountll(ch.bits[w]);
+                if (card <= SCH_ARRAY_MAX) {
+                    ch.array.clear();
+                    for (size_t w = 0; w < SCH_CHUNK_WORDS; ++w) {
+                        for (uint64_t x = ch.bits[w]; x; x &= x - 1) ch.array.push_back((uint16_t)(w * 64 + (size_t)__builtin_ctzll(x)));
+                    }
+                    ch.bits = SchVector<uint64_t>();
+                }
+                ch.card = card;
+            } else {
+                ch.card = ch.array.size();
+            }
+            if (ch.card == 0) ch = Chunk();
+            size_ += ch.card;
+        }
+    }
+
+    bool contains(uint32_t id) const {
+        size_t c = id >> 16;
+        if (c >= chunks_.size()) return false;
+        const Chunk& ch = chunks_[c];
+        uint16_t low = (uint16_t)(id & 0xffff);
+        if (ch.bits.size()) return (ch.bits[low >> 6] >> (low & 63)) & 1;
+        size_t lo = 0, hi = ch.array.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (ch.array[mid] < low) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo < ch.array.size() && ch.array[lo] == low;
+    }
+
+    void to_ids(SchVector<int>& out) const {
+        out.clear();
+        out.reserve(size_);
+        for (size_t c = 0; c < chunks_.size(); ++c) {
+            const Chunk& ch = chunks_[c];
+            int base = (int)(c * SCH_CHUNK_IDS);
+            if (ch.bits.size() == 0) {
+                for (size_t i = 0; i < ch.array.size(); ++i) out.push_back(base + ch.array[i]);
+                continue;
+            }
+            for (size_t w = 0; w < SCH_CHUNK_WORDS; ++w) {
+                for (uint64_t x = ch.bits[w]; x; x &= x - 1) out.push_back(base + (int)(w * 64) + __builtin_ctzll(x));
+            }
+        }
+    }
+};
+
+// A sub-expression with at least universe / SCH_DENSE_DIVISOR ids is kept as
+// a SchDocSet; sparser ones are sorted id lists.
+static const size_t SCH_DENSE_DIVISOR = 16;
+
+// Value of a boolean sub-expression: a posting list of the index (borrowed),
+// the sorted ids computed for it, or a dense SchDocSet.
+struct SchBoolValue {
+    bool dense;
+    bool borrowed;
+    SchPostingView view;
+    SchVector<int> ids;
+    SchDocSet set;
+
+    SchBoolValue() : dense(false), borrowed(false) {}
+    SchPostingView list() const { return borrowed ? view : SchPostingView(ids); }
+    size_t size() const { return dense ? set.size() : (borrowed ? view.size : ids.size()); }
+
+    void to_ids(SchVector<int>& out) const {
+        if (dense) { set.to_ids(out); return; }
+        if (!borrowed) { out = ids; return; }
+        SchVector<int> scratch;
+        const int32_t* p = sch_materialize(view, scratch);
+        out.resize(view.size);
+        for (size_t i = 0; i < view.size; ++i) out[i] = p[i];
+    }
+};
+
+// Keeps the ids of out that are (keep) or are not (!keep) in set.
+inline void sch_filter_ids(SchVector<int>& ids, const SchDocSet& set, bool keep) {
+    size_t k = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (set.contains((uint32_t)ids[i]) == keep) ids[k++] = ids[i];
+    }
+    ids.resize(k);
+}
+
+// ids minus a posting list without walking all of it: the common ids come from
+// the skip-aware intersection, then one pass drops them.
+inline void sch_subtract_list(SchVector<int>& ids, const SchPostingView& b) {
+    SchVector<int> common, scratch;
+    sch_intersect_views(SchPostingView(ids), b, common, scratch);
+    if (common.size() == 0) return;
+    size_t k = 0, j = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (j < common.size() && common[j] == ids[i]) { ++j; continue; }
+        ids[k++] = ids[i];
+    }
+    ids.resize(k);
+}
+
+inline void sch_settle(SchBoolValue& v) {
+    if (!v.dense) return;
+    v.set.optimize();
+    if (v.set.size() * SCH_DENSE_DIVISOR >= v.set.universe()) return;
+    v.set.to_ids(v.ids);
+    v.set = SchDocSet();
+    v.dense = false;
+}
+
+// OR of n values in one pass: a merge (a heap from three lists on) when the
+// inputs are sparse, a doc set when some input already is one or there are
+// enough lists, dense enough, for bitmaps to beat the heap.
+inline void sch_bool_or(const SchBoolValue* kids, size_t n, size_t universe, SchBoolValue& out) {
+    size_t total = 0;
+    bool dense = false;
+    for (size_t i = 0; i < n; ++i) {
+        total += kids[i].size();
+        dense = dense || kids[i].dense;
+    }
+    out.borrowed = false;
+    if (!dense && (n <= 2 || total * SCH_DENSE_DIVISOR < universe)) {
+        SchVector<SchPostingView> lists;
+        lists.reserve(n);
+        for (size_t i = 0; i < n; ++i) lists.push_back(kids[i].list());
+        sch_union_all(lists.begin(), lists.size(), out.ids);
+        out.dense = false;
+        return;
+    }
+    out.set.reset(universe);
+    for (size_t i = 0; i < n; ++i) {
+        if (kids[i].dense) out.set.add(kids[i].set);
+        else out.set.add(kids[i].list());
+    }
+    out.dense = true;
+    sch_settle(out);
+}
+
+// AND of pos minus every one of neg. Sorted lists are intersected by the
+// planner (shortest first, skipping), dense operands then filter the result;
+// a negated list is subtracted without building its complement, which only
+// happens when there is no positive operand at all (a bare NOT).
+inline void sch_bool_and(const SchBoolValue* pos, size_t npos, const SchBoolValue* neg, size_t nneg, size_t universe, SchBoolValue& out) {
+    out.borrowed = false;
+    SchVector<SchPostingView> lists;
+    SchVector<const SchDocSet*> sets;
+    lists.reserve(npos);
+    for (size_t i = 0; i < npos; ++i) {
+        if (pos[i].dense) sets.push_back(&pos[i].set);
+        else lists.push_back(pos[i].list());
+    }
+    if (lists.size()) {
+        out.ids = sch_intersect_all(lists.begin(), lists.size());
+        out.dense = false;
+        for (size_t i = 0; i < sets.size() && out.ids.size(); ++i) sch_filter_ids(out.ids, *sets[i], true);
+    } else {
+        out.set.reset(universe);
+        if (sets.size()) out.set.add(*sets[0]);
+        else out.set.fill();
+        for (size_t i = 1; i < sets.size(); ++i) out.set.intersect(*sets[i]);
+        out.dense = true;
+    }
+    for (size_t i = 0; i < nneg; ++i) {
+        if (out.dense) {
+            if (neg[i].dense) out.set.remove(neg[i].set);
+            else out.set.remove(neg[i].list());
+        } else if (out.ids.size()) {
+            if (neg[i].dense) sch_filter_ids(out.ids, neg[i].set, false);
+            else sch_subtract_list(out.ids, neg[i].list());
+        }
+    }
+    sch_settle(out);
+}
+
+#endif
@@ -2,47 +2,117 @@
 #define SCH_CONTAINERS_HPP
 
 #include <cstddef>
+#include <cstdint>
 #include <stdexcept>
 #include <iostream>
 #include <cstring>
+#include <new>
+#include <utility>
+#include "sch_arena.h"
 #include "sch_string.h"
 
-template <typename T>
+// Only the first `length` slots hold constructed elements; growth moves
+// elements into the new buffer instead of copying them.
+template <typename T, typename Alloc = SchHeapAllocator>
 class SchVector {
 private:
     T* data;
     size_t capacity;
     size_t length;
-    void resize(size_t new_capacity) {
-        T* new_data = new T[new_capacity];
+    Alloc alloc_;
+    void grow_to(size_t new_capacity) {
+        T* new_data = (T*)alloc_.allocate(new_capacity * sizeof(T));
         for (size_t i = 0; i < length; ++i) {
-            new_data[i] = data[i];
+            new (new_data + i) T(std::move(data[i]));
+            data[i].~T();
         }
-        delete[] data;
+        if (data) alloc_.deallocate(data, capacity * sizeof(T));
         data = new_data;
         capacity = new_capacity;
     }
+    void grow_for_one() {
+        if (length == capacity) grow_to(capacity ? capacity * 2 : 10);
+    }
+    void destroy_all() {
+        for (size_t i = 0; i < length; ++i) data[i].~T();
+        if (data) alloc_.deallocate(data, capacity * sizeof(T));
+        data = nullptr;
+        capacity = 0;
+        length = 0;
+    }
 public:
-    SchVector() : capacity(10), length(0) { data = new T[capacity]; }
-    ~SchVector() { delete[] data; }
-    SchVector(const SchVector& other) : capacity(other.capacity), length(other.length) {
-        data = new T[capacity];
-        for (size_t i = 0; i < length; ++i) data[i] = other.data[i];
+    SchVector(const Alloc& alloc = Alloc()) : data(nullptr), capacity(0), length(0), alloc_(alloc) {}
+    ~SchVector() { destroy_all(); }
+    SchVector(const SchVector& other) : data(nullptr), capacity(0), length(0), alloc_(other.alloc_) {
+        if (other.length) grow_to(other.length);
+        for (size_t i = 0; i < other.length; ++i) new (data + i) T(other.data[i]);
+        length = other.length;
+    }
+    SchVector(SchVector&& other) noexcept : data(other.data), capacity(other.capacity), length(other.length), alloc_(other.alloc_) {
+        other.data = nullptr;
+        other.capacity = 0;
+        other.length = 0;
     }
     SchVector& operator=(const SchVector& other) {
         if (this != &other) {
-            delete[] data;
+            destroy_all();
+            if (other.length) grow_to(other.length);
+            for (size_t i = 0; i < other.length; ++i) new (data + i) T(other.data[i]);
+            length = other.length;
+        }
+        return *this;
+    }
+    SchVector& operator=(SchVector&& other) noexcept {
+        if (this != &other) {
+            destroy_all();
+            data = other.data;
             capacity = other.capacity;
             length = other.length;
-            data = new T[capacity];
-            for (size_t i = 0; i < length; ++i) data[i] = other.data[i];
+            alloc_ = other.alloc_;
+            other.data = nullptr;
+            other.capacity = 0;
+            other.length = 0;
         }
         return *this;
     }
 
+    const Alloc& get_allocator() const { return alloc_; }
+
     void push_back(const T& value) {
-        if (length == capacity) resize(capacity * 2);
-        data[length++] = value;
+        if (length == capacity) {
+            T copy(value);
+            grow_for_one();
+            new (data + length++) T(std::move(copy));
+            return;
+        }
+        new (data + length++) T(value);
+    }
+    void push_back(T&& value) {
+        if (length == capacity) {
+            T tmp(std::move(value));
+            grow_for_one();
+            new (data + length++) T(std::move(tmp));
+            return;
+        }
+        new (data + length++) T(std::move(value));
+    }
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        grow_for_one();
+        new (data + length) T(std::forward<Args>(args)...);
+        return data[length++];
+    }
+    void pop_back() { if (length > 0) data[--length].~T(); }
+    void reserve(size_t n) { if (n > capacity) grow_to(n); }
+    void resize(size_t n) {
+        reserve(n);
+        while (length < n) new (data + length++) T();
+        while (length > n) data[--length].~T();
+    }
+    void shrink_to_fit() {
+        if (length == capacity) return;
+        if (length == 0) { destroy_all(); return; }
+        grow_to(length);
     }
     size_t size() const { return length; }
     T& operator[](size_t index) {
@@ -53,9 +123,13 @@ public:
         if (index >= length) throw std::out_of_range("Index out of bounds");
         return data[index];
     }
+    T& at_unchecked(size_t index) { return data[index]; }
+    const T& at_unchecked(size_t index) const { return data[index]; }
     T* begin() { return data; }
     T* end() { return data + length; }
-    void clear() { length = 0; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + length; }
+    void clear() { while (length > 0) data[--length].~T(); }
 };
 
 template <typename K, typename V>
@@ -63,89 +137,187 @@ struct SchPair {
     K key;
     V value;
     SchPair() {}
-    SchPair(K k, V v) : key(k), value(v) {}
+    SchPair(K k, V v) : key(std::move(k)), value(std::move(v)) {}
 };
 
+// Open-addressing string map (Robin Hood probing). Slots hold the key hash,
+// key location and entry number; keys live in one contiguous arena and values
+// in fixed-size chunks, so returned value pointers stay valid across growth.
+// get_keys() returns keys in insertion order.
 template <typename V>
 class SchStringHashMap {
 private:
-    struct Node {
-        char* key; // C-string copied
-        V value;
-        Node* next;
-        Node(const char* k, const V& v) : value(v), next(nullptr) {
-            size_t ln = std::strlen(k);
-            key = new char[ln + 1];
-            std::memcpy(key, k, ln + 1);
-        }
-        ~Node() { delete[] key; }
+    struct Slot {
+        uint32_t hash;
+        uint32_t entry; // 0 = empty, otherwise entry number + 1
+        uint32_t key_off;
+        uint32_t key_len;
     };
+    static const size_t CHUNK = 1024;
 
-    Node** buckets;
-    size_t bucket_count;
+    Slot* slots_;
+    size_t mask_;
     size_t size_;
+    char* arena_;
+    size_t arena_len_;
+    size_t arena_cap_;
+    V** chunks_;
+    size_t chunk_cap_;
 
-    size_t hash_cstr(const char* key) const {
-        unsigned long h = 2166136261u;
-        for (const unsigned char* p = (const unsigned char*)key; *p; ++p) {
-            h = (h ^ (*p)) * 16777619u;
-        }
-        return (size_t)(h % bucket_count);
+    SchStringHashMap(const SchStringHashMap&);
+    SchStringHashMap& operator=(const SchStringHashMap&);
+
+    static uint32_t hash_bytes(const char* k, size_t n) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < n; ++i) h = (h ^ (unsigned char)k[i]) * 1099511628211ull;
+        return (uint32_t)(h ^ (h >> 32));
     }
 
-public:
-    SchStringHashMap(size_t buckets_init = 10007) : bucket_count(buckets_init), size_(0) {
-        buckets = new Node*[bucket_count];
-        for (size_t i = 0; i < bucket_count; ++i) buckets[i] = nullptr;
+    size_t probe_dist(size_t pos, uint32_t hash) const { return (pos - (hash & mask_)) & mask_; }
+
+    long find_slot(const char* k, size_t n, uint32_t h) const {
+        size_t pos = h & mask_;
+        for (size_t dist = 0;; ++dist) {
+            const Slot& s = slots_[pos];
+            if (s.entry == 0 || probe_dist(pos, s.hash) < dist) return -1;
+            if (s.hash == h && s.key_len == n && std::memcmp(arena_ + s.key_off, k, n) == 0) return (long)pos;
+            pos = (pos + 1) & mask_;
+        }
     }
-    ~SchStringHashMap() {
-        for (size_t i = 0; i < bucket_count; ++i) {
-            Node* cur = buckets[i];
-            while (cur) {
-                Node* tmp = cur;
-                cur = cur->next;
-                delete tmp;
+
+    void place(Slot s) {
+        size_t pos = s.hash & mask_;
+        for (size_t dist = 0;; ++dist) {
+            Slot& cur = slots_[pos];
+            if (cur.entry == 0) { cur = s; return; }
+            size_t cur_dist = probe_dist(pos, cur.hash);
+            if (cur_dist < dist) {
+                Slot tmp = cur; cur = s; s = tmp;
+                dist = cur_dist;
             }
+            pos = (pos + 1) & mask_;
         }
-        delete[] buckets;
     }
 
-    void insert(const SchString& key, const V& value) {
-        const char* k = key.c_str();
-        size_t h = hash_cstr(k);
-        Node* cur = buckets[h];
-        while (cur) {
-            if (std::strcmp(cur->key, k) == 0) {
-                cur->value = value;
-                return;
-            }
-            cur = cur->next;
+    void init_slots(size_t capacity) {
+        slots_ = new Slot[capacity];
+        std::memset(slots_, 0, capacity * sizeof(Slot));
+        mask_ = capacity - 1;
+    }
+
+    void grow() {
+        Slot* old = slots_;
+        size_t old_cap = mask_ + 1;
+        init_slots(old_cap * 2);
+        for (size_t i = 0; i < old_cap; ++i) {
+            if (old[i].entry) place(old[i]);
+        }
+        delete[] old;
+    }
+
+    uint32_t append_key(const char* k, size_t n) {
+        size_t need = arena_len_ + sizeof(uint32_t) + n + 1;
+        if (need > arena_cap_) {
+            size_t cap = arena_cap_ ? arena_cap_ : 4096;
+            while (cap < need) cap *= 2;
+            char* grown = new char[cap];
+            if (arena_len_) std::memcpy(grown, arena_, arena_len_);
+            delete[] arena_;
+            arena_ = grown;
+            arena_cap_ = cap;
         }
-        Node* node = new Node(k, value);
-        node->next = buckets[h];
-        buckets[h] = node;
-        size_++;
-    }
-
-    V* get(const SchString& key) {
-        const char* k = key.c_str();
-        size_t h = hash_cstr(k);
-        Node* cur = buckets[h];
-        while (cur) {
-            if (std::strcmp(cur->key, k) == 0) return &(cur->value);
-            cur = cur->next;
+        uint32_t len = (uint32_t)n;
+        std::memcpy(arena_ + arena_len_, &len, sizeof(len));
+        uint32_t off = (uint32_t)(arena_len_ + sizeof(len));
+        if (n) std::memcpy(arena_ + off, k, n);
+        arena_[off + n] = '\0';
+        arena_len_ = need;
+        return off;
+    }
+
+    V& value_at(uint32_t entry) {
+        size_t e = entry - 1;
+        return chunks_[e / CHUNK][e % CHUNK];
+    }
+    const V& value_at(uint32_t entry) const {
+        size_t e = entry - 1;
+        return chunks_[e / CHUNK][e % CHUNK];
+    }
+
+    template <typename U>
+    V* append_value(U&& v) {
+        size_t chunk = size_ / CHUNK;
+        if (chunk >= chunk_cap_) {
+            size_t cap = chunk_cap_ ? chunk_cap_ * 2 : 16;
+            V** grown = new V*[cap];
+            for (size_t i = 0; i < cap; ++i) grown[i] = i < chunk_cap_ ? chunks_[i] : nullptr;
+            delete[] chunks_;
+            chunks_ = grown;
+            chunk_cap_ = cap;
         }
-        return nullptr;
+        if (!chunks_[chunk]) chunks_[chunk] = new V[CHUNK];
+        V* slot = &chunks_[chunk][size_ % CHUNK];
+        *slot = std::forward<U>(v);
+        return slot;
     }
 
+public:
+    SchStringHashMap(size_t expected = 10007) : size_(0), arena_(nullptr), arena_len_(0), arena_cap_(0),
+                                                chunks_(nullptr), chunk_cap_(0) {
+        size_t cap = 16;
+        while (cap * 4 < expected * 5) cap *= 2;
+        init_slots(cap);
+    }
+    ~SchStringHashMap() {
+        for (size_t i = 0; i < chunk_cap_; ++i) delete[] chunks_[i];
+        delete[] chunks_;
+        delete[] arena_;
+        delete[] slots_;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < chunk_cap_; ++i) { delete[] chunks_[i]; chunks_[i] = nullptr; }
+        std::memset(slots_, 0, (mask_ + 1) * sizeof(Slot));
+        arena_len_ = 0;
+        size_ = 0;
+    }
+
+    template <typename U>
+    void insert(const char* k, size_t n, U&& value) {
+        uint32_t h = hash_bytes(k, n);
+        long pos = find_slot(k, n, h);
+        if (pos >= 0) { value_at(slots_[pos].entry) = std::forward<U>(value); return; }
+        if ((size_ + 1) * 5 > (mask_ + 1) * 4) grow();
+        Slot s;
+        s.hash = h;
+        s.key_off = append_key(k, n);
+        s.key_len = (uint32_t)n;
+        append_value(std::forward<U>(value));
+        s.entry = (uint32_t)(++size_);
+        place(s);
+    }
+    template <typename U>
+    void insert(const SchString& key, U&& value) { insert(key.c_str(), key.size(), std::forward<U>(value)); }
+
+    V* get(const char* k, size_t n) {
+        long pos = find_slot(k, n, hash_bytes(k, n));
+        return pos < 0 ? nullptr : &value_at(slots_[pos].entry);
+    }
+    const V* get(const char* k, size_t n) const {
+        long pos = find_slot(k, n, hash_bytes(k, n));
+        return pos < 0 ? nullptr : &value_at(slots_[pos].entry);
+    }
+    V* get(const SchString& key) { return get(key.c_str(), key.size()); }
+    const V* get(const SchString& key) const { return get(key.c_str(), key.size()); }
+
     SchVector<SchString> get_keys() const {
         SchVector<SchString> keys;
-        for (size_t i = 0; i < bucket_count; ++i) {
-            Node* cur = buckets[i];
-            while (cur) {
-                keys.push_back(SchString(cur->key));
-                cur = cur->next;
-            }
+        size_t off = 0;
+        while (off < arena_len_) {
+            uint32_t len;
+            std::memcpy(&len, arena_ + off, sizeof(len));
+            keys.push_back(SchString(arena_ + off + sizeof(len), len));
+            off += sizeof(len) + len + 1;
         }
         return keys;
     }
@@ -0,0 +1,107 @@
+#ifndef SCH_CORPUS_PACK_H
+#define SCH_CORPUS_PACK_H
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Packed corpus: every document of a corpus directory in one file, in doc id
+// order (file names sorted bytewise, as index_builder lists a directory).
+// Written by src/corpus_pack.py. Layout, little-endian:
+//   SchPackHeader
+//   doc_count SchPackEntry
+//   file names, each NUL-terminated
+//   document texts, back to back
+static const char SCH_PACK_MAGIC[8] = {'S', 'C', 'H', 'P', 'A', 'C', 'K', '1'};
+static const uint32_t SCH_PACK_VERSION = 1;
+
+struct SchPackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t doc_count;
+    uint64_t file_size;
+};
+
+struct SchPackEntry {
+    uint64_t text_offset;
+    uint64_t text_len;
+    uint64_t name_offset;
+    uint32_t name_len;
+    uint32_t reserved;
+};
+
+// The pack mapped copy-on-write: texts can be tokenized in place without
+// touching the file. Pages already indexed are handed back with release().
+class SchCorpusPack {
+private:
+    char* base_;
+    size_t size_;
+    const SchPackEntry* entries_;
+    size_t count_;
+
+    SchCorpusPack(const SchCorpusPack&);
+    SchCorpusPack& operator=(const SchCorpusPack&);
+
+public:
+    SchCorpusPack() : base_(nullptr), size_(0), entries_(nullptr), count_(0) {}
+    ~SchCorpusPack() { close(); }
+
+    bool open(const char* filename) {
+        close();
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SchPackHeader)) { ::close(fd); return false; }
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        base_ = (char*)p;
+        size_ = (size_t)st.st_size;
+        const SchPackHeader* h = (const SchPackHeader*)base_;
+        if (std::memcmp(h->magic, SCH_PACK_MAGIC, sizeof(h->magic)) != 0 || h->version != SCH_PACK_VERSION ||
+            h->file_size != size_ || h->doc_count > (size_ - sizeof(SchPackHeader)) / sizeof(SchPackEntry)) {
+            close();
+            return false;
+        }
+        count_ = (size_t)h->doc_count;
+        entries_ = (const SchPackEntry*)(base_ + sizeof(SchPackHeader));
+        for (size_t i = 0; i < count_; ++i) {
+            const SchPackEntry& e = entries_[i];
+            bool ok = e.text_offset <= size_ && e.text_len <= size_ - e.text_offset &&
+                      e.name_offset < size_ && e.name_len < size_ - e.name_offset && base_[e.name_offset + e.name_len] == '\0';
+            if (!ok) { close(); return false; }
+        }
+        madvise(base_, size_, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void close() {
+        if (base_) munmap(base_, size_);
+        base_ = nullptr;
+        size_ = 0;
+        entries_ = nullptr;
+        count_ = 0;
+    }
+
+    bool is_open() const { return base_ != nullptr; }
+    size_t doc_count() const { return count_; }
+    const char* name(size_t i) const { return base_ + entries_[i].name_offset; }
+    size_t name_len(size_t i) const { return entries_[i].name_len; }
+    char* text(size_t i) const { return base_ + entries_[i].text_offset; }
+    size_t text_len(size_t i) const { return (size_t)entries_[i].text_len; }
+    size_t text_offset(size_t i) const { return (size_t)entries_[i].text_offset; }
+
+    // Drops the pages lying wholly inside [begin, end) of the file: their
+    // private copies go and the file is read again if they are touched.
+    void release(size_t begin, size_t end) const {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t lo = (begin + page - 1) / page * page, hi = end / page * page;
+        if (hi > lo) madvise(base_ + lo, hi - lo, MADV_DONTNEED);
+    }
+};
+
+#endif
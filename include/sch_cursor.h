@@ -0,0 +1,184 @@
+#ifndef SCH_CURSOR_H
+#define SCH_CURSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "sch_containers.h"
+#include "sch_postings.h"
+#include "sch_intersect.h"
+
+// Document-at-a-time evaluation. A cursor stands on one document of its result
+// (SCH_DOC_END once exhausted) and only moves forward: next() steps past it,
+// advance_to(target) to the first document >= target. A query becomes a tree
+// of cursors, so the caller pulls as many documents as it needs and nothing
+// past the last one is decoded or intersected. Cursors own their kids.
+class SchDocCursor {
+protected:
+    int32_t doc_;
+public:
+    SchDocCursor() : doc_(SCH_DOC_END) {}
+    virtual ~SchDocCursor() {}
+    int32_t doc() const { return doc_; }
+    virtual int32_t next() = 0;
+    virtual int32_t advance_to(int32_t target) = 0;
+    // Upper bound on the documents still to come, for ordering AND kids and
+    // bounding count estimates.
+    virtual size_t cost() const = 0;
+};
+
+// One posting list, raw or compressed; whole blocks are skipped through the
+// skip data. The list may be owned (a computed or cached result).
+class SchPostingCursor : public SchDocCursor {
+private:
+    SchVector<int> owned_;
+    SchPostingReader reader_;
+    const int32_t* ids_;
+    size_t pos_;
+    size_t len_;
+    size_t size_;
+
+    int32_t load(bool ok) {
+        pos_ = 0;
+        return doc_ = ok ? ids_[0] : SCH_DOC_END;
+    }
+
+public:
+    explicit SchPostingCursor(const SchPostingView& v) : reader_(v), ids_(nullptr), pos_(0), len_(0), size_(v.size) {
+        load(reader_.next_block(&ids_, &len_));
+    }
+    explicit SchPostingCursor(SchVector<int>&& ids)
+        : owned_(std::move(ids)), reader_(SchPostingView(owned_)), ids_(nullptr), pos_(0), len_(0), size_(owned_.size()) {
+        load(reader_.next_block(&ids_, &len_));
+    }
+
+    int32_t next() {
+        if (doc_ == SCH_DOC_END) return doc_;
+        if (++pos_ < len_) return doc_ = ids_[pos_];
+        return load(reader_.next_block(&ids_, &len_));
+    }
+
+    int32_t advance_to(int32_t target) {
+        if (doc_ >= target) return doc_;
+        if (ids_[len_ - 1] < target && load(reader_.skip_to(target, &ids_, &len_)) == SCH_DOC_END) return doc_;
+        pos_ = sch_gallop(ids_, pos_, len_, target);
+        return doc_ = ids_[pos_];
+    }
+
+    size_t cost() const { return size_; }
+};
+
+// Every document of [0, universe): the positive side of a bare NOT.
+class SchRangeCursor : public SchDocCursor {
+private:
+    int32_t end_;
+public:
+    explicit SchRangeCursor(size_t universe) : end_((int32_t)universe) { doc_ = end_ > 0 ? 0 : SCH_DOC_END; }
+    int32_t next() { return advance_to(doc_ == SCH_DOC_END ? doc_ : doc_ + 1); }
+    int32_t advance_to(int32_t target) {
+        if (doc_ >= target) return doc_;
+        return doc_ = target < end_ ? target : SCH_DOC_END;
+    }
+    size_t cost() const { return doc_ == SCH_DOC_END ? 0 : (size_t)(end_ - doc_); }
+};
+
+// Documents on every positive kid and on no negative one. Positive kids are
+// ordered by cost, so the rarest one proposes candidates and the others only
+// advance to them (leapfrogging); negative kids are probed per candidate.
+class SchAndCursor : public SchDocCursor {
+private:
+    SchVector<SchDocCursor*> pos_;
+    SchVector<SchDocCursor*> neg_;
+
+    int32_t settle(int32_t target) {
+        size_t n = pos_.size();
+        for (;;) {
+            target = pos_[0]->advance_to(target);
+            size_t i = 1;
+            while (i < n && target != SCH_DOC_END) {
+                int32_t d = pos_[i]->advance_to(target);
+                if (d == target) { ++i; continue; }
+                target = pos_[0]->advance_to(d);
+                i = 1;
+            }
+            if (target == SCH_DOC_END) return doc_ = SCH_DOC_END;
+            bool excluded = false;
+            for (size_t j = 0; j < neg_.size() && !excluded; ++j) excluded = neg_[j]->advance_to(target) == target;
+            if (!excluded) return doc_ = target;
+            ++target;
+        }
+    }
+
+public:
+    // Takes ownership of the kids; pos must not be empty.
+    SchAndCursor(SchVector<SchDocCursor*>& pos, SchVector<SchDocCursor*>& neg) : pos_(std::move(pos)), neg_(std::move(neg)) {
+        for (size_t i = 1; i < pos_.size(); ++i) {
+            SchDocCursor* c = pos_[i];
+            size_t j = i;
+            while (j > 0 && pos_[j - 1]->cost() > c->cost()) { pos_[j] = pos_[j - 1]; --j; }
+            pos_[j] = c;
+        }
+        settle(pos_[0]->doc());
+    }
+    ~SchAndCursor() {
+        for (size_t i = 0; i < pos_.size(); ++i) delete pos_[i];
+        for (size_t i = 0; i < neg_.size(); ++i) delete neg_[i];
+    }
+
+    int32_t next() { return doc_ == SCH_DOC_END ? doc_ : settle(doc_ + 1); }
+    int32_t advance_to(int32_t target) { return doc_ >= target ? doc_ : settle(target); }
+    size_t cost() const { return doc_ == SCH_DOC_END ? 0 : pos_[0]->cost(); }
+};
+
+// Documents on any kid. The current document is the smallest kid position,
+// found by a linear scan: OR nodes of a query have a handful of kids.
+class SchOrCursor : public SchDocCursor {
+private:
+    SchVector<SchDocCursor*> kids_;
+
+    int32_t settle() {
+        doc_ = SCH_DOC_END;
+        for (size_t i = 0; i < kids_.size(); ++i) {
+            if (kids_[i]->doc() < doc_) doc_ = kids_[i]->doc();
+        }
+        return doc_;
+    }
+
+public:
+    explicit SchOrCursor(SchVector<SchDocCursor*>& kids) : kids_(std::move(kids)) { settle(); }
+    ~SchOrCursor() {
+        for (size_t i = 0; i < kids_.size(); ++i) delete kids_[i];
+    }
+
+    int32_t next() {
+        if (doc_ == SCH_DOC_END) return doc_;
+        for (size_t i = 0; i < kids_.size(); ++i) {
+            if (kids_[i]->doc() == doc_) kids_[i]->next();
+        }
+        return settle();
+    }
+    int32_t advance_to(int32_t target) {
+        if (doc_ >= target) return doc_;
+        for (size_t i = 0; i < kids_.size(); ++i) kids_[i]->advance_to(target);
+        return settle();
+    }
+    size_t cost() const {
+        size_t c = 0;
+        for (size_t i = 0; i < kids_.size(); ++i) c += kids_[i]->cost();
+        return c;
+    }
+};
+
+// Estimated size of a result of which found matches lie before doc, the next
+// one, in a collection of universe ids: matches are assumed to be spread
+// evenly over the ids. The estimate stays within bound more (the cost of the
+// cursor standing on doc).
+inline size_t sch_estimate_count(size_t found, int32_t doc, size_t universe, size_t bound) {
+    double est = (double)(found + 1) * (double)universe / ((double)doc + 1.0);
+    size_t n = (size_t)(est + 0.5);
+    if (n > found + bound) n = found + bound;
+    if (n < found + 1) n = found + 1;
+    return n;
+}
+
+#endif
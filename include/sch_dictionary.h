@@ -0,0 +1,148 @@
+#ifndef SCH_DICTIONARY_H
+#define SCH_DICTIONARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "sch_containers.h"
+#include "sch_string.h"
+#include "sch_postings.h"
+
+// Front-coded term dictionary: terms in byte order, in blocks of
+// SCH_DICT_BLOCK. Every term is a varint length shared with the previous term
+// of its block, a varint suffix length and the suffix bytes; the first term of
+// a block shares nothing, so it can be compared in place. offsets[b] is the
+// start of block b: a lookup binary-searches the first terms of the blocks and
+// then scans at most one block without materializing any term.
+static const size_t SCH_DICT_BLOCK = 16;
+
+// Builds the blob and block offsets from terms added in increasing order.
+struct SchFrontCoder {
+    SchVector<unsigned char> bytes;
+    SchVector<uint64_t> offsets;
+    SchVector<char> prev;
+    size_t count;
+
+    SchFrontCoder() : count(0) {}
+
+    // False (and nothing added) when t does not sort after the previous term.
+    bool add(const char* t, size_t len) {
+        size_t shared = 0;
+        while (shared < len && shared < prev.size() && prev[shared] == t[shared]) ++shared;
+        if (count && (shared == len || (shared < prev.size() && (unsigned char)t[shared] < (unsigned char)prev[shared]))) return false;
+        if (count % SCH_DICT_BLOCK == 0) {
+            offsets.push_back(bytes.size());
+            shared = 0;
+        }
+        sch_varint_put((uint32_t)shared, bytes);
+        sch_varint_put((uint32_t)(len - shared), bytes);
+        for (size_t i = shared; i < len; ++i) bytes.push_back((unsigned char)t[i]);
+        prev.resize(len);
+        if (len) std::memcpy(prev.begin(), t, len);
+        ++count;
+        return true;
+    }
+};
+
+// Smallest key above every string starting with prefix: the prefix without
+// trailing 0xff bytes and with its last byte incremented. False when there is
+// none (every term from the prefix on matches).
+inline bool sch_prefix_successor(const char* prefix, size_t len, SchVector<char>& next) {
+    next.clear();
+    for (size_t i = 0; i < len; ++i) next.push_back(prefix[i]);
+    while (next.size() && (unsigned char)next[next.size() - 1] == 0xff) next.pop_back();
+    if (next.size() == 0) return false;
+    next[next.size() - 1] = (char)((unsigned char)next[next.size() - 1] + 1);
+    return true;
+}
+
+// Read-only view over a front-coded dictionary, in a mapping or in memory.
+class SchFrontDict {
+private:
+    const unsigned char* data_;
+    const uint64_t* offsets_;
+    size_t count_;
+
+    int compare_first(size_t b, const char* key, size_t len) const {
+        const unsigned char* p = data_ + offsets_[b];
+        sch_varint_get(p);
+        size_t n = sch_varint_get(p);
+        int c = std::memcmp(p, key, n < len ? n : len);
+        if (c) return c;
+        return n < len ? -1 : (n > len ? 1 : 0);
+    }
+
+public:
+    SchFrontDict() : data_(nullptr), offsets_(nullptr), count_(0) {}
+    SchFrontDict(const unsigned char* data, const uint64_t* offsets, size_t count) : data_(data), offsets_(offsets), count_(count) {}
+    explicit SchFrontDict(const SchFrontCoder& c) : data_(c.bytes.begin()), offsets_(c.offsets.begin()), count_(c.count) {}
+
+    size_t size() const { return count_; }
+
+    // Index of the first term >= key (size() if there is none); *found tells
+    // whether that term is key itself. While scanning a block, match is the
+    // common prefix of key and the previous term, which sorts before key: a
+    // term sharing more than match bytes with it still sorts before key, one
+    // sharing fewer sorts after it, and only an equal share needs a compare.
+    size_t lower_bound(const char* key, size_t len, bool* found = nullptr) const {
+        if (found) *found = false;
+        size_t lo = 0, hi = (count_ + SCH_DICT_BLOCK - 1) / SCH_DICT_BLOCK;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (compare_first(mid, key, len) <= 0) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == 0) return 0;
+        size_t i = (lo - 1) * SCH_DICT_BLOCK;
+        size_t end = i + SCH_DICT_BLOCK < count_ ? i + SCH_DICT_BLOCK : count_;
+        const unsigned char* p = data_ + offsets_[lo - 1];
+        size_t match = 0;
+        for (; i < end; ++i) {
+            size_t shared = sch_varint_get(p);
+            size_t n = sch_varint_get(p);
+            const unsigned char* suffix = p;
+            p += n;
+            if (shared > match) continue;
+            if (shared < match) return i;
+            size_t k = 0;
+            while (k < n && match < len && suffix[k] == (unsigned char)key[match]) { ++k; ++match; }
+            if (k == n) {
+                if (match == len) {
+                    if (found) *found = true;
+                    return i;
+                }
+                continue;
+            }
+            if (match == len || suffix[k] > (unsigned char)key[match]) return i;
+        }
+        return end;
+    }
+
+    // Range [*first, *last) of the terms starting with prefix.
+    void prefix_range(const char* prefix, size_t len, size_t* first, size_t* last) const {
+        *first = lower_bound(prefix, len);
+        SchVector<char> next;
+        *last = sch_prefix_successor(prefix, len, next) ? lower_bound(next.begin(), next.size()) : count_;
+    }
+
+    long find(const char* key, size_t len) const {
+        bool found;
+        size_t i = lower_bound(key, len, &found);
+        return found ? (long)i : -1;
+    }
+
+    SchString term(size_t i) const {
+        const unsigned char* p = data_ + offsets_[i / SCH_DICT_BLOCK];
+        SchVector<char> buf;
+        for (size_t j = i - i % SCH_DICT_BLOCK; j <= i; ++j) {
+            size_t shared = sch_varint_get(p);
+            size_t n = sch_varint_get(p);
+            buf.resize(shared);
+            for (size_t k = 0; k < n; ++k) buf.push_back((char)p[k]);
+            p += n;
+        }
+        return SchString(buf.begin(), buf.size());
+    }
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef SCH_INDEX_STRUCTS_H
+#define SCH_INDEX_STRUCTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Mapped index layout: a fixed-width header followed by 8-byte aligned sections.
+//   doc table:  SchDocEntry[doc_count], names blob (NUL-terminated)
+//   dictionary: SchDictEntry[vocab_size] sorted by term, terms blob (NUL-terminated).
+//               With SCH_FLAG_FRONT_CODED the entries are SchTermEntry, the terms
+//               blob is front-coded (see sch_dictionary.h) and TERM_BLOCKS holds
+//               a uint64 offset into it per block of terms.
+//   postings:   int32 doc ids, one contiguous sorted array per term, or with
+//               SCH_FLAG_BLOCK_CODEC blocks of bit-packed gaps (see sch_postings.h).
+//               SCH_FLAG_BLOCK_EXCEPTIONS marks files whose blocks may patch
+//               outlier gaps; older readers would take them for bit widths.
+//               With SCH_FLAG_SKIPS a raw list longer than one block starts with
+//               int32 skips[nblocks], the last doc id of every SCH_BLOCK_SIZE ids.
+//   scores:     with SCH_FLAG_SCORES, uint32 doc lengths (in tokens), one
+//               SchTermStats per dictionary entry, the term frequencies of every
+//               list (one bit-width byte, then fixed-width tf - 1 values) and a
+//               float BM25 upper bound per block of every list.
+//   positions:  with SCH_FLAG_POSITIONS, a uint64 offset per dictionary entry
+//               into the positions blob (layout in sch_positions.h); boolean
+//               queries never touch either section.
+//   doc stats:  one SchDocStats, the collection totals BM25 needs, so a reader
+//               does not sum the doc lengths at open.
+static const char SCH_INDEX_MAGIC[8] = {'S', 'C', 'H', 'I', 'D', 'X', 'M', '1'};
+// Flags change how sections are laid out, so a reader rejects any flag it does
+// not know instead of misreading the file.
+static const uint32_t SCH_INDEX_VERSION = 1;
+
+enum SchIndexFlags {
+    SCH_FLAG_BLOCK_CODEC = 1u << 0,
+    SCH_FLAG_SKIPS = 1u << 1,
+    SCH_FLAG_SCORES = 1u << 2,
+    SCH_FLAG_POSITIONS = 1u << 3,
+    SCH_FLAG_FRONT_CODED = 1u << 4,
+    SCH_FLAG_BLOCK_EXCEPTIONS = 1u << 5
+};
+
+static const uint32_t SCH_KNOWN_FLAGS = SCH_FLAG_BLOCK_CODEC | SCH_FLAG_SKIPS | SCH_FLAG_SCORES | SCH_FLAG_POSITIONS | SCH_FLAG_FRONT_CODED |
+                                        SCH_FLAG_BLOCK_EXCEPTIONS;
+
+static const size_t SCH_BLOCK_SIZE = 128;
+
+enum SchSectionId {
+    SCH_SEC_DOCS = 0,
+    SCH_SEC_DOC_NAMES,
+    SCH_SEC_DICT,
+    SCH_SEC_TERMS,
+    SCH_SEC_POSTINGS,
+    SCH_SEC_DOC_LENS,
+    SCH_SEC_TERM_STATS,
+    SCH_SEC_FREQS,
+    SCH_SEC_BLOCK_MAX,
+    SCH_SEC_POS_OFFSETS,
+    SCH_SEC_POSITIONS,
+    SCH_SEC_TERM_BLOCKS,
+    SCH_SEC_DOC_STATS,
+    SCH_SEC_MAX = 16
+};
+
+struct SchSection {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct SchIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t doc_count;
+    uint64_t vocab_size;
+    uint64_t file_size;
+    SchSection sections[SCH_SEC_MAX];
+};
+
+struct SchDocEntry {
+    uint64_t name_offset;
+    uint32_t name_len;
+    uint32_t reserved;
+};
+
+struct SchDictEntry {
+    uint64_t term_offset;
+    uint64_t postings_offset;
+    uint32_t term_len;
+    uint32_t doc_freq;
+};
+
+struct SchTermEntry {
+    uint64_t postings_offset;
+    uint32_t doc_freq;
+    uint32_t reserved;
+};
+
+// Ranking data of one dictionary entry; offsets are relative to the FREQS and
+// BLOCK_MAX sections, max_score bounds the BM25 contribution of the term.
+struct SchTermStats {
+    uint64_t freqs_offset;
+    uint64_t block_max_offset;
+    float max_score;
+    uint32_t max_tf;
+};
+
+struct SchDocStats {
+    uint64_t total_len;
+    uint64_t reserved;
+};
+
+// Per-block header of a compressed list with more than one block; offset is
+// relative to the end of the header array.
+struct SchBlockHeader {
+    int32_t max_id;
+    uint32_t offset;
+};
+
+inline size_t sch_align4(size_t n) { return (n + 3) & ~(size_t)3; }
+inline size_t sch_align8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+inline bool sch_is_mapped_index(const void* data, size_t size) {
+    return size >= sizeof(SchIndexHeader) && std::memcmp(data, SCH_INDEX_MAGIC, sizeof(SCH_INDEX_MAGIC)) == 0;
+}
+
+#endif
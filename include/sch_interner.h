@@ -0,0 +1,111 @@
+#ifndef SCH_INTERNER_H
+#define SCH_INTERNER_H
+
+#include <cstdint>
+#include <cstring>
+#include "sch_arena.h"
+#include "sch_containers.h"
+
+// Assigns dense ids to distinct terms in first-seen order. Term bytes are copied
+// once into an arena and stay at a stable address until clear(). The lookup
+// table holds only a hash and an id per slot and compares against the arena
+// copy, so every term is stored once.
+class SchTermInterner {
+private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t entry; // 0 = empty, otherwise term id + 1
+    };
+
+    Slot* slots_;
+    size_t mask_;
+    SchArena strings_;
+    SchVector<const char*> terms_;
+    SchVector<uint32_t> lens_;
+
+    SchTermInterner(const SchTermInterner&);
+    SchTermInterner& operator=(const SchTermInterner&);
+
+    static uint32_t hash_bytes(const char* k, size_t n) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < n; ++i) h = (h ^ (unsigned char)k[i]) * 1099511628211ull;
+        return (uint32_t)(h ^ (h >> 32));
+    }
+
+    void init_slots(size_t capacity) {
+        slots_ = new Slot[capacity];
+        std::memset(slots_, 0, capacity * sizeof(Slot));
+        mask_ = capacity - 1;
+    }
+
+    // Slot holding s, or the empty slot where it would go.
+    size_t probe(const char* s, size_t n, uint32_t h) const {
+        size_t pos = h & mask_;
+        for (;;) {
+            const Slot& slot = slots_[pos];
+            if (slot.entry == 0) return pos;
+            uint32_t id = slot.entry - 1;
+            if (slot.hash == h && lens_.at_unchecked(id) == n && std::memcmp(terms_.at_unchecked(id), s, n) == 0) return pos;
+            pos = (pos + 1) & mask_;
+        }
+    }
+
+    void grow() {
+        Slot* old = slots_;
+        size_t old_cap = mask_ + 1;
+        init_slots(old_cap * 2);
+        for (size_t i = 0; i < old_cap; ++i) {
+            if (!old[i].entry) continue;
+            size_t pos = old[i].hash & mask_;
+            while (slots_[pos].entry) pos = (pos + 1) & mask_;
+            slots_[pos] = old[i];
+        }
+        delete[] old;
+    }
+
+public:
+    SchTermInterner(size_t expected = 50000) : strings_(256 * 1024) {
+        size_t cap = 16;
+        while (cap * 4 < expected * 5) cap *= 2;
+        init_slots(cap);
+    }
+    ~SchTermInterner() { delete[] slots_; }
+
+    uint32_t intern(const char* s, size_t n, bool* inserted = nullptr) {
+        uint32_t h = hash_bytes(s, n);
+        size_t pos = probe(s, n, h);
+        if (inserted) *inserted = slots_[pos].entry == 0;
+        if (slots_[pos].entry) return slots_[pos].entry - 1;
+        char* copy = (char*)strings_.allocate(n + 1, 1);
+        std::memcpy(copy, s, n);
+        copy[n] = '\0';
+        uint32_t next = (uint32_t)terms_.size();
+        terms_.push_back(copy);
+        lens_.push_back((uint32_t)n);
+        if ((terms_.size() + 1) * 5 > (mask_ + 1) * 4) {
+            grow();
+            pos = probe(s, n, h);
+        }
+        slots_[pos].hash = h;
+        slots_[pos].entry = next + 1;
+        return next;
+    }
+
+    long find(const char* s, size_t n) const {
+        const Slot& slot = slots_[probe(s, n, hash_bytes(s, n))];
+        return slot.entry ? (long)slot.entry - 1 : -1;
+    }
+
+    size_t size() const { return terms_.size(); }
+    const char* term(uint32_t id) const { return terms_[id]; }
+    size_t length(uint32_t id) const { return lens_[id]; }
+
+    void clear() {
+        std::memset(slots_, 0, (mask_ + 1) * sizeof(Slot));
+        strings_.reset();
+        terms_.clear();
+        lens_.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,267 @@
+#ifndef SCH_INTERSECT_H
+#define SCH_INTERSECT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "sch_containers.h"
+#include "sch_postings.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Intersection kernels over sorted, duplicate-free id arrays. Each writes the
+// common ids in ascending order to out (room for min(na, nb) ids) and returns
+// how many were written.
+
+// First index in [lo, n) with a[index] >= x, found by doubling the step from lo.
+inline size_t sch_gallop(const int32_t* a, size_t lo, size_t n, int32_t x) {
+    size_t hi = lo, step = 1;
+    while (hi < n && a[hi] < x) {
+        lo = hi + 1;
+        hi += step;
+        step <<= 1;
+    }
+    if (hi > n) hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a[mid] < x) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+inline size_t sch_intersect_merge(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        if (a[i] == b[j]) { out[k++] = a[i]; i++; j++; }
+        else if (a[i] < b[j]) i++;
+        else j++;
+    }
+    return k;
+}
+
+// For lists of very different sizes: every id of the short list is located in
+// the long one by galloping forward from the previous match.
+inline size_t sch_intersect_gallop(const int32_t* small, size_t ns, const int32_t* large, size_t nl, int32_t* out) {
+    size_t j = 0, k = 0;
+    for (size_t i = 0; i < ns; ++i) {
+        j = sch_gallop(large, j, nl, small[i]);
+        if (j == nl) break;
+        if (large[j] == small[i]) out[k++] = small[i];
+    }
+    return k;
+}
+
+// For lists of similar size: compares a block of one list against every
+// rotation of a block of the other, then advances whichever block ends lower.
+inline size_t sch_intersect_simd(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+#if defined(__AVX2__)
+    const __m256i rot = _mm256_set_epi32(0, 7, 6, 5, 4, 3, 2, 1);
+    while (i + 8 <= na && j + 8 <= nb) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+        __m256i m = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; ++r) {
+            vb = _mm256_permutevar8x32_epi32(vb, rot);
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi32(va, vb));
+        }
+        unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(m));
+        while (mask) { out[k++] = a[i + (size_t)__builtin_ctz(mask)]; mask &= mask - 1; }
+        int32_t amax = a[i + 7], bmax = b[j + 7];
+        if (amax <= bmax) i += 8;
+        if (bmax <= amax) j += 8;
+    }
+#elif defined(__SSE2__)
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m));
+        while (mask) { out[k++] = a[i + (size_t)__builtin_ctz(mask)]; mask &= mask - 1; }
+        int32_t amax = a[i + 3], bmax = b[j + 3];
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+#endif
+    return k + sch_intersect_merge(a + i, na - i, b + j, nb - j, out + k);
+}
+
+// Length ratio from which galloping beats the block compare (see bench_intersect).
+static const size_t SCH_GALLOP_RATIO = 32;
+
+inline size_t sch_intersect(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+    if (na > nb) {
+        const int32_t* t = a; a = b; b = t;
+        size_t tn = na; na = nb; nb = tn;
+    }
+    if (na == 0) return 0;
+    if (nb / na >= SCH_GALLOP_RATIO) return sch_intersect_gallop(a, na, b, nb, out);
+    return sch_intersect_simd(a, na, b, nb, out);
+}
+
+// Decodes a posting list into buf unless it is already a raw array.
+inline const int32_t* sch_materialize(const SchPostingView& v, SchVector<int>& buf) {
+    if (!v.compressed()) return v.ids;
+    buf.resize(v.size);
+    SchPostingReader r(v);
+    const int32_t* ids = nullptr;
+    size_t n = 0, pos = 0;
+    while (r.next_block(&ids, &n)) {
+        for (size_t i = 0; i < n; ++i) buf[pos + i] = ids[i];
+        pos += n;
+    }
+    return buf.begin();
+}
+
+// Intersects two posting lists into out. The shorter list is materialized.
+// The longer one is probed in place when it is a plain array; when it carries
+// skip data and is much longer (or is compressed), the reader jumps straight
+// to the block holding the next candidate, so blocks without candidates are
+// never decoded or paged in. out must not alias either input.
+inline void sch_intersect_views(const SchPostingView& l1, const SchPostingView& l2, SchVector<int>& out, SchVector<int>& scratch) {
+    const SchPostingView& small = l1.size <= l2.size ? l1 : l2;
+    const SchPostingView& large = l1.size <= l2.size ? l2 : l1;
+    out.clear();
+    if (small.size == 0) return;
+    const int32_t* s = sch_materialize(small, scratch);
+    size_t ns = small.size;
+    out.resize(ns);
+    size_t k = 0;
+    if (!large.compressed() && (!large.has_skips() || large.size / ns < SCH_GALLOP_RATIO)) {
+        k = sch_intersect(s, ns, large.ids, large.size, out.begin());
+    } else {
+        SchPostingReader r(large);
+        const int32_t* b = nullptr;
+        size_t nb = 0, pos = 0;
+        while (pos < ns && r.skip_to(s[pos], &b, &nb)) {
+            size_t end = sch_gallop(s, pos, ns, b[nb - 1] + 1);
+            k += sch_intersect(s + pos, end - pos, b, nb, out.begin() + k);
+            pos = end;
+        }
+    }
+    out.resize(k);
+}
+
+// Query planner for a chain of ANDs: lists are intersected shortest first so
+// every intermediate result is bounded by the rarest term, and the chain stops
+// as soon as it becomes empty. Reorders lists.
+inline SchVector<int> sch_intersect_all(SchPostingView* lists, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        SchPostingView v = lists[i];
+        size_t j = i;
+        while (j > 0 && lists[j - 1].size > v.size) { lists[j] = lists[j - 1]; --j; }
+        lists[j] = v;
+    }
+    SchVector<int> acc, next, scratch;
+    if (n == 0 || lists[0].size == 0) return acc;
+    if (n == 1) {
+        const int32_t* ids = sch_materialize(lists[0], scratch);
+        acc.resize(lists[0].size);
+        for (size_t i = 0; i < lists[0].size; ++i) acc[i] = ids[i];
+        return acc;
+    }
+    sch_intersect_views(lists[0], lists[1], acc, scratch);
+    for (size_t i = 2; i < n && acc.size(); ++i) {
+        sch_intersect_views(SchPostingView(acc), lists[i], next, scratch);
+        SchVector<int> t = std::move(acc);
+        acc = std::move(next);
+        next = std::move(t);
+    }
+    return acc;
+}
+
+
+// Multiway union of n sorted lists: a binary min-heap of list cursors emits
+// every id once, in O(total * log n), where folding pairwise unions would copy
+// the growing result once per list; two lists are merged directly. Replaces out.
+struct SchUnionCursor {
+    SchPostingReader reader;
+    const int32_t* ids;
+    size_t pos;
+    size_t len;
+    explicit SchUnionCursor(const SchPostingView& v) : reader(v), ids(nullptr), pos(0), len(0) {}
+    bool next() {
+        if (++pos < len) return true;
+        pos = 0;
+        return reader.next_block(&ids, &len);
+    }
+};
+
+inline void sch_union_pair(const SchPostingView& l1, const SchPostingView& l2, SchVector<int>& out) {
+    out.clear();
+    out.reserve(l1.size + l2.size);
+    SchPostingReader r1(l1), r2(l2);
+    const int32_t *a = nullptr, *b = nullptr;
+    size_t na = 0, nb = 0, i = 0, j = 0;
+    bool has_a = r1.next_block(&a, &na), has_b = r2.next_block(&b, &nb);
+    while (has_a && has_b) {
+        if (a[i] == b[j]) { out.push_back(a[i]); i++; j++; }
+        else if (a[i] < b[j]) out.push_back(a[i++]);
+        else out.push_back(b[j++]);
+        if (i == na) { has_a = r1.next_block(&a, &na); i = 0; }
+        if (j == nb) { has_b = r2.next_block(&b, &nb); j = 0; }
+    }
+    for (; has_a; has_a = r1.next_block(&a, &na), i = 0) {
+        for (; i < na; ++i) out.push_back(a[i]);
+    }
+    for (; has_b; has_b = r2.next_block(&b, &nb), j = 0) {
+        for (; j < nb; ++j) out.push_back(b[j]);
+    }
+}
+
+inline void sch_union_all(const SchPostingView* lists, size_t n, SchVector<int>& out) {
+    if (n == 2) {
+        sch_union_pair(lists[0], lists[1], out);
+        return;
+    }
+    out.clear();
+    // Reserved up front: a cursor's ids may point into its own decode buffer.
+    SchVector<SchUnionCursor> cursors;
+    cursors.reserve(n);
+    SchVector<uint32_t> heap;
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (lists[i].size == 0) continue;
+        cursors.emplace_back(lists[i]);
+        SchUnionCursor& c = cursors[cursors.size() - 1];
+        c.reader.next_block(&c.ids, &c.len);
+        heap.push_back((uint32_t)(cursors.size() - 1));
+        total += lists[i].size;
+    }
+    out.reserve(total);
+    auto key = [&cursors](uint32_t c) { return cursors[c].ids[cursors[c].pos]; };
+    auto sift_down = [&](size_t i) {
+        uint32_t v = heap[i];
+        int32_t kv = key(v);
+        for (;;) {
+            size_t child = 2 * i + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && key(heap[child + 1]) < key(heap[child])) ++child;
+            if (key(heap[child]) >= kv) break;
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = v;
+    };
+    for (size_t i = heap.size() / 2; i-- > 0;) sift_down(i);
+    while (heap.size()) {
+        int32_t id = key(heap[0]);
+        if (out.size() == 0 || out[out.size() - 1] != id) out.push_back(id);
+        if (!cursors[heap[0]].next()) {
+            heap[0] = heap[heap.size() - 1];
+            heap.pop_back();
+            if (heap.size() == 0) break;
+        }
+        sift_down(0);
+    }
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef SCH_MAPPED_INDEX_H
+#define SCH_MAPPED_INDEX_H
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sch_index_structs.h"
+#include "sch_postings.h"
+#include "sch_dictionary.h"
+
+// Read-only view over an index file in the mapped format. Nothing is copied
+// to the heap: every accessor points straight into the mapping. Files without
+// SCH_FLAG_FRONT_CODED keep the older SchDictEntry dictionary.
+class SchMappedIndex {
+private:
+    const unsigned char* base_;
+    size_t size_;
+    const SchIndexHeader* header_;
+    const SchDocEntry* docs_;
+    const char* doc_names_;
+    const SchDictEntry* dict_;
+    const char* terms_;
+    const SchTermEntry* entries_;
+    SchFrontDict front_;
+    const unsigned char* postings_;
+    const uint32_t* doc_lens_;
+    const SchTermStats* term_stats_;
+    const unsigned char* freqs_;
+    const float* block_max_;
+    const uint64_t* pos_offsets_;
+    const unsigned char* positions_;
+    double avg_doc_len_;
+
+    SchMappedIndex(const SchMappedIndex&);
+    SchMappedIndex& operator=(const SchMappedIndex&);
+
+    bool section_ok(int id) const {
+        const SchSection& s = header_->sections[id];
+        return s.offset <= size_ && s.size <= size_ - s.offset;
+    }
+
+    bool fits(uint64_t offset, uint64_t n, int id) const {
+        const SchSection& s = header_->sections[id];
+        return offset <= s.size && n <= s.size - offset;
+    }
+
+    // Every offset and length read from the tables must stay inside its
+    // section, so a corrupt index is rejected at open instead of being read
+    // out of bounds later. One pass over the doc and term tables; posting
+    // data is only touched for the block headers of long lists.
+    bool entries_ok() const {
+        size_t ndocs = doc_count(), nterms = vocab_size();
+        if (!fits(0, ndocs * sizeof(SchDocEntry), SCH_SEC_DOCS)) return false;
+        for (size_t d = 0; d < ndocs; ++d) {
+            if (!fits(docs_[d].name_offset, (uint64_t)docs_[d].name_len + 1, SCH_SEC_DOC_NAMES) ||
+                doc_names_[docs_[d].name_offset + docs_[d].name_len] != '\0') return false;
+        }
+        if (!fits(0, nterms * (entries_ ? sizeof(SchTermEntry) : sizeof(SchDictEntry)), SCH_SEC_DICT)) return false;
+        if (entries_) {
+            size_t nblocks = (nterms + SCH_DICT_BLOCK - 1) / SCH_DICT_BLOCK;
+            if (!fits(0, nblocks * sizeof(uint64_t), SCH_SEC_TERM_BLOCKS)) return false;
+            const uint64_t* blocks = (const uint64_t*)(base_ + header_->sections[SCH_SEC_TERM_BLOCKS].offset);
+            for (size_t b = 0; b < nblocks; ++b) {
+                if (!fits(blocks[b], 1, SCH_SEC_TERMS)) return false;
+            }
+        }
+        if (has_scores() && (!fits(0, ndocs * sizeof(uint32_t), SCH_SEC_DOC_LENS) || !fits(0, nterms * sizeof(SchTermStats), SCH_SEC_TERM_STATS))) return false;
+        if (has_positions() && !fits(0, nterms * sizeof(uint64_t), SCH_SEC_POS_OFFSETS)) return false;
+        bool skips = (header_->flags & SCH_FLAG_SKIPS) != 0;
+        for (size_t t = 0; t < nterms; ++t) {
+            if (!entries_ && !fits(dict_[t].term_offset, (uint64_t)dict_[t].term_len + 1, SCH_SEC_TERMS)) return false;
+            uint64_t offset = entries_ ? entries_[t].postings_offset : dict_[t].postings_offset;
+            size_t df = entries_ ? entries_[t].doc_freq : dict_[t].doc_freq;
+            size_t nblocks = sch_block_count(df);
+            if (df > ndocs) return false;
+            if (!compressed()) {
+                if (!fits(offset, (df + (skips && nblocks > 1 ? nblocks : 0)) * sizeof(int32_t), SCH_SEC_POSTINGS)) return false;
+            } else {
+                size_t header_bytes = nblocks > 1 ? nblocks * sizeof(SchBlockHeader) : 0;
+                if (!fits(offset, header_bytes + 1, SCH_SEC_POSTINGS)) return false;
+                const SchBlockHeader* h = (const SchBlockHeader*)(postings_ + offset);
+                for (size_t b = 0; header_bytes && b < nblocks; ++b) {
+                    if (!fits(offset + header_bytes + h[b].offset, 1, SCH_SEC_POSTINGS) || h[b].max_id < 0 || (size_t)h[b].max_id >= ndocs) return false;
+                }
+            }
+            if (has_scores()) {
+                const SchTermStats& ts = term_stats_[t];
+                if (!fits(ts.freqs_offset, 1, SCH_SEC_FREQS) || freqs_[ts.freqs_offset] > 32 ||
+                    !fits(ts.freqs_offset + 1, (df * freqs_[ts.freqs_offset] + 7) / 8, SCH_SEC_FREQS) ||
+                    ts.block_max_offset % sizeof(float) || !fits(ts.block_max_offset, nblocks * sizeof(float), SCH_SEC_BLOCK_MAX)) return false;
+            }
+            if (has_positions() && !fits(pos_offsets_[t], nblocks > 1 ? nblocks * sizeof(uint32_t) : 0, SCH_SEC_POSITIONS)) return false;
+        }
+        return true;
+    }
+
+public:
+    SchMappedIndex() : base_(nullptr), size_(0), header_(nullptr), docs_(nullptr), doc_names_(nullptr),
+                       dict_(nullptr), terms_(nullptr), entries_(nullptr), postings_(nullptr), doc_lens_(nullptr), term_stats_(nullptr),
+                       freqs_(nullptr), block_max_(nullptr), pos_offsets_(nullptr), positions_(nullptr), avg_doc_len_(0) {}
+    ~SchMappedIndex() { close(); }
+
+    bool open(const char* filename) {
+        close();
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SchIndexHeader)) { ::close(fd); return false; }
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        base_ = (const unsigned char*)p;
+        size_ = (size_t)st.st_size;
+        if (!sch_is_mapped_index(base_, size_)) { close(); return false; }
+        header_ = (const SchIndexHeader*)base_;
+        if (header_->version != SCH_INDEX_VERSION || header_->file_size != size_ ||
+            (header_->flags & ~SCH_KNOWN_FLAGS) != 0) {
+            close();
+            return false;
+        }
+        for (int i = SCH_SEC_DOCS; i <= SCH_SEC_POSTINGS; ++i) {
+            if (!section_ok(i)) { close(); return false; }
+        }
+        docs_ = (const SchDocEntry*)(base_ + header_->sections[SCH_SEC_DOCS].offset);
+        doc_names_ = (const char*)(base_ + header_->sections[SCH_SEC_DOC_NAMES].offset);
+        dict_ = (const SchDictEntry*)(base_ + header_->sections[SCH_SEC_DICT].offset);
+        terms_ = (const char*)(base_ + header_->sections[SCH_SEC_TERMS].offset);
+        postings_ = base_ + header_->sections[SCH_SEC_POSTINGS].offset;
+        if (header_->flags & SCH_FLAG_FRONT_CODED) {
+            if (!section_ok(SCH_SEC_TERM_BLOCKS)) { close(); return false; }
+            entries_ = (const SchTermEntry*)dict_;
+            front_ = SchFrontDict((const unsigned char*)terms_, (const uint64_t*)(base_ + header_->sections[SCH_SEC_TERM_BLOCKS].offset), vocab_size());
+        }
+        if (header_->flags & SCH_FLAG_SCORES) {
+            for (int i = SCH_SEC_DOC_LENS; i <= SCH_SEC_BLOCK_MAX; ++i) {
+                if (!section_ok(i)) { close(); return false; }
+            }
+            if (!section_ok(SCH_SEC_DOC_STATS) || header_->sections[SCH_SEC_DOC_STATS].size < sizeof(SchDocStats)) { close(); return false; }
+            doc_lens_ = (const uint32_t*)(base_ + header_->sections[SCH_SEC_DOC_LENS].offset);
+            term_stats_ = (const SchTermStats*)(base_ + header_->sections[SCH_SEC_TERM_STATS].offset);
+            freqs_ = base_ + header_->sections[SCH_SEC_FREQS].offset;
+            block_max_ = (const float*)(base_ + header_->sections[SCH_SEC_BLOCK_MAX].offset);
+        }
+        if (header_->flags & SCH_FLAG_POSITIONS) {
+            if (!section_ok(SCH_SEC_POS_OFFSETS) || !section_ok(SCH_SEC_POSITIONS)) { close(); return false; }
+            pos_offsets_ = (const uint64_t*)(base_ + header_->sections[SCH_SEC_POS_OFFSETS].offset);
+            positions_ = base_ + header_->sections[SCH_SEC_POSITIONS].offset;
+        }
+        if (!entries_ok()) { close(); return false; }
+        if (has_scores()) {
+            double total = (double)((const SchDocStats*)(base_ + header_->sections[SCH_SEC_DOC_STATS].offset))->total_len;
+            avg_doc_len_ = doc_count() ? total / doc_count() : 0;
+        }
+        madvise((void*)base_, size_, MADV_RANDOM);
+        return true;
+    }
+
+    void close() {
+        if (base_) munmap((void*)base_, size_);
+        base_ = nullptr;
+        size_ = 0;
+        header_ = nullptr;
+        entries_ = nullptr;
+        doc_lens_ = nullptr;
+        term_stats_ = nullptr;
+        freqs_ = nullptr;
+        block_max_ = nullptr;
+        pos_offsets_ = nullptr;
+        positions_ = nullptr;
+    }
+
+    bool is_open() const { return base_ != nullptr; }
+    size_t file_size() const { return size_; }
+    const SchSection& section(int id) const { return header_->sections[id]; }
+    size_t doc_count() const { return header_ ? (size_t)header_->doc_count : 0; }
+    size_t vocab_size() const { return header_ ? (size_t)header_->vocab_size : 0; }
+
+    const char* doc_name(size_t doc_id) const { return doc_names_ + docs_[doc_id].name_offset; }
+    SchString term_at(size_t i) const {
+        if (entries_) return front_.term(i);
+        return SchString(terms_ + dict_[i].term_offset, dict_[i].term_len);
+    }
+
+    // Binary search over the sorted dictionary: index of the first term >= term
+    // (vocab_size() if none); *found tells whether it is term itself.
+    size_t lower_bound(const char* term, size_t len, bool* found = nullptr) const {
+        if (entries_) return front_.lower_bound(term, len, found);
+        if (found) *found = false;
+        size_t lo = 0, hi = vocab_size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            const SchDictEntry& e = dict_[mid];
+            size_t n = e.term_len < len ? e.term_len : len;
+            int c = std::memcmp(terms_ + e.term_offset, term, n);
+            if (c == 0) c = (e.term_len < len) ? -1 : (e.term_len > len ? 1 : 0);
+            if (c == 0) {
+                if (found) *found = true;
+                return mid;
+            }
+            if (c < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // Returns -1 when absent.
+    long find_term(const char* term, size_t len) const {
+        bool found;
+        size_t i = lower_bound(term, len, &found);
+        return found ? (long)i : -1;
+    }
+
+    // Range [*first, *last) of the terms starting with prefix.
+    void prefix_range(const char* prefix, size_t len, size_t* first, size_t* last) const {
+        *first = lower_bound(prefix, len);
+        SchVector<char> next;
+        *last = sch_prefix_successor(prefix, len, next) ? lower_bound(next.begin(), next.size()) : vocab_size();
+    }
+
+    bool compressed() const { return header_ && (header_->flags & SCH_FLAG_BLOCK_CODEC); }
+
+    bool has_scores() const { return doc_lens_ != nullptr; }
+    uint32_t doc_len(size_t doc_id) const { return doc_lens_[doc_id]; }
+    double avg_doc_len() const { return avg_doc_len_; }
+    const SchTermStats& term_stats(size_t term_idx) const { return term_stats_[term_idx]; }
+    const unsigned char* freqs(size_t term_idx) const { return freqs_ + term_stats_[term_idx].freqs_offset; }
+    const float* block_max(size_t term_idx) const { return block_max_ + term_stats_[term_idx].block_max_offset / sizeof(float); }
+
+    bool has_positions() const { return positions_ != nullptr; }
+    const unsigned char* positions(size_t term_idx) const { return positions_ + pos_offsets_[term_idx]; }
+
+    SchPostingView postings(size_t term_idx) const {
+        uint64_t offset = entries_ ? entries_[term_idx].postings_offset : dict_[term_idx].postings_offset;
+        size_t df = entries_ ? entries_[term_idx].doc_freq : dict_[term_idx].doc_freq;
+        if (compressed()) return SchPostingView(postings_ + offset, df);
+        return SchPostingView((const int32_t*)(postings_ + offset), df, (header_->flags & SCH_FLAG_SKIPS) != 0);
+    }
+};
+
+// True when filename starts with the mapped index magic, whether or not this
+// reader can open it (a newer version or unknown flags make open() fail).
+inline bool sch_file_has_index_magic(const char* filename) {
+    char magic[sizeof(SCH_INDEX_MAGIC)];
+    FILE* f = fopen(filename, "rb");
+    if (!f) return false;
+    bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && std::memcmp(magic, SCH_INDEX_MAGIC, sizeof(magic)) == 0;
+    fclose(f);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef SCH_POSITIONS_H
+#define SCH_POSITIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include "sch_containers.h"
+#include "sch_postings.h"
+#include "sch_mapped_index.h"
+#include "sch_intersect.h"
+
+// Positional record of one term: lists with more than one block start
+// (4-byte aligned) with uint32 offsets[nblocks] of every block's first
+// posting, relative to the end of the table. Each posting is then a varint
+// count followed by that many varint position deltas (the first one is the
+// position itself). Positions number the tokens of a document from 0.
+
+// Appends the record of one list (tfs[i] positions for posting i, read in
+// order from pos) and returns its offset within out.
+inline size_t sch_encode_positions(const int32_t* tfs, size_t n, const int32_t* pos, SchVector<unsigned char>& out) {
+    size_t nblocks = sch_block_count(n);
+    if (nblocks > 1) while (out.size() % 4) out.push_back(0);
+    size_t start = out.size();
+    size_t table_bytes = nblocks > 1 ? nblocks * sizeof(uint32_t) : 0;
+    for (size_t i = 0; i < table_bytes; ++i) out.push_back(0);
+    size_t data_start = out.size();
+    for (size_t i = 0; i < n; ++i) {
+        if (table_bytes && i % SCH_BLOCK_SIZE == 0) {
+            uint32_t off = (uint32_t)(out.size() - data_start);
+            std::memcpy(&out[start + (i / SCH_BLOCK_SIZE) * sizeof(uint32_t)], &off, sizeof(off));
+        }
+        sch_varint_put((uint32_t)tfs[i], out);
+        int32_t prev = 0;
+        for (int32_t k = 0; k < tfs[i]; ++k) {
+            sch_varint_put((uint32_t)(*pos - prev), out);
+            prev = *pos++;
+        }
+    }
+    return start;
+}
+
+// Start of the per-posting data of a term's record (the block table skipped),
+// for reading every posting in order when an index is rewritten.
+inline const unsigned char* sch_positions_stream(const SchMappedIndex& idx, size_t term_idx) {
+    size_t nblocks = idx.postings(term_idx).block_count();
+    return idx.positions(term_idx) + (nblocks > 1 ? nblocks * sizeof(uint32_t) : 0);
+}
+
+// Reads the positions of one term for increasing doc ids: the doc is located
+// through the posting reader (skipping blocks), then the position stream jumps
+// to that block and skips the postings before it without decoding them.
+// Holds a reader with an inline block buffer, so cursors must stay where they
+// were initialised.
+struct SchPositionCursor {
+    SchPostingReader reader;
+    const int32_t* ids;
+    size_t n;
+    size_t pos;
+    size_t block;
+    const uint32_t* block_offsets;
+    const unsigned char* data;
+    const unsigned char* p;
+    size_t p_index;
+
+    SchPositionCursor() : reader(SchPostingView()), ids(nullptr), n(0), pos(0), block(0),
+                          block_offsets(nullptr), data(nullptr), p(nullptr), p_index(0) {}
+
+    void init(const SchMappedIndex& idx, size_t term_idx) {
+        SchPostingView view = idx.postings(term_idx);
+        reader = SchPostingReader(view);
+        ids = nullptr;
+        n = pos = block = 0;
+        const unsigned char* rec = idx.positions(term_idx);
+        size_t nblocks = view.block_count();
+        block_offsets = nblocks > 1 ? (const uint32_t*)rec : nullptr;
+        data = rec + (nblocks > 1 ? nblocks * sizeof(uint32_t) : 0);
+        p = data;
+        p_index = 0;
+    }
+
+    // Decodes the positions of doc into out; false when doc is not in the list.
+    bool read(int32_t doc, SchVector<int32_t>& out) {
+        if (!ids || ids[n - 1] < doc) {
+            if (!reader.skip_to(doc, &ids, &n)) return false;
+            block = reader.current_block();
+            pos = 0;
+        }
+        pos = sch_gallop(ids, pos, n, doc);
+        if (pos == n || ids[pos] != doc) return false;
+        size_t j = block * SCH_BLOCK_SIZE + pos;
+        if (j < p_index || j / SCH_BLOCK_SIZE != p_index / SCH_BLOCK_SIZE) {
+            p = data + (block_offsets ? block_offsets[block] : 0);
+            p_index = block * SCH_BLOCK_SIZE;
+        }
+        for (; p_index < j; ++p_index) {
+            uint32_t c = sch_varint_get(p);
+            while (c) { if (!(*p++ & 0x80)) --c; }
+        }
+        uint32_t c = sch_varint_get(p);
+        out.resize(c);
+        int32_t prev = 0;
+        for (uint32_t k = 0; k < c; ++k) {
+            prev += (int32_t)sch_varint_get(p);
+            out[k] = prev;
+        }
+        ++p_index;
+        return true;
+    }
+};
+
+// One word of a phrase or NEAR group: it matches at position p when some
+// matching position q of the previous word has lo <= p - q <= hi. A phrase
+// word uses [1, 1]; NEAR/k uses [-k, k]. The first word's range is ignored.
+struct SchProximityTerm {
+    size_t term;
+    int32_t lo;
+    int32_t hi;
+};
+
+// Keeps the positions of cur that lie in [lo, hi] after some position of prev.
+inline size_t sch_position_step(const int32_t* prev, size_t np, const int32_t* cur, size_t nc, int32_t lo, int32_t hi, int32_t* out) {
+    size_t j = 0, k = 0;
+    for (size_t i = 0; i < nc && j < np; ++i) {
+        while (j < np && prev[j] < cur[i] - hi) ++j;
+        if (j < np && prev[j] <= cur[i] - lo) out[k++] = cur[i];
+    }
+    return k;
+}
+
+// Phrase / NEAR evaluation: the doc-id lists are intersected first (shortest
+// first) and positions are decoded only for the surviving candidates, word by
+// word, stopping at the first word that leaves no reachable position.
+inline SchVector<int> sch_proximity_match(const SchMappedIndex& idx, const SchProximityTerm* words, size_t n) {
+    SchVector<SchPostingView> lists;
+    for (size_t i = 0; i < n; ++i) lists.push_back(idx.postings(words[i].term));
+    SchVector<int> cand = sch_intersect_all(lists.begin(), n);
+    if (n <= 1) return cand;
+    SchVector<SchPositionCursor> cur;
+    cur.resize(n);
+    for (size_t i = 0; i < n; ++i) cur[i].init(idx, words[i].term);
+    SchVector<int> out;
+    SchVector<int32_t> reach, next, pos;
+    for (size_t c = 0; c < cand.size(); ++c) {
+        int32_t doc = cand[c];
+        if (!cur[0].read(doc, reach)) continue;
+        for (size_t i = 1; i < n && reach.size(); ++i) {
+            if (!cur[i].read(doc, pos)) { reach.clear(); break; }
+            next.resize(pos.size());
+            next.resize(sch_position_step(reach.begin(), reach.size(), pos.begin(), pos.size(), words[i].lo, words[i].hi, next.begin()));
+            SchVector<int32_t> t = std::move(reach);
+            reach = std::move(next);
+            next = std::move(t);
+        }
+        if (reach.size()) out.push_back(doc);
+    }
+    return out;
+}
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef SCH_POSTINGS_H
+#define SCH_POSTINGS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "sch_containers.h"
+#include "sch_index_structs.h"
+#include "sch_trace.h"
+
+inline unsigned sch_bits_needed(uint32_t v) {
+    return v ? 32u - (unsigned)__builtin_clz(v) : 0u;
+}
+
+inline void sch_varint_put(uint32_t v, SchVector<unsigned char>& out) {
+    while (v >= 0x80) { out.push_back((unsigned char)(v | 0x80)); v >>= 7; }
+    out.push_back((unsigned char)v);
+}
+
+inline uint32_t sch_varint_get(const unsigned char*& p) {
+    uint32_t v = 0;
+    unsigned shift = 0;
+    unsigned char b;
+    do {
+        b = *p++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return v;
+}
+
+// Compressed list layout: lists with more than one block start (4-byte aligned)
+// with SchBlockHeader[nblocks]; every block is then one bit-width byte followed
+// by count fixed-width (gap - 1) values. The postings section carries
+// SCH_CODEC_SLACK trailing bytes so the decoder may always load whole words.
+//
+// Outliers are patched (PFor): when SCH_BLOCK_EXCEPTIONS is set in the width
+// byte, two more bytes give the number of exceptions e and the width of their
+// high bits; the values keep only their low bits, and after them come e block
+// positions (a byte each) and the e high parts at their own fixed width. A few
+// large gaps then no longer set the width of the whole block. The width is the
+// one giving the smallest block.
+static const size_t SCH_CODEC_SLACK = 8;
+static const unsigned char SCH_BLOCK_EXCEPTIONS = 0x80;
+
+// Packs the low bits of n values at a fixed width; returns bytes written.
+inline size_t sch_pack_values(const uint32_t* v, size_t n, unsigned bits, unsigned char* out) {
+    const uint64_t mask = (1ull << bits) - 1;
+    uint64_t acc = 0;
+    unsigned fill = 0;
+    size_t w = 0;
+    for (size_t i = 0; i < n; ++i) {
+        acc |= (v[i] & mask) << fill;
+        fill += bits;
+        while (fill >= 8) { out[w++] = (unsigned char)acc; acc >>= 8; fill -= 8; }
+    }
+    if (fill) out[w++] = (unsigned char)acc;
+    return w;
+}
+
+// Width with the smallest encoding of a block of (gap - 1) values, and its
+// number of exceptions.
+inline unsigned sch_block_width(const uint32_t* v, size_t n, size_t* exceptions) {
+    uint32_t max_v = 0;
+    for (size_t i = 0; i < n; ++i) if (v[i] > max_v) max_v = v[i];
+    unsigned best = sch_bits_needed(max_v);
+    size_t best_cost = (n * best + 7) / 8;
+    *exceptions = 0;
+    for (unsigned bits = best; bits-- > 0; ) {
+        size_t e = 0;
+        for (size_t i = 0; i < n; ++i) e += (v[i] >> bits) != 0;
+        size_t cost = 3 + (n * bits + 7) / 8 + e + (e * (sch_bits_needed(max_v) - bits) + 7) / 8;
+        if (cost < best_cost) {
+            best = bits;
+            best_cost = cost;
+            *exceptions = e;
+        }
+    }
+    return best;
+}
+
+inline void sch_unpack_values(const unsigned char* in, size_t n, unsigned bits, uint32_t* out) {
+    const uint64_t mask = (1ull << bits) - 1;
+    size_t pos = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t w;
+        std::memcpy(&w, in + (pos >> 3), sizeof(w));
+        out[i] = (uint32_t)((w >> (pos & 7)) & mask);
+        pos += bits;
+    }
+}
+
+inline void sch_unpack_block(const unsigned char* in, size_t n, int32_t prev, unsigned bits, int32_t* out) {
+    if (bits == 0) {
+        for (size_t i = 0; i < n; ++i) out[i] = ++prev;
+        return;
+    }
+    const uint64_t mask = (1ull << bits) - 1;
+    size_t pos = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t w;
+        std::memcpy(&w, in + (pos >> 3), sizeof(w));
+        prev += (int32_t)((w >> (pos & 7)) & mask) + 1;
+        pos += bits;
+        out[i] = prev;
+    }
+}
+
+// A block with exceptions; kept out of line so the plain path stays small.
+__attribute__((noinline)) inline void sch_decode_patched(const unsigned char* p, size_t n, int32_t prev, int32_t* out) {
+    unsigned bits = p[0] & ~SCH_BLOCK_EXCEPTIONS, high_bits = p[2];
+    size_t e = p[1];
+    const unsigned char* at = p + 3 + (n * bits + 7) / 8;
+    uint32_t high[SCH_BLOCK_SIZE], add[SCH_BLOCK_SIZE];
+    sch_unpack_values(at + e, e, high_bits, high);
+    std::memset(add, 0, n * sizeof(uint32_t));
+    for (size_t k = 0; k < e; ++k) add[at[k]] = high[k] << bits;
+    const uint64_t mask = (1ull << bits) - 1;
+    size_t pos = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t w;
+        std::memcpy(&w, p + 3 + (pos >> 3), sizeof(w));
+        prev += (int32_t)(((w >> (pos & 7)) & mask) | add[i]) + 1;
+        pos += bits;
+        out[i] = prev;
+    }
+}
+
+// Decodes the block whose width byte is at p.
+inline void sch_decode_block(const unsigned char* p, size_t n, int32_t prev, int32_t* out) {
+    if (p[0] & SCH_BLOCK_EXCEPTIONS) sch_decode_patched(p, n, prev, out);
+    else sch_unpack_block(p + 1, n, prev, p[0], out);
+}
+
+inline size_t sch_block_count(size_t n) { return (n + SCH_BLOCK_SIZE - 1) / SCH_BLOCK_SIZE; }
+
+// Appends one compressed list to out and returns its offset within out.
+inline size_t sch_encode_postings(const int32_t* ids, size_t n, SchVector<unsigned char>& out) {
+    size_t nblocks = sch_block_count(n);
+    if (nblocks > 1) while (out.size() % 4) out.push_back(0);
+    size_t list_start = out.size();
+    size_t header_bytes = nblocks > 1 ? nblocks * sizeof(SchBlockHeader) : 0;
+    for (size_t i = 0; i < header_bytes; ++i) out.push_back(0);
+    size_t data_start = out.size();
+    unsigned char packed[SCH_BLOCK_SIZE * 4 + 8];
+    uint32_t gaps[SCH_BLOCK_SIZE];
+    int32_t prev = -1;
+    for (size_t b = 0; b < nblocks; ++b) {
+        size_t start = b * SCH_BLOCK_SIZE;
+        size_t cnt = (n - start < SCH_BLOCK_SIZE) ? n - start : SCH_BLOCK_SIZE;
+        int32_t p = prev;
+        for (size_t i = 0; i < cnt; ++i) {
+            gaps[i] = (uint32_t)(ids[start + i] - p - 1);
+            p = ids[start + i];
+        }
+        size_t exceptions = 0;
+        unsigned bits = sch_block_width(gaps, cnt, &exceptions);
+        if (header_bytes) {
+            SchBlockHeader h;
+            h.max_id = ids[start + cnt - 1];
+            h.offset = (uint32_t)(out.size() - data_start);
+            std::memcpy(&out[list_start + b * sizeof(SchBlockHeader)], &h, sizeof(h));
+        }
+        uint32_t high[SCH_BLOCK_SIZE];
+        unsigned high_bits = 0;
+        for (size_t i = 0, k = 0; exceptions && i < cnt; ++i) {
+            if (!(gaps[i] >> bits)) continue;
+            high[k] = gaps[i] >> bits;
+            if (sch_bits_needed(high[k]) > high_bits) high_bits = sch_bits_needed(high[k]);
+            ++k;
+        }
+        if (exceptions) {
+            out.push_back((unsigned char)(bits | SCH_BLOCK_EXCEPTIONS));
+            out.push_back((unsigned char)exceptions);
+            out.push_back((unsigned char)high_bits);
+        } else {
+            out.push_back((unsigned char)bits);
+        }
+        size_t w = sch_pack_values(gaps, cnt, bits, packed);
+        for (size_t i = 0; i < w; ++i) out.push_back(packed[i]);
+        if (exceptions) {
+            for (size_t i = 0; i < cnt; ++i) if (gaps[i] >> bits) out.push_back((unsigned char)i);
+            w = sch_pack_values(high, exceptions, high_bits, packed);
+            for (size_t i = 0; i < w; ++i) out.push_back(packed[i]);
+        }
+        prev = ids[start + cnt - 1];
+    }
+    return list_start;
+}
+
+// Term frequencies of one list: a bit-width byte, then n fixed-width (tf - 1)
+// values, so any position can be read directly. Returns the list offset.
+inline size_t sch_encode_freqs(const int32_t* tfs, size_t n, SchVector<unsigned char>& out) {
+    size_t start = out.size();
+    uint32_t max_v = 0;
+    for (size_t i = 0; i < n; ++i) if ((uint32_t)(tfs[i] - 1) > max_v) max_v = (uint32_t)(tfs[i] - 1);
+    unsigned bits = sch_bits_needed(max_v);
+    out.push_back((unsigned char)bits);
+    uint64_t acc = 0;
+    unsigned fill = 0;
+    for (size_t i = 0; i < n; ++i) {
+        acc |= (uint64_t)(uint32_t)(tfs[i] - 1) << fill;
+        fill += bits;
+        while (fill >= 8) { out.push_back((unsigned char)acc); acc >>= 8; fill -= 8; }
+    }
+    if (fill) out.push_back((unsigned char)acc);
+    return start;
+}
+
+inline uint32_t sch_freq_at(const unsigned char* freqs, size_t i) {
+    unsigned bits = freqs[0];
+    if (bits == 0) return 1;
+    size_t pos = i * bits;
+    uint64_t w;
+    std::memcpy(&w, freqs + 1 + (pos >> 3), sizeof(w));
+    return (uint32_t)((w >> (pos & 7)) & ((1ull << bits) - 1)) + 1;
+}
+
+// Position of a cursor that has run past the last document.
+static const int32_t SCH_DOC_END = INT32_MAX;
+
+// A posting list as stored: either a raw int array, optionally preceded by
+// its skip array, or a block-compressed list.
+struct SchPostingView {
+    const int32_t* ids;
+    const int32_t* skips;
+    const SchBlockHeader* blocks;
+    const unsigned char* data;
+    size_t size;
+    SchPostingView() : ids(nullptr), skips(nullptr), blocks(nullptr), data(nullptr), size(0) {}
+    SchPostingView(const int32_t* p, size_t n, bool has_skips = false) : ids(p), skips(nullptr), blocks(nullptr), data(nullptr), size(n) {
+        if (has_skips && block_count() > 1) {
+            skips = p;
+            ids = p + block_count();
+        }
+    }
+    SchPostingView(const SchVector<int>& v) : ids(v.size() ? &v[0] : nullptr), skips(nullptr), blocks(nullptr), data(nullptr), size(v.size()) {}
+    SchPostingView(const unsigned char* p, size_t n) : ids(nullptr), skips(nullptr), blocks(nullptr), data(p), size(n) {
+        if (block_count() > 1) {
+            blocks = (const SchBlockHeader*)p;
+            data = p + block_count() * sizeof(SchBlockHeader);
+        }
+    }
+    bool compressed() const { return data != nullptr; }
+    bool has_skips() const { return skips != nullptr || blocks != nullptr; }
+    size_t block_count() const { return sch_block_count(size); }
+    size_t block_len(size_t b) const {
+        size_t start = b * SCH_BLOCK_SIZE;
+        return (size - start < SCH_BLOCK_SIZE) ? size - start : SCH_BLOCK_SIZE;
+    }
+    // Last id of block b. Only reads the skip data when the list has any.
+    int32_t block_max(size_t b) const {
+        if (blocks) return blocks[b].max_id;
+        if (skips) return skips[b];
+        if (!compressed()) return ids[b * SCH_BLOCK_SIZE + block_len(b) - 1];
+        return INT32_MAX;
+    }
+};
+
+// Walks a posting list one block at a time. Raw lists are returned in place,
+// compressed blocks are decoded into a small local buffer. Every block counts
+// towards the blocks of the current trace; decoding is timed in detailed ones.
+class SchPostingReader {
+private:
+    SchPostingView view_;
+    size_t block_;
+    int32_t buf_[SCH_BLOCK_SIZE];
+public:
+    explicit SchPostingReader(const SchPostingView& v) : view_(v), block_(0) {}
+
+    // Moves to the first remaining block whose last id is >= target and returns
+    // it like next_block(). Skipped blocks are neither decoded nor touched: the
+    // search gallops over the skip data only.
+    bool skip_to(int32_t target, const int32_t** ids, size_t* n) {
+        size_t nblocks = view_.block_count();
+        if (block_ >= nblocks) return false;
+        if (view_.block_max(block_) < target) {
+            size_t lo = block_ + 1, hi = lo, step = 1;
+            while (hi < nblocks && view_.block_max(hi) < target) {
+                lo = hi + 1;
+                hi += step;
+                step <<= 1;
+            }
+            if (hi > nblocks) hi = nblocks;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (view_.block_max(mid) < target) lo = mid + 1;
+                else hi = mid;
+            }
+            block_ = lo;
+        }
+        return next_block(ids, n);
+    }
+
+    // Index of the block last returned by next_block() or skip_to().
+    size_t current_block() const { return block_ - 1; }
+
+    bool next_block(const int32_t** ids, size_t* n) {
+        size_t start = block_ * SCH_BLOCK_SIZE;
+        if (start >= view_.size) return false;
+        *n = view_.block_len(block_);
+        sch_trace_count(SCH_CTR_BLOCKS, 1);
+        if (!view_.compressed()) {
+            *ids = view_.ids + start;
+        } else {
+            SchStageTimer timer(SCH_STAGE_DECODE, true);
+            const unsigned char* p = view_.data + (view_.blocks ? view_.blocks[block_].offset : 0);
+            int32_t prev = block_ ? view_.blocks[block_ - 1].max_id : -1;
+            sch_decode_block(p, *n, prev, buf_);
+            *ids = buf_;
+        }
+        ++block_;
+        return true;
+    }
+};
+
+#endif
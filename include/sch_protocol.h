@@ -0,0 +1,200 @@
+#ifndef SCH_PROTOCOL_H
+#define SCH_PROTOCOL_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "sch_containers.h"
+
+// Wire format of search_cli --serve: every request and every response is a
+// 4-byte little-endian length followed by that many bytes. A request carries
+// one query; the response is exactly the text the stdin mode prints for it
+// ("Found N documents:" ... "---END---").
+static const uint32_t SCH_MAX_REQUEST = 64 * 1024;
+
+inline bool sch_read_full(int fd, void* buf, size_t n) {
+    char* p = (char*)buf;
+    while (n) {
+        ssize_t r = ::read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+inline bool sch_write_full(int fd, const void* buf, size_t n) {
+    const char* p = (const char*)buf;
+    while (n) {
+        ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// Appends the frame of data[0, n) to out.
+inline void sch_put_frame(const char* data, size_t n, SchVector<char>& out) {
+    size_t at = out.size();
+    out.resize(at + 4 + n);
+    for (int i = 0; i < 4; ++i) out[at + i] = (char)((n >> (8 * i)) & 0xff);
+    if (n) std::memcpy(out.begin() + at + 4, data, n);
+}
+
+// Sends one frame with a single write so small frames leave in one packet.
+inline bool sch_send_frame(int fd, const char* data, size_t n, SchVector<char>& scratch) {
+    scratch.clear();
+    sch_put_frame(data, n, scratch);
+    return sch_write_full(fd, scratch.begin(), scratch.size());
+}
+
+// Receives one frame into out (NUL-terminated, the terminator is not counted
+// in out.size()). Fails on EOF, I/O errors and frames longer than max_len.
+inline bool sch_recv_frame(int fd, SchVector<char>& out, uint32_t max_len) {
+    unsigned char h[4];
+    if (!sch_read_full(fd, h, 4)) return false;
+    uint32_t n = (uint32_t)h[0] | ((uint32_t)h[1] << 8) | ((uint32_t)h[2] << 16) | ((uint32_t)h[3] << 24);
+    if (n > max_len) return false;
+    out.resize(n + 1);
+    if (n && !sch_read_full(fd, out.begin(), n)) return false;
+    out[n] = '\0';
+    out.resize(n);
+    return true;
+}
+
+// Incoming bytes of one non-blocking connection. read_some() reads whatever
+// the socket has until a whole frame is buffered and never waits, so a client
+// that sends half a frame holds a buffer, not a thread; take() moves the
+// buffered frame out.
+class SchFrameReader {
+private:
+    SchVector<char> buf_;
+    size_t start_;
+
+    uint32_t header() const {
+        const unsigned char* h = (const unsigned char*)buf_.begin() + start_;
+        return (uint32_t)h[0] | ((uint32_t)h[1] << 8) | ((uint32_t)h[2] << 16) | ((uint32_t)h[3] << 24);
+    }
+
+public:
+    enum Status { READY, PARTIAL, FAILED };
+
+    SchFrameReader() : start_(0) {}
+
+    Status status(uint32_t max_len) const {
+        size_t avail = buf_.size() - start_;
+        if (avail < 4) return PARTIAL;
+        uint32_t n = header();
+        if (n > max_len) return FAILED;
+        return avail - 4 < n ? PARTIAL : READY;
+    }
+
+    // FAILED on EOF before a whole frame, I/O errors and oversized frames.
+    Status read_some(int fd, uint32_t max_len) {
+        for (;;) {
+            Status st = status(max_len);
+            if (st != PARTIAL) return st;
+            if (start_ && start_ == buf_.size()) {
+                buf_.clear();
+                start_ = 0;
+            }
+            size_t at = buf_.size();
+            buf_.resize(at + 4096);
+            ssize_t r = ::read(fd, buf_.begin() + at, 4096);
+            buf_.resize(at + (r > 0 ? (size_t)r : 0));
+            if (r > 0) continue;
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return PARTIAL;
+            return FAILED;
+        }
+    }
+
+    // The frame status() reported READY, NUL-terminated like sch_recv_frame.
+    void take(SchVector<char>& out) {
+        uint32_t n = header();
+        out.resize(n + 1);
+        if (n) std::memcpy(out.begin(), buf_.begin() + start_ + 4, n);
+        out[n] = '\0';
+        out.resize(n);
+        start_ += 4 + n;
+        if (start_ == buf_.size()) {
+            buf_.clear();
+            start_ = 0;
+        }
+    }
+};
+
+// Writes as much of buf[*pos, n) as the non-blocking socket takes; false on errors.
+inline bool sch_write_some(int fd, const char* buf, size_t n, size_t* pos) {
+    while (*pos < n) {
+        ssize_t w = ::send(fd, buf + *pos, n - *pos, MSG_NOSIGNAL);
+        if (w > 0) { *pos += (size_t)w; continue; }
+        if (w < 0 && errno == EINTR) continue;
+        return w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    return true;
+}
+
+// Addresses are "unix:/path/to/socket" or "tcp:PORT" (loopback only).
+inline int sch_socket_for(const char* addr, sockaddr_storage* sa, socklen_t* len) {
+    std::memset(sa, 0, sizeof(*sa));
+    if (std::strncmp(addr, "unix:", 5) == 0) {
+        sockaddr_un* un = (sockaddr_un*)sa;
+        const char* path = addr + 5;
+        if (std::strlen(path) >= sizeof(un->sun_path)) return -1;
+        un->sun_family = AF_UNIX;
+        std::strcpy(un->sun_path, path);
+        *len = sizeof(sockaddr_un);
+        return socket(AF_UNIX, SOCK_STREAM, 0);
+    }
+    if (std::strncmp(addr, "tcp:", 4) == 0) {
+        int port = std::atoi(addr + 4);
+        if (port <= 0 || port > 65535) return -1;
+        sockaddr_in* in = (sockaddr_in*)sa;
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t)port);
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        *len = sizeof(sockaddr_in);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        return fd;
+    }
+    return -1;
+}
+
+inline int sch_listen(const char* addr) {
+    sockaddr_storage sa;
+    socklen_t len = 0;
+    int fd = sch_socket_for(addr, &sa, &len);
+    if (fd < 0) return -1;
+    if (sa.ss_family == AF_UNIX) unlink(((sockaddr_un*)&sa)->sun_path);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (sockaddr*)&sa, len) != 0 || listen(fd, 128) != 0) { ::close(fd); return -1; }
+    return fd;
+}
+
+inline int sch_connect(const char* addr) {
+    sockaddr_storage sa;
+    socklen_t len = 0;
+    int fd = sch_socket_for(addr, &sa, &len);
+    if (fd < 0) return -1;
+    if (connect(fd, (sockaddr*)&sa, len) != 0) { ::close(fd); return -1; }
+    return fd;
+}
+
+#endif
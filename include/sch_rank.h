@@ -0,0 +1,255 @@
+#ifndef SCH_RANK_H
+#define SCH_RANK_H
+
+#include <cmath>
+#include <cstdint>
+#include "sch_containers.h"
+#include "sch_postings.h"
+#include "sch_mapped_index.h"
+#include "sch_intersect.h"
+
+static const float SCH_BM25_K1 = 1.2f;
+static const float SCH_BM25_B = 0.75f;
+// Stored term and block bounds are inflated by this factor so float rounding
+// can never push a real score above its bound.
+static const float SCH_BM25_BOUND_SLACK = 1.0001f;
+
+inline float sch_bm25_idf(size_t doc_count, size_t df) {
+    return (float)std::log(1.0 + ((double)doc_count - (double)df + 0.5) / ((double)df + 0.5));
+}
+
+inline float sch_bm25(float idf, uint32_t tf, uint32_t doc_len, float avg_doc_len) {
+    float norm = SCH_BM25_K1 * (1.0f - SCH_BM25_B + SCH_BM25_B * (float)doc_len / avg_doc_len);
+    return idf * (float)tf * (SCH_BM25_K1 + 1.0f) / ((float)tf + norm);
+}
+
+// Both the builder and the reader derive the average from the stored lengths
+// the same way, so bounds and query-time scores use the same value.
+inline float sch_avg_doc_len(double avg) { return avg > 0 ? (float)avg : 1.0f; }
+
+struct SchScoredDoc {
+    int32_t doc;
+    float score;
+};
+
+// Higher score first, ties broken by the lower doc id.
+inline bool sch_scored_better(const SchScoredDoc& a, const SchScoredDoc& b) {
+    return a.score > b.score || (a.score == b.score && a.doc < b.doc);
+}
+
+// Bounded min-heap keeping the k best documents; the root is the worst kept.
+class SchTopK {
+private:
+    SchVector<SchScoredDoc> heap_;
+    size_t k_;
+
+public:
+    explicit SchTopK(size_t k) : k_(k) { heap_.reserve(k); }
+
+    size_t size() const { return heap_.size(); }
+    bool full() const { return heap_.size() >= k_; }
+    float threshold() const { return heap_[0].score; }
+
+    // A candidate can only enter if it beats the root.
+    bool accepts(int32_t doc, float score) const {
+        if (k_ == 0) return false;
+        if (!full()) return true;
+        SchScoredDoc c = {doc, score};
+        return sch_scored_better(c, heap_[0]);
+    }
+
+    void push(int32_t doc, float score) {
+        if (!accepts(doc, score)) return;
+        SchScoredDoc c = {doc, score};
+        size_t i;
+        if (!full()) {
+            heap_.push_back(c);
+            i = heap_.size() - 1;
+            while (i > 0 && sch_scored_better(heap_[(i - 1) / 2], heap_[i])) {
+                SchScoredDoc t = heap_[i]; heap_[i] = heap_[(i - 1) / 2]; heap_[(i - 1) / 2] = t;
+                i = (i - 1) / 2;
+            }
+            return;
+        }
+        heap_[0] = c;
+        i = 0;
+        size_t n = heap_.size();
+        while (true) {
+            size_t l = 2 * i + 1, r = l + 1, w = i;
+            if (l < n && sch_scored_better(heap_[w], heap_[l])) w = l;
+            if (r < n && sch_scored_better(heap_[w], heap_[r])) w = r;
+            if (w == i) break;
+            SchScoredDoc t = heap_[i]; heap_[i] = heap_[w]; heap_[w] = t;
+            i = w;
+        }
+    }
+
+    // Best first.
+    SchVector<SchScoredDoc> sorted() const {
+        SchVector<SchScoredDoc> out;
+        for (size_t i = 0; i < heap_.size(); ++i) {
+            out.push_back(heap_[i]);
+            size_t j = out.size() - 1;
+            while (j > 0 && sch_scored_better(out[j], out[j - 1])) {
+                SchScoredDoc t = out[j]; out[j] = out[j - 1]; out[j - 1] = t;
+                --j;
+            }
+        }
+        return out;
+    }
+};
+
+// Document-at-a-time cursor over one query term with its frequencies and
+// BM25 bounds. Holds a reader with an inline block buffer, so cursors must
+// stay where they were initialised.
+struct SchTermCursor {
+    SchPostingView view;
+    SchPostingReader reader;
+    const unsigned char* freqs;
+    const float* block_max;
+    float idf;
+    float max_score;
+    const int32_t* ids;
+    size_t n;
+    size_t pos;
+    size_t block;
+    int32_t doc;
+
+    SchTermCursor() : reader(SchPostingView()), freqs(nullptr), block_max(nullptr), idf(0), max_score(0),
+                      ids(nullptr), n(0), pos(0), block(0), doc(SCH_DOC_END) {}
+
+    void init(const SchMappedIndex& idx, size_t term_idx) {
+        view = idx.postings(term_idx);
+        reader = SchPostingReader(view);
+        freqs = idx.freqs(term_idx);
+        block_max = idx.block_max(term_idx);
+        idf = sch_bm25_idf(idx.doc_count(), view.size);
+        max_score = idx.term_stats(term_idx).max_score;
+        load(reader.next_block(&ids, &n));
+    }
+
+    void load(bool ok) {
+        if (!ok) { doc = SCH_DOC_END; return; }
+        block = reader.current_block();
+        pos = 0;
+        doc = ids[0];
+    }
+
+    void next() {
+        if (doc == SCH_DOC_END) return;
+        if (++pos < n) doc = ids[pos];
+        else load(reader.next_block(&ids, &n));
+    }
+
+    // Moves to the first id >= target, skipping whole blocks through the skip data.
+    void advance_to(int32_t target) {
+        if (doc >= target) return;
+        if (ids[n - 1] < target) {
+            load(reader.skip_to(target, &ids, &n));
+            if (doc == SCH_DOC_END) return;
+        }
+        pos = sch_gallop(ids, pos, n, target);
+        doc = ids[pos];
+    }
+
+    uint32_t tf() const { return sch_freq_at(freqs, block * SCH_BLOCK_SIZE + pos); }
+
+    // Bound of the block that would hold target and the last id it covers,
+    // read from the skip data without moving the cursor.
+    float block_bound(int32_t target, int64_t* block_last) const {
+        size_t nblocks = view.block_count();
+        size_t b = block;
+        while (b < nblocks && view.block_max(b) < target) ++b;
+        if (b >= nblocks) { *block_last = SCH_DOC_END; return 0.0f; }
+        *block_last = b + 1 < nblocks ? view.block_max(b) : SCH_DOC_END;
+        return block_max[b];
+    }
+};
+
+// Block-Max MaxScore: terms are ordered by their score bound; the low-bound
+// prefix whose bounds sum below the top-k threshold is non-essential, so only
+// documents of the remaining (essential) lists become candidates. The
+// non-essential lists are probed with advance_to() in decreasing bound order,
+// and a candidate is dropped as soon as its partial score plus the remaining
+// term or block bounds cannot beat the threshold. The final score is summed
+// in query order, so results equal exhaustive scoring (ties by doc id).
+inline void sch_maxscore_topk(const SchMappedIndex& idx, SchTermCursor* cur, size_t nterms, SchTopK& top) {
+    float avg = sch_avg_doc_len(idx.avg_doc_len());
+    SchVector<size_t> order;
+    SchVector<float> prefix, contrib;
+    for (size_t i = 0; i < nterms; ++i) {
+        size_t j = i;
+        order.push_back(i);
+        while (j > 0 && cur[order[j - 1]].max_score > cur[i].max_score) { order[j] = order[j - 1]; --j; }
+        order[j] = i;
+    }
+    float run = 0;
+    for (size_t i = 0; i < nterms; ++i) {
+        run += cur[order[i]].max_score;
+        prefix.push_back(run);
+    }
+    contrib.resize(nterms);
+    size_t essential = 0;
+    while (essential < nterms) {
+        int32_t d = SCH_DOC_END;
+        for (size_t i = essential; i < nterms; ++i) {
+            if (cur[order[i]].doc < d) d = cur[order[i]].doc;
+        }
+        if (d == SCH_DOC_END) break;
+        uint32_t dl = idx.doc_len((size_t)d);
+        float theta = top.full() ? top.threshold() : 0.0f;
+        float partial = 0;
+        for (size_t i = 0; i < nterms; ++i) contrib[i] = 0;
+        for (size_t i = essential; i < nterms; ++i) {
+            SchTermCursor& c = cur[order[i]];
+            if (c.doc != d) continue;
+            contrib[order[i]] = sch_bm25(c.idf, c.tf(), dl, avg);
+            partial += contrib[order[i]];
+            c.next();
+        }
+        bool alive = true;
+        if (essential > 0 && top.full()) {
+            float bound = partial * SCH_BM25_BOUND_SLACK;
+            for (size_t i = 0; i < essential; ++i) {
+                int64_t last = 0;
+                bound += cur[order[i]].block_bound(d, &last);
+            }
+            alive = bound >= theta;
+        }
+        for (size_t i = essential; alive && i-- > 0;) {
+            if (top.full() && partial * SCH_BM25_BOUND_SLACK + prefix[i] < theta) { alive = false; break; }
+            SchTermCursor& c = cur[order[i]];
+            c.advance_to(d);
+            if (c.doc != d) continue;
+            contrib[order[i]] = sch_bm25(c.idf, c.tf(), dl, avg);
+            partial += contrib[order[i]];
+        }
+        if (!alive) continue;
+        float score = 0;
+        for (size_t t = 0; t < nterms; ++t) score += contrib[t];
+        top.push(d, score);
+        if (top.full()) {
+            while (essential < nterms && prefix[essential] < top.threshold()) ++essential;
+        }
+    }
+}
+
+// Term-at-a-time reference: scores every document containing any term.
+inline void sch_exhaustive_topk(const SchMappedIndex& idx, SchTermCursor* cur, size_t nterms, SchTopK& top) {
+    float avg = sch_avg_doc_len(idx.avg_doc_len());
+    SchVector<float> acc;
+    SchVector<unsigned char> seen;
+    acc.resize(idx.doc_count());
+    seen.resize(idx.doc_count());
+    SchVector<int32_t> touched;
+    for (size_t t = 0; t < nterms; ++t) {
+        for (; cur[t].doc != SCH_DOC_END; cur[t].next()) {
+            int32_t d = cur[t].doc;
+            if (!seen[(size_t)d]) { seen[(size_t)d] = 1; touched.push_back(d); }
+            acc[(size_t)d] += sch_bm25(cur[t].idf, cur[t].tf(), idx.doc_len((size_t)d), avg);
+        }
+    }
+    for (size_t i = 0; i < touched.size(); ++i) top.push(touched[i], acc[(size_t)touched[i]]);
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef SCH_REORDER_H
+#define SCH_REORDER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include "sch_containers.h"
+
+// Doc id reordering by recursive graph bisection (Dhulipala et al., KDD 2016):
+// the documents are split in two halves and documents are swapped between
+// them while that lowers the estimated cost of the d-gaps of every term,
+//   cost(t) = deg_a(t) * log2(n_a / (deg_a(t) + 1)) + deg_b(t) * log2(n_b / (deg_b(t) + 1)),
+// then each half is split again. Documents sharing many terms end up with
+// nearby ids, so posting lists get small gaps and long runs.
+//
+// The input is a forward index: the term ids of document d are
+// terms[offsets[d] .. offsets[d + 1]). order receives the documents in their
+// new order (order[new id] = old id). The result depends on the input only,
+// not on the number of threads.
+static const size_t SCH_BISECT_LEAF = 16;
+static const int SCH_BISECT_ITERATIONS = 20;
+
+struct SchBisectMove {
+    double gain;
+    uint32_t doc;
+    bool operator<(const SchBisectMove& o) const { return gain > o.gain || (gain == o.gain && doc < o.doc); }
+};
+
+// Degree arrays of one thread, indexed by term id, and log2 of every count
+// up to the number of documents + 2.
+class SchBisector {
+private:
+    const uint32_t* offsets_;
+    const uint32_t* terms_;
+    const double* log2_;
+    SchVector<int32_t> deg_a_, deg_b_;
+    SchVector<SchBisectMove> moves_a_, moves_b_;
+
+    void degrees(const uint32_t* docs, size_t n, size_t half) {
+        int32_t* a = deg_a_.begin();
+        int32_t* b = deg_b_.begin();
+        for (size_t i = 0; i < n; ++i) {
+            for (uint32_t k = offsets_[docs[i]]; k < offsets_[docs[i] + 1]; ++k) a[terms_[k]] = b[terms_[k]] = 0;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            int32_t* deg = i < half ? a : b;
+            for (uint32_t k = offsets_[docs[i]]; k < offsets_[docs[i] + 1]; ++k) deg[terms_[k]]++;
+        }
+    }
+
+    // Cost saved by moving doc from the side with degrees from (size n_from)
+    // to the other one.
+    double gain(uint32_t doc, const int32_t* from, const int32_t* to, double log_from, double log_to) const {
+        double g = 0;
+        for (uint32_t k = offsets_[doc]; k < offsets_[doc + 1]; ++k) {
+            int32_t f = from[terms_[k]], t = to[terms_[k]];
+            g += f * (log_from - log2_[f + 1]) + t * (log_to - log2_[t + 1]);
+            g -= (f - 1) * (log_from - log2_[f]) + (t + 1) * (log_to - log2_[t + 2]);
+        }
+        return g;
+    }
+
+    void move(uint32_t doc, int32_t* from, int32_t* to) {
+        for (uint32_t k = offsets_[doc]; k < offsets_[doc + 1]; ++k) {
+            from[terms_[k]]--;
+            to[terms_[k]]++;
+        }
+    }
+
+public:
+    SchBisector(const uint32_t* offsets, const uint32_t* terms, size_t nterms, const double* log2_table)
+        : offsets_(offsets), terms_(terms), log2_(log2_table) {
+        deg_a_.resize(nterms);
+        deg_b_.resize(nterms);
+    }
+
+    // One split of docs[0, n): the first n / 2 documents become the first half.
+    void split(uint32_t* docs, size_t n) {
+        size_t half = n / 2;
+        degrees(docs, n, half);
+        double log_a = log2_[half], log_b = log2_[n - half];
+        for (int iter = 0; iter < SCH_BISECT_ITERATIONS; ++iter) {
+            moves_a_.resize(half);
+            moves_b_.resize(n - half);
+            for (size_t i = 0; i < half; ++i) {
+                moves_a_[i].doc = docs[i];
+                moves_a_[i].gain = gain(docs[i], deg_a_.begin(), deg_b_.begin(), log_a, log_b);
+            }
+            for (size_t i = half; i < n; ++i) {
+                moves_b_[i - half].doc = docs[i];
+                moves_b_[i - half].gain = gain(docs[i], deg_b_.begin(), deg_a_.begin(), log_b, log_a);
+            }
+            std::sort(moves_a_.begin(), moves_a_.end());
+            std::sort(moves_b_.begin(), moves_b_.end());
+            size_t swaps = 0;
+            while (swaps < moves_a_.size() && swaps < moves_b_.size() && moves_a_[swaps].gain + moves_b_[swaps].gain > 0) {
+                move(moves_a_[swaps].doc, deg_a_.begin(), deg_b_.begin());
+                move(moves_b_[swaps].doc, deg_b_.begin(), deg_a_.begin());
+                ++swaps;
+            }
+            if (swaps == 0) break;
+            // The halves in gain order, swapped documents exchanged.
+            for (size_t i = 0; i < half; ++i) docs[i] = i < swaps ? moves_b_[i].doc : moves_a_[i].doc;
+            for (size_t i = half; i < n; ++i) docs[i] = i - half < swaps ? moves_a_[i - half].doc : moves_b_[i - half].doc;
+        }
+    }
+
+    void bisect(uint32_t* docs, size_t n) {
+        if (n <= SCH_BISECT_LEAF) return;
+        split(docs, n);
+        bisect(docs, n / 2);
+        bisect(docs + n / 2, n - n / 2);
+    }
+};
+
+// The top levels of the recursion run their halves on separate threads, each
+// with its own degree arrays.
+inline void sch_bisect_parallel(const uint32_t* offsets, const uint32_t* terms, size_t nterms, const double* log2_table,
+                                uint32_t* docs, size_t n, int threads) {
+    if (threads <= 1 || n <= SCH_BISECT_LEAF) {
+        SchBisector b(offsets, terms, nterms, log2_table);
+        b.bisect(docs, n);
+        return;
+    }
+    {
+        SchBisector b(offsets, terms, nterms, log2_table);
+        b.split(docs, n);
+    }
+    std::thread left([=]() { sch_bisect_parallel(offsets, terms, nterms, log2_table, docs, n / 2, threads / 2); });
+    sch_bisect_parallel(offsets, terms, nterms, log2_table, docs + n / 2, n - n / 2, threads - threads / 2);
+    left.join();
+}
+
+inline void sch_bisect_order(const uint32_t* offsets, const uint32_t* terms, size_t ndocs, size_t nterms, int threads, SchVector<uint32_t>& order) {
+    SchVector<double> log2_table;
+    log2_table.resize(ndocs + 3);
+    log2_table[0] = 0;
+    for (size_t i = 1; i < ndocs + 3; ++i) log2_table[i] = std::log2((double)i);
+    order.resize(ndocs);
+    for (size_t d = 0; d < ndocs; ++d) order[d] = (uint32_t)d;
+    sch_bisect_parallel(offsets, terms, nterms, log2_table.begin(), order.begin(), ndocs, threads);
+}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef SCH_RESULT_CACHE_H
+#define SCH_RESULT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include "sch_containers.h"
+#include "sch_string.h"
+
+struct SchCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+    size_t capacity;
+};
+
+// Doc-id lists keyed by canonical query strings, bounded by memory: every
+// entry is charged its key, its ids and a fixed node overhead, and the least
+// recently used entries are evicted until a new one fits. Entries larger than
+// an eighth of the capacity are not stored. All methods lock, so one cache can
+// be shared by server workers. Stored lists are immutable and shared: get()
+// only takes a reference under the lock and copies the ids after releasing
+// it, and put() builds the list before locking. A list can carry a tag for
+// the caller, e.g. the count of a result of which only the first documents
+// are stored.
+//
+// reset() empties the cache for a new index generation. get() and put() take
+// the epoch of the index a request runs on and ignore the cache while it
+// holds another one, so a request still running on the old index neither
+// reads nor stores results of the other.
+class SchResultCache {
+private:
+    struct Node {
+        Node* hash_next;
+        Node* prev;
+        Node* next;
+        uint32_t hash;
+        size_t bytes;
+        uint64_t tag;
+        SchString key;
+        std::shared_ptr<const SchVector<int> > docs;
+    };
+
+    Node** buckets_;
+    size_t nbuckets_;
+    size_t count_;
+    Node lru_;
+    size_t bytes_;
+    size_t capacity_;
+    size_t hits_;
+    size_t misses_;
+    size_t evictions_;
+    uint64_t epoch_;
+    mutable std::mutex mu_;
+
+    SchResultCache(const SchResultCache&);
+    SchResultCache& operator=(const SchResultCache&);
+
+    static uint32_t hash_bytes(const char* k, size_t n) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < n; ++i) h = (h ^ (unsigned char)k[i]) * 1099511628211ull;
+        return (uint32_t)(h ^ (h >> 32));
+    }
+
+    static size_t charge(size_t key_len, size_t ndocs) { return sizeof(Node) + key_len + 1 + ndocs * sizeof(int); }
+
+    Node* find(const SchString& key, uint32_t h) const {
+        for (Node* n = buckets_[h & (nbuckets_ - 1)]; n; n = n->hash_next) {
+            if (n->hash == h && n->key.size() == key.size() && std::memcmp(n->key.c_str(), key.c_str(), key.size()) == 0) return n;
+        }
+        return nullptr;
+    }
+
+    void unlink(Node* n) {
+        n->prev->next = n->next;
+        n->next->prev = n->prev;
+    }
+
+    void push_front(Node* n) {
+        n->next = lru_.next;
+        n->prev = &lru_;
+        lru_.next->prev = n;
+        lru_.next = n;
+    }
+
+    void erase(Node* n) {
+        Node** p = &buckets_[n->hash & (nbuckets_ - 1)];
+        while (*p != n) p = &(*p)->hash_next;
+        *p = n->hash_next;
+        unlink(n);
+        bytes_ -= n->bytes;
+        --count_;
+        delete n;
+    }
+
+    void grow() {
+        size_t cap = nbuckets_ * 2;
+        Node** b = new Node*[cap];
+        for (size_t i = 0; i < cap; ++i) b[i] = nullptr;
+        for (size_t i = 0; i < nbuckets_; ++i) {
+            Node* n = buckets_[i];
+            while (n) {
+                Node* next = n->hash_next;
+                n->hash_next = b[n->hash & (cap - 1)];
+                b[n->hash & (cap - 1)] = n;
+                n = next;
+            }
+        }
+        delete[] buckets_;
+        buckets_ = b;
+        nbuckets_ = cap;
+    }
+
+    void clear_locked() {
+        while (lru_.next != &lru_) erase(lru_.next);
+    }
+
+public:
+    explicit SchResultCache(size_t capacity_bytes = 0) : nbuckets_(64), count_(0), bytes_(0), capacity_(capacity_bytes),
+                                                         hits_(0), misses_(0), evictions_(0), epoch_(0) {
+        buckets_ = new Node*[nbuckets_];
+        for (size_t i = 0; i < nbuckets_; ++i) buckets_[i] = nullptr;
+        lru_.prev = lru_.next = &lru_;
+    }
+    ~SchResultCache() {
+        clear_locked();
+        delete[] buckets_;
+    }
+
+    void set_capacity(size_t capacity_bytes) {
+        std::lock_guard<std::mutex> lock(mu_);
+        capacity_ = capacity_bytes;
+        while (bytes_ > capacity_ && lru_.prev != &lru_) { erase(lru_.prev); ++evictions_; }
+    }
+
+    bool enabled() const { return capacity_ != 0; }
+
+    void reset(uint64_t epoch) {
+        std::lock_guard<std::mutex> lock(mu_);
+        clear_locked();
+        epoch_ = epoch;
+    }
+
+    bool get(const SchString& key, SchVector<int>& out, uint64_t epoch = 0, uint64_t* tag = nullptr) {
+        if (!capacity_) return false;
+        uint32_t h = hash_bytes(key.c_str(), key.size());
+        std::shared_ptr<const SchVector<int> > docs;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            Node* n = epoch == epoch_ ? find(key, h) : nullptr;
+            if (!n) { ++misses_; return false; }
+            ++hits_;
+            unlink(n);
+            push_front(n);
+            docs = n->docs;
+            if (tag) *tag = n->tag;
+        }
+        out = *docs;
+        return true;
+    }
+
+    void put(const SchString& key, const SchVector<int>& docs, uint64_t epoch = 0, uint64_t tag = 0) {
+        size_t bytes = charge(key.size(), docs.size());
+        if (!capacity_ || bytes > capacity_ / 8) return;
+        uint32_t h = hash_bytes(key.c_str(), key.size());
+        std::shared_ptr<const SchVector<int> > shared = std::make_shared<SchVector<int> >(docs);
+        std::lock_guard<std::mutex> lock(mu_);
+        if (epoch != epoch_) return;
+        if (Node* old = find(key, h)) erase(old);
+        while (bytes_ + bytes > capacity_ && lru_.prev != &lru_) { erase(lru_.prev); ++evictions_; }
+        Node* n = new Node;
+        n->hash = h;
+        n->bytes = bytes;
+        n->tag = tag;
+        n->key = key;
+        n->docs = shared;
+        if (count_ + 1 > nbuckets_) grow();
+        Node*& head = buckets_[h & (nbuckets_ - 1)];
+        n->hash_next = head;
+        head = n;
+        push_front(n);
+        bytes_ += bytes;
+        ++count_;
+    }
+
+    SchCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        SchCacheStats s;
+        s.hits = hits_;
+        s.misses = misses_;
+        s.evictions = evictions_;
+        s.entries = count_;
+        s.bytes = bytes_;
+        s.capacity = capacity_;
+        return s;
+    }
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef SCH_SEGMENTS_H
+#define SCH_SEGMENTS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "sch_containers.h"
+#include "sch_string.h"
+
+// Segmented index: <index>.segments lists immutable mapped index files in doc
+// id order; the documents of a segment are numbered after those of the
+// segments before it. Deleted documents are bits in the segment's tombstone
+// file. Every change (index_builder --append, a merge) writes the next
+// manifest generation to a temporary file and renames it into place, so a
+// reader sees either the old or the new segment list, never a mix. Segment
+// and tombstone files are synced before the manifest naming them is renamed
+// into place, and the directory after it.
+//
+//   SCHSEGS1 <generation> <next_segment_number>
+//   <segment_file> <doc_count> <deleted_count> <tombstone_file or ->
+//
+// File names are relative to the directory of the manifest. Fields are
+// separated by whitespace, so sch_write_manifest() refuses names that are
+// empty, longer than the reader's 1023 bytes or contain whitespace or control
+// characters.
+//
+// <file>.files next to a segment (or a plain mapped index) holds the size and
+// mtime of the corpus file each of its documents was read from, raw
+// SchDocFile records in doc id order. index_builder --append compares them
+// with the corpus; mtime_ns 0 or a missing table means unknown, which counts
+// as changed.
+
+struct SchSegmentInfo {
+    SchString file;
+    size_t doc_count;
+    size_t deleted;
+    SchString tombstones;
+};
+
+struct SchDocFile {
+    uint64_t size;
+    int64_t mtime_ns;
+};
+
+struct SchManifest {
+    uint64_t generation;
+    uint64_t next_segment;
+    SchVector<SchSegmentInfo> segments;
+
+    SchManifest() : generation(0), next_segment(1) {}
+    size_t doc_count() const {
+        size_t n = 0;
+        for (size_t i = 0; i < segments.size(); ++i) n += segments[i].doc_count;
+        return n;
+    }
+};
+
+// "<index>.segments"
+inline void sch_manifest_path(const char* index, char* out, size_t cap) {
+    snprintf(out, cap, "%s.segments", index);
+}
+
+// Path of a file named in the manifest of index (same directory).
+inline void sch_segment_path(const char* index, const char* file, char* out, size_t cap) {
+    const char* slash = std::strrchr(index, '/');
+    size_t dir = slash ? (size_t)(slash - index) + 1 : 0;
+    snprintf(out, cap, "%.*s%s", (int)dir, index, file);
+}
+
+inline bool sch_manifest_name_ok(const char* name) {
+    size_t len = std::strlen(name);
+    if (len == 0 || len > 1023) return false;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)name[i];
+        if (c <= ' ' || c == 0x7f) return false;
+    }
+    return true;
+}
+
+inline bool sch_read_manifest(const char* index, SchManifest& m) {
+    char path[4096];
+    sch_manifest_path(index, path, sizeof(path));
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    m = SchManifest();
+    unsigned long long gen = 0, next = 0;
+    bool ok = fscanf(f, "SCHSEGS1 %llu %llu", &gen, &next) == 2;
+    m.generation = gen;
+    m.next_segment = next;
+    char file[1024], tomb[1024];
+    size_t docs = 0, deleted = 0;
+    while (ok && fscanf(f, "%1023s %zu %zu %1023s", file, &docs, &deleted, tomb) == 4) {
+        SchSegmentInfo s;
+        s.file = SchString(file);
+        s.doc_count = docs;
+        s.deleted = deleted;
+        s.tombstones = SchString(std::strcmp(tomb, "-") == 0 ? "" : tomb);
+        m.segments.push_back(s);
+    }
+    fclose(f);
+    return ok;
+}
+
+inline bool sch_write_manifest(const char* index, const SchManifest& m) {
+    char path[4096], tmp[4200];
+    sch_manifest_path(index, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    for (size_t i = 0; i < m.segments.size(); ++i) {
+        const SchSegmentInfo& s = m.segments[i];
+        if (!sch_manifest_name_ok(s.file.c_str()) || (s.tombstones.size() && !sch_manifest_name_ok(s.tombstones.c_str()))) return false;
+    }
+    FILE* f = fopen(tmp, "w");
+    if (!f) return false;
+    fprintf(f, "SCHSEGS1 %llu %llu\n", (unsigned long long)m.generation, (unsigned long long)m.next_segment);
+    for (size_t i = 0; i < m.segments.size(); ++i) {
+        const SchSegmentInfo& s = m.segments[i];
+        fprintf(f, "%s %zu %zu %s\n", s.file.c_str(), s.doc_count, s.deleted, s.tombstones.size() ? s.tombstones.c_str() : "-");
+    }
+    bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp, path) != 0) return false;
+    char dir[4096];
+    sch_segment_path(index, ".", dir, sizeof(dir));
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+// Flushes a file written with stdio and closed to disk.
+inline bool sch_sync_file(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+// Tombstones are a bitmap over the segment's doc ids, stored as raw 64-bit words.
+inline bool sch_is_deleted(const SchVector<uint64_t>& bits, size_t doc) {
+    return (doc >> 6) < bits.size() && (bits[doc >> 6] >> (doc & 63)) & 1;
+}
+
+inline void sch_mark_deleted(SchVector<uint64_t>& bits, size_t doc) {
+    while ((doc >> 6) >= bits.size()) bits.push_back(0);
+    bits[doc >> 6] |= 1ull << (doc & 63);
+}
+
+inline bool sch_read_tombstones(const char* path, size_t doc_count, SchVector<uint64_t>& bits) {
+    bits.clear();
+    bits.resize((doc_count + 63) / 64);
+    for (size_t i = 0; i < bits.size(); ++i) bits[i] = 0;
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    size_t n = bits.size() ? fread(bits.begin(), sizeof(uint64_t), bits.size(), f) : 0;
+    fclose(f);
+    return n == bits.size();
+}
+
+inline bool sch_write_tombstones(const char* path, const SchVector<uint64_t>& bits) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = !bits.size() || fwrite(bits.begin(), sizeof(uint64_t), bits.size(), f) == bits.size();
+    ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+    return fclose(f) == 0 && ok;
+}
+
+// "<segment path>.files"
+inline void sch_doc_files_path(const char* segment, char* out, size_t cap) {
+    snprintf(out, cap, "%s.files", segment);
+}
+
+inline bool sch_read_doc_files(const char* path, size_t doc_count, SchVector<SchDocFile>& files) {
+    files.clear();
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    files.resize(doc_count);
+    size_t n = doc_count ? fread(files.begin(), sizeof(SchDocFile), doc_count, f) : 0;
+    bool ok = n == doc_count && fgetc(f) == EOF;
+    fclose(f);
+    if (!ok) files.clear();
+    return ok;
+}
+
+inline bool sch_write_doc_files(const char* path, const SchVector<SchDocFile>& files) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = !files.size() || fwrite(files.begin(), sizeof(SchDocFile), files.size(), f) == files.size();
+    ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+    return fclose(f) == 0 && ok;
+}
+
+#endif
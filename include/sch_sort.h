@@ -0,0 +1,74 @@
+#ifndef SCH_SORT_H
+#define SCH_SORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "sch_containers.h"
+
+// A string to sort by and the id it stands for. Only the handles move; the
+// bytes stay where they are (NUL-terminated).
+struct SchStrHandle {
+    const unsigned char* s;
+    uint32_t id;
+};
+
+static const size_t SCH_RADIX_CUTOFF = 32;
+
+// Sorts handles whose strings agree on the first depth bytes.
+inline void sch_msd_sort(SchStrHandle* h, SchStrHandle* tmp, size_t n, size_t depth) {
+    if (n < SCH_RADIX_CUTOFF) {
+        for (size_t i = 1; i < n; ++i) {
+            SchStrHandle x = h[i];
+            size_t j = i;
+            while (j > 0 && std::strcmp((const char*)h[j - 1].s + depth, (const char*)x.s + depth) > 0) { h[j] = h[j - 1]; --j; }
+            h[j] = x;
+        }
+        return;
+    }
+    // pos[b] starts as the first slot of bucket b and ends up past its last one.
+    size_t pos[256];
+    std::memset(pos, 0, sizeof(pos));
+    for (size_t i = 0; i < n; ++i) pos[h[i].s[depth]]++;
+    size_t sum = 0;
+    for (size_t b = 0; b < 256; ++b) { size_t c = pos[b]; pos[b] = sum; sum += c; }
+    for (size_t i = 0; i < n; ++i) tmp[pos[h[i].s[depth]]++] = h[i];
+    std::memcpy(h, tmp, n * sizeof(SchStrHandle));
+    // Bucket 0 holds strings that ended at depth: all equal, nothing to sort.
+    for (size_t b = 1; b < 256; ++b) {
+        size_t lo = pos[b - 1], hi = pos[b];
+        if (hi - lo > 1) sch_msd_sort(h + lo, tmp, hi - lo, depth + 1);
+    }
+}
+
+// MSD radix sort into strcmp order (bytes compared unsigned).
+inline void sch_sort_strings(SchVector<SchStrHandle>& h) {
+    if (h.size() <= 1) return;
+    SchVector<SchStrHandle> tmp;
+    tmp.resize(h.size());
+    sch_msd_sort(h.begin(), tmp.begin(), h.size(), 0);
+}
+
+// Stable LSD radix sort of ids by keys[id], a byte per pass; passes where every
+// key has the same byte are skipped.
+inline void sch_sort_by_key(SchVector<uint32_t>& ids, const uint32_t* keys) {
+    size_t n = ids.size();
+    if (n <= 1) return;
+    SchVector<uint32_t> tmp;
+    tmp.resize(n);
+    uint32_t* src = ids.begin();
+    uint32_t* dst = tmp.begin();
+    for (unsigned shift = 0; shift < 32; shift += 8) {
+        size_t count[256];
+        std::memset(count, 0, sizeof(count));
+        for (size_t i = 0; i < n; ++i) count[(keys[src[i]] >> shift) & 0xff]++;
+        if (count[(keys[src[0]] >> shift) & 0xff] == n) continue;
+        size_t sum = 0;
+        for (size_t b = 0; b < 256; ++b) { size_t c = count[b]; count[b] = sum; sum += c; }
+        for (size_t i = 0; i < n; ++i) dst[count[(keys[src[i]] >> shift) & 0xff]++] = src[i];
+        uint32_t* t = src; src = dst; dst = t;
+    }
+    if (src != ids.begin()) std::memcpy(ids.begin(), src, n * sizeof(uint32_t));
+}
+
+#endif
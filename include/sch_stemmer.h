@@ -0,0 +1,211 @@
+#ifndef SCH_STEMMER_H
+#define SCH_STEMMER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Porter-style stemmer working in place on a char buffer. The result is never
+// longer than the input, so no extra capacity is needed. Semantics follow the
+// original std::string implementation exactly, including its measure(), which
+// counts vowel runs (a trailing vowel run counts too).
+
+inline bool sch_stem_vowel(char c) {
+    return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u';
+}
+
+// 'y' is a consonant at the start of a word or after a vowel.
+inline bool sch_stem_consonant(const char* s, size_t i) {
+    size_t j = i;
+    while (j > 0 && s[j] == 'y') --j;
+    bool c = s[j] == 'y' || !sch_stem_vowel(s[j]);
+    return ((i - j) & 1) ? !c : c;
+}
+
+inline int sch_stem_measure(const char* s, size_t n) {
+    int m = 0;
+    bool prev_cons = true;
+    for (size_t i = 0; i < n; ++i) {
+        char c = s[i];
+        bool cons = sch_stem_vowel(c) ? false : (c == 'y' ? (i == 0 || !prev_cons) : true);
+        if (!cons && (i == 0 || prev_cons)) ++m;
+        prev_cons = cons;
+    }
+    return m;
+}
+
+inline bool sch_stem_has_vowel(const char* s, size_t n) {
+    bool prev_cons = true;
+    for (size_t i = 0; i < n; ++i) {
+        char c = s[i];
+        bool cons = sch_stem_vowel(c) ? false : (c == 'y' ? (i == 0 || !prev_cons) : true);
+        if (!cons) return true;
+        prev_cons = cons;
+    }
+    return false;
+}
+
+inline bool sch_stem_cvc(const char* s, long i) {
+    if (i < 2) return false;
+    if (!sch_stem_consonant(s, (size_t)i) || sch_stem_consonant(s, (size_t)i - 1) || !sch_stem_consonant(s, (size_t)i - 2)) return false;
+    char c = s[i];
+    return c != 'w' && c != 'x' && c != 'y';
+}
+
+inline bool sch_stem_ends(const char* s, size_t n, const char* suf, size_t len) {
+    if (n < len || s[n - 1] != suf[len - 1]) return false;
+    for (size_t i = 0; i + 1 < len; ++i) if (s[n - len + i] != suf[i]) return false;
+    return true;
+}
+
+struct SchStemRule {
+    const char* suf;
+    unsigned char suf_len;
+    const char* rep;
+    unsigned char rep_len;
+};
+
+// Applies the first rule whose suffix matches when the remaining stem has
+// measure > min_measure; later rules are not tried once a suffix matched.
+inline size_t sch_stem_apply(char* s, size_t n, const SchStemRule* rules, int min_measure) {
+    for (const SchStemRule* r = rules; r->suf; ++r) {
+        if (!sch_stem_ends(s, n, r->suf, r->suf_len)) continue;
+        size_t stem = n - r->suf_len;
+        if (sch_stem_measure(s, stem) > min_measure) {
+            std::memcpy(s + stem, r->rep, r->rep_len);
+            return stem + r->rep_len;
+        }
+        return n;
+    }
+    return n;
+}
+
+// Stems s[0..n) (already lowercase) in place and returns the new length.
+inline size_t sch_stem_inplace(char* s, size_t n) {
+    if (n <= 2) return n;
+
+    if (sch_stem_ends(s, n, "sses", 4)) n -= 2;
+    else if (sch_stem_ends(s, n, "ies", 3)) n -= 2;
+    else if (sch_stem_ends(s, n, "ss", 2)) {}
+    else if (s[n - 1] == 's') n -= 1;
+
+    bool step1b = false;
+    if (sch_stem_ends(s, n, "eed", 3)) {
+        if (sch_stem_measure(s, n - 3) > 0) n -= 1;
+    } else if (sch_stem_ends(s, n, "ed", 2)) {
+        if (sch_stem_has_vowel(s, n - 2)) { n -= 2; step1b = true; }
+    } else if (sch_stem_ends(s, n, "ing", 3)) {
+        if (sch_stem_has_vowel(s, n - 3)) { n -= 3; step1b = true; }
+    }
+
+    if (step1b) {
+        if (sch_stem_ends(s, n, "at", 2) || sch_stem_ends(s, n, "bl", 2) || sch_stem_ends(s, n, "iz", 2)) {
+            s[n++] = 'e';
+        } else if (n >= 2 && s[n - 1] == s[n - 2] && sch_stem_consonant(s, n - 1)) {
+            char last = s[n - 1];
+            if (last != 'l' && last != 's' && last != 'z') n -= 1;
+        } else if (sch_stem_measure(s, n) == 1 && sch_stem_cvc(s, (long)n - 1)) {
+            s[n++] = 'e';
+        }
+    }
+
+    if (n > 0 && s[n - 1] == 'y' && sch_stem_has_vowel(s, n - 1)) s[n - 1] = 'i';
+
+    static const SchStemRule step2[] = {
+        {"ational", 7, "ate", 3}, {"tional", 6, "tion", 4}, {"enci", 4, "ence", 4}, {"anci", 4, "ance", 4},
+        {"izer", 4, "ize", 3}, {"abli", 4, "able", 4}, {"alli", 4, "al", 2}, {"entli", 5, "ent", 3},
+        {"eli", 3, "e", 1}, {"ousli", 5, "ous", 3}, {"ization", 7, "ize", 3}, {"ation", 5, "ate", 3},
+        {"ator", 4, "ate", 3}, {"alism", 5, "al", 2}, {"iveness", 7, "ive", 3}, {"fulness", 7, "ful", 3},
+        {"ousness", 7, "ous", 3}, {"aliti", 5, "al", 2}, {"iviti", 5, "ive", 3}, {"biliti", 6, "ble", 3},
+        {nullptr, 0, nullptr, 0}
+    };
+    static const SchStemRule step3[] = {
+        {"icate", 5, "ic", 2}, {"ative", 5, "", 0}, {"alize", 5, "al", 2}, {"iciti", 5, "ic", 2},
+        {"ical", 4, "ic", 2}, {"ful", 3, "", 0}, {"ness", 4, "", 0}, {nullptr, 0, nullptr, 0}
+    };
+    static const SchStemRule step4[] = {
+        {"al", 2, "", 0}, {"ance", 4, "", 0}, {"ence", 4, "", 0}, {"er", 2, "", 0}, {"ic", 2, "", 0},
+        {"able", 4, "", 0}, {"ible", 4, "", 0}, {"ant", 3, "", 0}, {"ement", 5, "", 0}, {"ment", 4, "", 0},
+        {"ent", 3, "", 0}, {"ion", 3, "", 0}, {"ou", 2, "", 0}, {"ism", 3, "", 0}, {"ate", 3, "", 0},
+        {"iti", 3, "", 0}, {"ous", 3, "", 0}, {"ive", 3, "", 0}, {"ize", 3, "", 0}, {nullptr, 0, nullptr, 0}
+    };
+    n = sch_stem_apply(s, n, step2, 0);
+    n = sch_stem_apply(s, n, step3, 0);
+    n = sch_stem_apply(s, n, step4, 1);
+
+    if (n > 0 && s[n - 1] == 'e') {
+        int m = sch_stem_measure(s, n - 1);
+        if (m > 1 || (m == 1 && !sch_stem_cvc(s, (long)n - 2))) n -= 1;
+    }
+    return n;
+}
+
+// Bounded direct-mapped memo of surface token -> stem. A colliding token
+// simply replaces the slot, so memory stays fixed at slots * sizeof(Slot).
+// Tokens longer than SCH_STEM_CACHE_KEY bytes bypass the cache.
+static const size_t SCH_STEM_CACHE_KEY = 30;
+
+class SchStemCache {
+private:
+    struct Slot {
+        unsigned char key_len;
+        unsigned char stem_len;
+        char key[SCH_STEM_CACHE_KEY];
+        char stem[SCH_STEM_CACHE_KEY];
+    };
+
+    Slot* slots_;
+    size_t mask_;
+    size_t hits_;
+    size_t misses_;
+
+    SchStemCache(const SchStemCache&);
+    SchStemCache& operator=(const SchStemCache&);
+
+    static uint32_t hash_bytes(const char* k, size_t n) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < n; ++i) h = (h ^ (unsigned char)k[i]) * 1099511628211ull;
+        return (uint32_t)(h ^ (h >> 32));
+    }
+
+public:
+    explicit SchStemCache(size_t slots = 0) : slots_(nullptr), mask_(0), hits_(0), misses_(0) { init(slots); }
+    ~SchStemCache() { delete[] slots_; }
+
+    // Rounds slots up to a power of two; 0 disables the cache.
+    void init(size_t slots) {
+        delete[] slots_;
+        slots_ = nullptr;
+        mask_ = 0;
+        if (slots == 0) return;
+        size_t cap = 1;
+        while (cap < slots) cap <<= 1;
+        slots_ = new Slot[cap];
+        for (size_t i = 0; i < cap; ++i) slots_[i].key_len = 0;
+        mask_ = cap - 1;
+    }
+
+    bool enabled() const { return slots_ != nullptr; }
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+    // Stems the lowercase token s[0..n) in place, consulting the cache first.
+    size_t stem(char* s, size_t n) {
+        if (!slots_ || n > SCH_STEM_CACHE_KEY || n <= 2) return sch_stem_inplace(s, n);
+        Slot& slot = slots_[hash_bytes(s, n) & mask_];
+        if (slot.key_len == n && std::memcmp(slot.key, s, n) == 0) {
+            ++hits_;
+            std::memcpy(s, slot.stem, slot.stem_len);
+            return slot.stem_len;
+        }
+        ++misses_;
+        slot.key_len = (unsigned char)n;
+        std::memcpy(slot.key, s, n);
+        size_t len = sch_stem_inplace(s, n);
+        slot.stem_len = (unsigned char)len;
+        std::memcpy(slot.stem, s, len);
+        return len;
+    }
+};
+
+#endif
@@ -6,61 +6,87 @@
 #include <cstdio>
 #include <cstdlib>
 #include <string>
+#include "sch_arena.h"
 
-class SchString {
+template <typename Alloc>
+class SchBasicString {
 private:
     char* data_;
     size_t len_;
-public:
-    SchString() : data_(nullptr), len_(0) {}
-    SchString(const char* s) {
-        if (!s) { data_ = nullptr; len_ = 0; return; }
-        len_ = std::strlen(s);
-        data_ = new char[len_ + 1];
-        std::memcpy(data_, s, len_ + 1);
-    }
-    SchString(const char* s, size_t n) {
+    Alloc alloc_;
+
+    void assign(const char* s, size_t n) {
         if (!s || n == 0) { data_ = nullptr; len_ = 0; return; }
         len_ = n;
-        data_ = new char[len_ + 1];
+        data_ = (char*)alloc_.allocate(len_ + 1);
         std::memcpy(data_, s, len_);
         data_[len_] = '\0';
     }
-    SchString(const SchString& other) {
-        if (other.len_ == 0) { data_ = nullptr; len_ = 0; return; }
-        len_ = other.len_;
-        data_ = new char[len_ + 1];
-        std::memcpy(data_, other.data_, len_ + 1);
+    void release() {
+        if (data_) alloc_.deallocate(data_, len_ + 1);
+    }
+
+    template <typename A2> friend class SchBasicString;
+
+public:
+    SchBasicString(const Alloc& a = Alloc()) : data_(nullptr), len_(0), alloc_(a) {}
+    SchBasicString(const char* s, const Alloc& a = Alloc()) : alloc_(a) {
+        assign(s, s ? std::strlen(s) : 0);
     }
-    SchString& operator=(const SchString& other) {
+    SchBasicString(const char* s, size_t n, const Alloc& a = Alloc()) : alloc_(a) {
+        assign(s, n);
+    }
+    SchBasicString(const SchBasicString& other) : alloc_(other.alloc_) {
+        assign(other.data_, other.len_);
+    }
+    SchBasicString(SchBasicString&& other) noexcept : data_(other.data_), len_(other.len_), alloc_(other.alloc_) {
+        other.data_ = nullptr;
+        other.len_ = 0;
+    }
+    template <typename A2>
+    explicit SchBasicString(const SchBasicString<A2>& other, const Alloc& a = Alloc()) : alloc_(a) {
+        assign(other.data_, other.len_);
+    }
+    // Assignment adopts the source's allocator, so strings copied into a
+    // vector slot end up in the same arena as the source.
+    SchBasicString& operator=(const SchBasicString& other) {
         if (this == &other) return *this;
-        delete[] data_;
-        if (other.len_ == 0) { data_ = nullptr; len_ = 0; return *this; }
+        release();
+        alloc_ = other.alloc_;
+        assign(other.data_, other.len_);
+        return *this;
+    }
+    SchBasicString& operator=(SchBasicString&& other) noexcept {
+        if (this == &other) return *this;
+        release();
+        data_ = other.data_;
         len_ = other.len_;
-        data_ = new char[len_ + 1];
-        std::memcpy(data_, other.data_, len_ + 1);
+        alloc_ = other.alloc_;
+        other.data_ = nullptr;
+        other.len_ = 0;
         return *this;
     }
-    ~SchString() {
-        delete[] data_;
+    ~SchBasicString() {
+        release();
     }
 
-    static SchString from_std_string(const std::string& s) {
-        return SchString(s.c_str(), s.size());
+    static SchBasicString from_std_string(const std::string& s) {
+        return SchBasicString(s.c_str(), s.size());
     }
 
+    const Alloc& get_allocator() const { return alloc_; }
     const char* c_str() const { return (data_ ? data_ : ""); }
     size_t size() const { return len_; }
     bool empty() const { return len_ == 0; }
 
-    bool operator==(const SchString& other) const {
+    bool operator==(const SchBasicString& other) const {
         if (len_ != other.len_) return false;
         if (len_ == 0) return true;
         return std::memcmp(data_, other.data_, len_) == 0;
     }
-    bool operator!=(const SchString& other) const { return !(*this == other); }
+    bool operator!=(const SchBasicString& other) const { return !(*this == other); }
 
-    int compare(const SchString& other) const {
+    int compare(const SchBasicString& other) const {
         if (len_ == 0 && other.len_ == 0) return 0;
         if (len_ == 0) return -1;
         if (other.len_ == 0) return 1;
@@ -79,4 +105,7 @@ public:
     }
 };
 
+typedef SchBasicString<SchHeapAllocator> SchString;
+typedef SchBasicString<SchArenaAllocator> SchArenaString;
+
 #endif
@@ -3,11 +3,11 @@
 
 #include "sch_containers.h"
 #include "sch_string.h"
+#include "sch_stemmer.h"
 #include <string>
-#include <sstream>
 #include <algorithm>
 #include <cctype>
-#include <functional>
+#include <cstdlib>
 
 inline bool ends_with_cstr(const char* s, const char* suf) {
     size_t ls = std::strlen(s);
@@ -16,137 +16,126 @@ inline bool ends_with_cstr(const char* s, const char* suf) {
     return std::strcmp(s + (ls - rs), suf) == 0;
 }
 
-SchVector<SchString> tokenize(const SchString& text_sch, size_t min_token_len = 1) {
-    std::string text(text_sch.c_str(), text_sch.size());
-    SchVector<SchString> tokens;
-    std::string clean;
-    clean.reserve(text.size());
-    for (char c : text) {
-        if (std::isalnum(static_cast<unsigned char>(c))) clean.push_back(std::tolower(static_cast<unsigned char>(c)));
-        else clean.push_back(' ');
-    }
-    std::stringstream ss(clean);
-    std::string w;
-    while (ss >> w) {
-        if (w.size() >= min_token_len) tokens.push_back(SchString(w.c_str(), w.size()));
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Token characters are ASCII letters and digits (what std::isalnum accepts in
+// the "C" locale); the table maps each byte to its lowercase form or to 0.
+struct SchCharTable {
+    unsigned char lower[256];
+    SchCharTable() {
+        for (int c = 0; c < 256; ++c) {
+            if (c >= 'A' && c <= 'Z') lower[c] = (unsigned char)(c - 'A' + 'a');
+            else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) lower[c] = (unsigned char)c;
+            else lower[c] = 0;
+        }
     }
-    return tokens;
+};
+
+inline const unsigned char* sch_token_table() {
+    static const SchCharTable table;
+    return table.lower;
 }
 
-static SchString stem_word(const SchString& word_sch) {
-    std::string word(word_sch.c_str(), word_sch.size());
-    if (word.size() <= 2) return SchString(word.c_str(), word.size());
-    std::string s;
-    s.reserve(word.size());
-    for (char c : word) s.push_back(std::tolower(static_cast<unsigned char>(c)));
+#if defined(__SSE2__)
+inline __m128i sch_in_range16(__m128i v, char lo, char hi) {
+    __m128i t = _mm_xor_si128(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8((char)0x80));
+    return _mm_cmplt_epi8(t, _mm_set1_epi8((char)(hi - lo + 1 - 128)));
+}
 
-    std::function<bool(const std::string&, int)> is_consonant = [&](const std::string& str, int i)->bool {
-        char ch = str[i];
-        if (ch == 'a' || ch == 'e' || ch == 'i' || ch == 'o' || ch == 'u') return false;
-        if (ch == 'y') {
-            if (i == 0) return true;
-            return !is_consonant(str, i - 1);
-        }
-        return true;
-    };
+// Lowercases 16 bytes in place and returns the bitmask of token characters.
+inline unsigned sch_lower_alnum16(char* p) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i upper = sch_in_range16(v, 'A', 'Z');
+    __m128i alnum = _mm_or_si128(_mm_or_si128(upper, sch_in_range16(v, 'a', 'z')), sch_in_range16(v, '0', '9'));
+    _mm_storeu_si128((__m128i*)p, _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+    return (unsigned)_mm_movemask_epi8(alnum);
+}
+#endif
 
-    std::function<int(const std::string&)> measure = [&](const std::string& str)->int {
-        int m = 0;
-        size_t i = 0, n = str.size();
-        while (i < n && is_consonant(str, static_cast<int>(i))) ++i;
+// Single-pass tokenizer over a mutable buffer: token bytes are lowercased in
+// place and fn(token, length) is called for every token of at least
+// min_token_len bytes, pointing into text; fn may rewrite the token bytes.
+// Returns the number of tokens emitted.
+template <typename Fn>
+size_t sch_tokenize_inplace(char* text, size_t n, Fn&& fn, size_t min_token_len = 1) {
+    const unsigned char* table = sch_token_table();
+    size_t i = 0, count = 0;
+    while (i < n) {
+#if defined(__SSE2__)
+        while (i + 16 <= n) {
+            unsigned mask = sch_lower_alnum16(text + i);
+            if (mask) { i += (size_t)__builtin_ctz(mask); break; }
+            i += 16;
+        }
+#endif
+        while (i < n && !table[(unsigned char)text[i]]) ++i;
+        if (i >= n) break;
+        size_t start = i;
+#if defined(__SSE2__)
+        while (i + 16 <= n) {
+            unsigned mask = sch_lower_alnum16(text + i);
+            if (mask != 0xFFFFu) { i += (size_t)__builtin_ctz(~mask); break; }
+            i += 16;
+        }
+#endif
         while (i < n) {
-            while (i < n && !is_consonant(str, static_cast<int>(i))) ++i;
-            while (i < n && is_consonant(str, static_cast<int>(i))) ++i;
-            if (i > 0) m++;
+            unsigned char c = table[(unsigned char)text[i]];
+            if (!c) break;
+            text[i++] = (char)c;
+        }
+        if (i - start >= min_token_len) {
+            fn(text + start, i - start);
+            ++count;
         }
-        return m;
-    };
-
-    std::function<bool(const std::string&)> contains_vowel = [&](const std::string& str)->bool {
-        for (size_t i = 0; i < str.size(); ++i) if (!is_consonant(str, static_cast<int>(i))) return true;
-        return false;
-    };
-    std::function<bool(const std::string&)> ends_with_double_consonant = [&](const std::string& str)->bool {
-        size_t n = str.size();
-        if (n >= 2 && str[n-1] == str[n-2]) return is_consonant(str, static_cast<int>(n-1));
-        return false;
-    };
-    std::function<bool(const std::string&, int)> cvc = [&](const std::string& str, int i)->bool {
-        if (i < 2) return false;
-        if (!is_consonant(str, i) || is_consonant(str, i-1) || !is_consonant(str, i-2)) return false;
-        char ch = str[i];
-        if (ch == 'w' || ch == 'x' || ch == 'y') return false;
-        return true;
-    };
-
-    if (ends_with_cstr(s.c_str(), "sses")) s = s.substr(0, s.size() - 2);
-    else if (ends_with_cstr(s.c_str(), "ies")) s = s.substr(0, s.size() - 2);
-    else if (ends_with_cstr(s.c_str(), "ss")) {}
-    else if (ends_with_cstr(s.c_str(), "s")) s = s.substr(0, s.size() - 1);
-
-    bool step1b_performed = false;
-    if (ends_with_cstr(s.c_str(), "eed")) {
-        std::string stem = s.substr(0, s.size() - 3);
-        if (measure(stem) > 0) s = stem + "ee";
-    } else if (ends_with_cstr(s.c_str(), "ed")) {
-        std::string stem = s.substr(0, s.size() - 2);
-        if (contains_vowel(stem)) { s = stem; step1b_performed = true; }
-    } else if (ends_with_cstr(s.c_str(), "ing")) {
-        std::string stem = s.substr(0, s.size() - 3);
-        if (contains_vowel(stem)) { s = stem; step1b_performed = true; }
     }
+    return count;
+}
 
-    if (step1b_performed) {
-        if (ends_with_cstr(s.c_str(), "at") || ends_with_cstr(s.c_str(), "bl") || ends_with_cstr(s.c_str(), "iz")) { s.push_back('e'); }
-        else if (ends_with_double_consonant(s)) {
-            char last = s.back();
-            if (last != 'l' && last != 's' && last != 'z') s = s.substr(0, s.size() - 1);
-        } else if (measure(s) == 1 && cvc(s, static_cast<int>(s.size()) - 1)) s.push_back('e');
-    }
+template <typename Alloc>
+void tokenize_into(const char* text, size_t n, SchVector<SchBasicString<Alloc>, Alloc>& tokens, size_t min_token_len = 1) {
+    SchVector<char> buf;
+    buf.resize(n);
+    if (n) std::memcpy(buf.begin(), text, n);
+    sch_tokenize_inplace(buf.begin(), n, [&tokens](const char* tok, size_t len) {
+        tokens.emplace_back(tok, len, tokens.get_allocator());
+    }, min_token_len);
+}
 
-    if (ends_with_cstr(s.c_str(), "y")) {
-        std::string stem = s.substr(0, s.size() - 1);
-        if (contains_vowel(stem)) s = stem + "i";
-    }
+SchVector<SchString> tokenize(const SchString& text_sch, size_t min_token_len = 1) {
+    SchVector<SchString> tokens;
+    tokenize_into(text_sch.c_str(), text_sch.size(), tokens, min_token_len);
+    return tokens;
+}
 
-    struct Suf { const char* suf; const char* rep; };
-    static Suf step2[] = {
-        {"ational","ate"},{"tional","tion"},{"enci","ence"},{"anci","ance"},
-        {"izer","ize"},{"abli","able"},{"alli","al"},{"entli","ent"},
-        {"eli","e"},{"ousli","ous"},{"ization","ize"},{"ation","ate"},
-        {"ator","ate"},{"alism","al"},{"iveness","ive"},{"fulness","ful"},
-        {"ousness","ous"},{"aliti","al"},{"iviti","ive"},{"biliti","ble"},
-        {nullptr,nullptr}
-    };
-    for (int i = 0; step2[i].suf; ++i) {
-        if (ends_with_cstr(s.c_str(), step2[i].suf)) {
-            std::string stem = s.substr(0, s.size() - std::strlen(step2[i].suf));
-            if (measure(stem) > 0) { s = stem + std::string(step2[i].rep); }
-            break;
-        }
-    }
-    static Suf step3[] = { {"icate","ic"},{"ative",""},{"alize","al"},{"iciti","ic"},{"ical","ic"},{"ful",""},{"ness",""},{nullptr,nullptr} };
-    for (int i = 0; step3[i].suf; ++i) {
-        if (ends_with_cstr(s.c_str(), step3[i].suf)) {
-            std::string stem = s.substr(0, s.size() - std::strlen(step3[i].suf));
-            if (measure(stem) > 0) s = stem + std::string(step3[i].rep);
-            break;
-        }
-    }
-    const char* step4_list[] = {"al","ance","ence","er","ic","able","ible","ant","ement","ment","ent","ion","ou","ism","ate","iti","ous","ive","ize", nullptr};
-    for (int i = 0; step4_list[i]; ++i) {
-        if (ends_with_cstr(s.c_str(), step4_list[i])) {
-            std::string stem = s.substr(0, s.size() - std::strlen(step4_list[i]));
-            if (measure(stem) > 1) s = stem;
-            break;
-        }
-    }
-    if (ends_with_cstr(s.c_str(), "e")) {
-        std::string stem = s.substr(0, s.size() - 1);
-        if (measure(stem) > 1 || (measure(stem) == 1 && !cvc(stem, static_cast<int>(stem.size()) - 1))) s = stem;
-    }
+template <typename Alloc>
+static SchBasicString<Alloc> stem_word(const SchBasicString<Alloc>& word_sch) {
+    size_t n = word_sch.size();
+    if (n <= 2) return SchBasicString<Alloc>(word_sch.c_str(), n, word_sch.get_allocator());
+    char local[64];
+    SchVector<char> heap;
+    char* buf = local;
+    if (n > sizeof(local)) { heap.resize(n); buf = heap.begin(); }
+    const char* w = word_sch.c_str();
+    for (size_t i = 0; i < n; ++i) buf[i] = (w[i] >= 'A' && w[i] <= 'Z') ? (char)(w[i] - 'A' + 'a') : w[i];
+    size_t len = sch_stem_inplace(buf, n);
+    return SchBasicString<Alloc>(buf, len, word_sch.get_allocator());
+}
 
-    return SchString(s.c_str(), s.size());
+// "64M", "512K", "1.5G" or plain bytes; 0 for anything unparsable.
+inline size_t parse_mem_size(const char* s) {
+    char* end = nullptr;
+    double v = std::strtod(s, &end);
+    if (end == s || v <= 0) return 0;
+    switch (*end) {
+        case 'k': case 'K': v *= 1024.0; break;
+        case 'm': case 'M': v *= 1024.0 * 1024.0; break;
+        case 'g': case 'G': v *= 1024.0 * 1024.0 * 1024.0; break;
+        case '\0': break;
+        default: return 0;
+    }
+    return (size_t)v;
 }
 
 #endif
@@ -0,0 +1,184 @@
+#ifndef SCH_TRACE_H
+#define SCH_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <time.h>
+
+// Per-stage timers and counters of index_builder and search_cli. A thread
+// records into the SchTrace installed by a SchTraceScope; outside any scope
+// every hook is a thread-local load and a branch. Stages nest exclusively: a
+// stage started inside another pauses it, so the stage times of a trace add up
+// to the time spent under its timers. Build with -DSCH_NO_TRACE to compile the
+// hooks out entirely.
+enum SchStage {
+    SCH_STAGE_READ,
+    SCH_STAGE_TOKENIZE,
+    SCH_STAGE_STEM,
+    SCH_STAGE_INSERT,
+    SCH_STAGE_SAVE,
+    SCH_STAGE_PARSE,
+    SCH_STAGE_LOOKUP,
+    SCH_STAGE_DECODE,
+    SCH_STAGE_INTERSECT,
+    SCH_STAGE_OUTPUT,
+    SCH_STAGE_COUNT
+};
+
+enum SchCounter {
+    SCH_CTR_DOCS,
+    SCH_CTR_BYTES,
+    SCH_CTR_TOKENS,
+    SCH_CTR_TERMS,
+    SCH_CTR_SAMPLED_DOCS,
+    SCH_CTR_SAMPLED_NS,
+    SCH_CTR_QUERIES,
+    SCH_CTR_CACHED,
+    SCH_CTR_LISTS,
+    SCH_CTR_POSTINGS,
+    SCH_CTR_BLOCKS,
+    SCH_CTR_COUNT
+};
+
+inline const char* sch_stage_name(int s) {
+    static const char* names[SCH_STAGE_COUNT] = {"read", "tokenize", "stem", "insert", "save",
+                                                 "parse", "lookup", "decode", "intersect", "output"};
+    return names[s];
+}
+
+inline const char* sch_counter_name(int c) {
+    static const char* names[SCH_CTR_COUNT] = {"docs", "bytes", "tokens", "terms", "sampled_docs", "sampled_ns",
+                                               "queries", "cached", "lists", "postings", "blocks"};
+    return names[c];
+}
+
+inline uint64_t sch_trace_now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+struct SchTrace {
+    uint64_t ns[SCH_STAGE_COUNT];
+    uint64_t calls[SCH_STAGE_COUNT];
+    uint64_t counts[SCH_CTR_COUNT];
+    int active;
+    uint64_t since;
+    bool detailed;
+
+    SchTrace() : detailed(false) { clear(); }
+    void clear() {
+        for (int s = 0; s < SCH_STAGE_COUNT; ++s) ns[s] = calls[s] = 0;
+        for (int c = 0; c < SCH_CTR_COUNT; ++c) counts[c] = 0;
+        active = -1;
+        since = 0;
+    }
+    void merge(const SchTrace& o) {
+        for (int s = 0; s < SCH_STAGE_COUNT; ++s) {
+            ns[s] += o.ns[s];
+            calls[s] += o.calls[s];
+        }
+        for (int c = 0; c < SCH_CTR_COUNT; ++c) counts[c] += o.counts[c];
+    }
+};
+
+#ifndef SCH_NO_TRACE
+static const bool SCH_TRACE_ENABLED = true;
+
+inline SchTrace*& sch_trace_slot() {
+    static thread_local SchTrace* current = nullptr;
+    return current;
+}
+
+inline SchTrace* sch_trace_current() { return sch_trace_slot(); }
+
+inline void sch_trace_count(SchCounter c, uint64_t n) {
+    if (SchTrace* t = sch_trace_slot()) t->counts[c] += n;
+}
+
+class SchTraceScope {
+private:
+    SchTrace* prev_;
+public:
+    explicit SchTraceScope(SchTrace* t) : prev_(sch_trace_slot()) { sch_trace_slot() = t; }
+    ~SchTraceScope() { sch_trace_slot() = prev_; }
+};
+
+class SchStageTimer {
+private:
+    SchTrace* t_;
+    int prev_;
+public:
+    // A detail timer runs in too hot a place to time every call; it only
+    // times traces that ask for detail and is otherwise part of its parent.
+    explicit SchStageTimer(SchStage s, bool detail = false) : t_(sch_trace_slot()), prev_(-1) {
+        if (t_ && detail && !t_->detailed) t_ = nullptr;
+        if (!t_) return;
+        uint64_t now = sch_trace_now();
+        prev_ = t_->active;
+        if (prev_ >= 0) t_->ns[prev_] += now - t_->since;
+        t_->active = s;
+        t_->since = now;
+        t_->calls[s]++;
+    }
+    ~SchStageTimer() {
+        if (!t_) return;
+        uint64_t now = sch_trace_now();
+        t_->ns[t_->active] += now - t_->since;
+        t_->active = prev_;
+        t_->since = now;
+    }
+};
+#else
+static const bool SCH_TRACE_ENABLED = false;
+
+inline SchTrace* sch_trace_current() { return nullptr; }
+inline void sch_trace_count(SchCounter, uint64_t) {}
+
+class SchTraceScope {
+public:
+    explicit SchTraceScope(SchTrace*) {}
+};
+
+class SchStageTimer {
+public:
+    explicit SchStageTimer(SchStage, bool = false) {}
+};
+#endif
+
+// Cost of one sch_trace_now() call, for timers taken too often to ignore it.
+inline uint64_t sch_trace_clock_cost() {
+    static uint64_t cost = 0;
+    if (!cost) {
+        uint64_t start = sch_trace_now(), end = start;
+        for (int i = 0; i < 1000; ++i) end = sch_trace_now();
+        cost = (end - start) / 1000 + 1;
+    }
+    return cost;
+}
+
+// The stages that ran and every counter as one JSON object:
+//   {"enabled":true,"stages":{"parse":{"ms":0.012,"calls":3},...},"counters":{"queries":3,...}}
+// Returns the length snprintf would have written.
+inline size_t sch_trace_json(const SchTrace& t, char* buf, size_t cap) {
+    size_t n = 0;
+    auto put = [&](int w) { if (w > 0) n += (size_t)w; };
+    put(snprintf(buf, cap, "{\"enabled\":%s,\"stages\":{", SCH_TRACE_ENABLED ? "true" : "false"));
+    bool first = true;
+    for (int s = 0; s < SCH_STAGE_COUNT; ++s) {
+        if (!t.calls[s]) continue;
+        put(snprintf(buf + (n < cap ? n : cap), n < cap ? cap - n : 0, "%s\"%s\":{\"ms\":%.3f,\"calls\":%llu}", first ? "" : ",",
+                     sch_stage_name(s), t.ns[s] / 1e6, (unsigned long long)t.calls[s]));
+        first = false;
+    }
+    put(snprintf(buf + (n < cap ? n : cap), n < cap ? cap - n : 0, "},\"counters\":{"));
+    for (int c = 0; c < SCH_CTR_COUNT; ++c) {
+        put(snprintf(buf + (n < cap ? n : cap), n < cap ? cap - n : 0, "%s\"%s\":%llu", c ? "," : "", sch_counter_name(c),
+                     (unsigned long long)t.counts[c]));
+    }
+    put(snprintf(buf + (n < cap ? n : cap), n < cap ? cap - n : 0, "}}"));
+    return n;
+}
+
+#endif
@@ -2,6 +2,7 @@ import argparse
 import subprocess
 import os
 import re
+import tempfile
 from collections import defaultdict
 
 TOKEN_RE = re.compile(r'\w+', flags=re.UNICODE)
@@ -21,47 +22,40 @@ def count_matches(tokens_query, text):
         total += freq.get(q, 0)
     return total
 
-def run_search_cli(index_path, query, topk):
+def run_search_cli_batch(index_path, queries, topk, rank=False):
     """
-    Run ./search_cli [index_path] and send a single query line, parse output
-    Return list of docnames in returned order (up to topk)
+    Run ./search_cli --batch once over all (qid, query) pairs and parse its
+    TREC output ("qid doc rank")
+    Return dict qid -> list of docnames in returned order (up to topk)
+    With rank=True the queries are scored with BM25 (needs a mapped index)
     """
-    cmd = ['./search_cli', index_path] if index_path else ['./search_cli']
+    fd, qfile = tempfile.mkstemp(prefix='queries_', suffix='.txt')
+    with os.fdopen(fd, 'w', encoding='utf-8') as f:
+        for qid, q in queries:
+            f.write(f"{qid}\t{q}\n")
+    cmd = ['./search_cli', '--batch', qfile, '--top', str(topk)]
+    if rank:
+        cmd.append('--rank')
+    if index_path:
+        cmd.append(index_path)
     try:
-        proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+        proc = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
     except FileNotFoundError as e:
         raise RuntimeError(f"search_cli not found at {cmd[0]} (cwd={os.getcwd()}). Build project first.") from e
+    finally:
+        os.unlink(qfile)
+    if proc.returncode != 0:
+        raise RuntimeError(proc.stderr.strip())
+    for line in proc.stderr.splitlines():
+        if line.startswith("Batch:"):
+            print(line)
 
-    proc.stdin.write(query + "\n")
-    proc.stdin.flush()
-
-    docs = []
-    while True:
-        line = proc.stdout.readline()
-        if not line:
-            break
-        line = line.rstrip("\n").rstrip("\r")
-        if line.strip() == '---END---':
-            break
-        if line.startswith("Found "):
-            continue
-        if line.startswith("... and"):
-            break
-        if line.strip() == "":
-            continue
-        docs.append(line.strip())
-        if len(docs) >= topk:
-            pass
-    try:
-        proc.stdin.close()
-    except Exception:
-        pass
-    try:
-        proc.stdout.read()
-    except Exception:
-        pass
-    proc.terminate()
-    return docs[:topk]
+    docs = defaultdict(list)
+    for line in proc.stdout.splitlines():
+        parts = line.split()
+        if len(parts) == 3:
+            docs[parts[0]].append(parts[1])
+    return docs
 
 def build_qrels_for_query(query_id, query_str, corpus_dir, rel2_thr, rel1_thr):
     q_tokens = [t for t in tokenize_text(query_str) if t]
@@ -92,6 +86,7 @@ def main():
     p.add_argument('--out-qrels', default='qrels.txt', help='Output qrels file (default: qrels.txt)')
     p.add_argument('--out-results', default='results.txt', help='Output results file (default: results.txt)')
     p.add_argument('--topk', type=int, default=100, help='How many results to collect per query (default 100)')
+    p.add_argument('--rank', action='store_true', help='Rank results with BM25 (search_cli --rank, mapped index)')
     p.add_argument('--rel2-threshold', type=int, default=5, help='>= this -> relevance 2 (default 5)')
     p.add_argument('--rel1-threshold', type=int, default=1, help='>= this -> relevance 1 (default 1)')
     args = p.parse_args()
@@ -99,7 +94,7 @@ def main():
     if not os.path.exists(args.queries):
         print("Queries file not found:", args.queries)
         return
-    if not os.path.exists(args.index):
+    if not os.path.exists(args.index) and not os.path.exists(args.index + ".segments"):
         print("Warning: index file not found:", args.index)
     if not os.path.isdir(args.corpus):
         print("Corpus directory not found:", args.corpus)
@@ -126,13 +121,15 @@ def main():
     out_qrels = open(args.out_qrels, 'w', encoding='utf-8')
     out_results = open(args.out_results, 'w', encoding='utf-8')
 
+    try:
+        results = run_search_cli_batch(args.index, queries, args.topk, args.rank)
+    except Exception as e:
+        print("Error running search_cli:", e)
+        results = {}
+
     for qid, qtext in queries:
         print(f"Processing {qid}: {qtext}")
-        try:
-            docs = run_search_cli(args.index, qtext, args.topk)
-        except Exception as e:
-            print("Error running search_cli:", e)
-            docs = []
+        docs = results.get(qid, [])
         for rank, doc in enumerate(docs, start=1):
             out_results.write(f"{qid} {doc} {rank}\n")
 
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Упаковка корпуса в один файл (формат include/sch_corpus_pack.h): заголовок,
+# таблица смещений, имена файлов и тексты подряд. Документы идут в порядке
+# имён (байтовое сравнение), как их нумерует index_builder.
+#   $ python3 src/corpus_pack.py data/corpus data/corpus.pack
+
+import os
+import struct
+import sys
+
+PACK_MAGIC = b"SCHPACK1"
+PACK_VERSION = 1
+HEADER = struct.Struct("<8sIIQQ")
+ENTRY = struct.Struct("<QQQII")
+
+
+def corpus_files(corpus_dir):
+    names = [n for n in os.listdir(corpus_dir)
+             if n.endswith(".txt") and len(n) > 4 and os.path.isfile(os.path.join(corpus_dir, n))]
+    return sorted(names, key=os.fsencode)
+
+
+def write_pack(corpus_dir, pack_path):
+    names = corpus_files(corpus_dir)
+    encoded = [os.fsencode(n) for n in names]
+    sizes = [os.path.getsize(os.path.join(corpus_dir, n)) for n in names]
+    names_start = HEADER.size + ENTRY.size * len(names)
+    texts_start = names_start + sum(len(e) + 1 for e in encoded)
+    file_size = texts_start + sum(sizes)
+    tmp = pack_path + ".tmp"
+    with open(tmp, "wb") as out:
+        out.write(HEADER.pack(PACK_MAGIC, PACK_VERSION, 0, len(names), file_size))
+        name_off, text_off = names_start, texts_start
+        for e, size in zip(encoded, sizes):
+            out.write(ENTRY.pack(text_off, size, name_off, len(e), 0))
+            name_off += len(e) + 1
+            text_off += size
+        for e in encoded:
+            out.write(e + b"\0")
+        for n, size in zip(names, sizes):
+            with open(os.path.join(corpus_dir, n), "rb") as f:
+                data = f.read()
+            if len(data) != size:
+                raise IOError(f"{n} changed while packing")
+            out.write(data)
+    os.replace(tmp, pack_path)
+    return len(names)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        print(f"Usage: {sys.argv[0]} <corpus_dir> <corpus.pack>")
+        sys.exit(1)
+    n = write_pack(sys.argv[1], sys.argv[2])
+    print(f"Packed {n} documents into {sys.argv[2]}")
@@ -9,8 +9,10 @@ import re
 import urllib.parse
 import urllib.robotparser
 from collections import deque
+from corpus_pack import write_pack
 
 OUTPUT_DIR = "data/corpus"
+PACK_FILE = "data/corpus.pack"   # упакованный корпус для index_builder
 MIN_DOCS = 30005       # целевое число документов (настраиваемо)
 MIN_WORDS = 1000       # минимальное число слов в документе (настраиваемо)
 SEEDS_FILE = "seeds.txt"
@@ -143,6 +145,8 @@ def crawler():
             pass
 
     print(f"Crawling finished. Collected {docs_collected} documents in {OUTPUT_DIR}")
+    packed = write_pack(OUTPUT_DIR, PACK_FILE)
+    print(f"Packed {packed} documents into {PACK_FILE}")
 
 if __name__ == "__main__":
     crawler()
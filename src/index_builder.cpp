@@ -2,100 +2,380 @@
 #include <cstdlib>
 #include <cstring>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include "../include/sch_containers.h"
 #include "../include/sch_string_utils.h"
 #include "../include/sch_string.h"
+#include "../include/sch_index_structs.h"
+#include "../include/sch_postings.h"
+#include "../include/sch_dictionary.h"
+#include "../include/sch_rank.h"
+#include "../include/sch_positions.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_segments.h"
+#include "../include/sch_arena.h"
+#include "../include/sch_interner.h"
+#include "../include/sch_sort.h"
+#include "../include/sch_reorder.h"
+#include "../include/sch_corpus_pack.h"
+#include "../include/sch_stemmer.h"
+#include "../include/sch_trace.h"
+#include "../include/sch_alloc_counter.h"
 
+// Doc ids arrive in increasing order; tfs[i] counts the occurrences in doc_ids[i].
+// With --positions, positions holds the tfs[i] token positions of every posting
+// one after another.
 struct PostingList {
     SchVector<int> doc_ids;
+    SchVector<int> tfs;
+    SchVector<int> positions;
     void add(int doc_id) {
-        if (doc_ids.size() == 0 || doc_ids[doc_ids.size() - 1] != doc_id) doc_ids.push_back(doc_id);
+        if (doc_ids.size() == 0 || doc_ids.at_unchecked(doc_ids.size() - 1) != doc_id) {
+            doc_ids.push_back(doc_id);
+            tfs.push_back(1);
+        } else {
+            tfs.at_unchecked(tfs.size() - 1)++;
+        }
+    }
+};
+
+// Builder dictionary: terms are interned to dense ids in first-seen order and
+// postings/frequencies are indexed by term id.
+struct TermIndex {
+    SchTermInterner terms;
+    SchVector<PostingList> postings;
+    SchVector<int> freqs;
+    uint32_t add_term(const char* term, size_t len, bool* inserted) {
+        uint32_t id = terms.intern(term, len, inserted);
+        if (*inserted) {
+            postings.emplace_back();
+            freqs.push_back(0);
+        }
+        return id;
+    }
+    void clear() {
+        terms.clear();
+        postings = SchVector<PostingList>();
+        freqs = SchVector<int>();
     }
 };
 
-SchStringHashMap<PostingList> inverted_index(50000);
+TermIndex term_index;
+SchStemCache stem_cache;
+size_t stem_cache_slots = 8192;
 SchVector<SchString> all_doc_names;
-SchStringHashMap<int> term_frequencies(50007);
+SchVector<uint32_t> all_doc_lens;
+// Size and mtime of each document's file; empty for a packed corpus.
+SchVector<SchDocFile> all_doc_files;
+// Threads encoding lists in save_mapped_index (0: one per core).
+int save_threads = 0;
+bool reorder_docs = false;
+
+// Optional parts of a mapped index, given to the functions that build and
+// save one.
+struct IndexFormat {
+    bool compress = false;
+    bool positions = false;
+};
+
+// Output buffer of the index writers; larger sections bypass it.
+static const size_t SCH_WRITE_BUFFER = 4 << 20;
+
+// Paths are sorted as handles and then moved into place.
+void sort_schstring_vector(SchVector<SchString>& v) {
+    if (v.size() <= 1) return;
+    SchVector<SchStrHandle> h;
+    h.reserve(v.size());
+    for (size_t i = 0; i < v.size(); ++i) h.push_back(SchStrHandle{(const unsigned char*)v[i].c_str(), (uint32_t)i});
+    sch_sort_strings(h);
+    SchVector<SchString> sorted;
+    sorted.reserve(v.size());
+    for (size_t i = 0; i < h.size(); ++i) sorted.push_back(std::move(v[h[i].id]));
+    v = std::move(sorted);
+}
+
+// Sorts term ids by term bytes, reading them in place from the interner.
+SchVector<uint32_t> sorted_term_ids(const TermIndex& ti) {
+    SchVector<SchStrHandle> h;
+    h.reserve(ti.terms.size());
+    for (size_t i = 0; i < ti.terms.size(); ++i) h.push_back(SchStrHandle{(const unsigned char*)ti.terms.term((uint32_t)i), (uint32_t)i});
+    sch_sort_strings(h);
+    SchVector<uint32_t> ids;
+    ids.reserve(h.size());
+    for (size_t i = 0; i < h.size(); ++i) ids.push_back(h[i].id);
+    return ids;
+}
+
+// File mtimes come from the coarse clock, so a file written after this call
+// never gets an older mtime.
+static int64_t coarse_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// A file changed this close to its read is read again once the clock has
+// moved past its mtime; later or repeated changes get mtime 0.
+static const int64_t SCH_RACY_WAIT_NS = 50000000;
 
-template <typename T, typename Comp>
-void quicksort(SchVector<T>& arr, int left, int right, Comp comp) {
-    if (left >= right) return;
-    int i = left, j = right;
-    T pivot = arr[(left + right) / 2];
-    while (i <= j) {
-        while (comp(arr[i], pivot)) ++i;
-        while (comp(pivot, arr[j])) --j;
-        if (i <= j) {
-            T tmp = arr[i]; arr[i] = arr[j]; arr[j] = tmp;
-            ++i; --j;
+// Reads a whole open file with fstat/pread and closes it; false for missing or
+// empty files. file (if given) gets the size and mtime of the text read. A
+// file modified within the current clock tick could change again without its
+// mtime moving, so such a file is read again after the tick.
+static bool read_whole_fd(int fd, SchVector<char>& buf, SchDocFile* file) {
+    if (fd < 0) return false;
+    for (int attempt = 0;; ++attempt) {
+        int64_t now = coarse_now_ns();
+        struct stat st;
+        if (fstat(fd, &st) != 0) { close(fd); return false; }
+        size_t n = st.st_size > 0 ? (size_t)st.st_size : 0, got = 0;
+        buf.resize(n);
+        while (got < n) {
+            ssize_t r = pread(fd, buf.begin() + got, n - got, (off_t)got);
+            if (r <= 0) break;
+            got += (size_t)r;
         }
+        int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        bool racy = mtime >= now;
+        if (file && racy && got == n && attempt < 2 && mtime - now < SCH_RACY_WAIT_NS) {
+            while (coarse_now_ns() <= mtime) usleep(1000);
+            continue;
+        }
+        if (file) {
+            file->size = n;
+            file->mtime_ns = racy ? 0 : mtime;
+        }
+        close(fd);
+        return n && got == n;
     }
-    if (left < j) quicksort(arr, left, j, comp);
-    if (i < right) quicksort(arr, i, right, comp);
 }
 
-void sort_int_vector(SchVector<int>& v) {
-    if (v.size() <= 1) return;
-    auto comp = [](const int& a, const int& b){ return a < b; };
-    quicksort<int, decltype(comp)>(v, 0, (int)v.size() - 1, comp);
+// Returns an estimate of the heap bytes the document added to the dictionary.
+// Every token is stemmed in place inside content. Sampled documents also time
+// stemming and inserting per token (less the cost of reading the clock); the
+// split of the tokenize stage is extrapolated from them.
+template <bool Sampled>
+static size_t index_text_impl(char* content, size_t len, int doc_id, TermIndex& ti, SchStemCache& stems, bool positions, uint64_t* stem_ns, uint64_t* insert_ns) {
+    size_t bytes = 0;
+    int position = 0;
+    uint64_t clock = Sampled ? sch_trace_clock_cost() : 0;
+    size_t tokens = sch_tokenize_inplace(content, len, [&](char* tok, size_t tok_len) {
+        uint64_t t0 = Sampled ? sch_trace_now() : 0;
+        size_t stem_len = stems.stem(tok, tok_len);
+        uint64_t t1 = Sampled ? sch_trace_now() : 0;
+        bool inserted = false;
+        uint32_t id = ti.add_term(tok, stem_len, &inserted);
+        if (inserted) bytes += 2 * (stem_len + 1) + 64 + sizeof(PostingList) + 10 * sizeof(int);
+        PostingList& plist = ti.postings.at_unchecked(id);
+        size_t before = plist.doc_ids.size();
+        plist.add(doc_id);
+        if (plist.doc_ids.size() != before) bytes += 2 * sizeof(int);
+        if (positions) { plist.positions.push_back(position); bytes += sizeof(int); }
+        ++position;
+        ti.freqs.at_unchecked(id)++;
+        if (Sampled) {
+            uint64_t t2 = sch_trace_now();
+            *stem_ns += t1 - t0 > clock ? t1 - t0 - clock : 0;
+            *insert_ns += t2 - t1 > clock ? t2 - t1 - clock : 0;
+        }
+    });
+    if ((size_t)doc_id < all_doc_lens.size()) all_doc_lens[(size_t)doc_id] = (uint32_t)tokens;
+    sch_trace_count(SCH_CTR_TOKENS, tokens);
+    return bytes;
 }
 
-void sort_schstring_vector(SchVector<SchString>& v) {
-    if (v.size() <= 1) return;
-    auto comp = [](const SchString& a, const SchString& b){ return std::strcmp(a.c_str(), b.c_str()) < 0; };
-    quicksort<SchString, decltype(comp)>(v, 0, (int)v.size() - 1, comp);
-}
-
-static std::string read_file_to_string(const char* path) {
-    FILE* f = fopen(path, "rb");
-    if (!f) return std::string();
-    fseek(f, 0, SEEK_END);
-    long sz = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    if (sz <= 0) { fclose(f); return std::string(); }
-    std::string out;
-    out.resize(sz);
-    size_t r = fread(&out[0], 1, sz, f);
-    fclose(f);
-    if (r != (size_t)sz) return std::string();
-    return out;
-}
-
-void process_file(const char* filepath, int doc_id) {
-    std::string content = read_file_to_string(filepath);
-    if (content.empty()) return;
-    SchString content_sch(content.c_str(), content.size());
-    SchVector<SchString> tokens = tokenize(content_sch, 1);
-    for (size_t i = 0; i < tokens.size(); ++i) {
-        SchString stem = stem_word(tokens[i]);
-        PostingList* plist = inverted_index.get(stem);
-        if (plist == nullptr) {
-            PostingList new_list;
-            new_list.add(doc_id);
-            inverted_index.insert(stem, new_list);
-        } else {
-            plist->add(doc_id);
+// One document in SCH_TRACE_SAMPLE is sampled.
+static const int SCH_TRACE_SAMPLE = 64;
+
+static size_t index_text(char* content, size_t len, int doc_id, TermIndex& ti, SchStemCache& stems, bool positions) {
+    SchTrace* trace = sch_trace_current();
+    sch_trace_count(SCH_CTR_DOCS, 1);
+    sch_trace_count(SCH_CTR_BYTES, len);
+    SchStageTimer timer(SCH_STAGE_TOKENIZE);
+    if (!trace || doc_id % SCH_TRACE_SAMPLE) return index_text_impl<false>(content, len, doc_id, ti, stems, positions, nullptr, nullptr);
+    uint64_t stem_ns = 0, insert_ns = 0, start = sch_trace_now();
+    size_t bytes = index_text_impl<true>(content, len, doc_id, ti, stems, positions, &stem_ns, &insert_ns);
+    trace->ns[SCH_STAGE_STEM] += stem_ns;
+    trace->ns[SCH_STAGE_INSERT] += insert_ns;
+    trace->counts[SCH_CTR_SAMPLED_NS] += sch_trace_now() - start;
+    trace->counts[SCH_CTR_SAMPLED_DOCS]++;
+    return bytes;
+}
+
+// Spreads the tokenize stage (whole documents) over tokenize, stem and insert
+// in the proportions measured on the sampled documents.
+static void split_sampled_stages(SchTrace& t) {
+    uint64_t sampled = t.counts[SCH_CTR_SAMPLED_NS];
+    if (!sampled) return;
+    double text = (double)t.ns[SCH_STAGE_TOKENIZE];
+    uint64_t stem = (uint64_t)(text * t.ns[SCH_STAGE_STEM] / sampled);
+    uint64_t insert = (uint64_t)(text * t.ns[SCH_STAGE_INSERT] / sampled);
+    if (stem + insert > t.ns[SCH_STAGE_TOKENIZE]) return;
+    t.ns[SCH_STAGE_STEM] = stem;
+    t.ns[SCH_STAGE_INSERT] = insert;
+    t.ns[SCH_STAGE_TOKENIZE] -= stem + insert;
+    t.calls[SCH_STAGE_STEM] = t.calls[SCH_STAGE_INSERT] = t.calls[SCH_STAGE_TOKENIZE];
+}
+
+// The documents to index in doc id order: the files of a corpus directory or
+// the entries of a packed corpus.
+struct CorpusSource {
+    SchVector<SchString> files;
+    SchCorpusPack pack;
+    size_t size() const { return pack.is_open() ? pack.doc_count() : files.size(); }
+};
+
+// Indexed pages of a pack are released every this many bytes, so the private
+// copies made by in-place tokenizing do not pile up.
+static const size_t SCH_PACK_RELEASE = 8 << 20;
+
+// Reads the files [lo, hi) of a directory corpus in order, keeping the next
+// AHEAD files open with POSIX_FADV_WILLNEED: the kernel reads them into the
+// page cache in the background while the current one is tokenized. No reader
+// thread: with a warm cache it cost ~15%, as malloc and stdio start locking.
+class FilePrefetcher {
+private:
+    static const size_t AHEAD = 64;
+    const SchVector<SchString>& files_;
+    size_t next_, hi_;
+    int fds_[AHEAD];
+    SchVector<char> buf_;
+
+    void open_next() {
+        int fd = open(files_[next_].c_str(), O_RDONLY);
+        if (fd >= 0) posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        fds_[next_ % AHEAD] = fd;
+        next_++;
+    }
+
+public:
+    FilePrefetcher(const SchVector<SchString>& files, size_t lo, size_t hi) : files_(files), next_(lo), hi_(hi) {
+        for (size_t i = 0; i < AHEAD; ++i) fds_[i] = -1;
+        while (next_ < hi_ && next_ - lo < AHEAD) open_next();
+    }
+    ~FilePrefetcher() {
+        for (size_t i = 0; i < AHEAD; ++i) {
+            if (fds_[i] >= 0) close(fds_[i]);
         }
-        int* freq = term_frequencies.get(stem);
-        if (freq == nullptr) term_frequencies.insert(stem, 1);
-        else (*freq)++;
     }
+
+    // Document i, taken in order; the buffer is reused by the next call.
+    // nullptr for files that cannot be read or are empty. Records the file's
+    // size and mtime in all_doc_files when that is sized for the corpus.
+    char* take(size_t i, size_t* len) {
+        SchStageTimer timer(SCH_STAGE_READ);
+        int fd = fds_[i % AHEAD];
+        fds_[i % AHEAD] = -1;
+        bool ok = read_whole_fd(fd, buf_, i < all_doc_files.size() ? &all_doc_files[i] : nullptr);
+        if (next_ < hi_) open_next();
+        *len = buf_.size();
+        return ok ? buf_.begin() : nullptr;
+    }
+};
+
+// Per-thread index over a contiguous range of documents. Term ids follow
+// first-occurrence order, so interning the partial dictionaries one after
+// another reproduces the term ids of a single-threaded run.
+struct PartialIndex {
+    TermIndex index;
+    SchStemCache stems;
+};
+
+void build_index_parallel(const CorpusSource& src, int threads, bool positions) {
+    size_t nfiles = src.size();
+    PartialIndex* parts = new PartialIndex[threads];
+    for (int t = 0; t < threads; ++t) parts[t].stems.init(stem_cache_slots);
+    std::atomic<int> processed(0);
+    SchTrace* traces = new SchTrace[threads];
+    SchTrace* trace = sch_trace_current();
+    SchVector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            SchTraceScope scope(trace ? &traces[t] : nullptr);
+            size_t lo = nfiles * t / threads, hi = nfiles * (t + 1) / threads;
+            size_t released = src.pack.is_open() && lo < hi ? src.pack.text_offset(lo) : 0;
+            FilePrefetcher prefetch(src.files, lo, src.pack.is_open() ? lo : hi);
+            for (size_t i = lo; i < hi; ++i) {
+                if (src.pack.is_open()) {
+                    size_t end = src.pack.text_offset(i) + src.pack.text_len(i);
+                    if (src.pack.text_len(i)) index_text(src.pack.text(i), src.pack.text_len(i), (int)i, parts[t].index, parts[t].stems, positions);
+                    if (end - released >= SCH_PACK_RELEASE) { src.pack.release(released, end); released = end; }
+                } else {
+                    size_t len = 0;
+                    char* content = prefetch.take(i, &len);
+                    if (content) index_text(content, len, (int)i, parts[t].index, parts[t].stems, positions);
+                }
+                int done = ++processed;
+                if (done % 2000 == 0) fprintf(stderr, "Processed %d files...\n", done);
+            }
+        });
+    }
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+    workers.clear();
+    for (int t = 0; trace && t < threads; ++t) trace->merge(traces[t]);
+    delete[] traces;
+
+    for (int t = 0; t < threads; ++t) {
+        const SchTermInterner& terms = parts[t].index.terms;
+        for (size_t i = 0; i < terms.size(); ++i) {
+            bool inserted = false;
+            term_index.add_term(terms.term((uint32_t)i), terms.length((uint32_t)i), &inserted);
+        }
+    }
+    size_t nterms = term_index.terms.size();
+    SchVector<int>* local_ids = new SchVector<int>[threads];
+    for (int t = 0; t < threads; ++t) {
+        for (size_t g = 0; g < nterms; ++g) local_ids[t].push_back(-1);
+        const SchTermInterner& terms = parts[t].index.terms;
+        for (size_t i = 0; i < terms.size(); ++i) {
+            long g = term_index.terms.find(terms.term((uint32_t)i), terms.length((uint32_t)i));
+            local_ids[t][(size_t)g] = (int)i;
+        }
+    }
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            size_t lo = nterms * t / threads, hi = nterms * (t + 1) / threads;
+            for (size_t g = lo; g < hi; ++g) {
+                PostingList& merged = term_index.postings[g];
+                for (int p = 0; p < threads; ++p) {
+                    int local = local_ids[p][g];
+                    if (local < 0) continue;
+                    const PostingList& part = parts[p].index.postings[(size_t)local];
+                    for (size_t j = 0; j < part.doc_ids.size(); ++j) {
+                        merged.doc_ids.push_back(part.doc_ids[j]);
+                        merged.tfs.push_back(part.tfs[j]);
+                    }
+                    for (size_t j = 0; j < part.positions.size(); ++j) merged.positions.push_back(part.positions[j]);
+                    term_index.freqs[g] += parts[p].index.freqs[(size_t)local];
+                }
+            }
+        });
+    }
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+    delete[] local_ids;
+    delete[] parts;
 }
 
 void save_index(const char* filename) {
-    SchVector<SchString> keys = inverted_index.get_keys();
-    sort_schstring_vector(keys);
+    SchVector<uint32_t> keys = sorted_term_ids(term_index);
 
     FILE* out = fopen(filename, "wb");
     if (!out) { fprintf(stderr, "Error: cannot open %s for writing\n", filename); exit(1); }
+    setvbuf(out, nullptr, _IOFBF, SCH_WRITE_BUFFER);
 
     size_t docs_count = all_doc_names.size();
     fwrite(&docs_count, sizeof(docs_count), 1, out);
     for (size_t i = 0; i < docs_count; ++i) {
-        SchString s = all_doc_names[i];
+        const SchString& s = all_doc_names[i];
         size_t len = s.size();
         fwrite(&len, sizeof(len), 1, out);
         fwrite(s.c_str(), 1, len, out);
@@ -104,39 +384,495 @@ void save_index(const char* filename) {
     size_t vocab_size = keys.size();
     fwrite(&vocab_size, sizeof(vocab_size), 1, out);
     for (size_t i = 0; i < vocab_size; ++i) {
-        SchString term = keys[i];
-        PostingList* plist = inverted_index.get(term);
-        sort_int_vector(plist->doc_ids);
+        const char* term = term_index.terms.term(keys[i]);
+        PostingList* plist = &term_index.postings[keys[i]];
+        size_t term_len = term_index.terms.length(keys[i]);
+        fwrite(&term_len, sizeof(term_len), 1, out);
+        fwrite(term, 1, term_len, out);
+
+        size_t list_size = plist->doc_ids.size();
+        fwrite(&list_size, sizeof(list_size), 1, out);
+        fwrite(plist->doc_ids.begin(), sizeof(int), list_size, out);
+    }
+    fclose(out);
+}
+
+// SPIMI mode: the in-memory dictionary is flushed as a sorted run whenever the
+// memory budget is exceeded. A run record is the save_index() term record with
+// the term's total frequency after the term bytes.
+SchVector<SchString> spimi_runs;
+
+void flush_run(const char* index_file) {
+    char name[4096];
+    snprintf(name, sizeof(name), "%s.run%zu", index_file, spimi_runs.size());
+    FILE* out = fopen(name, "wb");
+    if (!out) { fprintf(stderr, "Error: cannot open %s for writing\n", name); exit(1); }
+    setvbuf(out, nullptr, _IOFBF, 1 << 20);
+
+    SchVector<uint32_t> keys = sorted_term_ids(term_index);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        PostingList* plist = &term_index.postings[keys[i]];
+        size_t term_len = term_index.terms.length(keys[i]);
+        size_t freq = (size_t)term_index.freqs[keys[i]];
+        size_t list_size = plist->doc_ids.size();
+        fwrite(&term_len, sizeof(term_len), 1, out);
+        fwrite(term_index.terms.term(keys[i]), 1, term_len, out);
+        fwrite(&freq, sizeof(freq), 1, out);
+        fwrite(&list_size, sizeof(list_size), 1, out);
+        fwrite(plist->doc_ids.begin(), sizeof(int), list_size, out);
+    }
+    fclose(out);
+    fprintf(stderr, "Flushed run %s (%zu terms)\n", name, keys.size());
+    spimi_runs.push_back(SchString(name));
+    term_index.clear();
+}
 
+// Single-threaded indexing of every document; with mem_limit the dictionary
+// is flushed as a SPIMI run whenever it grows past the limit.
+static void build_index_serial(const CorpusSource& src, const char* index_file, size_t mem_limit, bool positions) {
+    size_t n = src.size();
+    size_t mem_used = 0;
+    FilePrefetcher* prefetch = src.pack.is_open() ? nullptr : new FilePrefetcher(src.files, 0, n);
+    size_t released = src.pack.is_open() && n ? src.pack.text_offset(0) : 0;
+    for (size_t i = 0; i < n; ++i) {
+        size_t len = 0;
+        char* content;
+        if (prefetch) {
+            content = prefetch->take(i, &len);
+        } else {
+            content = src.pack.text(i);
+            len = src.pack.text_len(i);
+        }
+        if (content && len) mem_used += index_text(content, len, (int)i, term_index, stem_cache, positions);
+        if (!prefetch && src.pack.text_offset(i) + len - released >= SCH_PACK_RELEASE) {
+            src.pack.release(released, src.pack.text_offset(i) + len);
+            released = src.pack.text_offset(i) + len;
+        }
+        if (mem_limit && mem_used >= mem_limit) { flush_run(index_file); mem_used = 0; }
+        if ((i + 1) % 2000 == 0) fprintf(stderr, "Processed %zu files...\n", i + 1);
+    }
+    delete prefetch;
+    if (mem_limit && (term_index.terms.size() > 0 || spimi_runs.size() == 0)) flush_run(index_file);
+}
+
+struct RunCursor {
+    FILE* f;
+    std::string term;
+    size_t freq;
+    size_t list_size;
+};
+
+static bool run_next(RunCursor& c) {
+    size_t len = 0;
+    if (fread(&len, sizeof(len), 1, c.f) != 1) return false;
+    c.term.resize(len);
+    if (len && fread(&c.term[0], 1, len, c.f) != len) return false;
+    if (fread(&c.freq, sizeof(c.freq), 1, c.f) != 1) return false;
+    return fread(&c.list_size, sizeof(c.list_size), 1, c.f) == 1;
+}
+
+// Heap order: term first, then run number, so equal terms pop in doc-id order.
+static bool run_less(const RunCursor* runs, int a, int b) {
+    int c = std::strcmp(runs[a].term.c_str(), runs[b].term.c_str());
+    return c < 0 || (c == 0 && a < b);
+}
+
+static void heap_push(SchVector<int>& heap, const RunCursor* runs, int v) {
+    heap.push_back(v);
+    size_t i = heap.size() - 1;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!run_less(runs, heap[i], heap[parent])) break;
+        int tmp = heap[i]; heap[i] = heap[parent]; heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static int heap_pop(SchVector<int>& heap, const RunCursor* runs) {
+    int top = heap[0];
+    heap[0] = heap[heap.size() - 1];
+    size_t n = heap.size() - 1;
+    size_t i = 0;
+    while (true) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && run_less(runs, heap[l], heap[m])) m = l;
+        if (r < n && run_less(runs, heap[r], heap[m])) m = r;
+        if (m == i) break;
+        int tmp = heap[i]; heap[i] = heap[m]; heap[m] = tmp;
+        i = m;
+    }
+    heap.pop_back();
+    return top;
+}
+
+void merge_runs(const char* filename) {
+    size_t nruns = spimi_runs.size();
+    RunCursor* runs = new RunCursor[nruns];
+    SchVector<int> heap;
+    for (size_t r = 0; r < nruns; ++r) {
+        runs[r].f = fopen(spimi_runs[r].c_str(), "rb");
+        if (!runs[r].f) { fprintf(stderr, "Error: cannot open run %s\n", spimi_runs[r].c_str()); exit(1); }
+        setvbuf(runs[r].f, nullptr, _IOFBF, 1 << 20);
+        if (run_next(runs[r])) heap_push(heap, runs, (int)r);
+    }
+
+    FILE* out = fopen(filename, "wb");
+    if (!out) { fprintf(stderr, "Error: cannot open %s for writing\n", filename); exit(1); }
+    setvbuf(out, nullptr, _IOFBF, 1 << 20);
+
+    size_t docs_count = all_doc_names.size();
+    fwrite(&docs_count, sizeof(docs_count), 1, out);
+    for (size_t i = 0; i < docs_count; ++i) {
+        size_t len = all_doc_names[i].size();
+        fwrite(&len, sizeof(len), 1, out);
+        fwrite(all_doc_names[i].c_str(), 1, len, out);
+    }
+
+    long vocab_pos = ftell(out);
+    size_t vocab_size = 0;
+    fwrite(&vocab_size, sizeof(vocab_size), 1, out);
+
+    SchVector<int> group;
+    int chunk[4096];
+    while (heap.size() > 0) {
+        group.clear();
+        group.push_back(heap_pop(heap, runs));
+        const std::string term = runs[group[0]].term;
+        while (heap.size() > 0 && runs[heap[0]].term == term) group.push_back(heap_pop(heap, runs));
+
+        size_t total = 0, freq = 0;
+        for (size_t g = 0; g < group.size(); ++g) {
+            total += runs[group[g]].list_size;
+            freq += runs[group[g]].freq;
+        }
         size_t term_len = term.size();
         fwrite(&term_len, sizeof(term_len), 1, out);
         fwrite(term.c_str(), 1, term_len, out);
+        fwrite(&total, sizeof(total), 1, out);
+        for (size_t g = 0; g < group.size(); ++g) {
+            RunCursor& c = runs[group[g]];
+            size_t left = c.list_size;
+            while (left > 0) {
+                size_t n = left < 4096 ? left : 4096;
+                if (fread(chunk, sizeof(int), n, c.f) != n) { fprintf(stderr, "Error: truncated run file\n"); exit(1); }
+                fwrite(chunk, sizeof(int), n, out);
+                left -= n;
+            }
+        }
+        bool inserted = false;
+        uint32_t id = term_index.add_term(term.c_str(), term.size(), &inserted);
+        term_index.freqs[id] = (int)freq;
+        vocab_size++;
 
-        size_t list_size = plist->doc_ids.size();
-        fwrite(&list_size, sizeof(list_size), 1, out);
-        for (size_t j = 0; j < list_size; ++j) {
-            int did = plist->doc_ids[j];
-            fwrite(&did, sizeof(did), 1, out);
+        for (size_t g = 0; g < group.size(); ++g) {
+            if (run_next(runs[group[g]])) heap_push(heap, runs, group[g]);
         }
     }
+
+    fseek(out, vocab_pos, SEEK_SET);
+    fwrite(&vocab_size, sizeof(vocab_size), 1, out);
     fclose(out);
+
+    for (size_t r = 0; r < nruns; ++r) {
+        fclose(runs[r].f);
+        std::remove(spimi_runs[r].c_str());
+    }
+    delete[] runs;
 }
 
-void export_zipf(const char* filename) {
-    SchVector<SchString> keys = term_frequencies.get_keys();
-    SchVector< SchPair<SchString,int> > arr;
+static void write_padding(FILE* out, size_t written, size_t target) {
+    static const char zeros[8] = {0};
+    if (target > written) fwrite(zeros, 1, target - written, out);
+}
+
+// Raw lists longer than one block are preceded by the last id of each block.
+static size_t raw_skip_count(size_t n) {
+    size_t nblocks = sch_block_count(n);
+    return nblocks > 1 ? nblocks : 0;
+}
+
+// The sections of a run of consecutive terms (in sorted order), encoded on
+// their own. Offsets start at zero in each chunk until rebase_chunks() moves
+// them to their place in the file.
+struct EncodedChunk {
+    size_t first, last;
+    SchVector<SchTermEntry> dict;
+    SchVector<SchTermStats> stats;
+    SchVector<uint64_t> pos_offsets;
+    SchVector<unsigned char> encoded;
+    SchVector<unsigned char> freqs;
+    SchVector<float> block_max;
+    SchVector<unsigned char> positions;
+    size_t postings_size;
+    size_t postings_pad, positions_pad;
+};
+
+static void encode_chunk(const SchVector<uint32_t>& keys, EncodedChunk& c, const IndexFormat& fmt, size_t docs_count, float avg_len) {
+    c.postings_size = 0;
+    for (size_t i = c.first; i < c.last; ++i) {
+        PostingList* plist = &term_index.postings[keys[i]];
+        SchTermStats st;
+        st.freqs_offset = sch_encode_freqs(plist->tfs.begin(), plist->tfs.size(), c.freqs);
+        st.block_max_offset = c.block_max.size() * sizeof(float);
+        st.max_score = 0;
+        st.max_tf = 0;
+        float idf = sch_bm25_idf(docs_count, plist->doc_ids.size());
+        for (size_t j = 0; j < plist->doc_ids.size(); ++j) {
+            if (j % SCH_BLOCK_SIZE == 0) c.block_max.push_back(0);
+            float sc = sch_bm25(idf, (uint32_t)plist->tfs[j], all_doc_lens[(size_t)plist->doc_ids[j]], avg_len) * SCH_BM25_BOUND_SLACK;
+            float& bm = c.block_max[c.block_max.size() - 1];
+            if (sc > bm) bm = sc;
+            if (sc > st.max_score) st.max_score = sc;
+            if ((uint32_t)plist->tfs[j] > st.max_tf) st.max_tf = (uint32_t)plist->tfs[j];
+        }
+        c.stats.push_back(st);
+        if (fmt.positions) c.pos_offsets.push_back(sch_encode_positions(plist->tfs.begin(), plist->tfs.size(), plist->positions.begin(), c.positions));
+        SchTermEntry e;
+        e.reserved = 0;
+        e.doc_freq = (uint32_t)plist->doc_ids.size();
+        e.postings_offset = fmt.compress ? sch_encode_postings(plist->doc_ids.begin(), plist->doc_ids.size(), c.encoded) : c.postings_size;
+        c.dict.push_back(e);
+        if (fmt.compress) c.postings_size = c.encoded.size();
+        else c.postings_size += (raw_skip_count(e.doc_freq) + (size_t)e.doc_freq) * sizeof(int32_t);
+    }
+}
+
+// Splits the sorted terms into chunks of about target postings. A chunk other
+// than the first starts with a list of more than one block: such a list is
+// 4-byte aligned in the postings and positions sections whatever precedes it,
+// so each chunk encodes to the same bytes it would get in one serial pass once
+// it is padded to its place.
+static void plan_chunks(const SchVector<uint32_t>& keys, size_t target, SchVector<EncodedChunk>& chunks) {
+    size_t first = 0, acc = 0;
     for (size_t i = 0; i < keys.size(); ++i) {
-        int* f = term_frequencies.get(keys[i]);
-        if (f) arr.push_back(SchPair<SchString,int>(keys[i], *f));
+        size_t df = term_index.postings[keys[i]].doc_ids.size();
+        if (acc >= target && df > SCH_BLOCK_SIZE) {
+            chunks.emplace_back();
+            chunks[chunks.size() - 1].first = first;
+            chunks[chunks.size() - 1].last = i;
+            first = i;
+            acc = 0;
+        }
+        acc += df;
+    }
+    chunks.emplace_back();
+    chunks[chunks.size() - 1].first = first;
+    chunks[chunks.size() - 1].last = keys.size();
+}
+
+static size_t pad4(size_t n) { return (4 - n % 4) % 4; }
+
+// Moves chunk-relative offsets to file section offsets; returns the postings
+// and fills the other section sizes.
+static size_t rebase_chunks(SchVector<EncodedChunk>& chunks, const IndexFormat& fmt, size_t* freqs_size, size_t* block_max_count, size_t* positions_size) {
+    size_t postings = 0, freqs = 0, block_max = 0, positions = 0;
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        EncodedChunk& c = chunks[k];
+        c.postings_pad = fmt.compress ? pad4(postings) : 0;
+        c.positions_pad = fmt.positions ? pad4(positions) : 0;
+        postings += c.postings_pad;
+        positions += c.positions_pad;
+        for (size_t i = 0; i < c.dict.size(); ++i) {
+            c.dict[i].postings_offset += postings;
+            c.stats[i].freqs_offset += freqs;
+            c.stats[i].block_max_offset += block_max * sizeof(float);
+            if (fmt.positions) c.pos_offsets[i] += positions;
+        }
+        postings += c.postings_size;
+        freqs += c.freqs.size();
+        block_max += c.block_max.size();
+        positions += c.positions.size();
+    }
+    *freqs_size = freqs;
+    *block_max_count = block_max;
+    *positions_size = positions;
+    return postings;
+}
+
+static void write_zeros(FILE* out, size_t n) {
+    static const char zeros[64] = {0};
+    while (n) {
+        size_t k = n < sizeof(zeros) ? n : sizeof(zeros);
+        fwrite(zeros, 1, k, out);
+        n -= k;
+    }
+}
+
+void save_mapped_index(const char* filename, const IndexFormat& fmt) {
+    SchVector<uint32_t> keys = sorted_term_ids(term_index);
+
+    size_t docs_count = all_doc_names.size();
+    size_t vocab_size = keys.size();
+
+    SchDocStats doc_stats;
+    std::memset(&doc_stats, 0, sizeof(doc_stats));
+    for (size_t i = 0; i < docs_count; ++i) doc_stats.total_len += all_doc_lens[i];
+    double total_len = (double)doc_stats.total_len;
+    float avg_len = sch_avg_doc_len(docs_count ? total_len / docs_count : 0);
+
+    // Lists are encoded by a pool of threads while this one builds the
+    // document table and the front-coded dictionary.
+    size_t total_postings = 0;
+    for (size_t i = 0; i < vocab_size; ++i) total_postings += term_index.postings[i].doc_ids.size();
+    size_t nthreads = save_threads > 0 ? (size_t)save_threads : (size_t)std::thread::hardware_concurrency();
+    if (nthreads == 0) nthreads = 1;
+    size_t target = total_postings / (nthreads * 8);
+    if (target < (1 << 16)) target = 1 << 16;
+    SchVector<EncodedChunk> chunks;
+    plan_chunks(keys, target, chunks);
+    if (nthreads > chunks.size()) nthreads = chunks.size();
+    std::atomic<size_t> next_chunk(0);
+    auto encode_all = [&]() {
+        for (size_t k; (k = next_chunk.fetch_add(1)) < chunks.size(); ) encode_chunk(keys, chunks[k], fmt, docs_count, avg_len);
+    };
+    SchVector<std::thread> workers;
+    for (size_t t = 1; t < nthreads; ++t) workers.emplace_back(encode_all);
+
+    SchIndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SCH_INDEX_MAGIC, sizeof(header.magic));
+    header.version = SCH_INDEX_VERSION;
+    header.doc_count = docs_count;
+    header.vocab_size = vocab_size;
+    header.flags = SCH_FLAG_FRONT_CODED;
+    if (fmt.compress) header.flags |= SCH_FLAG_BLOCK_CODEC | SCH_FLAG_BLOCK_EXCEPTIONS;
+    else header.flags |= SCH_FLAG_SKIPS;
+
+    SchVector<SchDocEntry> docs;
+    size_t names_size = 0;
+    for (size_t i = 0; i < docs_count; ++i) {
+        SchDocEntry d;
+        d.name_offset = names_size;
+        d.name_len = (uint32_t)all_doc_names[i].size();
+        d.reserved = 0;
+        docs.push_back(d);
+        names_size += d.name_len + 1;
+    }
+    SchFrontCoder terms;
+    for (size_t i = 0; i < vocab_size; ++i) terms.add(term_index.terms.term(keys[i]), term_index.terms.length(keys[i]));
+
+    encode_all();
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+
+    size_t freqs_size, block_max_count, positions_size;
+    size_t postings_size = rebase_chunks(chunks, fmt, &freqs_size, &block_max_count, &positions_size);
+    if (fmt.compress) postings_size += SCH_CODEC_SLACK;
+    freqs_size += SCH_CODEC_SLACK;
+    header.flags |= SCH_FLAG_SCORES;
+    int last_section = SCH_SEC_BLOCK_MAX;
+    if (fmt.positions) {
+        header.flags |= SCH_FLAG_POSITIONS;
+        last_section = SCH_SEC_POSITIONS;
+    }
+
+    size_t sizes[SCH_SEC_DOC_STATS + 1] = {
+        docs_count * sizeof(SchDocEntry), names_size,
+        vocab_size * sizeof(SchTermEntry), terms.bytes.size(), postings_size,
+        docs_count * sizeof(uint32_t), vocab_size * sizeof(SchTermStats), freqs_size, block_max_count * sizeof(float),
+        (fmt.positions ? vocab_size : 0) * sizeof(uint64_t), positions_size, terms.offsets.size() * sizeof(uint64_t),
+        sizeof(SchDocStats)
+    };
+    size_t pos = sch_align8(sizeof(header));
+    for (int s = SCH_SEC_DOCS; s <= SCH_SEC_DOC_STATS; ++s) {
+        if (s > last_section && s < SCH_SEC_TERM_BLOCKS) continue;
+        header.sections[s].offset = pos;
+        header.sections[s].size = sizes[s];
+        pos = sch_align8(pos + sizes[s]);
     }
-    auto comp = [](const SchPair<SchString,int>& a, const SchPair<SchString,int>& b){ return a.value > b.value; };
-    if (arr.size() > 1) quicksort< SchPair<SchString,int>, decltype(comp) >(arr, 0, (int)arr.size() - 1, comp);
+    header.file_size = pos;
+
+    FILE* out = fopen(filename, "wb");
+    if (!out) { fprintf(stderr, "Error: cannot open %s for writing\n", filename); exit(1); }
+    setvbuf(out, nullptr, _IOFBF, SCH_WRITE_BUFFER);
+
+    fwrite(&header, sizeof(header), 1, out);
+    write_padding(out, sizeof(header), header.sections[SCH_SEC_DOCS].offset);
+    if (docs_count) fwrite(docs.begin(), sizeof(SchDocEntry), docs_count, out);
+    write_padding(out, header.sections[SCH_SEC_DOCS].offset + sizes[SCH_SEC_DOCS], header.sections[SCH_SEC_DOC_NAMES].offset);
+    for (size_t i = 0; i < docs_count; ++i) {
+        fwrite(all_doc_names[i].c_str(), 1, all_doc_names[i].size() + 1, out);
+    }
+    write_padding(out, header.sections[SCH_SEC_DOC_NAMES].offset + names_size, header.sections[SCH_SEC_DICT].offset);
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        if (chunks[k].dict.size()) fwrite(chunks[k].dict.begin(), sizeof(SchTermEntry), chunks[k].dict.size(), out);
+    }
+    write_padding(out, header.sections[SCH_SEC_DICT].offset + sizes[SCH_SEC_DICT], header.sections[SCH_SEC_TERMS].offset);
+    if (terms.bytes.size()) fwrite(terms.bytes.begin(), 1, terms.bytes.size(), out);
+    write_padding(out, header.sections[SCH_SEC_TERMS].offset + sizes[SCH_SEC_TERMS], header.sections[SCH_SEC_POSTINGS].offset);
+    if (fmt.compress) {
+        for (size_t k = 0; k < chunks.size(); ++k) {
+            write_zeros(out, chunks[k].postings_pad);
+            if (chunks[k].encoded.size()) fwrite(chunks[k].encoded.begin(), 1, chunks[k].encoded.size(), out);
+        }
+        write_zeros(out, SCH_CODEC_SLACK);
+    } else {
+        SchVector<int32_t> skips;
+        for (size_t i = 0; i < vocab_size; ++i) {
+            SchVector<int>& ids = term_index.postings[keys[i]].doc_ids;
+            size_t nskips = raw_skip_count(ids.size());
+            skips.clear();
+            for (size_t b = 0; b < nskips; ++b) {
+                size_t last = (b + 1) * SCH_BLOCK_SIZE - 1;
+                skips.push_back(ids[last < ids.size() ? last : ids.size() - 1]);
+            }
+            if (nskips) fwrite(skips.begin(), sizeof(int32_t), nskips, out);
+            fwrite(ids.begin(), sizeof(int32_t), ids.size(), out);
+        }
+    }
+    write_padding(out, header.sections[SCH_SEC_POSTINGS].offset + postings_size, header.sections[SCH_SEC_DOC_LENS].offset);
+    if (docs_count) fwrite(all_doc_lens.begin(), sizeof(uint32_t), docs_count, out);
+    write_padding(out, header.sections[SCH_SEC_DOC_LENS].offset + sizes[SCH_SEC_DOC_LENS], header.sections[SCH_SEC_TERM_STATS].offset);
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        if (chunks[k].stats.size()) fwrite(chunks[k].stats.begin(), sizeof(SchTermStats), chunks[k].stats.size(), out);
+    }
+    write_padding(out, header.sections[SCH_SEC_TERM_STATS].offset + sizes[SCH_SEC_TERM_STATS], header.sections[SCH_SEC_FREQS].offset);
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        if (chunks[k].freqs.size()) fwrite(chunks[k].freqs.begin(), 1, chunks[k].freqs.size(), out);
+    }
+    write_zeros(out, SCH_CODEC_SLACK);
+    write_padding(out, header.sections[SCH_SEC_FREQS].offset + sizes[SCH_SEC_FREQS], header.sections[SCH_SEC_BLOCK_MAX].offset);
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        if (chunks[k].block_max.size()) fwrite(chunks[k].block_max.begin(), sizeof(float), chunks[k].block_max.size(), out);
+    }
+    if (fmt.positions) {
+        write_padding(out, header.sections[SCH_SEC_BLOCK_MAX].offset + sizes[SCH_SEC_BLOCK_MAX], header.sections[SCH_SEC_POS_OFFSETS].offset);
+        for (size_t k = 0; k < chunks.size(); ++k) {
+            if (chunks[k].pos_offsets.size()) fwrite(chunks[k].pos_offsets.begin(), sizeof(uint64_t), chunks[k].pos_offsets.size(), out);
+        }
+        write_padding(out, header.sections[SCH_SEC_POS_OFFSETS].offset + sizes[SCH_SEC_POS_OFFSETS], header.sections[SCH_SEC_POSITIONS].offset);
+        for (size_t k = 0; k < chunks.size(); ++k) {
+            write_zeros(out, chunks[k].positions_pad);
+            if (chunks[k].positions.size()) fwrite(chunks[k].positions.begin(), 1, chunks[k].positions.size(), out);
+        }
+    }
+    write_padding(out, header.sections[last_section].offset + sizes[last_section], header.sections[SCH_SEC_TERM_BLOCKS].offset);
+    if (terms.offsets.size()) fwrite(terms.offsets.begin(), sizeof(uint64_t), terms.offsets.size(), out);
+    write_padding(out, header.sections[SCH_SEC_TERM_BLOCKS].offset + sizes[SCH_SEC_TERM_BLOCKS], header.sections[SCH_SEC_DOC_STATS].offset);
+    fwrite(&doc_stats, sizeof(doc_stats), 1, out);
+    write_padding(out, header.sections[SCH_SEC_DOC_STATS].offset + sizes[SCH_SEC_DOC_STATS], header.file_size);
+    fclose(out);
+}
+
+// Terms by frequency, most frequent first; equal frequencies keep first-seen
+// order. Terms are printed straight from the interner.
+void export_zipf(const char* filename) {
+    size_t n = term_index.terms.size();
+    SchVector<uint32_t> keys;
+    SchVector<uint32_t> ids;
+    keys.reserve(n);
+    ids.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys.push_back(~(uint32_t)term_index.freqs[i]);
+        ids.push_back((uint32_t)i);
+    }
+    sch_sort_by_key(ids, keys.begin());
 
     FILE* out = fopen(filename, "w");
     if (!out) { fprintf(stderr, "Error: cannot open %s for writing\n", filename); return; }
+    setvbuf(out, nullptr, _IOFBF, SCH_WRITE_BUFFER);
     fprintf(out, "Term,Frequency\n");
-    for (size_t i = 0; i < arr.size(); ++i) {
-        fprintf(out, "%s,%d\n", arr[i].key.c_str(), arr[i].value);
+    for (size_t i = 0; i < n; ++i) {
+        fprintf(out, "%s,%d\n", term_index.terms.term(ids[i]), term_index.freqs[ids[i]]);
     }
     fclose(out);
 }
@@ -167,36 +903,716 @@ SchVector<SchString> list_txt_files(const char* dirpath) {
     return files;
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        fprintf(stderr, "Usage: %s <corpus_dir> <output_index_file>\n", argv[0]);
-        return 1;
+// --reorder: renumbers the built documents by recursive graph bisection over
+// their terms (include/sch_reorder.h) so that similar documents get nearby ids.
+// Terms of a single document cannot bring documents together and are left
+// out of the forward index. The doc-name, length and file tables and every
+// posting list, with its tfs and positions, are permuted to the new ids.
+static void reorder_documents(int threads) {
+    size_t ndocs = all_doc_names.size(), nterms = term_index.postings.size();
+    if (ndocs < 2) return;
+    SchVector<uint32_t> offsets;
+    offsets.resize(ndocs + 1);
+    for (size_t d = 0; d <= ndocs; ++d) offsets[d] = 0;
+    uint32_t* off = offsets.begin();
+    for (size_t t = 0; t < nterms; ++t) {
+        const PostingList& p = term_index.postings[t];
+        if (p.doc_ids.size() < 2) continue;
+        for (size_t i = 0; i < p.doc_ids.size(); ++i) off[p.doc_ids.at_unchecked(i) + 1]++;
+    }
+    for (size_t d = 0; d < ndocs; ++d) off[d + 1] += off[d];
+    SchVector<uint32_t> fwd, fill;
+    fwd.resize(off[ndocs]);
+    fill.resize(ndocs);
+    std::memcpy(fill.begin(), off, ndocs * sizeof(uint32_t));
+    for (size_t t = 0; t < nterms; ++t) {
+        const PostingList& p = term_index.postings[t];
+        if (p.doc_ids.size() < 2) continue;
+        for (size_t i = 0; i < p.doc_ids.size(); ++i) fwd.at_unchecked(fill.at_unchecked((size_t)p.doc_ids.at_unchecked(i))++) = (uint32_t)t;
+    }
+    fill = SchVector<uint32_t>();
+
+    SchVector<uint32_t> order;
+    sch_bisect_order(off, fwd.begin(), ndocs, nterms, threads, order);
+    fwd = SchVector<uint32_t>();
+    SchVector<uint32_t> new_id;
+    new_id.resize(ndocs);
+    for (size_t i = 0; i < ndocs; ++i) new_id[order[i]] = (uint32_t)i;
+
+    SchVector<SchString> names;
+    SchVector<uint32_t> lens;
+    SchVector<SchDocFile> files;
+    names.reserve(ndocs);
+    lens.resize(ndocs);
+    for (size_t i = 0; i < ndocs; ++i) {
+        names.push_back(std::move(all_doc_names[order[i]]));
+        lens[i] = all_doc_lens[order[i]];
+    }
+    for (size_t i = 0; i < all_doc_files.size(); ++i) files.push_back(all_doc_files[order[i]]);
+    all_doc_names = std::move(names);
+    all_doc_lens = std::move(lens);
+    all_doc_files = std::move(files);
+
+    SchVector<uint32_t> keys, idx, pos_start;
+    for (size_t t = 0; t < nterms; ++t) {
+        PostingList& p = term_index.postings[t];
+        size_t n = p.doc_ids.size();
+        if (n == 1) p.doc_ids[0] = (int)new_id[(size_t)p.doc_ids[0]];
+        if (n <= 1) continue;
+        keys.resize(n);
+        idx.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            keys[i] = new_id.at_unchecked((size_t)p.doc_ids.at_unchecked(i));
+            idx[i] = (uint32_t)i;
+        }
+        sch_sort_by_key(idx, keys.begin());
+        PostingList q;
+        q.doc_ids.resize(n);
+        q.tfs.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            q.doc_ids.at_unchecked(i) = (int)keys.at_unchecked(idx.at_unchecked(i));
+            q.tfs.at_unchecked(i) = p.tfs.at_unchecked(idx.at_unchecked(i));
+        }
+        if (p.positions.size()) {
+            pos_start.resize(n);
+            uint32_t at = 0;
+            for (size_t i = 0; i < n; ++i) {
+                pos_start[i] = at;
+                at += (uint32_t)p.tfs.at_unchecked(i);
+            }
+            q.positions.reserve(p.positions.size());
+            for (size_t i = 0; i < n; ++i) {
+                uint32_t j = idx.at_unchecked(i);
+                for (uint32_t k = 0; k < (uint32_t)p.tfs.at_unchecked(j); ++k) q.positions.push_back(p.positions.at_unchecked(pos_start.at_unchecked(j) + k));
+            }
+        }
+        p = std::move(q);
+    }
+}
+
+// Incremental mode. index_builder --append indexes only the corpus files that
+// no live document of the segmented index has (or whose size or mtime differs
+// from the one recorded when the document was indexed) into a new segment,
+// and tombstones live documents whose file is gone or changed, then runs the
+// tiered merges.
+// Builds, appends and merges hold an flock on the directory of the index, so
+// no lock file is left behind; a merge run in the background with
+// --background-merge keeps holding it, so the next append waits for that
+// merge instead of racing it.
+static const size_t SCH_MERGE_FACTOR = 4;
+
+static int lock_index(const char* index_file) {
+    char dir[4096];
+    sch_segment_path(index_file, ".", dir, sizeof(dir));
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || flock(fd, LOCK_EX) != 0) { fprintf(stderr, "Error: cannot lock %s\n", dir); exit(1); }
+    return fd;
+}
+
+static const char* base_name(const char* path) {
+    const char* slash = std::strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static void reset_builder() {
+    term_index.clear();
+    all_doc_names = SchVector<SchString>();
+    all_doc_lens = SchVector<uint32_t>();
+    all_doc_files = SchVector<SchDocFile>();
+}
+
+struct OpenSegment {
+    SchMappedIndex idx;
+    SchVector<uint64_t> deleted;
+    SchVector<SchDocFile> files;
+};
+
+// True when the file at path is not the one doc of seg was read from. A
+// document without a recorded file (a packed corpus, or one that changed
+// while it was read) always counts as changed.
+static bool file_changed(const OpenSegment& seg, size_t doc, const char* path) {
+    struct stat st;
+    if (doc >= seg.files.size() || stat(path, &st) != 0) return true;
+    const SchDocFile& f = seg.files[doc];
+    int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return f.mtime_ns == 0 || f.mtime_ns != mtime || f.size != (uint64_t)(st.st_size > 0 ? st.st_size : 0);
+}
+
+static OpenSegment* open_segments(const char* index_file, const SchManifest& m) {
+    OpenSegment* segs = new OpenSegment[m.segments.size()];
+    for (size_t s = 0; s < m.segments.size(); ++s) {
+        char path[4096];
+        sch_segment_path(index_file, m.segments[s].file.c_str(), path, sizeof(path));
+        if (!segs[s].idx.open(path)) { fprintf(stderr, "Error: cannot open segment %s\n", path); exit(1); }
+        char files[4200];
+        sch_doc_files_path(path, files, sizeof(files));
+        sch_read_doc_files(files, segs[s].idx.doc_count(), segs[s].files);
+        segs[s].deleted.resize((segs[s].idx.doc_count() + 63) / 64);
+        for (size_t i = 0; i < segs[s].deleted.size(); ++i) segs[s].deleted[i] = 0;
+        if (m.segments[s].tombstones.size()) {
+            sch_segment_path(index_file, m.segments[s].tombstones.c_str(), path, sizeof(path));
+            if (!sch_read_tombstones(path, segs[s].idx.doc_count(), segs[s].deleted)) {
+                fprintf(stderr, "Error: cannot read tombstones %s\n", path);
+                exit(1);
+            }
+        }
+    }
+    return segs;
+}
+
+static void remove_index_file(const char* index_file, const char* name) {
+    char path[4096];
+    sch_segment_path(index_file, name, path, sizeof(path));
+    std::remove(path);
+}
+
+static void remove_segment(const char* index_file, const char* name) {
+    char path[4096], files[4200];
+    sch_segment_path(index_file, name, path, sizeof(path));
+    sch_doc_files_path(path, files, sizeof(files));
+    std::remove(path);
+    std::remove(files);
+}
+
+// Writes all_doc_files next to the index at path, or removes a stale table
+// when the documents were not read from files.
+static void save_doc_files(const char* path) {
+    char files[4200];
+    sch_doc_files_path(path, files, sizeof(files));
+    if (!all_doc_names.size() || all_doc_files.size() != all_doc_names.size()) {
+        std::remove(files);
+        return;
+    }
+    if (!sch_write_doc_files(files, all_doc_files)) { fprintf(stderr, "Error: cannot write %s\n", files); exit(1); }
+}
+
+// Publishes m as the next generation, then deletes the files the previous
+// generation used and the new one does not. index_file itself is never
+// deleted: tools that take a plain mapped index keep finding one there.
+static void publish_manifest(const char* index_file, const SchManifest& old_m, SchManifest& m) {
+    m.generation = old_m.generation + 1;
+    if (!sch_write_manifest(index_file, m)) { fprintf(stderr, "Error: cannot write the manifest of %s\n", index_file); exit(1); }
+    for (size_t i = 0; i < old_m.segments.size(); ++i) {
+        const SchSegmentInfo& o = old_m.segments[i];
+        bool file_used = std::strcmp(o.file.c_str(), base_name(index_file)) == 0, tomb_used = o.tombstones.size() == 0;
+        for (size_t j = 0; j < m.segments.size(); ++j) {
+            if (m.segments[j].file == o.file) file_used = true;
+            if (!tomb_used && m.segments[j].tombstones == o.tombstones) tomb_used = true;
+        }
+        if (!file_used) remove_segment(index_file, o.file.c_str());
+        if (!tomb_used) remove_index_file(index_file, o.tombstones.c_str());
+    }
+}
+
+// A full build replaces whatever segmented index was at index_file.
+static void drop_segments(const char* index_file) {
+    SchManifest m;
+    if (!sch_read_manifest(index_file, m)) return;
+    for (size_t i = 0; i < m.segments.size(); ++i) {
+        remove_segment(index_file, m.segments[i].file.c_str());
+        if (m.segments[i].tombstones.size()) remove_index_file(index_file, m.segments[i].tombstones.c_str());
+    }
+    char path[4096];
+    sch_manifest_path(index_file, path, sizeof(path));
+    std::remove(path);
+}
+
+// The manifest of index_file; a plain mapped index there becomes its first
+// segment.
+static SchManifest load_manifest(const char* index_file) {
+    SchManifest m;
+    if (sch_read_manifest(index_file, m)) return m;
+    SchMappedIndex base;
+    if (base.open(index_file)) {
+        SchSegmentInfo s;
+        s.file = SchString(base_name(index_file));
+        s.doc_count = base.doc_count();
+        s.deleted = 0;
+        m.segments.push_back(s);
+    } else if (sch_file_has_index_magic(index_file)) {
+        fprintf(stderr, "Error: %s is a mapped index of an unsupported version, with unknown flags or corrupt\n", index_file);
+        exit(1);
+    } else if (access(index_file, F_OK) == 0) {
+        fprintf(stderr, "Error: %s is a legacy index; rebuild it with --format mapped or --compress before appending\n", index_file);
+        exit(1);
+    }
+    return m;
+}
+
+// After a merge into a single segment, that segment also replaces index_file
+// (hard link to a temporary name, then rename), its file table is linked next
+// to it, and the next generation lists it under that name. The merged segment is published first, so readers of
+// the older generation never lose the inputs they are opening; a reader that
+// opens index_file from an older manifest sees a doc count that does not
+// match and rereads the manifest.
+static void replace_base(const char* index_file, SchManifest& m) {
+    char seg[4096], tmp[4200], seg_files[4200], base_files[4200];
+    sch_segment_path(index_file, m.segments[0].file.c_str(), seg, sizeof(seg));
+    sch_doc_files_path(seg, seg_files, sizeof(seg_files));
+    sch_doc_files_path(index_file, base_files, sizeof(base_files));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", index_file);
+    std::remove(tmp);
+    std::remove(base_files);
+    if (link(seg, tmp) != 0 || std::rename(tmp, index_file) != 0) {
+        std::remove(tmp);
+        return;
+    }
+    link(seg_files, base_files);
+    SchManifest next = m;
+    next.segments[0].file = SchString(base_name(index_file));
+    publish_manifest(index_file, m, next);
+    m = next;
+}
+
+// A segmented index keeps the block codec or positions only while every
+// segment has them: merges write what all their inputs share and appends
+// write what all existing segments share.
+static IndexFormat common_format(const OpenSegment* segs, size_t first, size_t count) {
+    IndexFormat fmt;
+    fmt.compress = fmt.positions = true;
+    for (size_t s = first; s < first + count; ++s) {
+        fmt.compress = fmt.compress && segs[s].idx.compressed();
+        fmt.positions = fmt.positions && segs[s].idx.has_positions();
+    }
+    return fmt;
+}
+
+// Rewrites segments [first, first + count) as one segment without their
+// deleted documents. Postings are decoded back into the builder dictionary in
+// segment order, so doc ids stay sorted and save_mapped_index() writes what a
+// full build over the same documents would write.
+static void merge_segments(const char* index_file, SchManifest& m, size_t first, size_t count) {
+    OpenSegment* segs = open_segments(index_file, m);
+    reset_builder();
+    IndexFormat fmt = common_format(segs, first, count);
+    bool files = false;
+    for (size_t s = first; s < first + count; ++s) files = files || segs[s].files.size();
+    PostingList merged;
+    for (size_t s = first; s < first + count; ++s) {
+        const SchMappedIndex& seg = segs[s].idx;
+        SchVector<int> remap;
+        for (size_t d = 0; d < seg.doc_count(); ++d) {
+            if (sch_is_deleted(segs[s].deleted, d)) { remap.push_back(-1); continue; }
+            remap.push_back((int)all_doc_names.size());
+            all_doc_names.push_back(SchString(seg.doc_name(d)));
+            all_doc_lens.push_back(seg.doc_len(d));
+            if (files) all_doc_files.push_back(d < segs[s].files.size() ? segs[s].files[d] : SchDocFile());
+        }
+        for (size_t t = 0; t < seg.vocab_size(); ++t) {
+            merged.doc_ids.clear();
+            merged.tfs.clear();
+            merged.positions.clear();
+            SchPostingReader r(seg.postings(t));
+            const unsigned char* fq = seg.freqs(t);
+            const unsigned char* pp = seg.has_positions() ? sch_positions_stream(seg, t) : nullptr;
+            const int32_t* ids = nullptr;
+            size_t n = 0, j = 0;
+            while (r.next_block(&ids, &n)) {
+                for (size_t k = 0; k < n; ++k, ++j) {
+                    int doc = remap[(size_t)ids[k]];
+                    uint32_t tf = sch_freq_at(fq, j);
+                    if (doc >= 0) {
+                        merged.doc_ids.push_back(doc);
+                        merged.tfs.push_back((int)tf);
+                    }
+                    if (!pp) continue;
+                    uint32_t c = sch_varint_get(pp);
+                    int32_t prev = 0;
+                    for (uint32_t p = 0; p < c; ++p) {
+                        prev += (int32_t)sch_varint_get(pp);
+                        if (doc >= 0 && fmt.positions) merged.positions.push_back(prev);
+                    }
+                }
+            }
+            if (merged.doc_ids.size() == 0) continue;
+            SchString term = seg.term_at(t);
+            bool inserted = false;
+            uint32_t id = term_index.add_term(term.c_str(), term.size(), &inserted);
+            PostingList& pl = term_index.postings[id];
+            for (size_t i = 0; i < merged.doc_ids.size(); ++i) {
+                pl.doc_ids.push_back(merged.doc_ids[i]);
+                pl.tfs.push_back(merged.tfs[i]);
+                term_index.freqs[id] += merged.tfs[i];
+            }
+            for (size_t i = 0; i < merged.positions.size(); ++i) pl.positions.push_back(merged.positions[i]);
+        }
+    }
+    delete[] segs;
+
+    char name[1024], path[4096];
+    snprintf(name, sizeof(name), "%s.seg%llu", base_name(index_file), (unsigned long long)m.next_segment);
+    sch_segment_path(index_file, name, path, sizeof(path));
+    save_mapped_index(path, fmt);
+    if (!sch_sync_file(path)) { fprintf(stderr, "Error: cannot sync %s\n", path); exit(1); }
+    save_doc_files(path);
+    SchManifest next;
+    next.next_segment = m.next_segment + 1;
+    for (size_t s = 0; s < m.segments.size(); ++s) {
+        if (s == first) {
+            SchSegmentInfo info;
+            info.file = SchString(name);
+            info.doc_count = all_doc_names.size();
+            info.deleted = 0;
+            next.segments.push_back(info);
+        }
+        if (s < first || s >= first + count) next.segments.push_back(m.segments[s]);
+    }
+    fprintf(stderr, "Merged %zu segments into %s (%zu documents)\n", count, name, all_doc_names.size());
+    publish_manifest(index_file, m, next);
+    m = next;
+    reset_builder();
+    if (m.segments.size() == 1) replace_base(index_file, m);
+}
+
+// Tiered policy: a segment's tier is the base-SCH_MERGE_FACTOR logarithm of
+// its live documents. SCH_MERGE_FACTOR adjacent segments of one tier merge
+// into a segment of the next tier, so every document is rewritten about
+// log(n) times however many appends there are. A segment that is more than
+// half deleted is rewritten on its own.
+static bool pick_merge(const SchManifest& m, size_t* first, size_t* count) {
+    size_t nseg = m.segments.size();
+    for (size_t s = 0; s < nseg; ++s) {
+        if (m.segments[s].deleted * 2 > m.segments[s].doc_count) { *first = s; *count = 1; return true; }
+    }
+    SchVector<int> tiers;
+    for (size_t s = 0; s < nseg; ++s) {
+        size_t live = m.segments[s].doc_count - m.segments[s].deleted;
+        int tier = 0;
+        while (live >= SCH_MERGE_FACTOR) { live /= SCH_MERGE_FACTOR; ++tier; }
+        tiers.push_back(tier);
+    }
+    for (size_t s = 0; s + SCH_MERGE_FACTOR <= nseg; ++s) {
+        size_t run = 1;
+        while (run < SCH_MERGE_FACTOR && tiers[s + run] == tiers[s]) ++run;
+        if (run == SCH_MERGE_FACTOR) { *first = s; *count = run; return true; }
+    }
+    return false;
+}
+
+static void run_merges(const char* index_file, bool merge_all) {
+    SchManifest m = load_manifest(index_file);
+    size_t first = 0, count = 0;
+    if (merge_all) {
+        size_t deleted = 0;
+        for (size_t s = 0; s < m.segments.size(); ++s) deleted += m.segments[s].deleted;
+        if (m.segments.size() > 1 || deleted) merge_segments(index_file, m, 0, m.segments.size());
+        return;
+    }
+    while (pick_merge(m, &first, &count)) merge_segments(index_file, m, first, count);
+}
+
+// --background-merge: the tiered merges run in a child in its own session,
+// with stdin on /dev/null and its output appended to <index>.merge.log. The
+// child inherits the locked descriptor and holds the lock until it is done.
+static void merge_in_background(const char* index_file) {
+    char log[4096];
+    snprintf(log, sizeof(log), "%s.merge.log", index_file);
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) { fprintf(stderr, "Error: cannot start the background merge\n"); exit(1); }
+    if (pid > 0) {
+        fprintf(stderr, "Merging in the background (pid %d), log in %s\n", (int)pid, log);
+        return;
+    }
+    setsid();
+    int in = open("/dev/null", O_RDONLY);
+    int out = open(log, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (in < 0 || out < 0) _exit(1);
+    dup2(in, STDIN_FILENO);
+    dup2(out, STDOUT_FILENO);
+    dup2(out, STDERR_FILENO);
+    close(in);
+    close(out);
+    run_merges(index_file, false);
+    fflush(nullptr);
+    _exit(0);
+}
+
+// Returns true when the index changed.
+static bool append_segment(const char* corpus_dir, const char* index_file, IndexFormat fmt, int threads) {
+    SchManifest m = load_manifest(index_file);
+    OpenSegment* segs = open_segments(index_file, m);
+
+    if (m.segments.size()) {
+        IndexFormat have = common_format(segs, 0, m.segments.size());
+        if ((fmt.compress && !have.compress) || (fmt.positions && !have.positions)) {
+            fprintf(stderr, "Warning: %s has segments without %s; the new segment leaves it out (rebuild the index to add it)\n",
+                    index_file, fmt.compress && !have.compress ? "the block codec" : "positions");
+        }
+        fmt = have;
+    }
+
+    SchStringHashMap<uint64_t> live;
+    SchVector< SchVector<unsigned char> > seen;
+    seen.resize(m.segments.size());
+    for (size_t s = 0; s < m.segments.size(); ++s) {
+        const SchMappedIndex& seg = segs[s].idx;
+        seen[s].resize(seg.doc_count());
+        for (size_t d = 0; d < seg.doc_count(); ++d) {
+            seen[s][d] = 0;
+            if (!sch_is_deleted(segs[s].deleted, d)) live.insert(seg.doc_name(d), std::strlen(seg.doc_name(d)), ((uint64_t)s << 32) | d);
+        }
     }
-    const char* corpus_dir = argv[1];
-    const char* index_file = argv[2];
 
     SchVector<SchString> files = list_txt_files(corpus_dir);
     sort_schstring_vector(files);
-
-    int doc_id_counter = 0;
+    SchVector<SchString> added;
+    SchVector<unsigned char> touched;
+    touched.resize(m.segments.size());
+    for (size_t s = 0; s < touched.size(); ++s) touched[s] = 0;
     for (size_t i = 0; i < files.size(); ++i) {
-        const char* path = files[i].c_str();
-        const char* p = files[i].c_str();
-        const char* last_slash = std::strrchr(p, '/');
-        SchString filename = last_slash ? SchString(last_slash + 1) : SchString(p);
-        all_doc_names.push_back(filename);
-        process_file(path, doc_id_counter);
-        doc_id_counter++;
-        if (doc_id_counter % 2000 == 0) fprintf(stderr, "Processed %d files...\n", doc_id_counter);
+        const char* name = base_name(files[i].c_str());
+        uint64_t* at = live.get(name, std::strlen(name));
+        if (at) {
+            size_t s = (size_t)(*at >> 32), d = (size_t)(*at & 0xffffffffu);
+            seen[s][d] = 1;
+            if (!file_changed(segs[s], d, files[i].c_str())) continue;
+            sch_mark_deleted(segs[s].deleted, d);
+            touched[s] = 1;
+        }
+        added.push_back(files[i]);
+    }
+    size_t removed = 0;
+    for (size_t s = 0; s < m.segments.size(); ++s) {
+        for (size_t d = 0; d < seen[s].size(); ++d) {
+            if (seen[s][d] || sch_is_deleted(segs[s].deleted, d)) continue;
+            sch_mark_deleted(segs[s].deleted, d);
+            touched[s] = 1;
+            removed++;
+        }
     }
 
+    SchManifest next = m;
+    for (size_t s = 0; s < m.segments.size(); ++s) {
+        if (!touched[s]) continue;
+        char name[1024], path[4096];
+        snprintf(name, sizeof(name), "%s.del%llu", m.segments[s].file.c_str(), (unsigned long long)(m.generation + 1));
+        sch_segment_path(index_file, name, path, sizeof(path));
+        if (!sch_write_tombstones(path, segs[s].deleted)) { fprintf(stderr, "Error: cannot write %s\n", path); exit(1); }
+        size_t deleted = 0;
+        for (size_t d = 0; d < segs[s].idx.doc_count(); ++d) deleted += sch_is_deleted(segs[s].deleted, d);
+        next.segments[s].tombstones = SchString(name);
+        next.segments[s].deleted = deleted;
+    }
+    delete[] segs;
+
+    if (added.size()) {
+        reset_builder();
+        for (size_t i = 0; i < added.size(); ++i) all_doc_names.push_back(SchString(base_name(added[i].c_str())));
+        all_doc_lens.resize(added.size());
+        all_doc_files.resize(added.size());
+        CorpusSource src;
+        src.files = std::move(added);
+        if (threads > 1) build_index_parallel(src, threads, fmt.positions);
+        else build_index_serial(src, index_file, 0, fmt.positions);
+        added = std::move(src.files);
+        if (reorder_docs) reorder_documents(threads);
+        char name[1024], path[4096];
+        snprintf(name, sizeof(name), "%s.seg%llu", base_name(index_file), (unsigned long long)next.next_segment++);
+        sch_segment_path(index_file, name, path, sizeof(path));
+        save_mapped_index(path, fmt);
+        if (!sch_sync_file(path)) { fprintf(stderr, "Error: cannot sync %s\n", path); exit(1); }
+        save_doc_files(path);
+        SchSegmentInfo info;
+        info.file = SchString(name);
+        info.doc_count = added.size();
+        info.deleted = 0;
+        next.segments.push_back(info);
+        reset_builder();
+    }
+    size_t changed = added.size() + removed;
+    fprintf(stderr, "Appended %zu documents, deleted %zu; %zu segments\n", added.size(), removed, next.segments.size());
+    if (changed || m.segments.size() == 0) publish_manifest(index_file, m, next);
+    return changed != 0;
+}
+
+// Stage times are summed over the indexing threads; stem and insert are
+// extrapolated from the sampled documents.
+static void print_trace(const SchTrace& t) {
+    for (int s = 0; s < SCH_STAGE_COUNT; ++s) {
+        if (t.calls[s]) fprintf(stderr, "Stage %-9s %10.1f ms %10llu calls\n", sch_stage_name(s), t.ns[s] / 1e6, (unsigned long long)t.calls[s]);
+    }
+    fprintf(stderr, "Traced %llu documents, %llu bytes, %llu tokens, %llu terms (%llu documents sampled)\n",
+            (unsigned long long)t.counts[SCH_CTR_DOCS], (unsigned long long)t.counts[SCH_CTR_BYTES], (unsigned long long)t.counts[SCH_CTR_TOKENS],
+            (unsigned long long)t.counts[SCH_CTR_TERMS], (unsigned long long)t.counts[SCH_CTR_SAMPLED_DOCS]);
+}
+
+static bool write_trace_json(const SchTrace& t, const char* path) {
+    char buf[2048];
+    size_t n = sch_trace_json(t, buf, sizeof(buf));
+    if (n >= sizeof(buf)) return false;
+    FILE* out = fopen(path, "w");
+    if (!out) return false;
+    fprintf(out, "%s\n", buf);
+    return fclose(out) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    bool mapped_format = false;
+    IndexFormat format;
+    bool append = false, merge = false, merge_all = false, background_merge = false;
+    int threads = 1;
+    size_t mem_limit = 0;
+    const char* stats_path = nullptr;
+    bool print_stages = false;
+    const char* positional[2] = {nullptr, nullptr};
+    int npositional = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char* fmt = argv[++i];
+            if (std::strcmp(fmt, "mapped") == 0) mapped_format = true;
+            else if (std::strcmp(fmt, "legacy") != 0) {
+                fprintf(stderr, "Unknown index format: %s (expected legacy or mapped)\n", fmt);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--compress") == 0) {
+            format.compress = true;
+            mapped_format = true;
+        } else if (std::strcmp(argv[i], "--positions") == 0) {
+            format.positions = true;
+            mapped_format = true;
+        } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+            if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+            if (threads <= 0) threads = 1;
+            save_threads = threads;
+        } else if (std::strcmp(argv[i], "--mem-limit") == 0 && i + 1 < argc) {
+            mem_limit = parse_mem_size(argv[++i]);
+            if (mem_limit == 0) {
+                fprintf(stderr, "Invalid memory limit: %s (expected e.g. 512M)\n", argv[i]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--append") == 0) {
+            append = true;
+        } else if (std::strcmp(argv[i], "--merge") == 0) {
+            merge = true;
+        } else if (std::strcmp(argv[i], "--merge-all") == 0) {
+            merge_all = true;
+        } else if (std::strcmp(argv[i], "--background-merge") == 0) {
+            background_merge = true;
+        } else if (std::strcmp(argv[i], "--stem-cache") == 0 && i + 1 < argc) {
+            stem_cache_slots = (size_t)std::atol(argv[++i]);
+        } else if (std::strcmp(argv[i], "--reorder") == 0) {
+            reorder_docs = true;
+        } else if (std::strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0) {
+            print_stages = true;
+        } else if (npositional < 2) {
+            positional[npositional++] = argv[i];
+        }
+    }
+    // Segment and tombstone names start with the index name.
+    const char* segmented = nullptr;
+    if (append && npositional == 2) segmented = positional[1];
+    else if ((merge || merge_all) && npositional == 1) segmented = positional[0];
+    if (segmented && !sch_manifest_name_ok(base_name(segmented))) {
+        fprintf(stderr, "Error: the name of a segmented index cannot contain whitespace or control characters: %s\n", segmented);
+        return 1;
+    }
+    if ((merge || merge_all) && !append && npositional == 1) {
+        int lock = lock_index(positional[0]);
+        run_merges(positional[0], merge_all);
+        close(lock);
+        return 0;
+    }
+    if (npositional < 2) {
+        fprintf(stderr, "Usage: %s [--format legacy|mapped] [--compress] [--positions] [-j N] [--mem-limit SIZE] [--stem-cache N] [--reorder] [--trace] [--stats FILE] <corpus_dir|corpus.pack> <output_index_file>\n", argv[0]);
+        fprintf(stderr, "       %s --append [--merge-all|--background-merge] [--compress] [--positions] [--reorder] [-j N] <corpus_dir> <index_file>\n", argv[0]);
+        fprintf(stderr, "       %s --merge|--merge-all <index_file>\n", argv[0]);
+        return 1;
+    }
+    if (mem_limit && (mapped_format || threads > 1 || append || reorder_docs)) {
+        fprintf(stderr, "--mem-limit writes the legacy layout single-threaded; drop --format/--compress/--positions/-j/--append/--reorder\n");
+        return 1;
+    }
+    const char* corpus_dir = positional[0];
+    const char* index_file = positional[1];
+    stem_cache.init(stem_cache_slots);
+    struct stat corpus_st;
+    bool packed_corpus = stat(corpus_dir, &corpus_st) == 0 && S_ISREG(corpus_st.st_mode);
+    if (packed_corpus && append) {
+        fprintf(stderr, "--append compares file modification times; give it the corpus directory, not a pack\n");
+        return 1;
+    }
+    int lock = lock_index(index_file);
+    if (append) {
+        bool changed = append_segment(corpus_dir, index_file, format, threads);
+        if (merge_all) run_merges(index_file, true);
+        else if (changed && background_merge) merge_in_background(index_file);
+        else if (changed) run_merges(index_file, false);
+        close(lock);
+        return 0;
+    }
+    drop_segments(index_file);
+
+    SchTrace trace;
+    SchTraceScope trace_scope(&trace);
+    CorpusSource src;
+    if (packed_corpus) {
+        if (!src.pack.open(corpus_dir)) { fprintf(stderr, "Error: %s is not a packed corpus\n", corpus_dir); return 1; }
+    } else {
+        src.files = list_txt_files(corpus_dir);
+        sort_schstring_vector(src.files);
+    }
+
+#ifdef SCH_COUNT_ALLOCS
+    size_t allocs_start = SCH_ALLOC_COUNT();
+#endif
+    int doc_id_counter = (int)src.size();
+    for (size_t i = 0; i < src.size(); ++i) {
+        if (packed_corpus) {
+            all_doc_names.push_back(SchString(src.pack.name(i), src.pack.name_len(i)));
+        } else {
+            const char* p = src.files[i].c_str();
+            const char* last_slash = std::strrchr(p, '/');
+            all_doc_names.push_back(last_slash ? SchString(last_slash + 1) : SchString(p));
+        }
+    }
+    all_doc_lens.resize(src.size());
+    if (mapped_format && !packed_corpus) all_doc_files.resize(src.size());
+    auto index_start = std::chrono::steady_clock::now();
+    if (threads > 1) build_index_parallel(src, threads, format.positions);
+    else build_index_serial(src, index_file, mem_limit, format.positions);
+
     fprintf(stderr, "Total processed: %d\n", doc_id_counter);
+    fprintf(stderr, "Indexed in %.1f ms.\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - index_start).count());
+#ifdef SCH_COUNT_ALLOCS
+    size_t allocs_indexed = SCH_ALLOC_COUNT();
+    fprintf(stderr, "Allocations while indexing: %zu (%.1f per document)\n", allocs_indexed - allocs_start,
+            doc_id_counter ? (double)(allocs_indexed - allocs_start) / doc_id_counter : 0.0);
+#endif
+    if (reorder_docs) {
+        auto reorder_start = std::chrono::steady_clock::now();
+        reorder_documents(threads);
+        fprintf(stderr, "Reordered in %.1f ms.\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - reorder_start).count());
+    }
     fprintf(stderr, "Saving index to: %s\n", index_file);
-    save_index(index_file);
+    if (!mem_limit) trace.counts[SCH_CTR_TERMS] = term_index.terms.size();
+    auto save_start = std::chrono::steady_clock::now();
+    {
+        SchStageTimer timer(SCH_STAGE_SAVE);
+        if (mem_limit) merge_runs(index_file);
+        else if (mapped_format) save_mapped_index(index_file, format);
+        else save_index(index_file);
+        save_doc_files(index_file);
 
-    std::string zipf = std::string(index_file) + ".csv";
-    export_zipf(zipf.c_str());
+#ifdef SCH_COUNT_ALLOCS
+        fprintf(stderr, "Allocations while saving: %zu\n", SCH_ALLOC_COUNT() - allocs_indexed);
+#endif
+
+        std::string zipf = std::string(index_file) + ".csv";
+        export_zipf(zipf.c_str());
+    }
+    fprintf(stderr, "Saved in %.1f ms.\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - save_start).count());
+    split_sampled_stages(trace);
+    if (SCH_TRACE_ENABLED && print_stages) print_trace(trace);
+    if (stats_path && !write_trace_json(trace, stats_path)) {
+        fprintf(stderr, "Error: cannot write %s\n", stats_path);
+        return 1;
+    }
 
     fprintf(stderr, "Done.\n");
+    close(lock);
     return 0;
 }
@@ -2,78 +2,233 @@
 #include <cstdlib>
 #include <cstring>
 #include <cctype>
+#include <cstdarg>
+#include <algorithm>
 #include <iostream>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
 #include "../include/sch_containers.h"
 #include "../include/sch_string.h"
 #include "../include/sch_string_utils.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_dictionary.h"
+#include "../include/sch_intersect.h"
+#include "../include/sch_boolean.h"
+#include "../include/sch_cursor.h"
+#include "../include/sch_rank.h"
+#include "../include/sch_positions.h"
+#include "../include/sch_protocol.h"
+#include "../include/sch_result_cache.h"
+#include "../include/sch_segments.h"
+#include "../include/sch_sort.h"
+#include "../include/sch_trace.h"
+#include "../include/sch_alloc_counter.h"
 
+static void append_key(SchVector<char>& k, const SchString& s) {
+    for (size_t i = 0; i < s.size(); ++i) k.push_back(s.c_str()[i]);
+}
+
+struct IndexSegment;
+
+// A legacy index (doc_names, then the sorted terms front-coded in memory with
+// their lists in the same order), one mapped file, or a segmented index
+// (<index>.segments, see sch_segments.h). Each segment is an IndexData of its
+// own; doc ids of a segmented index are the segment's base plus its local id.
 struct IndexData {
     SchVector<SchString> doc_names;
-    SchStringHashMap< SchVector<int> > index;
+    SchFrontCoder terms;
+    SchFrontDict dict;
+    SchVector< SchVector<int> > lists;
+    SchMappedIndex mapped;
+    SchVector<IndexSegment*> segments;
+    size_t segment_docs;
+    SchString cache_prefix;
+    uint64_t cache_epoch;
+    uint64_t generation;
+
+    IndexData() : segment_docs(0), cache_epoch(0), generation(0) {}
+    ~IndexData();
+    size_t doc_count() const {
+        if (segments.size()) return segment_docs;
+        return mapped.is_open() ? mapped.doc_count() : doc_names.size();
+    }
+    const char* doc_name(int doc_id) const;
+    SchPostingView lookup(const SchString& term) {
+        SchStageTimer timer(SCH_STAGE_LOOKUP);
+        long t = mapped.is_open() ? mapped.find_term(term.c_str(), term.size()) : dict.find(term.c_str(), term.size());
+        if (t < 0) return SchPostingView();
+        SchPostingView v = mapped.is_open() ? mapped.postings((size_t)t) : SchPostingView(lists[(size_t)t]);
+        sch_trace_count(SCH_CTR_LISTS, 1);
+        sch_trace_count(SCH_CTR_POSTINGS, v.size);
+        return v;
+    }
+    // Postings of every term starting with prefix, in dictionary order.
+    void lookup_prefix(const SchString& prefix, SchVector<SchPostingView>& out) {
+        SchStageTimer timer(SCH_STAGE_LOOKUP);
+        size_t first = 0, last = 0;
+        if (mapped.is_open()) mapped.prefix_range(prefix.c_str(), prefix.size(), &first, &last);
+        else dict.prefix_range(prefix.c_str(), prefix.size(), &first, &last);
+        for (size_t t = first; t < last; ++t) {
+            out.push_back(mapped.is_open() ? mapped.postings(t) : SchPostingView(lists[t]));
+            sch_trace_count(SCH_CTR_POSTINGS, out[out.size() - 1].size);
+        }
+        sch_trace_count(SCH_CTR_LISTS, last - first);
+    }
+    // Term id in the mapped index, -1 when absent.
+    long find_term(const SchString& term) const {
+        SchStageTimer timer(SCH_STAGE_LOOKUP);
+        long t = mapped.find_term(term.c_str(), term.size());
+        if (t >= 0) {
+            sch_trace_count(SCH_CTR_LISTS, 1);
+            sch_trace_count(SCH_CTR_POSTINGS, mapped.postings((size_t)t).size);
+        }
+        return t;
+    }
+};
+
+struct IndexSegment {
+    IndexData data;
+    size_t doc_base;
+    size_t deleted_count;
+    SchVector<uint64_t> deleted;
 };
 
-IndexData load_index(const char* filename) {
-    IndexData idx;
+IndexData::~IndexData() {
+    for (size_t i = 0; i < segments.size(); ++i) delete segments[i];
+}
+
+const char* IndexData::doc_name(int doc_id) const {
+    if (segments.size()) {
+        size_t lo = 0, hi = segments.size();
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (segments[mid]->doc_base <= (size_t)doc_id) lo = mid;
+            else hi = mid;
+        }
+        return segments[lo]->data.doc_name(doc_id - (int)segments[lo]->doc_base);
+    }
+    return mapped.is_open() ? mapped.doc_name((size_t)doc_id) : doc_names[doc_id].c_str();
+}
+
+// Opens every segment listed in the manifest of filename. A merge may replace
+// segments between reading the manifest and opening them (a full merge also
+// replaces filename itself), so a failed open, a segment whose doc count
+// differs from the manifest or a manifest that changed meanwhile rereads it a
+// few times before giving up: fatally at startup, keeping the loaded index on
+// a reload. generation receives the generation that was loaded.
+static bool load_segments(const char* filename, IndexData& idx, uint64_t* generation, bool fatal) {
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        SchManifest m;
+        if (!sch_read_manifest(filename, m)) return false;
+        for (size_t i = 0; i < idx.segments.size(); ++i) delete idx.segments[i];
+        idx.segments.clear();
+        bool ok = true;
+        size_t base = 0;
+        for (size_t s = 0; s < m.segments.size() && ok; ++s) {
+            IndexSegment* seg = new IndexSegment;
+            idx.segments.push_back(seg);
+            char path[4096];
+            sch_segment_path(filename, m.segments[s].file.c_str(), path, sizeof(path));
+            ok = seg->data.mapped.open(path) && seg->data.mapped.doc_count() == m.segments[s].doc_count;
+            seg->doc_base = base;
+            seg->deleted_count = m.segments[s].deleted;
+            seg->data.cache_epoch = idx.cache_epoch;
+            base += seg->data.mapped.doc_count();
+            SchVector<char> prefix;
+            append_key(prefix, m.segments[s].file);
+            prefix.push_back('|');
+            seg->data.cache_prefix = SchString(prefix.begin(), prefix.size());
+            if (ok && m.segments[s].tombstones.size()) {
+                sch_segment_path(filename, m.segments[s].tombstones.c_str(), path, sizeof(path));
+                ok = sch_read_tombstones(path, seg->data.mapped.doc_count(), seg->deleted);
+            }
+        }
+        SchManifest after;
+        if (ok && sch_read_manifest(filename, after) && after.generation == m.generation) {
+            idx.segment_docs = base;
+            idx.generation = m.generation;
+            if (generation) *generation = m.generation;
+            return true;
+        }
+        usleep(100000);
+    }
+    fprintf(stderr, "%s: segments of %s keep changing or are missing\n", fatal ? "FATAL" : "Warning", filename);
+    if (fatal) exit(1);
+    return false;
+}
+
+void load_index(const char* filename, IndexData& idx, uint64_t* generation) {
+    if (load_segments(filename, idx, generation, true)) return;
+    if (idx.mapped.open(filename)) return;
+    if (sch_file_has_index_magic(filename)) {
+        fprintf(stderr, "FATAL: %s is a mapped index of an unsupported version, with unknown flags or corrupt; rebuild it or update search_cli\n", filename);
+        exit(1);
+    }
     FILE* in = fopen(filename, "rb");
     if (!in) { fprintf(stderr, "FATAL: Failed to open index file: %s\n", filename); exit(1); }
 
     size_t docs_count = 0;
-    if (fread(&docs_count, sizeof(docs_count), 1, in) != 1) { fclose(in); return idx; }
+    if (fread(&docs_count, sizeof(docs_count), 1, in) != 1) { fclose(in); return; }
 
+    idx.doc_names.reserve(docs_count);
+    SchVector<char> buffer;
     for (size_t i = 0; i < docs_count; ++i) {
         size_t len;
         fread(&len, sizeof(len), 1, in);
-        char* buffer = new char[len + 1];
-        fread(buffer, 1, len, in);
-        buffer[len] = '\0';
-        idx.doc_names.push_back(SchString(buffer, len));
-        delete[] buffer;
+        buffer.resize(len);
+        fread(buffer.begin(), 1, len, in);
+        idx.doc_names.emplace_back(buffer.begin(), len);
     }
 
     size_t vocab_size = 0;
     fread(&vocab_size, sizeof(vocab_size), 1, in);
+    idx.lists.reserve(vocab_size);
     for (size_t i = 0; i < vocab_size; ++i) {
         size_t term_len;
         fread(&term_len, sizeof(term_len), 1, in);
-        char* term_buf = new char[term_len + 1];
-        fread(term_buf, 1, term_len, in);
-        term_buf[term_len] = '\0';
-        SchString term(term_buf, term_len);
-        delete[] term_buf;
+        buffer.resize(term_len);
+        fread(buffer.begin(), 1, term_len, in);
+        if (!idx.terms.add(buffer.begin(), term_len)) {
+            fprintf(stderr, "FATAL: terms of %s are not sorted; rebuild the index\n", filename);
+            exit(1);
+        }
 
         size_t list_size;
         fread(&list_size, sizeof(list_size), 1, in);
         SchVector<int> postings;
-        for (size_t j = 0; j < list_size; ++j) {
-            int did;
-            fread(&did, sizeof(did), 1, in);
-            postings.push_back(did);
-        }
-        idx.index.insert(term, postings);
+        postings.resize(list_size);
+        fread(postings.begin(), sizeof(int), list_size, in);
+        idx.lists.push_back(std::move(postings));
     }
     fclose(in);
-    return idx;
+    idx.dict = SchFrontDict(idx.terms);
 }
 
-SchVector<int> intersect_lists(const SchVector<int>& l1, const SchVector<int>& l2) {
-    SchVector<int> res;
-    size_t i = 0, j = 0;
-    while (i < l1.size() && j < l2.size()) {
-        if (l1[i] == l2[j]) { res.push_back(l1[i]); i++; j++; }
-        else if (l1[i] < l2[j]) i++;
-        else j++;
-    }
+SchVector<int> intersect_lists(const SchPostingView& l1, const SchPostingView& l2) {
+    SchVector<int> res, scratch;
+    sch_intersect_views(l1, l2, res, scratch);
     return res;
 }
-SchVector<int> union_lists(const SchVector<int>& l1, const SchVector<int>& l2) {
+SchVector<int> union_lists(const SchPostingView& l1, const SchPostingView& l2) {
     SchVector<int> res;
-    size_t i = 0, j = 0;
-    while (i < l1.size() || j < l2.size()) {
-        if (i == l1.size()) { res.push_back(l2[j++]); continue; }
-        if (j == l2.size()) { res.push_back(l1[i++]); continue; }
-        if (l1[i] == l2[j]) { res.push_back(l1[i]); i++; j++; }
-        else if (l1[i] < l2[j]) res.push_back(l1[i++]);
-        else res.push_back(l2[j++]);
+    SchPostingReader r1(l1), r2(l2);
+    const int32_t *a = nullptr, *b = nullptr;
+    size_t na = 0, nb = 0, i = 0, j = 0;
+    bool has_a = r1.next_block(&a, &na), has_b = r2.next_block(&b, &nb);
+    while (has_a || has_b) {
+        if (!has_b) res.push_back(a[i++]);
+        else if (!has_a) res.push_back(b[j++]);
+        else if (a[i] == b[j]) { res.push_back(a[i]); i++; j++; }
+        else if (a[i] < b[j]) res.push_back(a[i++]);
+        else res.push_back(b[j++]);
+        if (has_a && i == na) { has_a = r1.next_block(&a, &na); i = 0; }
+        if (has_b && j == nb) { has_b = r2.next_block(&b, &nb); j = 0; }
     }
     return res;
 }
@@ -82,69 +237,1304 @@ void to_upper_inplace(char* s) {
     for (size_t i = 0; s[i]; ++i) s[i] = (char)toupper((unsigned char)s[i]);
 }
 
+enum QueryOp { OP_TERM, OP_AND, OP_OR, OP_NEAR, OP_NOT };
+
+static QueryOp op_kind(const char* part) {
+    char op_copy[16]; std::strncpy(op_copy, part, 15); op_copy[15] = '\0';
+    to_upper_inplace(op_copy);
+    if (std::strcmp(op_copy, "AND") == 0) return OP_AND;
+    if (std::strcmp(op_copy, "OR") == 0) return OP_OR;
+    if (std::strcmp(op_copy, "NOT") == 0) return OP_NOT;
+    if (std::strncmp(op_copy, "NEAR/", 5) == 0 && isdigit((unsigned char)op_copy[5])) return OP_NEAR;
+    return OP_TERM;
+}
+
+// Splits a query on whitespace into NUL-terminated parts kept in buf; a
+// double-quoted phrase stays one part (quotes included) even when it contains
+// spaces, and a parenthesis outside quotes is always a part of its own.
+static void split_query(const char* q, SchVector<char>& buf, SchVector<const char*>& parts) {
+    buf.reserve(2 * std::strlen(q) + 1);
+    while (*q) {
+        while (*q && isspace((unsigned char)*q)) ++q;
+        if (!*q) break;
+        if (*q == '"') {
+            buf.push_back(*q++);
+            while (*q && *q != '"') buf.push_back(*q++);
+            if (*q) buf.push_back(*q++);
+        } else if (*q == '(' || *q == ')') {
+            buf.push_back(*q++);
+        } else {
+            while (*q && !isspace((unsigned char)*q) && *q != '(' && *q != ')') buf.push_back(*q++);
+        }
+        buf.push_back('\0');
+    }
+    for (size_t i = 0; i < buf.size(); i += std::strlen(buf.begin() + i) + 1) parts.push_back(buf.begin() + i);
+}
+
+static SchString stem_query_word(const SchString& word) {
+    SchStageTimer timer(SCH_STAGE_STEM, true);
+    return stem_word(word);
+}
+
+// Appends the stemmed words of one operand of a phrase / NEAR group. A quoted
+// phrase contributes every word, each one position after the previous; a plain
+// operand contributes its first word only, as in boolean queries.
+static void add_group_words(const char* part, int32_t lo, int32_t hi, SchVector<SchString>& words, SchVector<SchProximityTerm>& steps) {
+    bool phrase = part[0] == '"';
+    SchVector<SchString> toks = tokenize(SchString(part));
+    for (size_t i = 0; i < toks.size(); ++i) {
+        SchProximityTerm w;
+        w.term = 0;
+        w.lo = i ? 1 : lo;
+        w.hi = i ? 1 : hi;
+        words.push_back(stem_query_word(toks[i]));
+        steps.push_back(w);
+        if (!phrase) break;
+    }
+}
+
+// Results of boolean queries keyed by their canonical plan, and of the
+// sub-expressions evaluated on the way there (AND / OR / NOT nodes, phrase and
+// NEAR groups), so a query sharing a prefix with an earlier one starts from
+// the cached part. Sized by --cache; both are shared by the server workers.
+static SchResultCache result_cache;
+static SchResultCache subexpr_cache;
+
+// --exact-count: answers count every match (the whole result is evaluated)
+// instead of stopping after the documents shown and estimating the rest.
+static bool exact_counts = false;
+
+// One operand: a stemmed term (no word at all when the operand has no tokens),
+// the words and steps of a phrase / NEAR group, or a prefix* (its one word is
+// lowercased but not stemmed, since it is matched against stemmed terms).
+struct QueryOperand {
+    bool group;
+    bool prefix;
+    SchVector<SchString> words;
+    SchVector<SchProximityTerm> steps;
+    SchString key;
+};
+
+// A compiled query is a tree over the operands: a leaf (OP_TERM) names an
+// operand, AND / OR nodes have any number of kids and NOT has one. Keys are
+// canonical; an AND / OR with three or more kids also carries refine_key, the
+// key of its kids but the last in query order, under which the query without
+// its last operand may already be cached.
+struct QueryNode {
+    QueryOp op;
+    size_t operand;
+    SchVector<size_t> kids;
+    SchString key;
+    SchString refine_key;
+};
+
+struct QueryPlan {
+    SchVector<QueryOperand> operands;
+    SchVector<QueryNode> nodes;
+    size_t root;
+    SchString key;
+};
+
+static bool key_less(const SchString& a, const SchString& b) { return std::strcmp(a.c_str(), b.c_str()) < 0; }
+
+// Key of an AND / OR node over the keys of its operands, sorted and without
+// duplicates: "Kernel and memory" and "memory AND kernel" are both &(kernel,memori).
+static SchString node_key(char op, SchVector<SchString>& kids) {
+    std::sort(kids.begin(), kids.end(), key_less);
+    size_t n = 0;
+    for (size_t i = 0; i < kids.size(); ++i) {
+        if (n && kids[i] == kids[n - 1]) continue;
+        if (n != i) kids[n] = kids[i];
+        ++n;
+    }
+    kids.resize(n);
+    SchVector<char> k;
+    k.push_back(op);
+    k.push_back('(');
+    for (size_t i = 0; i < kids.size(); ++i) {
+        if (i) k.push_back(',');
+        append_key(k, kids[i]);
+    }
+    k.push_back(')');
+    return SchString(k.begin(), k.size());
+}
+
+// Key of a phrase / NEAR group: the words with the allowed offset before each
+// one, e.g. "slab [1:1] alloc". Both orders of a two-word NEAR share a key.
+static SchString group_key(QueryOperand& op) {
+    if (op.words.size() == 2 && op.steps[1].lo == -op.steps[1].hi && key_less(op.words[1], op.words[0])) {
+        SchString w = op.words[0];
+        op.words[0] = op.words[1];
+        op.words[1] = w;
+    }
+    SchVector<char> k;
+    k.push_back('"');
+    for (size_t i = 0; i < op.words.size(); ++i) {
+        if (i) {
+            char step[32];
+            snprintf(step, sizeof(step), " [%d:%d] ", (int)op.steps[i].lo, (int)op.steps[i].hi);
+            for (const char* p = step; *p; ++p) k.push_back(*p);
+        }
+        append_key(k, op.words[i]);
+    }
+    k.push_back('"');
+    return SchString(k.begin(), k.size());
+}
+
+// Recursive descent, NOT binding tightest, then AND (explicit or implicit),
+// then OR:
+//   expr := and (OR and)*    and := unary (AND? unary)*
+//   unary := NOT unary | ( expr ) | operand
+// An operand is a term, a prefix* (the union of every term starting with the
+// prefix), a "quoted phrase", or a chain `a NEAR/k b` (the two words at most
+// k positions apart, in either order); phrase and NEAR operands are matched
+// on an index built with --positions and evaluate to a doc list. Nested ANDs
+// and ORs flatten into one n-ary node and NOT NOT cancels out. Malformed input
+// degrades instead of failing: a missing ')' closes at the end, a stray ')'
+// or an operator with no operand after it is skipped.
+class QueryParser {
+private:
+    SchVector<const char*> parts_;
+    SchVector<char> buf_;
+    size_t pos_;
+    int depth_;
+    QueryPlan& plan_;
+
+    static bool is_open(const char* p) { return p[0] == '(' && !p[1]; }
+    static bool is_close(const char* p) { return p[0] == ')' && !p[1]; }
+
+    size_t add_node(QueryOp op) {
+        plan_.nodes.push_back(QueryNode());
+        plan_.nodes[plan_.nodes.size() - 1].op = op;
+        return plan_.nodes.size() - 1;
+    }
+
+    size_t leaf(size_t operand) {
+        size_t n = add_node(OP_TERM);
+        plan_.nodes[n].operand = operand;
+        plan_.nodes[n].key = plan_.operands[operand].key;
+        return n;
+    }
+
+    size_t empty_leaf() {
+        plan_.operands.push_back(QueryOperand());
+        plan_.operands[plan_.operands.size() - 1].group = false;
+        plan_.operands[plan_.operands.size() - 1].prefix = false;
+        return leaf(plan_.operands.size() - 1);
+    }
+
+    size_t negate(size_t kid) {
+        if (plan_.nodes[kid].op == OP_NOT) return plan_.nodes[kid].kids[0];
+        size_t n = add_node(OP_NOT);
+        plan_.nodes[n].kids.push_back(kid);
+        SchVector<char> k;
+        k.push_back('!');
+        append_key(k, plan_.nodes[kid].key);
+        plan_.nodes[n].key = SchString(k.begin(), k.size());
+        return n;
+    }
+
+    size_t combine(QueryOp op, const SchVector<size_t>& kids) {
+        if (kids.size() == 1) return kids[0];
+        SchVector<size_t> flat;
+        for (size_t i = 0; i < kids.size(); ++i) {
+            const QueryNode& kid = plan_.nodes[kids[i]];
+            if (kid.op != op) flat.push_back(kids[i]);
+            else for (size_t j = 0; j < kid.kids.size(); ++j) flat.push_back(kid.kids[j]);
+        }
+        char c = op == OP_OR ? '|' : '&';
+        SchVector<SchString> keys;
+        for (size_t i = 0; i < flat.size(); ++i) keys.push_back(plan_.nodes[flat[i]].key);
+        SchString key = node_key(c, keys);
+        SchString refine_key;
+        if (flat.size() >= 3) {
+            keys.clear();
+            for (size_t i = 0; i + 1 < flat.size(); ++i) keys.push_back(plan_.nodes[flat[i]].key);
+            refine_key = node_key(c, keys);
+        }
+        size_t n = add_node(op);
+        plan_.nodes[n].kids = flat;
+        plan_.nodes[n].key = key;
+        plan_.nodes[n].refine_key = refine_key;
+        return n;
+    }
+
+    size_t parse_operand() {
+        plan_.operands.push_back(QueryOperand());
+        QueryOperand& op = plan_.operands[plan_.operands.size() - 1];
+        const char* t = parts_[pos_++];
+        op.group = t[0] == '"' || (pos_ + 1 < parts_.size() && op_kind(parts_[pos_]) == OP_NEAR);
+        size_t len = std::strlen(t);
+        op.prefix = !op.group && len > 1 && t[len - 1] == '*';
+        if (op.prefix) {
+            SchVector<SchString> toks = tokenize(SchString(t));
+            op.group = toks.size() != 0;
+            if (op.group) {
+                op.words.push_back(toks[0]);
+                SchVector<char> k;
+                append_key(k, toks[0]);
+                k.push_back('*');
+                op.key = SchString(k.begin(), k.size());
+            }
+        } else if (!op.group) {
+            SchVector<SchString> toks = tokenize(SchString(t));
+            if (toks.size()) op.words.push_back(stem_query_word(toks[0]));
+            if (op.words.size()) op.key = op.words[0];
+        } else {
+            add_group_words(t, 0, 0, op.words, op.steps);
+            while (pos_ + 1 < parts_.size() && op_kind(parts_[pos_]) == OP_NEAR) {
+                int32_t k = (int32_t)std::atoi(parts_[pos_] + 5);
+                add_group_words(parts_[pos_ + 1], -k, k, op.words, op.steps);
+                pos_ += 2;
+            }
+            op.key = group_key(op);
+        }
+        return leaf(plan_.operands.size() - 1);
+    }
+
+    size_t parse_unary() {
+        while (pos_ < parts_.size()) {
+            const char* p = parts_[pos_];
+            if (is_close(p)) {
+                if (depth_) break;
+                ++pos_;
+                continue;
+            }
+            if (is_open(p)) {
+                ++pos_;
+                ++depth_;
+                size_t e = parse_expr();
+                --depth_;
+                if (pos_ < parts_.size()) ++pos_;
+                return e;
+            }
+            QueryOp op = op_kind(p);
+            if (op == OP_NOT) {
+                ++pos_;
+                return negate(parse_unary());
+            }
+            if (op != OP_TERM) {
+                ++pos_;
+                continue;
+            }
+            return parse_operand();
+        }
+        return empty_leaf();
+    }
+
+    size_t parse_and() {
+        SchVector<size_t> kids;
+        kids.push_back(parse_unary());
+        while (pos_ < parts_.size()) {
+            const char* p = parts_[pos_];
+            QueryOp op = op_kind(p);
+            if (op == OP_OR || (depth_ && is_close(p))) break;
+            if (op == OP_AND || is_close(p)) {
+                ++pos_;
+                continue;
+            }
+            kids.push_back(parse_unary());
+        }
+        return combine(OP_AND, kids);
+    }
+
+    size_t parse_expr() {
+        SchVector<size_t> kids;
+        kids.push_back(parse_and());
+        while (pos_ < parts_.size() && op_kind(parts_[pos_]) == OP_OR) {
+            ++pos_;
+            if (pos_ == parts_.size() || (depth_ && is_close(parts_[pos_]))) break;
+            kids.push_back(parse_and());
+        }
+        return combine(OP_OR, kids);
+    }
+
+public:
+    QueryParser(const char* query_cstr, QueryPlan& plan) : pos_(0), depth_(0), plan_(plan) {
+        split_query(query_cstr, buf_, parts_);
+    }
+
+    void parse() {
+        if (parts_.size() == 0) return;
+        plan_.root = parse_expr();
+        plan_.key = plan_.nodes[plan_.root].key;
+    }
+};
+
+static void parse_query(const char* query_cstr, QueryPlan& plan) {
+    SchStageTimer timer(SCH_STAGE_PARSE);
+    QueryParser parser(query_cstr, plan);
+    parser.parse();
+}
+
+// Sub-expression results of a segment only hold for that segment, so their
+// keys carry the segment's prefix.
+static SchString scoped_key(const IndexData& idx, const SchString& key) {
+    if (idx.cache_prefix.size() == 0) return key;
+    SchVector<char> k;
+    append_key(k, idx.cache_prefix);
+    append_key(k, key);
+    return SchString(k.begin(), k.size());
+}
+
+// Value of one operand: a term borrows its postings from the index; prefix and
+// group results are computed into v.ids and, unless the operand is the whole
+// query, stored in the sub-expression cache.
+static void operand_value(const QueryOperand& op, IndexData& idx, SchBoolValue& v, bool store) {
+    if (!op.group) {
+        v.borrowed = true;
+        if (op.words.size()) v.view = idx.lookup(op.words[0]);
+        return;
+    }
+    SchVector<int>& docs = v.ids;
+    SchString key = scoped_key(idx, op.key);
+    if (subexpr_cache.get(key, docs, idx.cache_epoch)) return;
+    if (op.prefix) {
+        SchVector<SchPostingView> lists;
+        idx.lookup_prefix(op.words[0], lists);
+        sch_union_all(lists.begin(), lists.size(), docs);
+    } else if (idx.mapped.is_open() && idx.mapped.has_positions()) {
+        SchVector<SchProximityTerm> steps = op.steps;
+        bool missing = false;
+        for (size_t w = 0; w < op.words.size(); ++w) {
+            long term = idx.find_term(op.words[w]);
+            if (term < 0) missing = true;
+            else steps[w].term = (size_t)term;
+        }
+        if (!missing) docs = sch_proximity_match(idx.mapped, steps.begin(), steps.size());
+    } else {
+        static std::atomic<bool> warned(false);
+        if (!warned.exchange(true)) fprintf(stderr, "Index has no positions (build with --positions); phrase and NEAR fall back to AND\n");
+        SchVector<SchPostingView> lists;
+        for (size_t w = 0; w < op.words.size(); ++w) lists.push_back(idx.lookup(op.words[w]));
+        docs = sch_intersect_all(lists.begin(), lists.size());
+    }
+    if (store) subexpr_cache.put(key, docs, idx.cache_epoch);
+}
+
+// Evaluates node n into v. Every AND and OR is one n-ary pass (sch_bool_and,
+// sch_bool_or) that keeps each value as a sorted list or a bitmap set by its
+// density; an AND subtracts its NOT kids, so a complement is only built for a
+// NOT with nothing to subtract from. Nodes below the root are looked up in and
+// stored to the sub-expression cache, and a node with a refine_key first tries
+// that (on a whole index also in the result cache): a query extended by one
+// more operand starts from the earlier answer.
+static void eval_node(const QueryPlan& plan, size_t n, IndexData& idx, SchBoolValue& v, bool root) {
+    const QueryNode& node = plan.nodes[n];
+    if (node.op == OP_TERM) {
+        operand_value(plan.operands[node.operand], idx, v, !root);
+        return;
+    }
+    SchString key;
+    if (!root) {
+        key = scoped_key(idx, node.key);
+        if (subexpr_cache.get(key, v.ids, idx.cache_epoch)) return;
+    }
+    size_t universe = idx.doc_count();
+    if (node.op == OP_NOT) {
+        SchBoolValue kid;
+        eval_node(plan, node.kids[0], idx, kid, false);
+        sch_bool_and(nullptr, 0, &kid, 1, universe, v);
+    } else {
+        SchVector<SchBoolValue> pos, neg;
+        pos.reserve(node.kids.size());
+        size_t first = 0;
+        if (node.refine_key.size()) {
+            pos.push_back(SchBoolValue());
+            if (subexpr_cache.get(scoped_key(idx, node.refine_key), pos[0].ids, idx.cache_epoch) ||
+                (idx.cache_prefix.size() == 0 && result_cache.get(node.refine_key, pos[0].ids, idx.cache_epoch))) first = node.kids.size() - 1;
+            else pos.clear();
+        }
+        for (size_t k = first; k < node.kids.size(); ++k) {
+            const QueryNode& kid = plan.nodes[node.kids[k]];
+            bool negated = node.op == OP_AND && kid.op == OP_NOT;
+            SchVector<SchBoolValue>& into = negated ? neg : pos;
+            into.push_back(SchBoolValue());
+            eval_node(plan, negated ? kid.kids[0] : node.kids[k], idx, into[into.size() - 1], false);
+        }
+        if (node.op == OP_OR) sch_bool_or(pos.begin(), pos.size(), universe, v);
+        else sch_bool_and(pos.begin(), pos.size(), neg.begin(), neg.size(), universe, v);
+    }
+    if (!root && subexpr_cache.enabled()) {
+        SchVector<int> ids;
+        v.to_ids(ids);
+        subexpr_cache.put(key, ids, idx.cache_epoch);
+    }
+}
+
+static void evaluate_plan(const QueryPlan& plan, IndexData& idx, SchVector<int>& result) {
+    SchStageTimer timer(SCH_STAGE_INTERSECT);
+    SchBoolValue v;
+    eval_node(plan, plan.root, idx, v, true);
+    if (v.dense || v.borrowed) v.to_ids(result);
+    else result = std::move(v.ids);
+}
+
+// A whole query is looked up by its canonical key first (single terms are not
+// cached: their postings are already a view into the index). A segmented
+// index evaluates the plan on every segment and concatenates the live
+// documents; segments are in doc id order, so the result stays sorted.
 SchVector<int> execute_query_cstr(const char* query_cstr, IndexData& idx) {
-    SchVector<const char*> parts;
+    QueryPlan plan;
+    parse_query(query_cstr, plan);
+    SchVector<int> result;
+    if (plan.nodes.size() == 0) return result;
+    const QueryNode& root = plan.nodes[plan.root];
+    bool cacheable = root.op != OP_TERM || plan.operands[root.operand].group;
+    if (cacheable && result_cache.get(plan.key, result, idx.cache_epoch)) {
+        sch_trace_count(SCH_CTR_CACHED, 1);
+        return result;
+    }
+    if (idx.segments.size() == 0) {
+        evaluate_plan(plan, idx, result);
+    } else {
+        SchVector<int> part;
+        for (size_t s = 0; s < idx.segments.size(); ++s) {
+            IndexSegment* seg = idx.segments[s];
+            part.clear();
+            evaluate_plan(plan, seg->data, part);
+            for (size_t i = 0; i < part.size(); ++i) {
+                if (!sch_is_deleted(seg->deleted, (size_t)part[i])) result.push_back((int)seg->doc_base + part[i]);
+            }
+        }
+    }
+    if (cacheable) result_cache.put(plan.key, result, idx.cache_epoch);
+    return result;
+}
+
+// Passes the cursor of a node below the root through and keeps the documents
+// it stands on. Stepped to the end without skipping any, they are the node's
+// whole result and go to the sub-expression cache; an advance_to that may
+// skip documents stops the recording.
+class SubexprCursor : public SchDocCursor {
+private:
+    SchDocCursor* kid_;
+    SchString key_;
+    uint64_t epoch_;
+    SchVector<int> docs_;
+    bool whole_;
+
+    int32_t step(int32_t d) {
+        doc_ = d;
+        if (!whole_) return doc_;
+        if (doc_ != SCH_DOC_END) {
+            docs_.push_back(doc_);
+        } else {
+            subexpr_cache.put(key_, docs_, epoch_);
+            stop();
+        }
+        return doc_;
+    }
+
+    void stop() {
+        whole_ = false;
+        docs_ = SchVector<int>();
+    }
+
+public:
+    SubexprCursor(SchDocCursor* kid, const SchString& key, uint64_t epoch) : kid_(kid), key_(key), epoch_(epoch), whole_(true) {
+        step(kid_->doc());
+    }
+    ~SubexprCursor() { delete kid_; }
+
+    int32_t next() { return doc_ == SCH_DOC_END ? doc_ : step(kid_->next()); }
+    int32_t advance_to(int32_t target) {
+        if (doc_ >= target) return doc_;
+        if (target > doc_ + 1) stop();
+        return step(kid_->advance_to(target));
+    }
+    size_t cost() const { return kid_->cost(); }
+};
+
+static SchDocCursor* node_cursor(const QueryPlan& plan, size_t n, IndexData& idx, bool root);
+
+// The AND / OR / NOT cursor of node over the cursors of its kids; a cached
+// refine_key prefix stands in for all kids but the last.
+static SchDocCursor* node_op_cursor(const QueryPlan& plan, const QueryNode& node, IndexData& idx) {
+    SchVector<int> cached;
+    SchVector<SchDocCursor*> pos, neg;
+    if (node.op == OP_NOT) {
+        neg.push_back(node_cursor(plan, node.kids[0], idx, false));
+    } else {
+        size_t first = 0;
+        if (node.refine_key.size() && (subexpr_cache.get(scoped_key(idx, node.refine_key), cached, idx.cache_epoch) ||
+                                       (idx.cache_prefix.size() == 0 && result_cache.get(node.refine_key, cached, idx.cache_epoch)))) {
+            pos.push_back(new SchPostingCursor(std::move(cached)));
+            first = node.kids.size() - 1;
+        }
+        for (size_t k = first; k < node.kids.size(); ++k) {
+            const QueryNode& kid = plan.nodes[node.kids[k]];
+            if (node.op == OP_AND && kid.op == OP_NOT) neg.push_back(node_cursor(plan, kid.kids[0], idx, false));
+            else pos.push_back(node_cursor(plan, node.kids[k], idx, false));
+        }
+        if (node.op == OP_OR) return new SchOrCursor(pos);
+    }
+    if (pos.size() == 0) pos.push_back(new SchRangeCursor(idx.doc_count()));
+    return new SchAndCursor(pos, neg);
+}
+
+// Cursor over node n for document-at-a-time evaluation, with the cache
+// lookups of eval_node: a cached node (or refine_key prefix) is read from its
+// stored list. Groups and prefixes are still computed whole by operand_value;
+// other nodes below the root are stored by SubexprCursor when walked whole.
+static SchDocCursor* node_cursor(const QueryPlan& plan, size_t n, IndexData& idx, bool root) {
+    const QueryNode& node = plan.nodes[n];
+    if (node.op == OP_TERM) {
+        SchBoolValue v;
+        operand_value(plan.operands[node.operand], idx, v, !root);
+        if (v.borrowed) return new SchPostingCursor(v.view);
+        return new SchPostingCursor(std::move(v.ids));
+    }
+    SchVector<int> cached;
+    if (!root && subexpr_cache.get(scoped_key(idx, node.key), cached, idx.cache_epoch)) return new SchPostingCursor(std::move(cached));
+    SchDocCursor* c = node_op_cursor(plan, node, idx);
+    if (!root && subexpr_cache.enabled()) c = new SubexprCursor(c, scoped_key(idx, node.key), idx.cache_epoch);
+    return c;
+}
+
+// The first (lowest id) k documents of a query. The cursor tree goes on
+// counting matches up to SCH_COUNT_SAMPLE and stops there: total is exact when
+// it ran out by then, and is extrapolated from how far the sample reached
+// otherwise (a single term on a whole index is counted by its list size). A
+// segmented index walks its segments in order. The answer is cached under
+// topk_key with its count in the tag; a complete result also goes to the
+// result cache under the plan key, where refine_key lookups find it.
+static const size_t SCH_COUNT_SAMPLE = 256;
+
+struct QueryHits {
+    SchVector<int> docs;
+    size_t total;
+    bool exact;
+};
+
+static SchString topk_key(const SchString& key, size_t k) {
+    char head[32];
+    int n = snprintf(head, sizeof(head), "%zu\t", k);
+    SchVector<char> out;
+    for (int i = 0; i < n; ++i) out.push_back(head[i]);
+    append_key(out, key);
+    return SchString(out.begin(), out.size());
+}
+
+static uint64_t hits_tag(const QueryHits& hits) { return (uint64_t)hits.total << 1 | (hits.exact ? 1 : 0); }
+
+void execute_query_topk(const char* query_cstr, IndexData& idx, size_t k, QueryHits& hits) {
+    hits.docs.clear();
+    hits.total = 0;
+    hits.exact = true;
+    QueryPlan plan;
+    parse_query(query_cstr, plan);
+    if (plan.nodes.size() == 0) return;
+    const QueryNode& root = plan.nodes[plan.root];
+    bool cacheable = root.op != OP_TERM || plan.operands[root.operand].group;
+    SchString key;
+    uint64_t tag = 0;
+    if (cacheable) key = topk_key(plan.key, k);
+    if (cacheable && result_cache.get(key, hits.docs, idx.cache_epoch, &tag)) {
+        sch_trace_count(SCH_CTR_CACHED, 1);
+        hits.total = (size_t)(tag >> 1);
+        hits.exact = (tag & 1) != 0;
+        return;
+    }
+    SchStageTimer timer(SCH_STAGE_INTERSECT);
+    size_t sample = k > SCH_COUNT_SAMPLE ? k : SCH_COUNT_SAMPLE;
+    int32_t next = SCH_DOC_END;
+    size_t bound = 0, seen = 0, listed = 0;
+    SchVector<int> all;
+    for (size_t s = 0; s < (idx.segments.size() ? idx.segments.size() : 1) && next == SCH_DOC_END; ++s) {
+        IndexSegment* seg = idx.segments.size() ? idx.segments[s] : nullptr;
+        size_t base = seg ? seg->doc_base : 0;
+        SchDocCursor* c = node_cursor(plan, plan.root, seg ? seg->data : idx, true);
+        if (!cacheable && !seg) listed = c->cost();
+        for (int32_t d = c->doc(); d != SCH_DOC_END; d = c->next()) {
+            if (seg && sch_is_deleted(seg->deleted, (size_t)d)) continue;
+            if (seen == sample) {
+                next = (int32_t)(base + d);
+                bound = c->cost();
+                if (seg) bound += idx.doc_count() - base - seg->data.doc_count();
+                break;
+            }
+            if (hits.docs.size() < k) hits.docs.push_back((int)(base + d));
+            if (cacheable && result_cache.enabled()) all.push_back((int)(base + d));
+            ++seen;
+        }
+        delete c;
+    }
+    hits.total = seen;
+    if (next != SCH_DOC_END && listed) {
+        hits.total = listed;
+    } else if (next != SCH_DOC_END) {
+        hits.exact = false;
+        hits.total = sch_estimate_count(seen, next, idx.doc_count(), bound);
+    } else if (cacheable) {
+        result_cache.put(plan.key, all, idx.cache_epoch);
+    }
+    if (cacheable) result_cache.put(key, hits.docs, idx.cache_epoch, hits_tag(hits));
+}
+
+static void ranked_topk(const IndexData& idx, const SchVector<SchString>& words, SchTopK& top) {
+    const SchMappedIndex& mapped = idx.mapped;
+    SchVector<size_t> terms;
+    for (size_t i = 0; i < words.size(); ++i) {
+        long t = idx.find_term(words[i]);
+        if (t >= 0) terms.push_back((size_t)t);
+    }
+    SchVector<SchTermCursor> cursors;
+    cursors.resize(terms.size());
+    for (size_t i = 0; i < terms.size(); ++i) cursors[i].init(mapped, terms[i]);
+    sch_maxscore_topk(mapped, cursors.begin(), cursors.size(), top);
+}
+
+// The stemmed words of a ranked query: operators are ignored and the token
+// after a NOT is dropped.
+static void ranked_words(const char* query_cstr, SchVector<SchString>& words) {
+    SchStageTimer timer(SCH_STAGE_PARSE);
     char* qcopy = strdup(query_cstr);
     char* tok = std::strtok(qcopy, " \t\r\n");
-    while (tok) { parts.push_back(tok); tok = std::strtok(NULL, " \t\r\n"); }
-    if (parts.size() == 0) { free(qcopy); return SchVector<int>(); }
-
-    auto process_term = [&](const char* t)->SchVector<int> {
-        SchString t_sch(t);
-        SchVector<SchString> toks = tokenize(t_sch);
-        if (toks.size() == 0) return SchVector<int>();
-        SchString st = stem_word(toks[0]);
-        SchVector<int>* ptr = idx.index.get(st);
-        if (ptr) return *ptr;
-        return SchVector<int>();
-    };
+    bool negated = false;
+    while (tok) {
+        QueryOp op = op_kind(tok);
+        if (op == OP_TERM && !negated) {
+            SchVector<SchString> toks = tokenize(SchString(tok));
+            for (size_t i = 0; i < toks.size(); ++i) words.push_back(stem_query_word(toks[i]));
+        }
+        negated = op == OP_NOT;
+        tok = std::strtok(NULL, " \t\r\n");
+    }
+    free(qcopy);
+}
+
+// Ranked mode: every query word contributes its BM25 score; the top k
+// documents come from block-max MaxScore. Segments score with their own
+// statistics (exact again once merged) and each is asked for k plus its
+// deleted documents, so k live ones survive the tombstones.
+SchVector<SchScoredDoc> execute_ranked_query(const char* query_cstr, IndexData& idx, size_t k) {
+    SchVector<SchString> words;
+    ranked_words(query_cstr, words);
+    SchStageTimer timer(SCH_STAGE_INTERSECT);
+    SchTopK top(k);
+    if (idx.segments.size() == 0) {
+        ranked_topk(idx, words, top);
+        return top.sorted();
+    }
+    for (size_t s = 0; s < idx.segments.size(); ++s) {
+        IndexSegment* seg = idx.segments[s];
+        SchTopK part(k + seg->deleted_count);
+        ranked_topk(seg->data, words, part);
+        SchVector<SchScoredDoc> docs = part.sorted();
+        for (size_t i = 0; i < docs.size(); ++i) {
+            if (!sch_is_deleted(seg->deleted, (size_t)docs[i].doc)) top.push((int32_t)seg->doc_base + docs[i].doc, docs[i].score);
+        }
+    }
+    return top.sorted();
+}
+
+static void append_fmt(SchVector<char>& out, const char* fmt, ...) {
+    char local[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(local, sizeof(local), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    size_t pos = out.size();
+    out.resize(pos + (size_t)n + 1);
+    if ((size_t)n < sizeof(local)) {
+        std::memcpy(out.begin() + pos, local, (size_t)n);
+    } else {
+        va_start(ap, fmt);
+        vsnprintf(out.begin() + pos, (size_t)n + 1, fmt, ap);
+        va_end(ap);
+    }
+    out.resize(pos + (size_t)n);
+}
+
+static void append_cache_stats(SchVector<char>& out) {
+    const char* names[2] = {"results", "subexpressions"};
+    SchResultCache* caches[2] = {&result_cache, &subexpr_cache};
+    for (int c = 0; c < 2; ++c) {
+        SchCacheStats st = caches[c]->stats();
+        append_fmt(out, "Cache %s: %zu hits, %zu misses, %zu evictions, %zu entries, %zu of %zu bytes\n", names[c],
+                   st.hits, st.misses, st.evictions, st.entries, st.bytes, st.capacity);
+    }
+}
+
+// Stage times and counters of every query answered by format_response, for
+// "#stats json". Stemming and decoding are only split out for EXPLAIN; in
+// other queries they count towards parse and intersect.
+static SchTrace query_totals;
+static std::mutex query_totals_lock;
 
-    SchVector<int> result = process_term(parts[0]);
-    for (size_t i = 1; i < parts.size(); ++i) {
-        const char* op = parts[i];
-        char op_copy[16]; std::strncpy(op_copy, op, 15); op_copy[15] = '\0';
-        to_upper_inplace(op_copy);
-        if (std::strcmp(op_copy, "AND") == 0 || std::strcmp(op_copy, "OR") == 0) {
-            if (i + 1 >= parts.size()) break;
-            SchVector<int> next = process_term(parts[i+1]);
-            if (std::strcmp(op_copy, "AND") == 0) result = intersect_lists(result, next);
-            else result = union_lists(result, next);
-            ++i;
+static void add_query_totals(SchTrace& trace) {
+    if (!SCH_TRACE_ENABLED) return;
+    trace.counts[SCH_CTR_QUERIES]++;
+    std::lock_guard<std::mutex> lock(query_totals_lock);
+    query_totals.merge(trace);
+}
+
+// One JSON line for the web backend: {"trace":{...},"cache":{"results":{...},"subexpressions":{...}}}.
+static void append_stats_json(SchVector<char>& out) {
+    SchTrace totals;
+    {
+        std::lock_guard<std::mutex> lock(query_totals_lock);
+        totals.merge(query_totals);
+    }
+    char buf[2048];
+    sch_trace_json(totals, buf, sizeof(buf));
+    append_fmt(out, "{\"trace\":%s,\"cache\":{", buf);
+    const char* names[2] = {"results", "subexpressions"};
+    SchResultCache* caches[2] = {&result_cache, &subexpr_cache};
+    for (int c = 0; c < 2; ++c) {
+        SchCacheStats st = caches[c]->stats();
+        append_fmt(out, "%s\"%s\":{\"hits\":%zu,\"misses\":%zu,\"evictions\":%zu,\"entries\":%zu,\"bytes\":%zu,\"capacity\":%zu}",
+                   c ? "," : "", names[c], st.hits, st.misses, st.evictions, st.entries, st.bytes, st.capacity);
+    }
+    append_fmt(out, "}}\n");
+}
+
+// The answer to one query as printed in stdin mode and sent by the server:
+// the count ("~" when estimated) and the first SCH_SHOWN_RESULTS documents.
+static const size_t SCH_SHOWN_RESULTS = 15;
+
+static void append_answer(const char* query, IndexData& idx, bool ranked, size_t top_k, SchVector<char>& out) {
+    if (ranked) {
+        SchVector<SchScoredDoc> ranked_results = execute_ranked_query(query, idx, top_k);
+        SchStageTimer timer(SCH_STAGE_OUTPUT);
+        append_fmt(out, "Found %zu documents:\n", ranked_results.size());
+        for (size_t i = 0; i < ranked_results.size(); ++i) append_fmt(out, "%s\n", idx.doc_name(ranked_results[i].doc));
+        return;
+    }
+    QueryHits hits;
+    if (exact_counts) {
+        hits.docs = execute_query_cstr(query, idx);
+        hits.total = hits.docs.size();
+        hits.exact = true;
+        if (hits.docs.size() > SCH_SHOWN_RESULTS) hits.docs.resize(SCH_SHOWN_RESULTS);
+    } else {
+        execute_query_topk(query, idx, SCH_SHOWN_RESULTS, hits);
+    }
+    SchStageTimer timer(SCH_STAGE_OUTPUT);
+    const char* about = hits.exact ? "" : "~";
+    append_fmt(out, "Found %s%zu documents:\n", about, hits.total);
+    for (size_t i = 0; i < hits.docs.size(); ++i) {
+        int docid = hits.docs[i];
+        if (docid >= 0 && docid < (int)idx.doc_count()) {
+            append_fmt(out, "%s\n", idx.doc_name(docid));
         } else {
-            SchVector<int> next = process_term(op);
-            result = intersect_lists(result, next);
+            append_fmt(out, "(doc id %d)\n", docid);
         }
     }
-    free(qcopy);
-    return result;
+    if (hits.total > hits.docs.size()) append_fmt(out, "... and %s%zu more\n", about, hits.total - hits.docs.size());
 }
 
-int main(int argc, char* argv[]) {
-    const char* index_path = "dumps/main_index.bin";
-    if (argc > 1) index_path = argv[1];
+// Posting lists an operand reads and their total length, over every segment.
+static void operand_lists(IndexData& idx, const QueryOperand& op, size_t* lists, size_t* postings) {
+    for (size_t s = 0; s < idx.segments.size(); ++s) operand_lists(idx.segments[s]->data, op, lists, postings);
+    if (idx.segments.size()) return;
+    SchVector<SchPostingView> views;
+    if (op.prefix && op.words.size()) idx.lookup_prefix(op.words[0], views);
+    else for (size_t w = 0; w < op.words.size(); ++w) views.push_back(idx.lookup(op.words[w]));
+    for (size_t i = 0; i < views.size(); ++i) {
+        if (!views[i].size) continue;
+        ++*lists;
+        *postings += views[i].size;
+    }
+}
 
-    fprintf(stderr, "Loading index from: %s ...\n", index_path);
-    IndexData idx = load_index(index_path);
-    fprintf(stderr, "Index loaded. Ready for queries.\n");
+static void explain_node(const QueryPlan& plan, size_t n, int depth, IndexData& idx, SchVector<char>& out) {
+    const QueryNode& node = plan.nodes[n];
+    append_fmt(out, "%*s", 2 * depth, "");
+    if (node.op != OP_TERM) {
+        append_fmt(out, "%s\n", node.op == OP_AND ? "AND" : (node.op == OP_OR ? "OR" : "NOT"));
+        for (size_t k = 0; k < node.kids.size(); ++k) explain_node(plan, node.kids[k], depth + 1, idx, out);
+        return;
+    }
+    const QueryOperand& op = plan.operands[node.operand];
+    size_t lists = 0, postings = 0;
+    operand_lists(idx, op, &lists, &postings);
+    const char* kind = op.prefix ? "PREFIX" : (op.group ? "PHRASE" : "TERM");
+    append_fmt(out, "%s %s: lists %zu, postings %zu\n", kind, op.words.size() ? op.key.c_str() : "(no words)", lists, postings);
+}
+
+// EXPLAIN <query>: the plan with the lists every operand reads, the answer,
+// then the time per stage and the counters of this one evaluation (cache hits
+// included, so a repeated query shows the cached path). Unlike other queries
+// it also times stemming and block decoding on their own.
+static void explain_query(const char* query, IndexData& idx, bool ranked, size_t top_k, SchVector<char>& out) {
+    SchTrace trace;
+    trace.detailed = true;
+    SchVector<char> answer;
+    uint64_t start = sch_trace_now();
+    {
+        SchTraceScope scope(&trace);
+        append_answer(query, idx, ranked, top_k, answer);
+    }
+    uint64_t total = sch_trace_now() - start;
+    add_query_totals(trace);
+    if (ranked) {
+        SchVector<SchString> words;
+        ranked_words(query, words);
+        append_fmt(out, "Plan: BM25 top %zu\n", top_k);
+        for (size_t w = 0; w < words.size(); ++w) {
+            QueryOperand op;
+            op.group = op.prefix = false;
+            op.words.push_back(words[w]);
+            size_t lists = 0, postings = 0;
+            operand_lists(idx, op, &lists, &postings);
+            append_fmt(out, "  TERM %s: lists %zu, postings %zu\n", words[w].c_str(), lists, postings);
+        }
+    } else {
+        QueryPlan plan;
+        parse_query(query, plan);
+        append_fmt(out, "Plan: %s\n", plan.nodes.size() ? plan.key.c_str() : "(empty)");
+        if (plan.nodes.size()) explain_node(plan, plan.root, 1, idx, out);
+    }
+    size_t pos = out.size();
+    out.resize(pos + answer.size());
+    if (answer.size()) std::memcpy(out.begin() + pos, answer.begin(), answer.size());
+    if (!SCH_TRACE_ENABLED) append_fmt(out, "Stages: not traced (built with -DSCH_NO_TRACE)\n");
+    for (int s = 0; s < SCH_STAGE_COUNT; ++s) {
+        if (trace.calls[s]) append_fmt(out, "Stage %-9s %9.3f ms %6llu calls\n", sch_stage_name(s), trace.ns[s] / 1e6, (unsigned long long)trace.calls[s]);
+    }
+    append_fmt(out, "Read %llu lists, %llu postings, %llu blocks%s\n", (unsigned long long)trace.counts[SCH_CTR_LISTS],
+               (unsigned long long)trace.counts[SCH_CTR_POSTINGS], (unsigned long long)trace.counts[SCH_CTR_BLOCKS],
+               trace.counts[SCH_CTR_CACHED] ? "; answered from the result cache" : "");
+    append_fmt(out, "Total %.3f ms\n", total / 1e6);
+}
+
+// Every answer ends with "---END---". The line "#stats" is answered with the
+// cache counters (and the manifest generation of a segmented index), "#stats
+// json" with the stage totals and cache counters as JSON, and
+// "EXPLAIN <query>" with explain_query().
+void format_response(const char* query, IndexData& idx, bool ranked, size_t top_k, SchVector<char>& out) {
+    out.clear();
+    if (std::strcmp(query, "#stats") == 0) {
+        append_cache_stats(out);
+        if (idx.segments.size()) append_fmt(out, "Index generation %llu, %zu segments\n", (unsigned long long)idx.generation, idx.segments.size());
+    } else if (std::strcmp(query, "#stats json") == 0) {
+        append_stats_json(out);
+    } else if (std::strncmp(query, "EXPLAIN ", 8) == 0) {
+        explain_query(query + 8, idx, ranked, top_k, out);
+    } else {
+        SchTrace trace;
+        {
+            SchTraceScope scope(&trace);
+            append_answer(query, idx, ranked, top_k, out);
+        }
+        add_query_totals(trace);
+    }
+    append_fmt(out, "---END---\n");
+}
+
+// The index requests run on. current() looks at the manifest at most every
+// SCH_RELOAD_CHECK_NS; when --append or a merge has published another
+// generation (or a first --append turned a plain index into segments), the
+// first request to notice loads it outside the lock and swaps it in while
+// the others go on with the previous one. Requests holding the previous
+// IndexData finish on it, and the caches move to the new epoch.
+static const int64_t SCH_RELOAD_CHECK_NS = 100000000;
+
+static int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class LiveIndex {
+private:
+    const char* path_;
+    std::mutex mu_;
+    std::shared_ptr<IndexData> current_;
+    std::atomic<int64_t> next_check_;
+    std::mutex reload_mu_;
+    uint64_t generation_;
+    uint64_t epoch_;
+    ino_t manifest_ino_;
+    int64_t manifest_mtime_;
+
+    bool manifest_changed(struct stat& st) const {
+        char path[4096];
+        sch_manifest_path(path_, path, sizeof(path));
+        if (stat(path, &st) != 0) return false;
+        int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        return st.st_ino != manifest_ino_ || mtime != manifest_mtime_;
+    }
+
+    void remember(const struct stat& st) {
+        manifest_ino_ = st.st_ino;
+        manifest_mtime_ = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    }
+
+    void check() {
+        std::unique_lock<std::mutex> reload(reload_mu_, std::try_to_lock);
+        if (!reload.owns_lock()) return;
+        struct stat st;
+        if (!manifest_changed(st)) return;
+        SchManifest m;
+        if (!sch_read_manifest(path_, m)) return;
+        if (m.generation == generation_) { remember(st); return; }
+        std::shared_ptr<IndexData> next = std::make_shared<IndexData>();
+        next->cache_epoch = epoch_ + 1;
+        uint64_t generation = 0;
+        if (!load_segments(path_, *next, &generation, false)) return;
+        ++epoch_;
+        generation_ = generation;
+        remember(st);
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            current_.swap(next);
+        }
+        result_cache.reset(epoch_);
+        subexpr_cache.reset(epoch_);
+        fprintf(stderr, "Reloaded %s: generation %llu, %zu segments\n", path_, (unsigned long long)generation_, current_->segments.size());
+    }
+
+public:
+    explicit LiveIndex(const char* path) : path_(path), next_check_(0), generation_(0), epoch_(0), manifest_ino_(0), manifest_mtime_(0) {}
+
+    void load() {
+        struct stat st;
+        if (manifest_changed(st)) remember(st);
+        current_ = std::make_shared<IndexData>();
+        load_index(path_, *current_, &generation_);
+        next_check_ = steady_ns() + SCH_RELOAD_CHECK_NS;
+    }
+
+    std::shared_ptr<IndexData> current() {
+        int64_t now = steady_ns();
+        int64_t next = next_check_.load(std::memory_order_relaxed);
+        if (now >= next && next_check_.compare_exchange_strong(next, now + SCH_RELOAD_CHECK_NS)) check();
+        std::lock_guard<std::mutex> lock(mu_);
+        return current_;
+    }
+};
+
+// Server mode: the workers share one epoll set. The listening socket and every
+// connection are registered one-shot, so a ready socket wakes exactly one
+// worker; a connection is re-armed after its request has been answered. A slow
+// query therefore only holds its own worker, and idle connections hold none.
+// Each request takes the current index from LiveIndex and keeps it until
+// answered.
+// State of one client connection. EPOLLONESHOT hands it to one worker at a
+// time, so it needs no lock.
+struct ServeConn {
+    int fd;
+    SchFrameReader in;
+    SchVector<char> out;
+    size_t out_pos;
+};
+
+// Answers the frames the connection has buffered. Returns the events to wait
+// for next, or 0 when the connection is done.
+static uint32_t serve_connection(ServeConn* c, LiveIndex* live, bool ranked, size_t top_k,
+                                 SchVector<char>& request, SchVector<char>& response) {
+    for (;;) {
+        if (!sch_write_some(c->fd, c->out.begin(), c->out.size(), &c->out_pos)) return 0;
+        if (c->out_pos < c->out.size()) return EPOLLOUT;
+        c->out.clear();
+        c->out_pos = 0;
+        SchFrameReader::Status st = c->in.read_some(c->fd, SCH_MAX_REQUEST);
+        if (st == SchFrameReader::FAILED) return 0;
+        if (st == SchFrameReader::PARTIAL) return EPOLLIN;
+        c->in.take(request);
+        size_t len = request.size();
+        while (len > 0 && (request[len - 1] == '\n' || request[len - 1] == '\r')) request[--len] = '\0';
+        std::shared_ptr<IndexData> idx = live->current();
+        format_response(request.begin(), *idx, ranked, top_k, response);
+        sch_put_frame(response.begin(), response.size(), c->out);
+    }
+}
+
+// Connections are non-blocking: a worker reads what a client has sent and
+// goes back to epoll when the frame is not complete yet, so a slow client
+// never holds a thread. The listening socket is registered with a null ptr.
+static void serve_worker(int epfd, int listen_fd, LiveIndex* live, bool ranked, size_t top_k) {
+    SchVector<char> request, response;
+    epoll_event ev;
+    for (;;) {
+        int n = epoll_wait(epfd, &ev, 1, -1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        ServeConn* c = (ServeConn*)ev.data.ptr;
+        if (!c) {
+            for (;;) {
+                int conn = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (conn < 0) break;
+                ServeConn* nc = new ServeConn();
+                nc->fd = conn;
+                nc->out_pos = 0;
+                epoll_event ce;
+                ce.events = EPOLLIN | EPOLLONESHOT;
+                ce.data.ptr = nc;
+                if (epoll_ctl(epfd, EPOLL_CTL_ADD, conn, &ce) != 0) { close(conn); delete nc; }
+            }
+            ev.events = EPOLLIN | EPOLLONESHOT;
+            ev.data.ptr = nullptr;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, listen_fd, &ev);
+            continue;
+        }
+        uint32_t wait = serve_connection(c, live, ranked, top_k, request, response);
+        ev.events = wait | EPOLLONESHOT;
+        ev.data.ptr = c;
+        if (!wait || epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev) != 0) {
+            close(c->fd);
+            delete c;
+        }
+    }
+}
 
+static int run_server(const char* addr, int threads, LiveIndex& live, bool ranked, size_t top_k) {
+    int listen_fd = sch_listen(addr);
+    if (listen_fd < 0) { fprintf(stderr, "FATAL: cannot listen on %s (expected unix:PATH or tcp:PORT)\n", addr); return 1; }
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+    int epfd = epoll_create1(0);
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = nullptr;
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) != 0) { fprintf(stderr, "FATAL: epoll setup failed\n"); return 1; }
+    fprintf(stderr, "Serving on %s with %d threads.\n", addr, threads);
+    SchVector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) workers.emplace_back(serve_worker, epfd, listen_fd, &live, ranked, top_k);
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+    return 0;
+}
+
+// Client mode: forwards stdin lines to a server and prints the answers, so the
+// output matches running the queries locally.
+static int run_client(const char* addr) {
+    int fd = sch_connect(addr);
+    if (fd < 0) { fprintf(stderr, "FATAL: cannot connect to %s\n", addr); return 1; }
+    SchVector<char> response, frame;
     char linebuf[4096];
     while (fgets(linebuf, sizeof(linebuf), stdin)) {
         size_t L = strlen(linebuf);
         while (L > 0 && (linebuf[L-1] == '\n' || linebuf[L-1] == '\r')) { linebuf[L-1] = '\0'; --L; }
         if (L == 0) continue;
-        SchVector<int> results = execute_query_cstr(linebuf, idx);
-        printf("Found %zu documents:\n", results.size());
-        for (size_t i = 0; i < results.size(); ++i) {
-            if (i >= 15) { printf("... and %zu more\n", results.size() - 15); break; }
-            int docid = results[i];
-            if (docid >= 0 && docid < (int)idx.doc_names.size()) {
-                printf("%s\n", idx.doc_names[docid].c_str());
+        if (!sch_send_frame(fd, linebuf, L, frame) || !sch_recv_frame(fd, response, UINT32_MAX - 1)) {
+            fprintf(stderr, "FATAL: connection to %s lost\n", addr);
+            close(fd);
+            return 1;
+        }
+        fwrite(response.begin(), 1, response.size(), stdout);
+        fflush(stdout);
+    }
+    close(fd);
+    return 0;
+}
+
+static double now_sec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct BatchQuery {
+    SchString qid;
+    SchString text;
+    SchVector<SchString> docs;
+    size_t found;
+    double seconds;
+};
+
+// Reads "qid query" lines the way generate_qrels_and_results.py does: the id is
+// split off at a tab, or taken from a first word starting with 'q'; otherwise
+// it is q<line number>.
+static bool read_batch(const char* path, SchVector<BatchQuery>& batch) {
+    FILE* in = fopen(path, "r");
+    if (!in) return false;
+    char linebuf[4096];
+    size_t lineno = 0;
+    while (fgets(linebuf, sizeof(linebuf), in)) {
+        ++lineno;
+        char* line = linebuf;
+        size_t L = strlen(line);
+        while (L > 0 && isspace((unsigned char)line[L - 1])) line[--L] = '\0';
+        while (*line && isspace((unsigned char)*line)) { ++line; --L; }
+        if (L == 0) continue;
+        batch.push_back(BatchQuery());
+        BatchQuery& q = batch[batch.size() - 1];
+        char* tab = std::strchr(line, '\t');
+        char* space = std::strpbrk(line, " \t");
+        char* text = line;
+        if (tab) {
+            q.qid = SchString(line, (size_t)(tab - line));
+            text = tab + 1;
+        } else if (line[0] == 'q' && space) {
+            q.qid = SchString(line, (size_t)(space - line));
+            text = space;
+            while (*text && isspace((unsigned char)*text)) ++text;
+        } else {
+            char id[32];
+            snprintf(id, sizeof(id), "q%zu", lineno);
+            q.qid = SchString(id);
+        }
+        q.text = SchString(text);
+        q.found = 0;
+        q.seconds = 0;
+    }
+    fclose(in);
+    return true;
+}
+
+// Latencies are kept in 0.1 us steps; order lists the queries by latency.
+static double percentile(const SchVector<uint32_t>& order, const SchVector<uint32_t>& lat, double p) {
+    if (order.size() == 0) return 0;
+    return lat[order[(size_t)(p * (order.size() - 1))]] / 10.0;
+}
+
+// Batch mode: the queries of a file are answered by a pool of threads pulling
+// the next unanswered one, then written in input order as TREC run lines
+// "qid doc rank" (at most top_k per query). Doc names are taken with the
+// answer, from the index generation the query ran on. Per-query latency goes to
+// latency_path ("qid microseconds found"), the throughput summary to stderr.
+static int run_batch(const char* path, const char* out_path, const char* latency_path, int threads, LiveIndex& live, bool ranked, size_t top_k) {
+    SchVector<BatchQuery> batch;
+    if (!read_batch(path, batch)) { fprintf(stderr, "FATAL: cannot open query file: %s\n", path); return 1; }
+    FILE* out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) { fprintf(stderr, "FATAL: cannot write %s\n", out_path); return 1; }
+
+    std::atomic<size_t> next(0);
+    SchTrace batch_trace;
+    std::mutex batch_trace_lock;
+    auto work = [&]() {
+        SchTrace trace;
+        SchTraceScope scope(&trace);
+        for (size_t i = next++; i < batch.size(); i = next++) {
+            BatchQuery& q = batch[i];
+            double t0 = now_sec();
+            std::shared_ptr<IndexData> idx = live.current();
+            SchVector<int> docs;
+            if (ranked) {
+                SchVector<SchScoredDoc> top = execute_ranked_query(q.text.c_str(), *idx, top_k);
+                for (size_t j = 0; j < top.size(); ++j) docs.push_back((int)top[j].doc);
+                q.found = docs.size();
+            } else if (exact_counts) {
+                docs = execute_query_cstr(q.text.c_str(), *idx);
+                q.found = docs.size();
             } else {
-                printf("(doc id %d)\n", docid);
+                QueryHits hits;
+                execute_query_topk(q.text.c_str(), *idx, top_k, hits);
+                docs = std::move(hits.docs);
+                q.found = hits.total;
             }
+            if (docs.size() > top_k) docs.resize(top_k);
+            q.seconds = now_sec() - t0;
+            for (size_t j = 0; j < docs.size(); ++j) q.docs.push_back(SchString(idx->doc_name(docs[j])));
         }
-        printf("---END---\n");
+        std::lock_guard<std::mutex> lock(batch_trace_lock);
+        batch_trace.merge(trace);
+    };
+    double t0 = now_sec();
+    SchVector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) workers.emplace_back(work);
+    work();
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+    double elapsed = now_sec() - t0;
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        for (size_t j = 0; j < batch[i].docs.size(); ++j) fprintf(out, "%s %s %zu\n", batch[i].qid.c_str(), batch[i].docs[j].c_str(), j + 1);
+    }
+    if (out != stdout) fclose(out);
+    else fflush(out);
+
+    SchVector<uint32_t> lat, order;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        double tenths = batch[i].seconds * 1e7 + 0.5;
+        lat.push_back(tenths < 4e9 ? (uint32_t)tenths : 4000000000u);
+        order.push_back((uint32_t)i);
+    }
+    if (latency_path) {
+        FILE* lf = fopen(latency_path, "w");
+        if (!lf) { fprintf(stderr, "FATAL: cannot write %s\n", latency_path); return 1; }
+        for (size_t i = 0; i < batch.size(); ++i) fprintf(lf, "%s %.1f %zu\n", batch[i].qid.c_str(), lat[i] / 10.0, batch[i].found);
+        fclose(lf);
+    }
+    sch_sort_by_key(order, lat.begin());
+    fprintf(stderr, "Batch: %zu queries, %d threads, %.3f s, %.0f queries/s; latency p50 %.1f us, p95 %.1f us, p99 %.1f us, max %.1f us\n",
+            batch.size(), threads, elapsed, elapsed > 0 ? batch.size() / elapsed : 0.0, percentile(order, lat, 0.50), percentile(order, lat, 0.95),
+            percentile(order, lat, 0.99), percentile(order, lat, 1.0));
+    for (int s = 0; s < SCH_STAGE_COUNT; ++s) {
+        if (batch_trace.calls[s]) fprintf(stderr, "Stage %-9s %10.1f ms %10llu calls\n", sch_stage_name(s), batch_trace.ns[s] / 1e6, (unsigned long long)batch_trace.calls[s]);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* index_path = "dumps/main_index.bin";
+    const char* serve_addr = nullptr;
+    const char* connect_addr = nullptr;
+    const char* batch_path = nullptr;
+    const char* out_path = nullptr;
+    const char* latency_path = nullptr;
+    bool ranked = false;
+    size_t top_k = 15;
+    int threads = 0;
+    size_t cache_bytes = 32 * 1024 * 1024;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--rank") == 0) ranked = true;
+        else if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc) top_k = (size_t)std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc) serve_addr = argv[++i];
+        else if (std::strcmp(argv[i], "--connect") == 0 && i + 1 < argc) connect_addr = argv[++i];
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc) batch_path = argv[++i];
+        else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (std::strcmp(argv[i], "--latency") == 0 && i + 1 < argc) latency_path = argv[++i];
+        else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) cache_bytes = parse_mem_size(argv[++i]);
+        else if (std::strcmp(argv[i], "--exact-count") == 0) exact_counts = true;
+        else index_path = argv[i];
+    }
+    if (connect_addr) return run_client(connect_addr);
+
+    fprintf(stderr, "Loading index from: %s ...\n", index_path);
+#ifdef SCH_COUNT_ALLOCS
+    size_t allocs_start = SCH_ALLOC_COUNT();
+#endif
+    double load_start = now_sec();
+    LiveIndex live(index_path);
+    live.load();
+    double load_sec = now_sec() - load_start;
+#ifdef SCH_COUNT_ALLOCS
+    fprintf(stderr, "Allocations while loading: %zu\n", SCH_ALLOC_COUNT() - allocs_start);
+#endif
+    std::shared_ptr<IndexData> loaded = live.current();
+    bool scores = loaded->segments.size() ? true : loaded->mapped.is_open() && loaded->mapped.has_scores();
+    for (size_t s = 0; s < loaded->segments.size(); ++s) scores = scores && loaded->segments[s]->data.mapped.has_scores();
+    loaded.reset();
+    if (ranked && !scores) {
+        fprintf(stderr, "FATAL: --rank needs an index built with --format mapped or --compress\n");
+        exit(1);
+    }
+    result_cache.set_capacity(cache_bytes - cache_bytes / 4);
+    subexpr_cache.set_capacity(cache_bytes / 4);
+    fprintf(stderr, "Index loaded in %.2f ms. Ready for queries.\n", load_sec * 1e3);
+    if (batch_path) {
+        if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+        return run_batch(batch_path, out_path, latency_path, threads, live, ranked, top_k);
+    }
+    if (serve_addr) {
+        if (threads <= 0) {
+            threads = (int)std::thread::hardware_concurrency();
+            if (threads < 4) threads = 4;
+        }
+        return run_server(serve_addr, threads, live, ranked, top_k);
+    }
+
+    SchVector<char> response;
+    char linebuf[4096];
+    while (fgets(linebuf, sizeof(linebuf), stdin)) {
+        size_t L = strlen(linebuf);
+        while (L > 0 && (linebuf[L-1] == '\n' || linebuf[L-1] == '\r')) { linebuf[L-1] = '\0'; --L; }
+        if (L == 0) continue;
+#ifdef SCH_COUNT_ALLOCS
+        size_t allocs_query = SCH_ALLOC_COUNT();
+#endif
+        std::shared_ptr<IndexData> idx = live.current();
+        format_response(linebuf, *idx, ranked, top_k, response);
+        fwrite(response.begin(), 1, response.size(), stdout);
         fflush(stdout);
+#ifdef SCH_COUNT_ALLOCS
+        fprintf(stderr, "Allocations for query: %zu\n", SCH_ALLOC_COUNT() - allocs_query);
+#endif
+    }
+    if (result_cache.enabled()) {
+        append_cache_stats(response);
+        fwrite(response.begin(), 1, response.size(), stderr);
     }
     return 0;
 }
@@ -1,38 +1,76 @@
 import subprocess
 import os
+import socket
+import struct
+import threading
 import time
-from flask import Flask, request, render_template_string
+from flask import Flask, Response, request, render_template_string
 
 app = Flask(__name__)
 
 SEARCH_BINARY = "./search_cli"
 INDEX_FILE = "dumps/main_index.bin"
+SEARCH_SOCKET = os.environ.get("SEARCH_SOCKET", "dumps/search.sock")
 
-search_process = None
+server_process = None
+server_lock = threading.Lock()
+local = threading.local()
 
-def get_search_process():
-    global search_process
-    if search_process is None or search_process.poll() is not None:
-        if not os.path.exists(INDEX_FILE):
-             return None
-        search_process = subprocess.Popen(
-            [SEARCH_BINARY, INDEX_FILE],
-            stdin=subprocess.PIPE,
-            stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE,
-            text=True,
-            bufsize=1
+def start_search_server():
+    """Starts search_cli --serve once; all Flask workers share it."""
+    global server_process
+    with server_lock:
+        if server_process is not None and server_process.poll() is None:
+            return True
+        if not os.path.exists(INDEX_FILE) and not os.path.exists(INDEX_FILE + ".segments"):
+            return False
+        server_process = subprocess.Popen(
+            [SEARCH_BINARY, "--serve", "unix:" + SEARCH_SOCKET, INDEX_FILE],
+            stdin=subprocess.DEVNULL,
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.DEVNULL
         )
         timeout = 5.0
         start = time.time()
         while time.time() - start < timeout:
-            line = search_process.stderr.readline()
-            if not line:
+            try:
+                s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                s.connect(SEARCH_SOCKET)
+                s.close()
+                return True
+            except OSError:
                 time.sleep(0.05)
-                continue
-            if "Ready" in line or "Index loaded" in line:
-                break
-    return search_process
+        return False
+
+def recv_exact(sock, n):
+    buf = b""
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            raise ConnectionError("search server closed the connection")
+        buf += chunk
+    return buf
+
+def query_server(query):
+    """Sends one length-prefixed query on this thread's connection and returns the reply text."""
+    payload = query.encode("utf-8")
+    for attempt in range(2):
+        sock = getattr(local, "sock", None)
+        try:
+            if sock is None:
+                sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                sock.connect(SEARCH_SOCKET)
+                local.sock = sock
+            sock.sendall(struct.pack("<I", len(payload)) + payload)
+            n = struct.unpack("<I", recv_exact(sock, 4))[0]
+            return recv_exact(sock, n).decode("utf-8", errors="replace")
+        except OSError:
+            if sock is not None:
+                sock.close()
+            local.sock = None
+            if attempt == 1 or not start_search_server():
+                raise
+    return ""
 
 @app.route("/", methods=["GET", "POST"])
 def index():
@@ -44,19 +82,12 @@ def index():
     if request.method == "POST":
         query = request.form.get("query", "").strip()
         if query:
-            proc = get_search_process()
-            if proc is None:
+            if not start_search_server():
                 error_msg = f"Index file not found ({INDEX_FILE}); запустите индексер."
             else:
                 try:
-                    proc.stdin.write(query + "\n")
-                    proc.stdin.flush()
-
-                    while True:
-                        line = proc.stdout.readline()
-                        if not line:
-                            break
-                        line = line.rstrip("\n").rstrip("\r")
+                    for line in query_server(query).split("\n"):
+                        line = line.rstrip("\r")
                         if line.strip() == "":
                             continue
                         if line.strip() == "---END---":
@@ -71,7 +102,7 @@ def index():
                         else:
                             results.append(line.strip())
                 except Exception as e:
-                    error_msg = f"Ошибка запуска search_cli: {e}"
+                    error_msg = f"Ошибка запроса к search_cli: {e}"
 
     html = """
     <!doctype html>
@@ -137,5 +168,17 @@ def index():
     """
     return render_template_string(html, query=query, results=results, found_count=found_count, error_msg=error_msg)
 
+@app.route("/stats")
+def stats():
+    """Stage times, counters and cache statistics of search_cli as JSON, for scraping."""
+    if not start_search_server():
+        return Response('{"error":"index not found"}\n', status=503, mimetype="application/json")
+    try:
+        reply = query_server("#stats json")
+    except OSError:
+        return Response('{"error":"search server unavailable"}\n', status=502, mimetype="application/json")
+    body = reply.split("---END---")[0].strip()
+    return Response(body + "\n", mimetype="application/json")
+
 if __name__ == "__main__":
-    app.run(port=5000)
+    app.run(port=5000, threaded=True)
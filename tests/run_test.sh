@@ -6,7 +6,26 @@ cd "$ROOT_DIR"
 
 echo "Running tests..."
 
-make all
+# Retries a command every 50 ms until it succeeds; fails after 10 s.
+wait_until() {
+    local deadline=$((SECONDS + 10))
+    until "$@"; do
+        [ $SECONDS -lt $deadline ] || return 1
+        sleep 0.05
+    done
+}
+
+# True once the server on socket $1 has loaded the manifest generation of index $2.
+serves_generation() {
+    local gen
+    gen=$(head -n 1 "$2.segments" | cut -d' ' -f2)
+    printf '#stats\n' | ./search_cli --connect "unix:$1" 2>/dev/null | grep -q "^Index generation $gen,"
+}
+
+make all tests/test_tokenizer tests/test_stemmer tests/test_rank tests/test_phrase tests/test_dictionary tests/test_boolean tests/test_cursor tests/test_sort tests/test_reorder
+
+./tests/test_tokenizer data/corpus
+./tests/test_stemmer dumps/main_index.bin.csv data/corpus
 
 TEST_CORPUS="tests/test_corpus"
 rm -rf "$TEST_CORPUS"
@@ -39,4 +58,326 @@ if echo "$OUTPUT" | grep -q "Found 0 documents"; then
     exit 2
 fi
 
+./index_builder --format mapped "$TEST_CORPUS" "tests/test_index_mapped.bin"
+
+MAPPED_OUTPUT=$(echo "kernel AND memory" | ./search_cli "tests/test_index_mapped.bin")
+if [ "$OUTPUT" != "$MAPPED_OUTPUT" ]; then
+    echo "Test failed: mapped index output differs from legacy index"
+    echo "$MAPPED_OUTPUT"
+    exit 3
+fi
+
+./index_builder --compress "$TEST_CORPUS" "tests/test_index_packed.bin"
+
+PACKED_OUTPUT=$(echo "kernel AND memory" | ./search_cli "tests/test_index_packed.bin")
+if [ "$OUTPUT" != "$PACKED_OUTPUT" ]; then
+    echo "Test failed: compressed index output differs from legacy index"
+    echo "$PACKED_OUTPUT"
+    exit 4
+fi
+
+python3 - <<'PYEOF'
+import struct
+data = bytearray(open("tests/test_index_packed.bin", "rb").read())
+struct.pack_into("<I", data, 12, struct.unpack_from("<I", data, 12)[0] | 1 << 31)
+open("tests/test_index_flags.bin", "wb").write(data)
+PYEOF
+if echo "kernel" | ./search_cli "tests/test_index_flags.bin" >/dev/null 2>&1; then
+    echo "Test failed: a mapped index with an unknown flag was opened"
+    exit 18
+fi
+python3 - <<'PYEOF'
+import struct
+data = bytearray(open("tests/test_index_packed.bin", "rb").read())
+flags = struct.unpack_from("<I", data, 12)[0]
+dict_offset = struct.unpack_from("<Q", data, 40 + 2 * 16)[0]
+struct.pack_into("<Q", data, dict_offset + (0 if flags & 1 << 4 else 8), 1 << 40)
+open("tests/test_index_flags.bin", "wb").write(data)
+PYEOF
+if echo "kernel" | ./search_cli "tests/test_index_flags.bin" >/dev/null 2>&1; then
+    echo "Test failed: a mapped index with a postings offset past its section was opened"
+    exit 18
+fi
+rm -f tests/test_index_flags.bin
+
+./tests/test_rank "tests/test_index_mapped.bin" "tests/test_index_packed.bin"
+./tests/test_dictionary "tests/test_index_mapped.bin" "tests/test_index_packed.bin"
+./tests/test_boolean
+./tests/test_cursor
+./tests/test_sort
+./tests/test_reorder
+
+RANKED_TOP=$(echo "memory kernel" | ./search_cli --rank --top 1 "tests/test_index_packed.bin" | sed -n 2p)
+if [ "$RANKED_TOP" != "doc0.txt" ]; then
+    echo "Test failed: ranked query did not put doc0.txt first (got '$RANKED_TOP')"
+    exit 7
+fi
+
+./index_builder --positions "$TEST_CORPUS" "tests/test_index_pos.bin"
+./tests/test_phrase "tests/test_index_pos.bin" "$TEST_CORPUS" 200
+
+PHRASE_HITS=$(printf '"slab allocators"\n"allocators slab"\nkernel NEAR/2 management\nkernel NEAR/1 management\nkernel NEAR/3 allocation\n' | ./search_cli "tests/test_index_pos.bin" | grep "^Found" | tr '\n' ' ')
+if [ "$PHRASE_HITS" != "Found 1 documents: Found 0 documents: Found 1 documents: Found 0 documents: Found 0 documents: " ]; then
+    echo "Test failed: phrase/NEAR queries returned '$PHRASE_HITS'"
+    exit 8
+fi
+
+PREFIX_QUERIES='journ*\nmemor* AND kern*\ntcp OR journ*\nzz*\nJOURN*\n'
+for PREFIX_INDEX in "tests/test_index.bin" "tests/test_index_pos.bin"; do
+    PREFIX_HITS=$(printf "$PREFIX_QUERIES" | ./search_cli "$PREFIX_INDEX" 2>/dev/null | grep -v '^Cache' | tr '\n' ' ')
+    if [ "$PREFIX_HITS" != "Found 1 documents: doc2.txt ---END--- Found 1 documents: doc0.txt ---END--- Found 2 documents: doc1.txt doc2.txt ---END--- Found 0 documents: ---END--- Found 1 documents: doc2.txt ---END--- " ]; then
+        echo "Test failed: prefix queries on $PREFIX_INDEX returned '$PREFIX_HITS'"
+        exit 13
+    fi
+done
+
+BOOLEAN_QUERIES='NOT kernel\nsystem AND NOT kernel\ntcp OR journaling AND kernel\n(tcp OR journaling) AND NOT crash\nkernel OR NOT (tcp OR journaling)\nNOT NOT tcp\n'
+for BOOLEAN_INDEX in "tests/test_index.bin" "tests/test_index_pos.bin"; do
+    BOOLEAN_HITS=$(printf "$BOOLEAN_QUERIES" | ./search_cli "$BOOLEAN_INDEX" 2>/dev/null | grep -v '^Cache' | tr '\n' ' ')
+    if [ "$BOOLEAN_HITS" != "Found 2 documents: doc1.txt doc2.txt ---END--- Found 1 documents: doc1.txt ---END--- Found 1 documents: doc1.txt ---END--- Found 1 documents: doc1.txt ---END--- Found 1 documents: doc0.txt ---END--- Found 1 documents: doc1.txt ---END--- " ]; then
+        echo "Test failed: NOT / parenthesized queries on $BOOLEAN_INDEX returned '$BOOLEAN_HITS'"
+        exit 14
+    fi
+done
+
+CACHE_QUERIES='Kernel and memory\nmemory AND kernel\nkernel OR tcp\ntcp OR kernel OR journaling\n"slab allocators" OR tcp\nkernel "slab allocators"\n'
+CACHED_OUTPUT=$(printf "${CACHE_QUERIES}#stats\n" | ./search_cli "tests/test_index_pos.bin" 2>/dev/null)
+UNCACHED_OUTPUT=$(printf "${CACHE_QUERIES}#stats\n" | ./search_cli --cache 0 "tests/test_index_pos.bin" 2>/dev/null)
+if [ "$(echo "$CACHED_OUTPUT" | grep -v '^Cache')" != "$(echo "$UNCACHED_OUTPUT" | grep -v '^Cache')" ] || \
+   ! echo "$CACHED_OUTPUT" | grep -q "^Cache results: 2 hits, 5 misses" || \
+   ! echo "$CACHED_OUTPUT" | grep -q "^Cache subexpressions: 1 hits"; then
+    echo "Test failed: cached answers or cache counters are wrong"
+    echo "$CACHED_OUTPUT"
+    exit 10
+fi
+
+# Answers with more than the 15 documents shown are cached too, estimated
+# counts included, and so are sub-expressions the cursors walk whole.
+TOPK_CORPUS="tests/test_corpus_topk"
+rm -rf "$TOPK_CORPUS"
+mkdir -p "$TOPK_CORPUS"
+for i in $(seq -w 1 300); do
+    if [ "$i" -le 20 ]; then echo "alpha beta gamma filler$i" > "$TOPK_CORPUS/doc$i.txt"
+    else echo "alpha beta filler$i" > "$TOPK_CORPUS/doc$i.txt"; fi
+done
+./index_builder --compress "$TOPK_CORPUS" "tests/test_index_topk.bin" >/dev/null 2>&1
+TOPK_QUERIES='gamma AND alpha\nAlpha and gamma\nalpha AND beta\nbeta alpha\n(gamma AND alpha) OR delta\n(alpha gamma) OR epsilon\n'
+TOPK_CACHED=$(printf "${TOPK_QUERIES}#stats\n" | ./search_cli "tests/test_index_topk.bin" 2>/dev/null)
+TOPK_UNCACHED=$(printf "${TOPK_QUERIES}#stats\n" | ./search_cli --cache 0 "tests/test_index_topk.bin" 2>/dev/null)
+if [ "$(echo "$TOPK_CACHED" | grep -v '^Cache')" != "$(echo "$TOPK_UNCACHED" | grep -v '^Cache')" ] || \
+   [ "$(echo "$TOPK_CACHED" | grep -c '^Found 20 documents')" != 4 ] || [ "$(echo "$TOPK_CACHED" | grep -c '^Found ~')" != 2 ] || \
+   ! echo "$TOPK_CACHED" | grep -q "^Cache results: 2 hits, 4 misses" || \
+   ! echo "$TOPK_CACHED" | grep -q "^Cache subexpressions: 1 hits, 1 misses"; then
+    echo "Test failed: answers with more than 15 documents or their sub-expressions were not cached"
+    echo "$TOPK_CACHED" | grep -v '^doc'
+    exit 10
+fi
+rm -rf "$TOPK_CORPUS" tests/test_index_topk.bin*
+
+EXPLAIN_OUTPUT=$(printf 'EXPLAIN kernel AND NOT tcp\nkernel AND NOT tcp\n#stats json\n' | ./search_cli --cache 0 "tests/test_index_packed.bin" 2>/dev/null)
+EXPLAIN_ANSWER=$(echo "$EXPLAIN_OUTPUT" | sed -n '/^Found/,/^---END---/p' | grep -v '^Stage\|^Read\|^Total')
+if ! echo "$EXPLAIN_OUTPUT" | grep -q '^Plan: &(!tcp,kernel)$' || \
+   ! echo "$EXPLAIN_OUTPUT" | grep -q '^    TERM kernel: lists 1, postings 1$' || \
+   ! echo "$EXPLAIN_OUTPUT" | grep -q '^Stage parse ' || ! echo "$EXPLAIN_OUTPUT" | grep -q '^Stage lookup ' || \
+   ! echo "$EXPLAIN_OUTPUT" | grep -q '^Read 2 lists, 2 postings' || \
+   [ "$(echo "$EXPLAIN_ANSWER" | sed -n 1,3p)" != "$(echo "$EXPLAIN_ANSWER" | sed -n 4,6p)" ] || \
+   ! echo "$EXPLAIN_OUTPUT" | grep -q '^{"trace":{"enabled":true,.*"queries":2,'; then
+    echo "Test failed: EXPLAIN or #stats json output is wrong"
+    echo "$EXPLAIN_OUTPUT"
+    exit 16
+fi
+
+printf 'q1\tkernel AND memory\nq2 journaling OR tcp\nslab\n' > tests/test_batch.txt
+BATCH_OUTPUT=$(./search_cli --batch tests/test_batch.txt --threads 2 "tests/test_index_pos.bin" 2>/dev/null | tr '\n' ' ')
+rm -f tests/test_batch.txt
+if [ "$BATCH_OUTPUT" != "q1 doc0.txt 1 q2 doc1.txt 1 q2 doc2.txt 2 q3 doc0.txt 1 " ]; then
+    echo "Test failed: batch mode returned '$BATCH_OUTPUT'"
+    exit 11
+fi
+
+SEG_CORPUS="tests/test_corpus_seg"
+rm -rf "$SEG_CORPUS" tests/test_index_seg.bin*
+mkdir -p "$SEG_CORPUS"
+cp "$TEST_CORPUS/doc0.txt" "$TEST_CORPUS/doc1.txt" "$SEG_CORPUS/"
+./index_builder --compress "$SEG_CORPUS" "tests/test_index_seg.bin" >/dev/null
+cp "$TEST_CORPUS/doc2.txt" "$SEG_CORPUS/"
+./index_builder --append --merge "$SEG_CORPUS" "tests/test_index_seg.bin"
+rm "$SEG_CORPUS/doc1.txt"
+./index_builder --append --merge "$SEG_CORPUS" "tests/test_index_seg.bin"
+SEG_HITS=$(printf 'journaling
+tcp
+kernel OR journaling
+NOT tcp
+' | ./search_cli "tests/test_index_seg.bin" 2>/dev/null | grep -v '^Cache' | tr '\n' ' ')
+./index_builder --merge-all "tests/test_index_seg.bin"
+./index_builder --compress "$SEG_CORPUS" "tests/test_index_seg_full.bin" >/dev/null
+SEG_MERGED="tests/$(sed -n 2p tests/test_index_seg.bin.segments | cut -d' ' -f1)"
+if [ "$SEG_HITS" != "Found 1 documents: doc2.txt ---END--- Found 0 documents: ---END--- Found 2 documents: doc0.txt doc2.txt ---END--- Found 2 documents: doc0.txt doc2.txt ---END--- " ] || \
+   [ "$SEG_MERGED" != "tests/test_index_seg.bin" ] || ! cmp -s "$SEG_MERGED" "tests/test_index_seg_full.bin"; then
+    echo "Test failed: appended segments returned '$SEG_HITS' or the full merge did not replace the base index with a full build"
+    exit 12
+fi
+if [ -e "tests/test_index_seg.bin.lock" ]; then
+    echo "Test failed: --append left a lock file behind"
+    exit 12
+fi
+if ./index_builder --append "$SEG_CORPUS" "tests/test_index_seg space.bin" 2>/dev/null || [ -e "tests/test_index_seg space.bin.segments" ]; then
+    echo "Test failed: --append accepted an index name the manifest cannot hold"
+    exit 12
+fi
+
+# --append merges in the foreground unless --background-merge detaches the
+# merge, which then logs to <index>.merge.log.
+cp "$TEST_CORPUS/doc1.txt" "$SEG_CORPUS/doc1.txt"
+rm -f "$SEG_CORPUS/doc2.txt"
+./index_builder --compress "$SEG_CORPUS" "tests/test_index_bg.bin" >/dev/null
+cp "$TEST_CORPUS/doc2.txt" "$SEG_CORPUS/"
+./index_builder --append "$SEG_CORPUS" "tests/test_index_bg.bin" 2>/dev/null
+echo "quokka wallaby" > "$SEG_CORPUS/doc3.txt"
+./index_builder --append "$SEG_CORPUS" "tests/test_index_bg.bin" 2>/dev/null
+BG_FOREGROUND=$(wc -l < tests/test_index_bg.bin.segments)
+echo "wallaby" > "$SEG_CORPUS/doc4.txt"
+BG_OUTPUT=$(./index_builder --append --background-merge "$SEG_CORPUS" "tests/test_index_bg.bin" 2>&1 | tr '\n' ' ')
+merged_in_background() {
+    grep -q '^Merged 4 segments' tests/test_index_bg.bin.merge.log 2>/dev/null && \
+        [ "$(wc -l < tests/test_index_bg.bin.segments)" = 2 ]
+}
+if [ "$BG_FOREGROUND" != 4 ] || [[ "$BG_OUTPUT" != *"Merging in the background"* ]] || [[ "$BG_OUTPUT" == *Merged* ]] || \
+   ! wait_until merged_in_background; then
+    echo "Test failed: --background-merge did not merge in a detached process ('$BG_OUTPUT', $BG_FOREGROUND manifest lines)"
+    exit 12
+fi
+rm -f "$SEG_CORPUS/doc1.txt" "$SEG_CORPUS/doc3.txt" "$SEG_CORPUS/doc4.txt" tests/test_index_bg.bin*
+# A --compress --positions append onto a raw index keeps the raw format, so
+# merging it back gives what a full raw build gives.
+rm -f "$SEG_CORPUS/doc1.txt" "$SEG_CORPUS/doc2.txt"
+./index_builder --format mapped "$SEG_CORPUS" "tests/test_index_fmt.bin" >/dev/null 2>&1
+cp "$TEST_CORPUS/doc2.txt" "$SEG_CORPUS/"
+FMT_WARNING=$(./index_builder --append --compress --positions "$SEG_CORPUS" "tests/test_index_fmt.bin" 2>&1 | grep -c '^Warning' || true)
+./index_builder --merge-all "tests/test_index_fmt.bin" 2>/dev/null
+./index_builder --format mapped "$SEG_CORPUS" "tests/test_index_fmt_full.bin" >/dev/null 2>&1
+if [ "$FMT_WARNING" != 1 ] || ! cmp -s "tests/test_index_fmt.bin" "tests/test_index_fmt_full.bin"; then
+    echo "Test failed: an append in another format changed the format of the merged index ($FMT_WARNING warnings)"
+    exit 12
+fi
+rm -f tests/test_index_fmt.bin* tests/test_index_fmt_full.bin*
+
+# An edit that keeps the file's old mtime (as cp -p, rsync -t or touch -r
+# leave it) is picked up by the next append, which reindexes only that file.
+# A running server picks up the new manifest generations of --append and
+# --merge-all.
+./index_builder --compress "$SEG_CORPUS" "tests/test_index_scan.bin" >/dev/null
+SCAN_SOCK="tests/test_scan.sock"
+./search_cli --serve "unix:$SCAN_SOCK" "tests/test_index_scan.bin" 2>/dev/null &
+SCAN_PID=$!
+if ! wait_until test -S "$SCAN_SOCK"; then
+    echo "Test failed: the server did not open $SCAN_SOCK"
+    kill $SCAN_PID
+    exit 12
+fi
+SCAN_BEFORE=$(echo quokka | ./search_cli --connect "unix:$SCAN_SOCK" | tr '\n' ' ')
+touch -r "$SEG_CORPUS/doc0.txt" "tests/test_index_scan.bin.stamp"
+echo "quokka" >> "$SEG_CORPUS/doc0.txt"
+touch -r "tests/test_index_scan.bin.stamp" "$SEG_CORPUS/doc0.txt"
+SCAN_APPENDED=$(./index_builder --append "$SEG_CORPUS" "tests/test_index_scan.bin" 2>&1 | grep '^Appended' | cut -d';' -f1)
+SCAN_HITS=$(echo quokka | ./search_cli "tests/test_index_scan.bin" 2>/dev/null | grep -v '^Cache' | tr '\n' ' ')
+SCAN_RELOADED=0
+wait_until serves_generation "$SCAN_SOCK" "tests/test_index_scan.bin" && SCAN_RELOADED=$((SCAN_RELOADED + 1))
+SCAN_SERVED=$(printf 'quokka\njournaling OR quokka\n' | ./search_cli --connect "unix:$SCAN_SOCK" | tr '\n' ' ')
+./index_builder --merge-all "tests/test_index_scan.bin" 2>/dev/null
+wait_until serves_generation "$SCAN_SOCK" "tests/test_index_scan.bin" && SCAN_RELOADED=$((SCAN_RELOADED + 1))
+SCAN_MERGED=$(printf 'quokka\njournaling OR quokka\n' | ./search_cli --connect "unix:$SCAN_SOCK" | tr '\n' ' ')
+kill $SCAN_PID
+rm -f "$SCAN_SOCK"
+if [ "$SCAN_HITS" != "Found 1 documents: doc0.txt ---END--- " ] || [ "$SCAN_APPENDED" != "Appended 1 documents, deleted 0" ]; then
+    echo "Test failed: an edit that kept the old mtime was missed by --append: '$SCAN_HITS' ($SCAN_APPENDED)"
+    exit 12
+fi
+if [ "$SCAN_BEFORE" != "Found 0 documents: ---END--- " ] || [ $SCAN_RELOADED != 2 ] || [ "$SCAN_SERVED" != "$SCAN_MERGED" ] || \
+   [ "$SCAN_SERVED" != "Found 1 documents: doc0.txt ---END--- Found 2 documents: doc2.txt doc0.txt ---END--- " ]; then
+    echo "Test failed: the server did not reload the index ($SCAN_RELOADED of 2 generations): '$SCAN_BEFORE' '$SCAN_SERVED' '$SCAN_MERGED'"
+    exit 12
+fi
+rm -rf "$SEG_CORPUS" tests/test_index_seg.bin* tests/test_index_seg_full.bin* tests/test_index_scan.bin*
+
+SERVER_SOCK="tests/test_server.sock"
+./search_cli --serve "unix:$SERVER_SOCK" --threads 2 "tests/test_index_pos.bin" 2>/dev/null &
+SERVER_PID=$!
+if ! wait_until test -S "$SERVER_SOCK"; then
+    echo "Test failed: the server did not open $SERVER_SOCK"
+    kill $SERVER_PID
+    exit 9
+fi
+# More stalled clients than workers, each with half a frame sent; the client
+# holds them until it is killed.
+STALLED_READY="tests/test_server.stalled"
+rm -f "$STALLED_READY"
+python3 -c '
+import signal, socket, sys
+conns = []
+for _ in range(8):
+    s = socket.socket(socket.AF_UNIX)
+    s.connect(sys.argv[1])
+    s.send(b"\x40\x00\x00\x00kern")
+    conns.append(s)
+open(sys.argv[2], "w").close()
+signal.pause()
+' "$SERVER_SOCK" "$STALLED_READY" &
+STALLED_PID=$!
+wait_until test -e "$STALLED_READY"
+rm -f "$STALLED_READY"
+SERVER_QUERIES='kernel AND memory\n"slab allocators"\njournaling OR tcp\nnosuchterm\n'
+SERVER_OUTPUT=$(printf "$SERVER_QUERIES" | timeout 5 ./search_cli --connect "unix:$SERVER_SOCK")
+kill $STALLED_PID 2>/dev/null
+LOCAL_OUTPUT=$(printf "$SERVER_QUERIES" | ./search_cli "tests/test_index_pos.bin" 2>/dev/null)
+kill $SERVER_PID
+rm -f "$SERVER_SOCK"
+if [ "$SERVER_OUTPUT" != "$LOCAL_OUTPUT" ] || [ -z "$SERVER_OUTPUT" ]; then
+    echo "Test failed: server answers differ from stdin mode or stalled clients blocked it"
+    echo "$SERVER_OUTPUT"
+    exit 9
+fi
+
+./index_builder -j 2 "$TEST_CORPUS" "tests/test_index_mt.bin"
+if ! cmp -s "tests/test_index.bin" "tests/test_index_mt.bin"; then
+    echo "Test failed: multi-threaded index differs from single-threaded index"
+    exit 5
+fi
+
+./index_builder --mem-limit 1K "$TEST_CORPUS" "tests/test_index_spimi.bin"
+if ! cmp -s "tests/test_index.bin" "tests/test_index_spimi.bin"; then
+    echo "Test failed: SPIMI index differs from in-memory index"
+    exit 6
+fi
+
+python3 src/corpus_pack.py "$TEST_CORPUS" "tests/test_corpus.pack"
+PACK_LOG=$(./index_builder "tests/test_corpus.pack" "tests/test_index_pack.bin" 2>&1)
+TRACE_LOG=$(./index_builder --trace "tests/test_corpus.pack" "tests/test_index_pack.bin" 2>&1)
+if echo "$PACK_LOG" | grep -q '^Stage \|^Traced ' || ! echo "$TRACE_LOG" | grep -q '^Traced 3 documents'; then
+    echo "Test failed: stage report printed without --trace or missing with it"
+    exit 19
+fi
+./index_builder -j 2 --compress "tests/test_corpus.pack" "tests/test_index_pack_j2.bin"
+if ! cmp -s "tests/test_index.bin" "tests/test_index_pack.bin" || ! cmp -s "tests/test_index_packed.bin" "tests/test_index_pack_j2.bin"; then
+    echo "Test failed: index built from the packed corpus differs from the directory build"
+    exit 15
+fi
+
+REORDER_CORPUS="tests/test_corpus_reorder"
+rm -rf "$REORDER_CORPUS"
+mkdir -p "$REORDER_CORPUS"
+ls data/corpus | head -60 | while read -r f; do cp "data/corpus/$f" "$REORDER_CORPUS/"; done
+printf 'q1 linux\nq2 linux AND NOT windows\nq3 "open source"\nq4 kern* OR google\n' > tests/test_batch.txt
+./index_builder --positions "$REORDER_CORPUS" "tests/test_index_order.bin" >/dev/null 2>&1
+./index_builder --positions --reorder "$REORDER_CORPUS" "tests/test_index_reorder.bin" >/dev/null 2>&1
+./index_builder --positions --reorder -j 2 "$REORDER_CORPUS" "tests/test_index_reorder_j2.bin" >/dev/null 2>&1
+ORDER_HITS=$(./search_cli --batch tests/test_batch.txt --top 1000 "tests/test_index_order.bin" 2>/dev/null | cut -d' ' -f1,2 | sort)
+REORDER_HITS=$(./search_cli --batch tests/test_batch.txt --top 1000 "tests/test_index_reorder.bin" 2>/dev/null | cut -d' ' -f1,2 | sort)
+rm -rf "$REORDER_CORPUS" tests/test_batch.txt
+if [ -z "$ORDER_HITS" ] || [ "$ORDER_HITS" != "$REORDER_HITS" ] || ! cmp -s "tests/test_index_reorder.bin" "tests/test_index_reorder_j2.bin"; then
+    echo "Test failed: reordered index returns other documents or depends on -j"
+    exit 17
+fi
+rm -f tests/test_index_order.bin* tests/test_index_reorder.bin* tests/test_index_reorder_j2.bin*
+
 echo "Test passed."
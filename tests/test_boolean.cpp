@@ -0,0 +1,141 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_postings.h"
+#include "../include/sch_intersect.h"
+#include "../include/sch_boolean.h"
+#include "test_util.h"
+
+// Checks SchDocSet and the n-ary AND / OR / NOT executors against a plain
+// bool-per-document evaluation, over lists from very sparse to nearly full
+// (so both array and bitmap chunks, and both sorted-list and set values, are
+// exercised), given as raw arrays and as compressed postings.
+
+static SchTestRng rng(9090);
+
+static int failures = 0;
+
+static SchBoolValue leaf(const TestList& l) {
+    SchBoolValue v;
+    v.borrowed = true;
+    v.view = rng(2) ? SchPostingView(l.ids) : SchPostingView(l.encoded.begin(), l.ids.size());
+    return v;
+}
+
+static void check(const char* what, const SchBoolValue& v, const SchVector<char>& expected) {
+    SchVector<int> got;
+    v.to_ids(got);
+    size_t k = 0;
+    bool ok = true;
+    for (size_t d = 0; d < expected.size() && ok; ++d) {
+        if (!expected[d]) continue;
+        ok = k < got.size() && got[k] == (int)d;
+        ++k;
+    }
+    ok = ok && k == got.size();
+    if (!ok) {
+        if (failures < 10) fprintf(stderr, "%s: %zu ids (%s), wrong\n", what, got.size(), v.dense ? "set" : "list");
+        failures++;
+    }
+}
+
+static void check_queries() {
+    int queries = 0, dense = 0;
+    for (int q = 0; q < 200; ++q) {
+        size_t universe = 1 + rng(q % 4 ? 3000 : 200000);
+        SchVector<TestList> lists;
+        size_t n = 1 + rng(6);
+        for (size_t i = 0; i < n; ++i) {
+            lists.push_back(TestList());
+            make_list(lists[i], universe, rng, false);
+        }
+        size_t npos = rng(n + 1);
+        SchVector<SchBoolValue> pos, neg, kids;
+        SchVector<char> all_or, all_and;
+        for (size_t d = 0; d < universe; ++d) {
+            bool o = false, a = true;
+            for (size_t i = 0; i < n; ++i) {
+                o = o || lists[i].member[d];
+                a = a && (i < npos ? lists[i].member[d] : !lists[i].member[d]);
+            }
+            all_or.push_back(o);
+            all_and.push_back(a);
+        }
+        for (size_t i = 0; i < n; ++i) kids.push_back(leaf(lists[i]));
+        SchBoolValue or_value;
+        sch_bool_or(kids.begin(), kids.size(), universe, or_value);
+        check("OR", or_value, all_or);
+        // Kids of the AND are themselves OR results half of the time, so dense
+        // values meet sorted lists.
+        for (size_t i = 0; i < n; ++i) {
+            SchVector<SchBoolValue>& into = i < npos ? pos : neg;
+            into.push_back(SchBoolValue());
+            SchBoolValue one = leaf(lists[i]);
+            if (rng(2)) sch_bool_or(&one, 1, universe, into[into.size() - 1]);
+            else into[into.size() - 1] = one;
+        }
+        SchBoolValue and_value;
+        sch_bool_and(pos.begin(), pos.size(), neg.begin(), neg.size(), universe, and_value);
+        check("AND NOT", and_value, all_and);
+        dense += or_value.dense + and_value.dense;
+        queries++;
+    }
+    printf("%d boolean queries match the per-document evaluation (%d dense results)\n", queries, dense);
+}
+
+static void check_set_ops() {
+    size_t universe = 300000;
+    TestList a, b;
+    make_list(a, universe, rng, false);
+    make_list(b, universe, rng, false);
+    SchDocSet s, t;
+    s.reset(universe);
+    s.add(SchPostingView(a.ids));
+    t.reset(universe);
+    t.add(SchPostingView(b.encoded.begin(), b.ids.size()));
+    t.optimize();
+    SchDocSet u = s;
+    u.add(t);
+    SchDocSet i = s;
+    i.intersect(t);
+    SchDocSet m = s;
+    m.remove(t);
+    SchDocSet c;
+    c.reset(universe);
+    c.fill();
+    c.remove(SchPostingView(a.ids));
+    u.optimize();
+    i.optimize();
+    m.optimize();
+    c.optimize();
+    s.optimize();
+    size_t nu = 0, ni = 0, nm = 0, nc = 0;
+    for (size_t d = 0; d < universe; ++d) {
+        bool x = a.member[d], y = b.member[d];
+        nu += x || y;
+        ni += x && y;
+        nm += x && !y;
+        nc += !x;
+        if (u.contains((uint32_t)d) != (x || y) || i.contains((uint32_t)d) != (x && y) || m.contains((uint32_t)d) != (x && !y) ||
+            c.contains((uint32_t)d) != !x || s.contains((uint32_t)d) != x) {
+            if (failures < 10) fprintf(stderr, "Set operations disagree at doc %zu\n", d);
+            failures++;
+        }
+    }
+    if (u.size() != nu || i.size() != ni || m.size() != nm || c.size() != nc || s.size() != a.ids.size()) {
+        fprintf(stderr, "Set sizes are wrong\n");
+        failures++;
+    }
+    printf("Doc set operations on %zu + %zu ids match\n", a.ids.size(), b.ids.size());
+}
+
+int main() {
+    for (int r = 0; r < 4; ++r) check_set_ops();
+    check_queries();
+    if (failures) {
+        fprintf(stderr, "Boolean test FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_postings.h"
+#include "../include/sch_intersect.h"
+#include "../include/sch_cursor.h"
+#include "test_util.h"
+
+// Checks the document-at-a-time cursors against a bool-per-document
+// evaluation: full walks with next() over AND (with NOT kids), OR, bare NOT and
+// nested trees, and walks mixing next() with advance_to() jumps, over raw and
+// compressed lists from very sparse to nearly full and clustered.
+
+static SchTestRng rng(2121);
+
+static int failures = 0;
+
+static SchDocCursor* leaf(const TestList& l) {
+    if (rng(3) == 0) {
+        SchVector<int> copy = l.ids;
+        return new SchPostingCursor(std::move(copy));
+    }
+    return new SchPostingCursor(rng(2) ? SchPostingView(l.ids) : SchPostingView(l.encoded.begin(), l.ids.size()));
+}
+
+// Walks c, jumping ahead with advance_to() now and then, and compares every
+// document it stands on with the expected membership.
+static void check(const char* what, SchDocCursor* c, const SchVector<char>& expected, bool jumps) {
+    size_t universe = expected.size();
+    size_t d = 0;
+    bool ok = true;
+    while (ok) {
+        while (d < universe && !expected[d]) ++d;
+        int32_t want = d < universe ? (int32_t)d : SCH_DOC_END;
+        ok = c->doc() == want;
+        if (want == SCH_DOC_END) break;
+        if (jumps && rng(4) == 0) {
+            d += 1 + rng(universe / 8 + 1);
+            c->advance_to((int32_t)d);
+        } else {
+            ++d;
+            c->next();
+        }
+    }
+    if (!ok) {
+        if (failures < 10) fprintf(stderr, "%s: cursor at %d, expected doc %zu\n", what, c->doc(), d);
+        failures++;
+    }
+    delete c;
+}
+
+int main() {
+    int queries = 0;
+    for (int q = 0; q < 300; ++q) {
+        size_t universe = 1 + rng(q % 4 ? 3000 : 200000);
+        size_t n = 1 + rng(5);
+        SchVector<TestList> lists;
+        for (size_t i = 0; i < n; ++i) {
+            lists.push_back(TestList());
+            make_list(lists[i], universe, rng, true);
+        }
+        size_t npos = rng(n + 1);
+        SchVector<char> all_or, all_and, not_first, nested;
+        for (size_t d = 0; d < universe; ++d) {
+            bool o = false, a = true;
+            for (size_t i = 0; i < n; ++i) {
+                o = o || lists[i].member[d];
+                a = a && (i < npos ? lists[i].member[d] : !lists[i].member[d]);
+            }
+            all_or.push_back(o);
+            all_and.push_back(a);
+            not_first.push_back(!lists[0].member[d]);
+            nested.push_back(o && lists[n - 1].member[d]);
+        }
+        for (int jumps = 0; jumps < 2; ++jumps) {
+            SchVector<SchDocCursor*> kids, pos, neg;
+            for (size_t i = 0; i < n; ++i) kids.push_back(leaf(lists[i]));
+            check("OR", new SchOrCursor(kids), all_or, jumps);
+
+            for (size_t i = 0; i < n; ++i) (i < npos ? pos : neg).push_back(leaf(lists[i]));
+            if (pos.size() == 0) pos.push_back(new SchRangeCursor(universe));
+            check("AND NOT", new SchAndCursor(pos, neg), all_and, jumps);
+
+            pos.push_back(new SchRangeCursor(universe));
+            neg.push_back(leaf(lists[0]));
+            check("NOT", new SchAndCursor(pos, neg), not_first, jumps);
+
+            for (size_t i = 0; i < n; ++i) kids.push_back(leaf(lists[i]));
+            pos.push_back(new SchOrCursor(kids));
+            pos.push_back(leaf(lists[n - 1]));
+            check("(OR) AND", new SchAndCursor(pos, neg), nested, jumps);
+        }
+        queries++;
+    }
+    if (failures) {
+        fprintf(stderr, "Cursor test FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("%d cursor trees match the per-document evaluation\n", queries);
+    return 0;
+}
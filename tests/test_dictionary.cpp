@@ -0,0 +1,171 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_dictionary.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_intersect.h"
+#include "test_util.h"
+
+// Checks the front-coded dictionary (lookups, lower bounds and prefix ranges
+// against a sorted word list, then every term of the given mapped indexes)
+// and the heap-based multiway union against pairwise merges.
+
+static SchTestRng rng(1818);
+
+static int failures = 0;
+
+static void fail(const char* what, const char* key) {
+    if (failures < 10) fprintf(stderr, "%s for \"%s\"\n", what, key);
+    failures++;
+}
+
+// Words over a small alphabet, so that long shared prefixes are common.
+static SchString random_word() {
+    char buf[16];
+    size_t n = 1 + rng(10);
+    for (size_t i = 0; i < n; ++i) buf[i] = "abcde\xff"[rng(i < 3 ? 3 : 6)];
+    return SchString(buf, n);
+}
+
+static bool word_less(const SchString& a, const SchString& b) {
+    size_t n = a.size() < b.size() ? a.size() : b.size();
+    int c = std::memcmp(a.c_str(), b.c_str(), n);
+    return c ? c < 0 : a.size() < b.size();
+}
+
+static size_t scan_lower_bound(const SchVector<SchString>& words, const SchString& key) {
+    size_t i = 0;
+    while (i < words.size() && word_less(words[i], key)) ++i;
+    return i;
+}
+
+static void check_words() {
+    SchVector<SchString> words;
+    for (int i = 0; i < 3000; ++i) words.push_back(random_word());
+    std::sort(words.begin(), words.end(), word_less);
+    size_t n = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (n && words[i] == words[n - 1]) continue;
+        words[n++] = words[i];
+    }
+    while (words.size() > n) words.pop_back();
+
+    SchFrontCoder coder;
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (!coder.add(words[i].c_str(), words[i].size())) fail("Sorted word rejected", words[i].c_str());
+    }
+    if (coder.add(words[0].c_str(), words[0].size())) fail("Out of order word accepted", words[0].c_str());
+    SchFrontDict dict(coder);
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (!(dict.term(i) == words[i])) fail("Decoded term differs", words[i].c_str());
+        if (dict.find(words[i].c_str(), words[i].size()) != (long)i) fail("Term not found", words[i].c_str());
+    }
+    for (int q = 0; q < 5000; ++q) {
+        SchString key = random_word();
+        bool found = false;
+        size_t got = dict.lower_bound(key.c_str(), key.size(), &found);
+        size_t expected = scan_lower_bound(words, key);
+        if (got != expected || found != (expected < words.size() && words[expected] == key)) fail("Wrong lower bound", key.c_str());
+        size_t plen = 1 + rng(key.size());
+        size_t first = 0, last = 0, count = 0;
+        dict.prefix_range(key.c_str(), plen, &first, &last);
+        for (size_t i = 0; i < words.size(); ++i) {
+            bool match = words[i].size() >= plen && std::memcmp(words[i].c_str(), key.c_str(), plen) == 0;
+            if (match && (i < first || i >= last)) fail("Prefix match outside the range", words[i].c_str());
+            count += match;
+        }
+        if (last - first != count) fail("Wrong prefix range", key.c_str());
+    }
+    size_t plain = 0;
+    for (size_t i = 0; i < words.size(); ++i) plain += words[i].size() + 1;
+    printf("Front-coded dictionary: %zu words in %zu bytes (%zu as plain strings)\n", words.size(), coder.bytes.size(), plain);
+}
+
+static void check_index(const char* path) {
+    SchMappedIndex idx;
+    if (!idx.open(path)) { fprintf(stderr, "Cannot open mapped index %s\n", path); failures++; return; }
+    SchString prev;
+    for (size_t t = 0; t < idx.vocab_size(); ++t) {
+        SchString term = idx.term_at(t);
+        if (t && !word_less(prev, term)) fail("Dictionary not sorted at", term.c_str());
+        if (idx.find_term(term.c_str(), term.size()) != (long)t) fail("Index term not found", term.c_str());
+        prev = term;
+    }
+    for (int q = 0; q < 200 && idx.vocab_size(); ++q) {
+        SchString term = idx.term_at(rng(idx.vocab_size()));
+        size_t plen = 1 + rng(term.size());
+        size_t first = 0, last = 0;
+        idx.prefix_range(term.c_str(), plen, &first, &last);
+        bool ok = first < last && (first == 0 || std::strncmp(idx.term_at(first - 1).c_str(), term.c_str(), plen) != 0) &&
+                  (last == idx.vocab_size() || std::strncmp(idx.term_at(last).c_str(), term.c_str(), plen) != 0);
+        for (size_t i = first; ok && i < last; ++i) ok = std::strncmp(idx.term_at(i).c_str(), term.c_str(), plen) == 0;
+        if (!ok) fail("Wrong index prefix range", term.c_str());
+    }
+    printf("%s: %zu terms round-trip\n", path, (size_t)idx.vocab_size());
+}
+
+static SchVector<int> pairwise_union(const SchVector< SchVector<int> >& lists) {
+    SchVector<int> acc;
+    for (size_t l = 0; l < lists.size(); ++l) {
+        SchVector<int> next;
+        size_t i = 0, j = 0;
+        const SchVector<int>& b = lists[l];
+        while (i < acc.size() || j < b.size()) {
+            if (j == b.size() || (i < acc.size() && acc[i] < b[j])) next.push_back(acc[i++]);
+            else if (i == acc.size() || b[j] < acc[i]) next.push_back(b[j++]);
+            else { next.push_back(acc[i]); ++i; ++j; }
+        }
+        acc = next;
+    }
+    return acc;
+}
+
+static void check_union() {
+    int queries = 0;
+    for (int q = 0; q < 300; ++q) {
+        SchVector< SchVector<int> > lists;
+        for (size_t l = rng(40); l > 0; --l) lists.push_back(SchVector<int>());
+        SchVector<unsigned char> encoded;
+        SchVector<size_t> offsets;
+        for (size_t l = 0; l < lists.size(); ++l) {
+            size_t n = rng(4) == 0 ? rng(1000) : rng(20);
+            int id = (int)rng(50);
+            for (size_t i = 0; i < n; ++i) {
+                lists[l].push_back(id);
+                id += 1 + (int)rng(q % 2 ? 3 : 300);
+            }
+            offsets.push_back(sch_encode_postings(lists[l].begin(), lists[l].size(), encoded));
+        }
+        for (size_t i = 0; i < SCH_CODEC_SLACK; ++i) encoded.push_back(0);
+        SchVector<SchPostingView> views;
+        for (size_t l = 0; l < lists.size(); ++l) {
+            if (l % 2) views.push_back(SchPostingView(encoded.begin() + offsets[l], lists[l].size()));
+            else views.push_back(SchPostingView(lists[l]));
+        }
+        SchVector<int> got;
+        sch_union_all(views.begin(), views.size(), got);
+        SchVector<int> expected = pairwise_union(lists);
+        bool ok = got.size() == expected.size();
+        for (size_t i = 0; ok && i < got.size(); ++i) ok = got[i] == expected[i];
+        if (!ok) {
+            if (failures < 10) fprintf(stderr, "Union of %zu lists: %zu ids, expected %zu\n", lists.size(), got.size(), expected.size());
+            failures++;
+        }
+        queries++;
+    }
+    printf("%d multiway unions match pairwise merges\n", queries);
+}
+
+int main(int argc, char* argv[]) {
+    check_words();
+    for (int a = 1; a < argc; ++a) check_index(argv[a]);
+    check_union();
+    if (failures) {
+        fprintf(stderr, "Dictionary test FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+    return 0;
+}
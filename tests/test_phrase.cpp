@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_string_utils.h"
+#include "../include/sch_stemmer.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_positions.h"
+#include "test_util.h"
+
+// Checks phrase and NEAR matching on a positional index against a scan of the
+// tokenized corpus the index was built from.
+
+static SchTestRng rng(4242);
+
+static SchVector< SchVector<int32_t> > docs;
+
+static bool load_docs(const SchMappedIndex& idx, const char* corpus) {
+    docs.resize(idx.doc_count());
+    SchVector<char> buf;
+    for (size_t d = 0; d < idx.doc_count(); ++d) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", corpus, idx.doc_name(d));
+        FILE* f = fopen(path, "rb");
+        if (!f) { fprintf(stderr, "Cannot open %s\n", path); return false; }
+        fseek(f, 0, SEEK_END);
+        long sz = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        buf.resize(sz > 0 ? (size_t)sz : 0);
+        size_t n = sz > 0 ? fread(buf.begin(), 1, (size_t)sz, f) : 0;
+        fclose(f);
+        SchVector<int32_t>& toks = docs[d];
+        sch_tokenize_inplace(buf.begin(), n, [&](char* tok, size_t len) {
+            len = sch_stem_inplace(tok, len);
+            toks.push_back((int32_t)idx.find_term(tok, len));
+        });
+    }
+    return true;
+}
+
+static bool doc_matches(const SchVector<int32_t>& toks, const SchProximityTerm* w, size_t n, size_t at, size_t word) {
+    if (word == n) return true;
+    long lo = (long)at + w[word].lo, hi = (long)at + w[word].hi;
+    for (long p = lo < 0 ? 0 : lo; p <= hi && p < (long)toks.size(); ++p) {
+        if (toks[(size_t)p] == (int32_t)w[word].term && doc_matches(toks, w, n, (size_t)p, word + 1)) return true;
+    }
+    return false;
+}
+
+static SchVector<int> scan(const SchProximityTerm* w, size_t n) {
+    SchVector<int> out;
+    for (size_t d = 0; d < docs.size(); ++d) {
+        const SchVector<int32_t>& toks = docs[d];
+        bool hit = false;
+        for (size_t p = 0; p < toks.size() && !hit; ++p) {
+            hit = toks[p] == (int32_t)w[0].term && doc_matches(toks, w, n, p, 1);
+        }
+        if (hit) out.push_back((int)d);
+    }
+    return out;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <positional_index> <corpus_dir> [queries]\n", argv[0]);
+        return 1;
+    }
+    SchMappedIndex idx;
+    if (!idx.open(argv[1]) || !idx.has_positions()) { fprintf(stderr, "Need an index built with --positions: %s\n", argv[1]); return 1; }
+    if (!load_docs(idx, argv[2])) return 1;
+    int nqueries = argc > 3 ? std::atoi(argv[3]) : 300;
+
+    int failures = 0, matched = 0;
+    for (int q = 0; q < nqueries; ++q) {
+        size_t d = rng(docs.size());
+        const SchVector<int32_t>& toks = docs[d];
+        if (toks.size() < 4) continue;
+        SchProximityTerm w[3];
+        size_t n = 2 + rng(2);
+        size_t start = rng(toks.size() - n);
+        int kind = q % 3;
+        for (size_t i = 0; i < n; ++i) {
+            w[i].term = (size_t)toks[start + i];
+            w[i].lo = w[i].hi = 1;
+        }
+        if (kind == 1) {
+            n = 2;
+            int32_t k = 1 + (int32_t)rng(6);
+            size_t other = start + 1 + rng(8);
+            if (other < toks.size()) w[1].term = (size_t)toks[other];
+            w[1].lo = -k;
+            w[1].hi = k;
+        } else if (kind == 2) {
+            w[1].term = (size_t)toks[rng(toks.size())];
+        }
+        SchVector<int> got = sch_proximity_match(idx, w, n);
+        SchVector<int> expected = scan(w, n);
+        bool ok = got.size() == expected.size();
+        for (size_t i = 0; ok && i < got.size(); ++i) ok = got[i] == expected[i];
+        if (!ok) {
+            if (failures < 10) {
+                fprintf(stderr, "Query %d (%s", q, idx.term_at(w[0].term).c_str());
+                for (size_t i = 1; i < n; ++i) fprintf(stderr, " [%d,%d] %s", w[i].lo, w[i].hi, idx.term_at(w[i].term).c_str());
+                fprintf(stderr, "): %zu docs, expected %zu\n", got.size(), expected.size());
+            }
+            failures++;
+        }
+        if (got.size()) matched++;
+    }
+    if (failures) {
+        fprintf(stderr, "Phrase test FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("%s: %d phrase/NEAR queries match a corpus scan (%d non-empty)\n", argv[1], nqueries, matched);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_mapped_index.h"
+#include "../include/sch_rank.h"
+#include "test_util.h"
+
+static SchTestRng rng(99);
+
+static SchVector<SchScoredDoc> run(const SchMappedIndex& idx, const size_t* terms, size_t n, size_t k, bool pruned) {
+    SchVector<SchTermCursor> cursors;
+    cursors.resize(n);
+    for (size_t i = 0; i < n; ++i) cursors[i].init(idx, terms[i]);
+    SchTopK top(k);
+    if (pruned) sch_maxscore_topk(idx, cursors.begin(), n, top);
+    else sch_exhaustive_topk(idx, cursors.begin(), n, top);
+    return top.sorted();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <mapped_index> [<mapped_index> ...]\n", argv[0]);
+        return 1;
+    }
+    int failures = 0;
+    for (int a = 1; a < argc; ++a) {
+        SchMappedIndex idx;
+        if (!idx.open(argv[a]) || !idx.has_scores()) { fprintf(stderr, "Need a mapped index with scores: %s\n", argv[a]); return 1; }
+
+        unsigned long long tf_total = 0, len_total = 0;
+        for (size_t t = 0; t < idx.vocab_size(); ++t) {
+            const unsigned char* f = idx.freqs(t);
+            for (size_t i = 0; i < idx.postings(t).size; ++i) tf_total += sch_freq_at(f, i);
+        }
+        for (size_t d = 0; d < idx.doc_count(); ++d) len_total += idx.doc_len(d);
+        if (tf_total != len_total) {
+            fprintf(stderr, "%s: term frequencies sum to %llu, document lengths to %llu\n", argv[a], tf_total, len_total);
+            failures++;
+        }
+
+        SchVector<size_t> by_df[3];
+        for (size_t t = 0; t < idx.vocab_size(); ++t) {
+            size_t df = idx.postings(t).size;
+            by_df[df < 20 ? 0 : (df < 2000 ? 1 : 2)].push_back(t);
+        }
+        size_t ks[] = {1, 10, 100};
+        int queries = 0;
+        for (int q = 0; q < 600; ++q) {
+            size_t terms[6];
+            size_t n = 1 + rng(5);
+            for (size_t i = 0; i < n; ++i) {
+                size_t b = rng(3);
+                for (int tries = 0; tries < 3 && by_df[b].size() == 0; ++tries) b = (b + 1) % 3;
+                terms[i] = by_df[b].size() ? by_df[b][rng(by_df[b].size())] : 0;
+            }
+            if (q % 50 == 0 && n > 1) terms[n - 1] = terms[0];
+            for (size_t ki = 0; ki < 3; ++ki) {
+                SchVector<SchScoredDoc> w = run(idx, terms, n, ks[ki], true);
+                SchVector<SchScoredDoc> e = run(idx, terms, n, ks[ki], false);
+                bool ok = w.size() == e.size();
+                for (size_t i = 0; ok && i < w.size(); ++i) ok = w[i].doc == e[i].doc && w[i].score == e[i].score;
+                if (!ok) {
+                    if (failures < 10) fprintf(stderr, "%s: MaxScore top-%zu differs from exhaustive for query %d\n", argv[a], ks[ki], q);
+                    failures++;
+                }
+                queries++;
+            }
+        }
+        printf("%s: %d ranked queries match exhaustive BM25\n", argv[a], queries);
+    }
+    if (failures) {
+        fprintf(stderr, "Ranking test FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+    return 0;
+}
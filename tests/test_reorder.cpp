@@ -0,0 +1,94 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "../include/sch_containers.h"
+#include "../include/sch_reorder.h"
+#include "test_util.h"
+
+// Checks sch_bisect_order on synthetic corpora: documents drawn from a few
+// topics, each with its own vocabulary, are shuffled; the order must be a
+// permutation, must not depend on the thread count and must bring the
+// log2-gap cost of the posting lists well below that of the shuffled ids.
+
+static SchTestRng rng(2525);
+
+static int failures = 0;
+
+// Average log2(gap) over all postings when document order[i] gets id i.
+static double log_gap_cost(const SchVector<uint32_t>& offsets, const SchVector<uint32_t>& terms, size_t nterms,
+                           const SchVector<uint32_t>& order) {
+    size_t ndocs = order.size();
+    SchVector<int64_t> last;
+    last.resize(nterms);
+    for (size_t t = 0; t < nterms; ++t) last[t] = -1;
+    double cost = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < ndocs; ++i) {
+        for (uint32_t k = offsets[order[i]]; k < offsets[order[i] + 1]; ++k) {
+            cost += std::log2((double)((int64_t)i - last[terms[k]]));
+            last[terms[k]] = (int64_t)i;
+            n++;
+        }
+    }
+    return n ? cost / n : 0;
+}
+
+static void check(size_t ndocs, size_t topics, size_t words_per_topic) {
+    size_t nterms = topics * words_per_topic + 50;
+    SchVector<uint32_t> offsets, terms;
+    offsets.push_back(0);
+    SchVector<unsigned char> used;
+    used.resize(nterms);
+    for (size_t d = 0; d < ndocs; ++d) {
+        for (size_t t = 0; t < nterms; ++t) used[t] = 0;
+        size_t topic = rng(topics), len = 5 + rng(30);
+        for (size_t j = 0; j < len; ++j) {
+            // Mostly topic words, some shared by every topic.
+            size_t t = rng(5) ? topic * words_per_topic + rng(words_per_topic) : topics * words_per_topic + rng(50);
+            if (used[t]) continue;
+            used[t] = 1;
+            terms.push_back((uint32_t)t);
+        }
+        offsets.push_back((uint32_t)terms.size());
+    }
+
+    SchVector<uint32_t> order, order_mt;
+    sch_bisect_order(offsets.begin(), terms.begin(), ndocs, nterms, 1, order);
+    sch_bisect_order(offsets.begin(), terms.begin(), ndocs, nterms, 3, order_mt);
+    bool ok = order.size() == ndocs && order_mt.size() == ndocs;
+    SchVector<unsigned char> seen;
+    seen.resize(ndocs);
+    for (size_t i = 0; i < ndocs; ++i) seen[i] = 0;
+    for (size_t i = 0; ok && i < ndocs; ++i) {
+        ok = order[i] < ndocs && !seen[order[i]] && order[i] == order_mt[i];
+        if (ok) seen[order[i]] = 1;
+    }
+    if (!ok) {
+        if (failures < 10) fprintf(stderr, "sch_bisect_order: %zu documents: not a permutation or differs between 1 and 3 threads\n", ndocs);
+        failures++;
+        return;
+    }
+    SchVector<uint32_t> identity;
+    for (size_t i = 0; i < ndocs; ++i) identity.push_back((uint32_t)i);
+    double before = log_gap_cost(offsets, terms, nterms, identity), after = log_gap_cost(offsets, terms, nterms, order);
+    if (ndocs >= 256 && after > before * 0.8) {
+        if (failures < 10) fprintf(stderr, "sch_bisect_order: %zu documents in %zu topics: log2 gap %.2f -> %.2f bits\n", ndocs, topics, before, after);
+        failures++;
+    }
+}
+
+int main() {
+    int cases = 0;
+    size_t sizes[] = {0, 1, 2, 17, 100, 256, 1000, 5000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        check(sizes[s], 8, 40);
+        check(sizes[s], 32, 20);
+        cases += 2;
+    }
+    if (failures) {
+        fprintf(stderr, "Reorder test FAILED: %d cases\n", failures);
+        return 1;
+    }
+    printf("%d document orders are permutations with lower gap cost\n", cases);
+    return 0;
+}
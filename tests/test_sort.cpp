@@ -0,0 +1,83 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/sch_containers.h"
+#include "../include/sch_sort.h"
+#include "test_util.h"
+
+// Checks the radix sorts of index_builder: sch_sort_strings against strcmp
+// order on vocabularies with long shared prefixes, duplicates and bytes above
+// 127, and sch_sort_by_key for order and stability.
+
+static SchTestRng rng(2222);
+
+static int failures = 0;
+
+static void check_strings(size_t n, size_t alphabet, size_t max_len) {
+    SchVector<char*> strs;
+    for (size_t i = 0; i < n; ++i) {
+        size_t len = rng(max_len + 1);
+        char* s = new char[len + 1];
+        // A quarter of the strings extend a prefix of an earlier one.
+        const char* base = rng(4) == 0 && i ? strs[rng(i)] : "";
+        size_t shared = std::strlen(base);
+        if (shared > len) shared = len;
+        std::memcpy(s, base, shared);
+        for (size_t j = shared; j < len; ++j) {
+            s[j] = (char)(alphabet > 26 ? 1 + rng(255) : 'a' + rng(alphabet));
+        }
+        s[len] = '\0';
+        strs.push_back(s);
+    }
+    SchVector<SchStrHandle> h;
+    for (size_t i = 0; i < n; ++i) h.push_back(SchStrHandle{(const unsigned char*)strs[i], (uint32_t)i});
+    sch_sort_strings(h);
+    bool ok = h.size() == n;
+    SchVector<char> seen;
+    seen.resize(n);
+    for (size_t i = 0; i < n; ++i) seen[i] = 0;
+    for (size_t i = 0; ok && i < n; ++i) {
+        ok = !seen[h[i].id] && (const char*)h[i].s == strs[h[i].id];
+        seen[h[i].id] = 1;
+        if (ok && i > 0) ok = std::strcmp((const char*)h[i - 1].s, (const char*)h[i].s) <= 0;
+    }
+    if (!ok) {
+        if (failures < 10) fprintf(stderr, "sch_sort_strings: %zu strings over %zu symbols out of order\n", n, alphabet);
+        failures++;
+    }
+    for (size_t i = 0; i < n; ++i) delete[] strs[i];
+}
+
+static void check_keys(size_t n, uint32_t range) {
+    SchVector<uint32_t> keys, ids;
+    for (size_t i = 0; i < n; ++i) {
+        keys.push_back(range ? (uint32_t)rng(range) : (uint32_t)(rng(65536) << 16 | rng(65536)));
+        ids.push_back((uint32_t)i);
+    }
+    sch_sort_by_key(ids, keys.begin());
+    bool ok = ids.size() == n;
+    for (size_t i = 1; ok && i < n; ++i) {
+        uint32_t a = keys[ids[i - 1]], b = keys[ids[i]];
+        ok = a < b || (a == b && ids[i - 1] < ids[i]);
+    }
+    if (!ok) {
+        if (failures < 10) fprintf(stderr, "sch_sort_by_key: %zu keys below %u out of order\n", n, range);
+        failures++;
+    }
+}
+
+int main() {
+    int cases = 0;
+    for (int q = 0; q < 200; ++q) {
+        size_t n = rng(q % 10 ? 300 : 20000);
+        check_strings(n, q % 3 == 0 ? 2 : (q % 3 == 1 ? 26 : 255), q % 5 ? 12 : 80);
+        check_keys(n, q % 4 == 0 ? 0 : (uint32_t)(1 + rng(q % 4 == 1 ? 3 : 100000)));
+        cases++;
+    }
+    if (failures) {
+        fprintf(stderr, "Sort test FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("%d string and key sorts match\n", cases);
+    return 0;
+}
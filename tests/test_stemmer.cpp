@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unordered_set>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_string_utils.h"
+#include "../include/sch_stemmer.h"
+#include "reference_text_pipeline.h"
+
+static int failures = 0;
+static size_t checked = 0;
+static SchStemCache cache(256);
+
+static void check(const std::string& word) {
+    std::string expected = reference_stem(word);
+    SchString got = stem_word(SchString(word.data(), word.size()));
+    bool ok = expected == got.c_str();
+    std::string lower = word;
+    for (size_t i = 0; i < lower.size(); ++i) lower[i] = (char)std::tolower((unsigned char)lower[i]);
+    if (ok && word.size() > 2) {
+        std::string buf = lower;
+        size_t n = cache.stem(&buf[0], buf.size());
+        ok = expected == buf.substr(0, n);
+    }
+    if (!ok) {
+        if (failures < 10) fprintf(stderr, "MISMATCH: '%s' -> expected '%s', got '%s'\n", word.c_str(), expected.c_str(), got.c_str());
+        failures++;
+    }
+    checked++;
+}
+
+int main(int argc, char* argv[]) {
+    const char* cases[] = {
+        "", "a", "is", "IS", "Running", "caresses", "ponies", "ties", "caress", "cats", "feed", "agreed",
+        "plastered", "bled", "motoring", "sing", "conflated", "troubled", "sized", "hopping", "tanned",
+        "falling", "hissing", "fizzed", "failing", "filing", "happy", "sky", "relational", "conditional",
+        "rational", "valenci", "hesitanci", "digitizer", "conformabli", "radicalli", "differentli", "vileli",
+        "analogousli", "vietnamization", "predication", "operator", "feudalism", "decisiveness", "hopefulness",
+        "callousness", "formaliti", "sensitiviti", "sensibiliti", "triplicate", "formative", "formalize",
+        "electriciti", "electrical", "hopeful", "goodness", "revival", "allowance", "inference", "airliner",
+        "gyroscopic", "adjustable", "defensible", "irritant", "replacement", "adjustment", "dependent",
+        "adoption", "homologou", "communism", "activate", "angulariti", "homologous", "effective", "bowdlerize",
+        "probate", "rate", "cease", "controll", "roll", "yyyy", "syzygy", "yelling", "toying", "enjoy",
+        "eed", "ing", "ies", "sses", "xyz", "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz",
+        nullptr
+    };
+    for (int i = 0; cases[i]; ++i) check(cases[i]);
+
+    const char alphabet[] = "aeiouybcdlnstzwx";
+    unsigned seed = 777;
+    for (int i = 0; i < 200000; ++i) {
+        std::string s;
+        size_t len = 1 + (size_t)(i % 12);
+        for (size_t j = 0; j < len; ++j) {
+            seed = seed * 1103515245u + 12345u;
+            s.push_back(alphabet[(seed >> 16) % (sizeof(alphabet) - 1)]);
+        }
+        check(s);
+    }
+
+    size_t vocab = 0;
+    if (argc > 1) {
+        FILE* f = fopen(argv[1], "r");
+        if (f) {
+            char line[4096];
+            if (!fgets(line, sizeof(line), f)) line[0] = '\0';
+            while (fgets(line, sizeof(line), f)) {
+                char* comma = std::strrchr(line, ',');
+                if (!comma) continue;
+                check(std::string(line, comma - line));
+                vocab++;
+            }
+            fclose(f);
+        }
+    }
+
+    size_t surface = 0;
+    if (argc > 2) {
+        std::unordered_set<std::string> seen;
+        DIR* dir = opendir(argv[2]);
+        if (dir) {
+            struct dirent* ent;
+            while ((ent = readdir(dir)) != NULL) {
+                size_t ln = std::strlen(ent->d_name);
+                if (ln <= 4 || std::strcmp(ent->d_name + ln - 4, ".txt") != 0) continue;
+                std::string path = std::string(argv[2]) + "/" + ent->d_name;
+                FILE* f = fopen(path.c_str(), "rb");
+                if (!f) continue;
+                std::string text;
+                char buf[65536];
+                size_t r;
+                while ((r = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, r);
+                fclose(f);
+                sch_tokenize_inplace(&text[0], text.size(), [&seen](const char* tok, size_t len) {
+                    seen.insert(std::string(tok, len));
+                });
+            }
+            closedir(dir);
+        }
+        for (const std::string& w : seen) check(w);
+        surface = seen.size();
+    }
+
+    if (failures) {
+        fprintf(stderr, "Stemmer differential test FAILED: %d of %zu words differ\n", failures, checked);
+        return 1;
+    }
+    printf("Stemmer differential test passed (%zu words: %zu vocabulary terms, %zu corpus tokens).\n", checked, vocab, surface);
+    return 0;
+}
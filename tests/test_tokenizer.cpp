@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <vector>
+#include "../include/sch_containers.h"
+#include "../include/sch_string.h"
+#include "../include/sch_string_utils.h"
+#include "reference_text_pipeline.h"
+
+static int failures = 0;
+
+static void check(const std::string& text, size_t min_len, const char* what) {
+    std::vector<std::string> expected = reference_tokenize(text.data(), text.size(), min_len);
+    std::vector<std::string> got;
+    std::string buf = text;
+    sch_tokenize_inplace(&buf[0], buf.size(), [&got](const char* tok, size_t len) {
+        got.push_back(std::string(tok, len));
+    }, min_len);
+    SchVector<SchString> via_api = tokenize(SchString(text.data(), text.size()), min_len);
+
+    bool ok = expected == got && via_api.size() == expected.size();
+    for (size_t i = 0; ok && i < expected.size(); ++i) ok = expected[i] == via_api[i].c_str();
+    if (!ok) {
+        if (failures < 10) fprintf(stderr, "MISMATCH (%s): expected %zu tokens, got %zu\n", what, expected.size(), got.size());
+        failures++;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* cases[] = {
+        "", "a", " ", "A", "Hello, World!", "  leading and trailing  ", "MiXeD123CaSe_under-score",
+        "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ",
+        "a.b,c;d:e!f?g", "\t\n\r tabs\tand\nnewlines\r", "[@`{/:] boundaries", "x",
+        "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 utf8 \xc3\xa9t\xc3\xa9", nullptr
+    };
+    for (int i = 0; cases[i]; ++i) {
+        for (size_t m = 1; m <= 3; ++m) check(cases[i], m, cases[i]);
+    }
+
+    unsigned seed = 12345;
+    for (int i = 0; i < 2000; ++i) {
+        std::string s;
+        size_t len = (size_t)(i % 97);
+        for (size_t j = 0; j < len; ++j) {
+            seed = seed * 1103515245u + 12345u;
+            s.push_back((char)(seed >> 16));
+        }
+        check(s, 1 + (size_t)(i % 3), "random bytes");
+    }
+
+    size_t files = 0;
+    if (argc > 1) {
+        DIR* dir = opendir(argv[1]);
+        if (dir) {
+            struct dirent* ent;
+            while ((ent = readdir(dir)) != NULL) {
+                size_t ln = std::strlen(ent->d_name);
+                if (ln <= 4 || std::strcmp(ent->d_name + ln - 4, ".txt") != 0) continue;
+                std::string path = std::string(argv[1]) + "/" + ent->d_name;
+                FILE* f = fopen(path.c_str(), "rb");
+                if (!f) continue;
+                std::string text;
+                char buf[65536];
+                size_t r;
+                while ((r = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, r);
+                fclose(f);
+                check(text, 1, ent->d_name);
+                files++;
+            }
+            closedir(dir);
+        }
+    }
+
+    if (failures) {
+        fprintf(stderr, "Tokenizer differential test FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("Tokenizer differential test passed (%zu corpus files).\n", files);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef SCH_TEST_UTIL_H
+#define SCH_TEST_UTIL_H
+
+// Helpers shared by the tests and benchmarks: a seeded generator (each file
+// keeps its own seed, so the generated inputs do not change), a monotonic
+// clock, and random posting lists kept together with their membership.
+
+#include <chrono>
+#include "../include/sch_containers.h"
+#include "../include/sch_postings.h"
+
+struct SchTestRng {
+    unsigned state;
+    explicit SchTestRng(unsigned seed) : state(seed) {}
+    size_t operator()(size_t n) {
+        state = state * 1103515245u + 12345u;
+        return (size_t)(state >> 8) % n;
+    }
+};
+
+inline double now_sec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct TestList {
+    SchVector<int> ids;
+    SchVector<unsigned char> encoded;
+    SchVector<char> member;
+};
+
+// Lists are uniform at one of five densities, or, with clustered set, also
+// runs of nearby documents with long jumps between them, which the codec
+// stores as patched exceptions.
+inline void make_list(TestList& l, size_t universe, SchTestRng& rng, bool clustered) {
+    size_t density = rng(clustered ? 6 : 5);
+    size_t per_thousand = density == 0 ? 1 : (density == 1 ? 20 : (density == 2 ? 150 : (density == 3 ? 600 : 990)));
+    bool in_run = false;
+    for (size_t d = 0; d < universe; ++d) {
+        if (density == 5) in_run = in_run ? rng(1000) >= 40 : rng(1000) < 3;
+        bool in = density == 5 ? in_run && rng(4) != 0 : rng(1000) < per_thousand;
+        l.member.push_back(in);
+        if (in) l.ids.push_back((int)d);
+    }
+    sch_encode_postings(l.ids.begin(), l.ids.size(), l.encoded);
+    for (size_t i = 0; i < SCH_CODEC_SLACK; ++i) l.encoded.push_back(0);
+}
+
+#endif